@@ -36,10 +36,35 @@ However, SH1106 driver don't provide several functions such as scroll commands.
 
 #include "Adafruit_GFX.h"
 #include "Adafruit_SH1106.h"
+#include "glcdfont.c" // the classic 5x7 font of Adafruit_GFX, for blitChar()
 
-// the memory buffer for the LCD
+#ifdef SH1106_ASYNC
+ #include <hardware/dma.h>
+ #include <hardware/i2c.h>
+#endif
+#ifdef SH1106_PIO_SPI
+ #include <hardware/clocks.h>
+ #include <hardware/pio.h>
+
+// SPI mode 0 transmitter, MSB first, 4 PIO cycles per bit
+//   .side_set 1          ; SCLK
+//   out pins, 1  side 0 [1]
+//   nop          side 1 [1]
+static const uint16_t spi_tx_instructions[] = {
+  0x6101,
+  0xb142,
+};
+
+static const pio_program_t spi_tx_program = {
+  .instructions = spi_tx_instructions,
+  .length = 2,
+  .origin = -1,
+};
+#endif
 
-static uint8_t buffer[SH1106_LCDHEIGHT * SH1106_LCDWIDTH / 8] = { 
+// the splash screen, copied into the buffer of a panel of the default size
+
+static const uint8_t splash[SH1106_LCDHEIGHT * SH1106_LCDWIDTH / 8] PROGMEM = { 
 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -110,98 +135,66 @@ static uint8_t buffer[SH1106_LCDHEIGHT * SH1106_LCDWIDTH / 8] = {
 #endif
 };
 
-#define sh1106_swap(a, b) { int16_t t = a; a = b; b = t; }
-
-// the most basic function, set a single pixel
-void Adafruit_SH1106::drawPixel(int16_t x, int16_t y, uint16_t color) {
-  if ((x < 0) || (x >= width()) || (y < 0) || (y >= height()))
-    return;
-
-  // check rotation, move pixel around if necessary
-  switch (getRotation()) {
-  case 1:
-    sh1106_swap(x, y);
-    x = WIDTH - x - 1;
-    break;
-  case 2:
-    x = WIDTH - x - 1;
-    y = HEIGHT - y - 1;
-    break;
-  case 3:
-    sh1106_swap(x, y);
-    y = HEIGHT - y - 1;
-    break;
-  }  
-
-  // x is which column
-    switch (color) 
-    {
-      case WHITE:   buffer[x+ (y/8)*SH1106_LCDWIDTH] |=  (1 << (y&7)); break;
-      case BLACK:   buffer[x+ (y/8)*SH1106_LCDWIDTH] &= ~(1 << (y&7)); break; 
-      case INVERSE: buffer[x+ (y/8)*SH1106_LCDWIDTH] ^=  (1 << (y&7)); break; 
-    }
-    
+Adafruit_SH1106_Base::Adafruit_SH1106_Base(int16_t w, int16_t h, const SH1106_Storage &storage) :
+Adafruit_GFX(w, h), buffer(storage.buffer), sent(storage.sent), dirtyFirst(storage.dirtyFirst), dirtyLast(storage.dirtyLast), stream(storage.stream) {
+  pages = h / 8;
+  wire = &Wire;
+  sclk = dc = cs = sid = -1;
+  rst = -1;
+  if (w == SH1106_LCDWIDTH && h == SH1106_LCDHEIGHT) {
+    memcpy_P(buffer, splash, sizeof(splash));
+  } else {
+    memset(buffer, 0, w * pages);
+  }
 }
 
-Adafruit_SH1106::Adafruit_SH1106(int8_t SID, int8_t SCLK, int8_t DC, int8_t RST, int8_t CS) : Adafruit_GFX(SH1106_LCDWIDTH, SH1106_LCDHEIGHT) {
+void Adafruit_SH1106_Base::initSoftSPI(int8_t SID, int8_t SCLK, int8_t DC, int8_t RST, int8_t CS) {
   cs = CS;
   rst = RST;
   dc = DC;
   sclk = SCLK;
   sid = SID;
-  hwSPI = false;
+  transport = SH1106_TRANSPORT_SOFT_SPI;
+  busClock = SH1106_SPI_CLOCK;
 }
 
-// constructor for hardware SPI - we indicate DataCommand, ChipSelect, Reset 
-Adafruit_SH1106::Adafruit_SH1106(int8_t DC, int8_t RST, int8_t CS) : Adafruit_GFX(SH1106_LCDWIDTH, SH1106_LCDHEIGHT) {
+// hardware SPI - we indicate DataCommand, ChipSelect, Reset 
+void Adafruit_SH1106_Base::initHardSPI(int8_t DC, int8_t RST, int8_t CS) {
   dc = DC;
   rst = RST;
   cs = CS;
-  hwSPI = true;
+  transport = SH1106_TRANSPORT_HW_SPI;
+  busClock = SH1106_SPI_CLOCK;
 }
 
-// initializer for I2C - we only indicate the reset pin!
-Adafruit_SH1106::Adafruit_SH1106(int8_t reset) :
-Adafruit_GFX(SH1106_LCDWIDTH, SH1106_LCDHEIGHT) {
+// I2C - we only indicate the reset pin and the bus!
+void Adafruit_SH1106_Base::initI2C(int8_t reset, TwoWire &bus) {
   sclk = dc = cs = sid = -1;
   rst = reset;
+  wire = &bus;
+  transport = SH1106_TRANSPORT_I2C;
 }
   
 
-void Adafruit_SH1106::begin(uint8_t vccstate, uint8_t i2caddr, bool reset) {
+void Adafruit_SH1106_Base::begin(uint8_t vccstate, uint8_t i2caddr, bool reset) {
   _vccstate = vccstate;
   _i2caddr = i2caddr;
+  invalidate();
 
   // set pin directions
-  if (sid != -1){
-//     pinMode(dc, OUTPUT);
-//     pinMode(cs, OUTPUT);
-//     csport      = portOutputRegister(digitalPinToPort(cs));
-//     cspinmask   = digitalPinToBitMask(cs);
-//     dcport      = portOutputRegister(digitalPinToPort(dc));
-//     dcpinmask   = digitalPinToBitMask(dc);
-//     if (!hwSPI){
-//       // set pins for software-SPI
-//       pinMode(sid, OUTPUT);
-//       pinMode(sclk, OUTPUT);
-//       clkport     = portOutputRegister(digitalPinToPort(sclk));
-//       clkpinmask  = digitalPinToBitMask(sclk);
-//       mosiport    = portOutputRegister(digitalPinToPort(sid));
-//       mosipinmask = digitalPinToBitMask(sid);
-//       }
-//     if (hwSPI){
-//       SPI.begin ();
-// #ifdef __SAM3X8E__
-//       SPI.setClockDivider (9); // 9.3 MHz
-// #else
-//       SPI.setClockDivider (SPI_CLOCK_DIV2); // 8 MHz
-// #endif
-      // }
-    }
+  if (transport != SH1106_TRANSPORT_I2C) {
+    spiBegin();
+  }
   else
   {
     // I2C Init
-    Wire.begin();
+    wire->begin();
+    wire->setClock(busClock);
+#ifdef SH1106_ASYNC
+    if (dmaChannel < 0) {
+      dmaChannel = dma_claim_unused_channel(false);
+    }
+#endif
 #ifdef __SAM3X8E__
     // Force 400 KHz I2C, rawr! (Uses pins 20, 21 for SDA, SCL)
     TWI1->TWI_CWGR = 0;
@@ -224,7 +217,7 @@ void Adafruit_SH1106::begin(uint8_t vccstate, uint8_t i2caddr, bool reset) {
     // turn on VCC (9V?)
   }
 
-   #if defined SH1106_128_32
+  if (HEIGHT == 32) {
     // Init sequence for 128x32 OLED module
     SH1106_command(SH1106_DISPLAYOFF);                    // 0xAE
     SH1106_command(SH1106_SETDISPLAYCLOCKDIV);            // 0xD5
@@ -256,9 +249,9 @@ void Adafruit_SH1106::begin(uint8_t vccstate, uint8_t i2caddr, bool reset) {
     SH1106_command(0x40);
     SH1106_command(SH1106_DISPLAYALLON_RESUME);           // 0xA4
     SH1106_command(SH1106_NORMALDISPLAY);                 // 0xA6
-  #endif
+  }
 
-  #if defined SH1106_128_64
+  if (HEIGHT == 64) {
     // Init sequence for 128x64 OLED module
     SH1106_command(SH1106_DISPLAYOFF);                    // 0xAE
     SH1106_command(SH1106_SETDISPLAYCLOCKDIV);            // 0xD5
@@ -294,9 +287,9 @@ void Adafruit_SH1106::begin(uint8_t vccstate, uint8_t i2caddr, bool reset) {
     SH1106_command(0x40);
     SH1106_command(SH1106_DISPLAYALLON_RESUME);           // 0xA4
     SH1106_command(SH1106_NORMALDISPLAY);                 // 0xA6
-  #endif
+  }
   
-  #if defined SH1106_96_16
+  if (HEIGHT == 16) {
     // Init sequence for 96x16 OLED module
     SH1106_command(SH1106_DISPLAYOFF);                    // 0xAE
     SH1106_command(SH1106_SETDISPLAYCLOCKDIV);            // 0xD5
@@ -331,13 +324,13 @@ void Adafruit_SH1106::begin(uint8_t vccstate, uint8_t i2caddr, bool reset) {
     SH1106_command(0x40);
     SH1106_command(SH1106_DISPLAYALLON_RESUME);           // 0xA4
     SH1106_command(SH1106_NORMALDISPLAY);                 // 0xA6
-  #endif
+  }
 
   SH1106_command(SH1106_DISPLAYON);//--turn on oled panel
 }
 
 
-void Adafruit_SH1106::invertDisplay(uint8_t i) {
+void Adafruit_SH1106_Base::invertDisplay(uint8_t i) {
   if (i) {
     SH1106_command(SH1106_INVERTDISPLAY);
   } else {
@@ -345,28 +338,21 @@ void Adafruit_SH1106::invertDisplay(uint8_t i) {
   }
 }
 
-void Adafruit_SH1106::SH1106_command(uint8_t c) { 
-  if (sid != -1)
+void Adafruit_SH1106_Base::SH1106_command(uint8_t c) { 
+  if (transport != SH1106_TRANSPORT_I2C)
   {
     // SPI
-    //digitalWrite(cs, HIGH);
-    *csport |= cspinmask;
-    //digitalWrite(dc, LOW);
-    *dcport &= ~dcpinmask;
-    //digitalWrite(cs, LOW);
-    *csport &= ~cspinmask;
-    fastSPIwrite(c);
-    //digitalWrite(cs, HIGH);
-    *csport |= cspinmask;
+    spiWrite(false, &c, 1);
   }
   else
   {
     // I2C
     uint8_t control = 0x00;   // Co = 0, D/C = 0
-    Wire.beginTransmission(_i2caddr);
-    WIRE_WRITE(control);
-    WIRE_WRITE(c);
-    Wire.endTransmission();
+    wire->beginTransmission(_i2caddr);
+    wire->write(control);
+    wire->write(c);
+    wire->endTransmission();
+    bytesSent += 2;
   }
  
 }
@@ -375,7 +361,7 @@ void Adafruit_SH1106::SH1106_command(uint8_t c) {
 // Activate a right handed scroll for rows start through stop
 // Hint, the display is 16 rows tall. To scroll the whole display, run:
 // display.scrollright(0x00, 0x0F) 
-/*void Adafruit_SH1106::startscrollright(uint8_t start, uint8_t stop){
+/*void Adafruit_SH1106_Base::startscrollright(uint8_t start, uint8_t stop){
   SH1106_command(SH1106_RIGHT_HORIZONTAL_SCROLL);
   SH1106_command(0X00);
   SH1106_command(start);
@@ -390,7 +376,7 @@ void Adafruit_SH1106::SH1106_command(uint8_t c) {
 // Activate a right handed scroll for rows start through stop
 // Hint, the display is 16 rows tall. To scroll the whole display, run:
 // display.scrollright(0x00, 0x0F) 
-void Adafruit_SH1106::startscrollleft(uint8_t start, uint8_t stop){
+void Adafruit_SH1106_Base::startscrollleft(uint8_t start, uint8_t stop){
   SH1106_command(SH1106_LEFT_HORIZONTAL_SCROLL);
   SH1106_command(0X00);
   SH1106_command(start);
@@ -405,7 +391,7 @@ void Adafruit_SH1106::startscrollleft(uint8_t start, uint8_t stop){
 // Activate a diagonal scroll for rows start through stop
 // Hint, the display is 16 rows tall. To scroll the whole display, run:
 // display.scrollright(0x00, 0x0F) 
-void Adafruit_SH1106::startscrolldiagright(uint8_t start, uint8_t stop){
+void Adafruit_SH1106_Base::startscrolldiagright(uint8_t start, uint8_t stop){
   SH1106_command(SH1106_SET_VERTICAL_SCROLL_AREA);  
   SH1106_command(0X00);
   SH1106_command(SH1106_LCDHEIGHT);
@@ -422,7 +408,7 @@ void Adafruit_SH1106::startscrolldiagright(uint8_t start, uint8_t stop){
 // Activate a diagonal scroll for rows start through stop
 // Hint, the display is 16 rows tall. To scroll the whole display, run:
 // display.scrollright(0x00, 0x0F) 
-void Adafruit_SH1106::startscrolldiagleft(uint8_t start, uint8_t stop){
+void Adafruit_SH1106_Base::startscrolldiagleft(uint8_t start, uint8_t stop){
   SH1106_command(SH1106_SET_VERTICAL_SCROLL_AREA);  
   SH1106_command(0X00);
   SH1106_command(SH1106_LCDHEIGHT);
@@ -435,14 +421,14 @@ void Adafruit_SH1106::startscrolldiagleft(uint8_t start, uint8_t stop){
   SH1106_command(SH1106_ACTIVATE_SCROLL);
 }
 
-void Adafruit_SH1106::stopscroll(void){
+void Adafruit_SH1106_Base::stopscroll(void){
   SH1106_command(SH1106_DEACTIVATE_SCROLL);
 }
 
 // Dim the display
 // dim = true: display is dimmed
 // dim = false: display is normal
-void Adafruit_SH1106::dim(boolean dim) {
+void Adafruit_SH1106_Base::dim(boolean dim) {
   uint8_t contrast;
 
   if (dim) {
@@ -460,29 +446,22 @@ void Adafruit_SH1106::dim(boolean dim) {
   SH1106_command(contrast);
 }*/
 
-void Adafruit_SH1106::SH1106_data(uint8_t c) {
+void Adafruit_SH1106_Base::SH1106_data(uint8_t c) {
  
-  if (sid != -1)
+  if (transport != SH1106_TRANSPORT_I2C)
   {
     // SPI
-    //digitalWrite(cs, HIGH);
-    *csport |= cspinmask;
-    //digitalWrite(dc, HIGH);
-    *dcport |= dcpinmask;
-    //digitalWrite(cs, LOW);
-    *csport &= ~cspinmask;
-    fastSPIwrite(c);
-    //digitalWrite(cs, HIGH);
-    *csport |= cspinmask;
+    spiWrite(true, &c, 1);
   }
   else
   {
     // I2C
     uint8_t control = 0x40;   // Co = 0, D/C = 1
-    Wire.beginTransmission(_i2caddr);
-    WIRE_WRITE(control);
-    WIRE_WRITE(c);
-    Wire.endTransmission();
+    wire->beginTransmission(_i2caddr);
+    wire->write(control);
+    wire->write(c);
+    wire->endTransmission();
+    bytesSent += 2;
   }
   
 }
@@ -491,91 +470,202 @@ void Adafruit_SH1106::SH1106_data(uint8_t c) {
 
 #define SH1106_SETSTARTLINE 0x40*/
 
-void Adafruit_SH1106::display(void) {
-	
-    SH1106_command(SH1106_SETLOWCOLUMN | 0x0);  // low col = 0
-    SH1106_command(SH1106_SETHIGHCOLUMN | 0x0);  // hi col = 0
-    SH1106_command(SH1106_SETSTARTLINE | 0x0); // line #0
-	
-  
+void Adafruit_SH1106_Base::setBusClock(uint32_t hz) {
+  busClock = hz;
+  if (transport == SH1106_TRANSPORT_I2C) {
+    wire->setClock(busClock);
+  }
+#ifdef SH1106_PIO_SPI
+  if (pio != NULL) {
+    pio_sm_set_clkdiv(pio, pioSm, (float)clock_get_hz(clk_sys) / (4.0f * busClock));
+  }
+#endif
+}
 
+void Adafruit_SH1106_Base::invalidate(void) {
+  sentValid = false;
+  for (uint8_t page = 0; page < pages; page++) {
+    dirtyFirst[page] = 0;
+    dirtyLast[page] = WIDTH - 1;
+  }
+}
 
-    //Serial.println(TWBR, DEC);
-    //Serial.println(TWSR & 0x3, DEC);
+// take the column range of a page that has to be sent and mark it as sent.
+// returns false if the page is unchanged
+bool Adafruit_SH1106_Base::nextRange(uint8_t page, uint8_t &first, uint8_t &last) {
+  first = dirtyFirst[page];
+  last = dirtyLast[page];
+  dirtyFirst[page] = 0xFF;
+  dirtyLast[page] = 0;
+  if (first > last) return false;
+
+  uint8_t *row = &buffer[page * WIDTH];
+  uint8_t *sentRow = &sent[page * WIDTH];
+  if (sentValid) {
+    while (first <= last && row[first] == sentRow[first]) first++;
+    if (first > last) return false;
+    while (row[last] == sentRow[last]) last--;
+  }
+  memcpy(&sentRow[first], &row[first], last - first + 1);
+  return true;
+}
 
-    // I2C
-    //height >>= 3;
-    //width >>= 3;
-	byte height=64;
-	byte width=132; 
-	byte m_row = 0;
-	byte m_col = 2;
-	
-	
-	height >>= 3;
-	width >>= 3;
-	//Serial.println(width);
-	
-	int p = 0;
-	
-	byte i, j, k =0;
-	
-	if(sid != -1)
-	{
-			
-		for ( i = 0; i < height; i++) {
-		
-		// send a bunch of data in one xmission
-        SH1106_command(0xB0 + i + m_row);//set page address
-        SH1106_command(m_col & 0xf);//set lower column address
-        SH1106_command(0x10 | (m_col >> 4));//set higher column address
-		
-        for( j = 0; j < 8; j++){        
-			// SPI
-			*csport |= cspinmask;
-			*dcport |= dcpinmask;
-			*csport &= ~cspinmask;
-			
-            for ( k = 0; k < width; k++, p++) {
-					fastSPIwrite(buffer[p]);
-            }
-            *csport |= cspinmask;
-        }
-		}
-		
-	}
-	else{
-		
-	 // save I2C bitrate
-	// #ifndef __SAM3X8E__
-  //   		uint8_t twbrbackup = TWBR;
-  //   		TWBR = 12; // upgrade to 400KHz!
-	// #endif
-	
-	for ( i = 0; i < height; i++) {
-		
-		// send a bunch of data in one xmission
-        SH1106_command(0xB0 + i + m_row);//set page address
-        SH1106_command(m_col & 0xf);//set lower column address
-        SH1106_command(0x10 | (m_col >> 4));//set higher column address
-		
-        for( j = 0; j < 8; j++){        
-			Wire.beginTransmission(_i2caddr);
-            Wire.write(0x40);
-            for ( k = 0; k < width; k++, p++) {
-		Wire.write(buffer[p]);
-            }
-            Wire.endTransmission();
-        	}
-	}
-	
-	// #ifndef __SAM3X8E__
-  //   		TWBR = twbrbackup;
-	// #endif
-	}
+// send only the pages touched since the last call, and within each page
+// only the column range that really differs from what the panel shows
+void Adafruit_SH1106_Base::display(void) {
+  waitFlush();
+  uint32_t start = micros();
+  for (uint8_t page = 0; page < pages; page++) {
+    uint8_t first, last;
+    if (nextRange(page, first, last)) {
+      sendPage(page, first, last);
+    }
+  }
+  sentValid = true;
+  lastFlushMicros = micros() - start;
+}
+
+#ifdef SH1106_ASYNC
+static_assert(SH1106_STREAM_STOP == I2C_IC_DATA_CMD_STOP_BITS, "STOP bit of IC_DATA_CMD");
+#endif
+
+// the same transmissions as sendPage() over I2C, each page ends with a STOP
+uint16_t Adafruit_SH1106_Base::queueFrame(uint16_t *out) {
+  uint16_t n = 0;
+  for (uint8_t page = 0; page < pages; page++) {
+    uint8_t first, last;
+    if (!nextRange(page, first, last)) continue;
+
+    uint8_t col = first + SH1106_COLUMN_OFFSET;
+    out[n++] = 0x80;
+    out[n++] = 0xB0 + page;//set page address
+    out[n++] = 0x80;
+    out[n++] = col & 0xf;//set lower column address
+    out[n++] = 0x80;
+    out[n++] = 0x10 | (col >> 4);//set higher column address
+    out[n++] = 0x40;
+    uint8_t *row = &buffer[page * WIDTH];
+    for (uint8_t x = first; x <= last; x++) {
+      out[n++] = row[x];
+    }
+    out[n - 1] |= SH1106_STREAM_STOP;
+  }
+  sentValid = true;
+  return n;
+}
+
+bool Adafruit_SH1106_Base::displayAsync(void) {
+#ifdef SH1106_ASYNC
+  if (transport != SH1106_TRANSPORT_I2C || dmaChannel < 0) {
+    display();
+    return true;
+  }
+  if (flushing()) return false;
+
+  // copy the changes into the stream now, so the buffer is free for the next frame
+  uint16_t n = queueFrame(stream);
+  if (n == 0) {
+    lastFlushMicros = 0;
+    return true;
+  }
+  bytesSent += n;
+
+  i2c_hw_t *hw = i2c_get_hw(i2cInst());
+  hw->enable = 0;
+  hw->tar = _i2caddr;
+  hw->enable = 1;
+
+  // 16bit writes are replicated on the bus, the upper half of IC_DATA_CMD is reserved
+  dma_channel_config c = dma_channel_get_default_config(dmaChannel);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, i2c_get_dreq(i2cInst(), true));
+  flushStart = micros();
+  asyncActive = true;
+  dma_channel_configure(dmaChannel, &c, &hw->data_cmd, stream, n, true);
+  return true;
+#else
+  display();
+  return true;
+#endif
+}
+
+bool Adafruit_SH1106_Base::flushing(void) {
+#ifdef SH1106_ASYNC
+  if (!asyncActive) return false;
+
+  i2c_hw_t *hw = i2c_get_hw(i2cInst());
+  if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+    // NACK etc. the controller flushed its FIFO, give up this frame and resend everything next time
+    dma_channel_abort(dmaChannel);
+    (void)hw->clr_tx_abrt;
+    flushErrors++;
+    asyncActive = false;
+    invalidate();
+    return false;
+  }
+  if (dma_channel_is_busy(dmaChannel)) return true;
+  // DMA is done when the last word enters the FIFO, wait until the STOP has been sent
+  if (!(hw->status & I2C_IC_STATUS_TFE_BITS) || (hw->status & I2C_IC_STATUS_MST_ACTIVITY_BITS)) return true;
+
+  asyncActive = false;
+  lastFlushMicros = micros() - flushStart;
+  return false;
+#else
+  return false;
+#endif
 }
 
-/*void Adafruit_SH1106::display(void) {
+void Adafruit_SH1106_Base::sendPage(uint8_t page, uint8_t first, uint8_t last) {
+  uint8_t col = first + SH1106_COLUMN_OFFSET;
+  uint8_t *p = &buffer[page * WIDTH + first];
+  uint8_t *end = &buffer[page * WIDTH + last + 1];
+
+  if (transport != SH1106_TRANSPORT_I2C)
+  {
+    // SPI: the three address commands in one burst with D/C low, then the page data
+    uint8_t cmd[3] = {
+      (uint8_t)(0xB0 + page),     //set page address
+      (uint8_t)(col & 0xf),       //set lower column address
+      (uint8_t)(0x10 | (col >> 4)) //set higher column address
+    };
+    spiWrite(false, cmd, sizeof(cmd));
+    spiWrite(true, p, end - p);
+    return;
+  }
+
+  // I2C: the address commands and the page data go in one transmission.
+  // Control byte 0x80 (Co = 1, D/C = 0) sends one command and expects another control byte,
+  // 0x40 (Co = 0, D/C = 1) makes every following byte display data.
+  wire->beginTransmission(_i2caddr);
+  wire->write(0x80);
+  wire->write(0xB0 + page);//set page address
+  wire->write(0x80);
+  wire->write(col & 0xf);//set lower column address
+  wire->write(0x80);
+  wire->write(0x10 | (col >> 4));//set higher column address
+  wire->write(0x40);
+  bytesSent += 7;
+
+  // if the page doesn't fit the Wire buffer, continue with data only transmissions
+  uint16_t room = SH1106_I2C_BUFFER - 7;
+  while (true) {
+    uint16_t n = min((int)room, (int)(end - p));
+    wire->write(p, n);
+    wire->endTransmission();
+    p += n;
+    bytesSent += n;
+    if (p >= end) break;
+
+    wire->beginTransmission(_i2caddr);
+    wire->write(0x40);
+    bytesSent += 1;
+    room = SH1106_I2C_BUFFER - 1;
+  }
+}
+
+/*void Adafruit_SH1106_Base::display(void) {
   SH1106_command(SH1106_COLUMNADDR);
   SH1106_command(0);   // Column start address (0 = reset)
   SH1106_command(SH1106_LCDWIDTH-1); // Column end address (127 = reset)
@@ -625,14 +715,14 @@ void Adafruit_SH1106::display(void) {
 		k++;
 		continue;
 	  }
-      Wire.beginTransmission(_i2caddr);
-      WIRE_WRITE(0x40);
+      wire->beginTransmission(_i2caddr);
+      wire->write(0x40);
       for (uint8_t x=0; x<16; x++) {
-  WIRE_WRITE(buffer[i]);
+  wire->write(buffer[i]);
   i++;
       }
       i--;
-      Wire.endTransmission();
+      wire->endTransmission();
     }
 #ifndef __SAM3X8E__
     TWBR = twbrbackup;
@@ -641,239 +731,150 @@ void Adafruit_SH1106::display(void) {
 }
 */
 // clear everything
-void Adafruit_SH1106::clearDisplay(void) {
-  memset(buffer, 0, (SH1106_LCDWIDTH*SH1106_LCDHEIGHT/8));
-}
-
-
-inline void Adafruit_SH1106::fastSPIwrite(uint8_t d) {
-  
-  if(hwSPI) {
-    (void)SPI.transfer(d);
-  } else {
-    for(uint8_t bit = 0x80; bit; bit >>= 1) {
-      *clkport &= ~clkpinmask;
-      if(d & bit) *mosiport |=  mosipinmask;
-      else        *mosiport &= ~mosipinmask;
-      *clkport |=  clkpinmask;
-    }
+void Adafruit_SH1106_Base::clearDisplay(void) {
+  memset(buffer, 0, WIDTH * pages);
+  for (uint8_t page = 0; page < pages; page++) {
+    markDirty(page, 0, WIDTH - 1);
   }
-  //*csport |= cspinmask;
 }
 
-void Adafruit_SH1106::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
-  boolean bSwap = false;
-  switch(rotation) { 
-    case 0:
-      // 0 degree rotation, do nothing
-      break;
-    case 1:
-      // 90 degree rotation, swap x & y for rotation, then invert x
-      bSwap = true;
-      sh1106_swap(x, y);
-      x = WIDTH - x - 1;
-      break;
-    case 2:
-      // 180 degree rotation, invert x and y - then shift y around for height.
-      x = WIDTH - x - 1;
-      y = HEIGHT - y - 1;
-      x -= (w-1);
-      break;
-    case 3:
-      // 270 degree rotation, swap x & y for rotation, then invert y  and adjust y for w (not to become h)
-      bSwap = true;
-      sh1106_swap(x, y);
-      y = HEIGHT - y - 1;
-      y -= (w-1);
-      break;
-  }
-
-  if(bSwap) { 
-    drawFastVLineInternal(x, y, w, color);
-  } else { 
-    drawFastHLineInternal(x, y, w, color);
-  }
+// apply a colour to the bits set in 'bits'
+static inline void applyColor(uint8_t &b, uint8_t bits, uint16_t color) {
+  if (color == WHITE) b |= bits;
+  else if (color == BLACK) b &= ~bits;
+  else if (color == INVERSE) b ^= bits;
 }
 
-void Adafruit_SH1106::drawFastHLineInternal(int16_t x, int16_t y, int16_t w, uint16_t color) {
-  // Do bounds/limit checks
-  if(y < 0 || y >= HEIGHT) { return; }
-
-  // make sure we don't try to draw below 0
-  if(x < 0) { 
-    w += x;
-    x = 0;
-  }
+// same result as Adafruit_GFX::drawChar() with the classic font at size 1
+// and no rotation, but each glyph column is shifted into the one or two page
+// bytes it covers instead of being drawn pixel by pixel.
+void Adafruit_SH1106_Base::blitChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg) {
+  if ((x >= WIDTH) || (y >= HEIGHT) || (x + 5 < 0) || (y + 7 < 0))
+    return;
+  if (!_cp437 && (c >= 176))
+    c++; // Handle 'classic' charset behavior
+
+  bool opaque = bg != color;
+  int16_t page = y >> 3; // -1 when the glyph starts above the screen
+  uint8_t shift = y & 7;
+  uint16_t mask = 0xFF << shift;
+  int16_t first = x < 0 ? 0 : x;
+  int16_t last = x + (opaque ? 5 : 4); // the 6th column is the gap, only drawn when opaque
+  if (last >= WIDTH) last = WIDTH - 1;
+  if (first > last)
+    return;
 
-  // make sure we don't go off the edge of the display
-  if( (x + w) > WIDTH) { 
-    w = (WIDTH - x);
+  for (int16_t col = first; col <= last; col++) {
+    uint8_t i = col - x;
+    uint16_t bits = (i < 5 ? pgm_read_byte(&font[c * 5 + i]) : 0) << shift;
+    // upper page gets the low byte, the page below the high byte
+    for (uint8_t k = 0; k < 2; k++) {
+      int16_t p = page + k;
+      uint8_t m = k ? mask >> 8 : mask;
+      if (p < 0 || p >= pages || m == 0)
+        continue;
+      uint8_t b = k ? bits >> 8 : bits;
+      uint8_t &dst = buffer[p * WIDTH + col];
+      if (opaque)
+        applyColor(dst, ~b & m, bg);
+      applyColor(dst, b, color);
+    }
   }
-
-  // if our width is now negative, punt
-  if(w <= 0) { return; }
-
-  // set up the pointer for  movement through the buffer
-  register uint8_t *pBuf = buffer;
-  // adjust the buffer pointer for the current row
-  pBuf += ((y/8) * SH1106_LCDWIDTH);
-  // and offset x columns in
-  pBuf += x;
-
-  register uint8_t mask = 1 << (y&7);
-
-  switch (color) 
-  {
-  case WHITE:         while(w--) { *pBuf++ |= mask; }; break;
-    case BLACK: mask = ~mask;   while(w--) { *pBuf++ &= mask; }; break;
-  case INVERSE:         while(w--) { *pBuf++ ^= mask; }; break;
+  for (int16_t p = page; p <= page + (shift ? 1 : 0); p++) {
+    if (p >= 0 && p < pages)
+      markDirty(p, first, last);
   }
 }
 
-void Adafruit_SH1106::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
-  bool bSwap = false;
-  switch(rotation) { 
-    case 0:
-      break;
-    case 1:
-      // 90 degree rotation, swap x & y for rotation, then invert x and adjust x for h (now to become w)
-      bSwap = true;
-      sh1106_swap(x, y);
-      x = WIDTH - x - 1;
-      x -= (h-1);
-      break;
-    case 2:
-      // 180 degree rotation, invert x and y - then shift y around for height.
-      x = WIDTH - x - 1;
-      y = HEIGHT - y - 1;
-      y -= (h-1);
-      break;
-    case 3:
-      // 270 degree rotation, swap x & y for rotation, then invert y 
-      bSwap = true;
-      sh1106_swap(x, y);
-      y = HEIGHT - y - 1;
-      break;
-  }
+void Adafruit_SH1106_Base::spiBegin(void) {
+  pinMode(dc, OUTPUT);
+  pinMode(cs, OUTPUT);
+  digitalWrite(cs, HIGH);
 
-  if(bSwap) { 
-    drawFastHLineInternal(x, y, h, color);
-  } else {
-    drawFastVLineInternal(x, y, h, color);
+  if (transport == SH1106_TRANSPORT_HW_SPI) {
+    SPI.begin();
+    return;
   }
-}
-
-
-void Adafruit_SH1106::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h, uint16_t color) {
 
-  // do nothing if we're off the left or right side of the screen
-  if(x < 0 || x >= WIDTH) { return; }
-
-  // make sure we don't try to draw below 0
-  if(__y < 0) { 
-    // __y is negative, this will subtract enough from __h to account for __y being 0
-    __h += __y;
-    __y = 0;
-
-  } 
-
-  // make sure we don't go past the height of the display
-  if( (__y + __h) > HEIGHT) { 
-    __h = (HEIGHT - __y);
+#ifdef SH1106_PIO_SPI
+  if (pio == NULL) {
+    // the program is 2 instructions, take a state machine of whichever PIO has room
+    PIO candidates[] = {pio0, pio1};
+    for (PIO candidate : candidates) {
+      if (!pio_can_add_program(candidate, &spi_tx_program)) continue;
+      int candidateSm = pio_claim_unused_sm(candidate, false);
+      if (candidateSm < 0) continue;
+      pio = candidate;
+      pioSm = candidateSm;
+      break;
+    }
   }
-
-  // if our height is now negative, punt 
-  if(__h <= 0) { 
+  if (pio != NULL) {
+    uint offset = pio_add_program(pio, &spi_tx_program);
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset, offset + 1);
+    sm_config_set_sideset(&c, 1, false, false);
+    sm_config_set_sideset_pins(&c, sclk);
+    sm_config_set_out_pins(&c, sid, 1);
+    // MSB first, a new byte is pulled every 8 bits
+    sm_config_set_out_shift(&c, false, true, 8);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv(&c, (float)clock_get_hz(clk_sys) / (4.0f * busClock));
+
+    uint32_t pins = (1u << sid) | (1u << sclk);
+    pio_sm_set_pins_with_mask(pio, pioSm, 0, pins);
+    pio_sm_set_pindirs_with_mask(pio, pioSm, pins, pins);
+    pio_gpio_init(pio, sid);
+    pio_gpio_init(pio, sclk);
+    pio_sm_init(pio, pioSm, offset, &c);
+    pio_sm_set_enabled(pio, pioSm, true);
     return;
   }
+#endif
 
-  // this display doesn't need ints for coordinates, use local byte registers for faster juggling
-  register uint8_t y = __y;
-  register uint8_t h = __h;
-
-
-  // set up the pointer for fast movement through the buffer
-  register uint8_t *pBuf = buffer;
-  // adjust the buffer pointer for the current row
-  pBuf += ((y/8) * SH1106_LCDWIDTH);
-  // and offset x columns in
-  pBuf += x;
-
-  // do the first partial byte, if necessary - this requires some masking
-  register uint8_t mod = (y&7);
-  if(mod) {
-    // mask off the high n bits we want to set 
-    mod = 8-mod;
-
-    // note - lookup table results in a nearly 10% performance improvement in fill* functions
-    // register uint8_t mask = ~(0xFF >> (mod));
-    static uint8_t premask[8] = {0x00, 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC, 0xFE };
-    register uint8_t mask = premask[mod];
-
-    // adjust the mask if we're not going to reach the end of this byte
-    if( h < mod) { 
-      mask &= (0XFF >> (mod-h));
-    }
+  // no PIO left, bit-bang
+  pinMode(sid, OUTPUT);
+  pinMode(sclk, OUTPUT);
+  digitalWrite(sclk, LOW);
+}
 
-  switch (color) 
-    {
-    case WHITE:   *pBuf |=  mask;  break;
-    case BLACK:   *pBuf &= ~mask;  break;
-    case INVERSE: *pBuf ^=  mask;  break;
+// one SPI transaction, D/C low for commands and high for display data
+void Adafruit_SH1106_Base::spiWrite(bool data, const uint8_t *p, uint16_t n) {
+  digitalWrite(dc, data ? HIGH : LOW);
+  digitalWrite(cs, LOW);
+  bytesSent += n;
+
+  if (transport == SH1106_TRANSPORT_HW_SPI) {
+    SPI.beginTransaction(SPISettings(busClock, MSBFIRST, SPI_MODE0));
+#ifdef ARDUINO_ARCH_RP2040
+    SPI.transfer(p, NULL, n); // transmit only, the whole block at once
+#else
+    while (n--) (void)SPI.transfer(*p++);
+#endif
+    SPI.endTransaction();
+  }
+#ifdef SH1106_PIO_SPI
+  else if (pio != NULL) {
+    while (n--) {
+      pio_sm_put_blocking(pio, pioSm, (uint32_t)*p++ << 24);
     }
-  
-    // fast exit if we're done here!
-    if(h<mod) { return; }
-
-    h -= mod;
-
-    pBuf += SH1106_LCDWIDTH;
+    // the state machine stalls on the empty FIFO once the last bit is out
+    uint32_t stall = 1u << (PIO_FDEBUG_TXSTALL_LSB + pioSm);
+    pio->fdebug = stall;
+    while (!(pio->fdebug & stall)) {}
   }
-
-
-  // write solid bytes while we can - effectively doing 8 rows at a time
-  if(h >= 8) { 
-    if (color == INVERSE)  {          // separate copy of the code so we don't impact performance of the black/white write version with an extra comparison per loop
-      do  {
-      *pBuf=~(*pBuf);
-
-        // adjust the buffer forward 8 rows worth of data
-        pBuf += SH1106_LCDWIDTH;
-
-        // adjust h & y (there's got to be a faster way for me to do this, but this should still help a fair bit for now)
-        h -= 8;
-      } while(h >= 8);
-      }
-    else {
-      // store a local value to work with 
-      register uint8_t val = (color == WHITE) ? 255 : 0;
-
-      do  {
-        // write our value in
-      *pBuf = val;
-
-        // adjust the buffer forward 8 rows worth of data
-        pBuf += SH1106_LCDWIDTH;
-
-        // adjust h & y (there's got to be a faster way for me to do this, but this should still help a fair bit for now)
-        h -= 8;
-      } while(h >= 8);
+#endif
+  else {
+    while (n--) {
+      uint8_t d = *p++;
+      for (uint8_t bit = 0x80; bit; bit >>= 1) {
+        digitalWrite(sclk, LOW);
+        digitalWrite(sid, (d & bit) ? HIGH : LOW);
+        digitalWrite(sclk, HIGH);
       }
     }
-
-  // now do the final partial byte, if necessary
-  if(h) {
-    mod = h & 7;
-    // this time we want to mask the low bits of the byte, vs the high bits we did above
-    // register uint8_t mask = (1 << mod) - 1;
-    // note - lookup table results in a nearly 10% performance improvement in fill* functions
-    static uint8_t postmask[8] = {0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F };
-    register uint8_t mask = postmask[mod];
-    switch (color) 
-    {
-      case WHITE:   *pBuf |=  mask;  break;
-      case BLACK:   *pBuf &= ~mask;  break;
-      case INVERSE: *pBuf ^=  mask;  break;
-    }
+    digitalWrite(sclk, LOW);
   }
+
+  digitalWrite(cs, HIGH);
 }
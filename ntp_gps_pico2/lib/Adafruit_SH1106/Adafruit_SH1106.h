@@ -26,6 +26,9 @@ However, SH1106 driver don't provide several functions such as scroll commands.
 
 *********************************************************************/
 
+#ifndef _ADAFRUIT_SH1106_H
+#define _ADAFRUIT_SH1106_H
+
 #if ARDUINO >= 100
  #include "Arduino.h"
  #define WIRE_WRITE Wire.write
@@ -43,8 +46,16 @@ However, SH1106 driver don't provide several functions such as scroll commands.
 #endif
 
 #include <SPI.h>
+#include <Wire.h>
 #include <Adafruit_GFX.h>
 
+#if defined(ARDUINO_ARCH_RP2040)
+ #define SH1106_ASYNC
+ #define SH1106_PIO_SPI
+ #include <hardware/i2c.h>
+ #include <hardware/pio.h>
+#endif
+
 #define BLACK 0
 #define WHITE 1
 #define INVERSE 2
@@ -110,6 +121,20 @@ However, SH1106 driver don't provide several functions such as scroll commands.
 
 #define SH1106_SETMULTIPLEX 0xA8
 
+#define SH1106_PAGES (SH1106_LCDHEIGHT / 8)
+#define SH1106_I2C_CLOCK 400000 // default bus clock set by begin()
+#define SH1106_SPI_CLOCK 4000000 // SH1106 serial clock cycle is 250ns min
+#ifdef WIRE_BUFFER_SIZE
+  #define SH1106_I2C_BUFFER WIRE_BUFFER_SIZE
+#else
+  #define SH1106_I2C_BUFFER 32
+#endif
+#define SH1106_COLUMN_OFFSET 2 // SH1106 has 132 columns of RAM, the panel shows columns 2..129
+// displayAsync() streams IC_DATA_CMD words of the RP2040/RP2350 I2C controller:
+// the byte in bits 0-7 and STOP in bit 9 (I2C_IC_DATA_CMD_STOP_BITS) on the last byte of a transmission
+#define SH1106_STREAM_STOP 0x200
+#define SH1106_STREAM_WORDS(w, h) ((h) / 8 * (7 + (w))) // a full frame, one transmission per page
+
 #define SH1106_SETLOWCOLUMN 0x00
 #define SH1106_SETHIGHCOLUMN 0x10
 
@@ -138,12 +163,26 @@ However, SH1106 driver don't provide several functions such as scroll commands.
 #define SH1106_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL 0x29
 #define SH1106_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL 0x2A
 
-class Adafruit_SH1106 : public Adafruit_GFX {
- public:
-  Adafruit_SH1106(int8_t SID, int8_t SCLK, int8_t DC, int8_t RST, int8_t CS);
-  Adafruit_SH1106(int8_t DC, int8_t RST, int8_t CS);
-  Adafruit_SH1106(int8_t RST);
+// how the panel is connected, chosen by the constructor
+enum SH1106_Transport {
+  SH1106_TRANSPORT_I2C,
+  SH1106_TRANSPORT_HW_SPI,   // SPI peripheral, whole pages per transfer
+  SH1106_TRANSPORT_SOFT_SPI, // any pins, a PIO state machine on RP2040/RP2350, else bit-banged
+};
+
+// memory of one panel, owned by SH1106<W, H, ROT>
+struct SH1106_Storage {
+  uint8_t *buffer;     // W * H / 8, one byte is 8 vertical pixels of a page
+  uint8_t *sent;       // what the panel currently shows
+  uint8_t *dirtyFirst; // per page column range touched since the last display(),
+  uint8_t *dirtyLast;  // first > last when clean
+  uint16_t *stream;    // IC_DATA_CMD words for displayAsync()
+};
 
+// bus handling, init sequence and frame transfer shared by every panel size.
+// the drawing hot paths live in SH1106<W, H, ROT> below.
+class Adafruit_SH1106_Base : public Adafruit_GFX {
+ public:
   void begin(uint8_t switchvcc = SH1106_SWITCHCAPVCC, uint8_t i2caddr = SH1106_I2C_ADDRESS, bool reset=true);
   void SH1106_command(uint8_t c);
   void SH1106_data(uint8_t c);
@@ -151,6 +190,29 @@ class Adafruit_SH1106 : public Adafruit_GFX {
   void clearDisplay(void);
   void invertDisplay(uint8_t i);
   void display();
+  // forget what the panel shows, the next display() sends every page
+  void invalidate(void);
+  // bytes written to the bus by display() and commands (I2C control bytes included)
+  uint32_t getBytesSent(void) { return bytesSent; }
+  // start sending the changes with DMA and return immediately (I2C on RP2040/RP2350).
+  // drawing may continue while the frame is in flight, the next frame is taken
+  // from the buffer on the next call. returns false if the previous frame is still busy.
+  // falls back to display() where DMA is not available.
+  bool displayAsync(void);
+  // the hardware independent half of displayAsync(): write the changes since the
+  // last frame to 'out' as IC_DATA_CMD words (SH1106_STREAM_WORDS(width, height) at most)
+  // and mark them as sent. returns the number of words, 0 if nothing changed.
+  uint16_t queueFrame(uint16_t *out);
+  // true while an async frame is being sent, the I2C bus must not be used meanwhile
+  bool flushing(void);
+  void waitFlush(void) { while (flushing()) {} }
+  uint32_t getFlushErrors(void) { return flushErrors; }
+
+  // time the last display() or displayAsync() frame took on the bus
+  uint32_t getLastFlushMicros(void) { return lastFlushMicros; }
+  // I2C or SPI clock used for the display (an I2C bus is shared, other devices must support it)
+  void setBusClock(uint32_t hz);
+  SH1106_Transport getTransport(void) { return transport; }
 
   /*void startscrollright(uint8_t start, uint8_t stop);
   void startscrollleft(uint8_t start, uint8_t stop);
@@ -161,20 +223,282 @@ class Adafruit_SH1106 : public Adafruit_GFX {
   
   void dim(uint8_t contrast);
 
-  void drawPixel(int16_t x, int16_t y, uint16_t color);
+ protected:
+  Adafruit_SH1106_Base(int16_t w, int16_t h, const SH1106_Storage &storage);
+  void initSoftSPI(int8_t SID, int8_t SCLK, int8_t DC, int8_t RST, int8_t CS);
+  void initHardSPI(int8_t DC, int8_t RST, int8_t CS);
+  void initI2C(int8_t RST, TwoWire &bus);
+
+  uint8_t *const buffer;
+  uint8_t pages;
+
+  // classic font, size 1, rotation 0 only
+  void blitChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg);
 
-  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
-  virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+  inline void markDirty(uint8_t page, uint8_t first, uint8_t last) {
+    if (first < dirtyFirst[page]) dirtyFirst[page] = first;
+    if (last > dirtyLast[page]) dirtyLast[page] = last;
+  }
 
  private:
   int8_t _i2caddr, _vccstate, sid, sclk, dc, rst, cs;
-  void fastSPIwrite(uint8_t c);
+  TwoWire *wire;
+  SH1106_Transport transport = SH1106_TRANSPORT_I2C;
+
+  uint8_t *const sent;
+  uint8_t *const dirtyFirst;
+  uint8_t *const dirtyLast;
+  uint16_t *const stream;
+  boolean sentValid = false; // the copy of what was sent to the panel is valid
+  uint32_t bytesSent = 0;
+  uint32_t lastFlushMicros = 0;
+  uint32_t flushStart = 0;
+  uint32_t flushErrors = 0;
+  int dmaChannel = -1;
+  boolean asyncActive = false;
+  uint32_t busClock = SH1106_I2C_CLOCK;
+
+  void sendPage(uint8_t page, uint8_t first, uint8_t last);
+  bool nextRange(uint8_t page, uint8_t &first, uint8_t &last);
+  void spiBegin(void);
+  void spiWrite(bool data, const uint8_t *p, uint16_t n);
+
+#ifdef SH1106_PIO_SPI
+  PIO pio = NULL;
+  uint pioSm = 0;
+#endif
+
+#ifdef SH1106_ASYNC
+  i2c_inst_t *i2cInst(void) { return wire == &Wire1 ? i2c1 : i2c0; }
+#endif
+};
+
+// one panel of W x H pixels. the buffer belongs to the instance, so several
+// panels (on different buses or addresses) can be driven at the same time.
+// ROT is the fixed rotation (0-3, as Adafruit_GFX::setRotation()); the pixel
+// and line paths are specialised for it and for the colour at compile time.
+template <int16_t W, int16_t H, uint8_t ROT = 0>
+class SH1106 : public Adafruit_SH1106_Base {
+  static_assert(H % 8 == 0, "SH1106 height must be a multiple of 8");
+  static_assert(W <= 132, "SH1106 has 132 columns");
+  static_assert(ROT < 4, "rotation must be 0-3");
 
-  boolean hwSPI;
-  PortReg *mosiport, *clkport, *csport, *dcport;
-  PortMask mosipinmask, clkpinmask, cspinmask, dcpinmask;
+ public:
+  // software SPI on any pins (a PIO state machine where available)
+  SH1106(int8_t SID, int8_t SCLK, int8_t DC, int8_t RST, int8_t CS) : Adafruit_SH1106_Base(W, H, storage(this)) {
+    initSoftSPI(SID, SCLK, DC, RST, CS);
+    Adafruit_GFX::setRotation(ROT);
+  }
+  // hardware SPI
+  SH1106(int8_t DC, int8_t RST, int8_t CS) : Adafruit_SH1106_Base(W, H, storage(this)) {
+    initHardSPI(DC, RST, CS);
+    Adafruit_GFX::setRotation(ROT);
+  }
+  // I2C
+  SH1106(int8_t RST, TwoWire &bus = Wire) : Adafruit_SH1106_Base(W, H, storage(this)) {
+    initI2C(RST, bus);
+    Adafruit_GFX::setRotation(ROT);
+  }
+
+  // the rotation is the template parameter ROT, the pixel paths are built for
+  // it. Adafruit_GFX::setRotation() is virtual, so a call through the base
+  // class would otherwise leave the paths and the cursor bounds out of step.
+  void setRotation(uint8_t r) { (void)r; }
+
+  // text in the classic font at size 1 is copied into the page buffer a
+  // column at a time, at any y. other fonts, sizes and rotations go through
+  // the pixel by pixel path of Adafruit_GFX.
+  // print() reaches the glyphs through the virtual write(), drawChar() of
+  // Adafruit_GFX is not virtual, so both are taken over here. cursor, wrap and
+  // newline handling are the same as Adafruit_GFX::write().
+  using Print::write;
+  size_t write(uint8_t c) {
+    if (ROT != 0 || gfxFont || textsize_x != 1 || textsize_y != 1)
+      return Adafruit_GFX::write(c);
+    if (c == '\n') {
+      cursor_x = 0;
+      cursor_y += 8;
+    } else if (c != '\r') {
+      if (wrap && (cursor_x + 6 > _width)) {
+        cursor_x = 0;
+        cursor_y += 8;
+      }
+      blitChar(cursor_x, cursor_y, c, textcolor, textbgcolor);
+      cursor_x += 6;
+    }
+    return 1;
+  }
+
+  using Adafruit_GFX::drawChar;
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y) {
+    if (ROT == 0 && !gfxFont && size_x == 1 && size_y == 1) {
+      blitChar(x, y, c, color, bg);
+    } else {
+      Adafruit_GFX::drawChar(x, y, c, color, bg, size_x, size_y);
+    }
+  }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if ((uint16_t)x >= (uint16_t)LOGICAL_W || (uint16_t)y >= (uint16_t)LOGICAL_H) return;
+    toPhysical(x, y);
+    switch (color) {
+      case WHITE:   plot<WHITE>(x, y); break;
+      case BLACK:   plot<BLACK>(x, y); break;
+      case INVERSE: plot<INVERSE>(x, y); break;
+    }
+  }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    switch (color) {
+      case WHITE:   hline<WHITE>(x, y, w); break;
+      case BLACK:   hline<BLACK>(x, y, w); break;
+      case INVERSE: hline<INVERSE>(x, y, w); break;
+    }
+  }
+
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    switch (color) {
+      case WHITE:   vline<WHITE>(x, y, h); break;
+      case BLACK:   vline<BLACK>(x, y, h); break;
+      case INVERSE: vline<INVERSE>(x, y, h); break;
+    }
+  }
+
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    switch (color) {
+      case WHITE:   rect<WHITE>(x, y, w, h); break;
+      case BLACK:   rect<BLACK>(x, y, w, h); break;
+      case INVERSE: rect<INVERSE>(x, y, w, h); break;
+    }
+  }
+
+  void fillScreen(uint16_t color) {
+    switch (color) {
+      case WHITE:   physicalRect<WHITE>(0, 0, W, H); break;
+      case BLACK:   clearDisplay(); break;
+      case INVERSE: physicalRect<INVERSE>(0, 0, W, H); break;
+    }
+  }
+
+  // logical (rotated) line of w pixels
+  template <uint16_t COLOR>
+  void hline(int16_t x, int16_t y, int16_t w) {
+    switch (ROT) {
+      case 0: physicalHLine<COLOR>(x, y, w); break;
+      case 1: physicalVLine<COLOR>(W - y - 1, x, w); break;
+      case 2: physicalHLine<COLOR>(W - x - w, H - y - 1, w); break;
+      case 3: physicalVLine<COLOR>(y, H - x - w, w); break;
+    }
+  }
+
+  // logical (rotated) line of h pixels
+  template <uint16_t COLOR>
+  void vline(int16_t x, int16_t y, int16_t h) {
+    switch (ROT) {
+      case 0: physicalVLine<COLOR>(x, y, h); break;
+      case 1: physicalHLine<COLOR>(W - y - h, x, h); break;
+      case 2: physicalVLine<COLOR>(W - x - 1, H - y - h, h); break;
+      case 3: physicalHLine<COLOR>(y, H - x - 1, h); break;
+    }
+  }
+
+  // logical (rotated) rectangle
+  template <uint16_t COLOR>
+  void rect(int16_t x, int16_t y, int16_t w, int16_t h) {
+    switch (ROT) {
+      case 0: physicalRect<COLOR>(x, y, w, h); break;
+      case 1: physicalRect<COLOR>(W - y - h, x, h, w); break;
+      case 2: physicalRect<COLOR>(W - x - w, H - y - h, w, h); break;
+      case 3: physicalRect<COLOR>(y, H - x - w, h, w); break;
+    }
+  }
+
+ protected:
+  static constexpr int16_t LOGICAL_W = (ROT & 1) ? H : W;
+  static constexpr int16_t LOGICAL_H = (ROT & 1) ? W : H;
+
+  static inline void toPhysical(int16_t &x, int16_t &y) {
+    int16_t t;
+    switch (ROT) {
+      case 1: t = x; x = W - y - 1; y = t; break;
+      case 2: x = W - x - 1; y = H - y - 1; break;
+      case 3: t = x; x = y; y = H - t - 1; break;
+    }
+  }
+
+  template <uint16_t COLOR>
+  static inline void apply(uint8_t &b, uint8_t mask) {
+    if (COLOR == WHITE) b |= mask;
+    else if (COLOR == BLACK) b &= ~mask;
+    else b ^= mask;
+  }
+
+  template <uint16_t COLOR>
+  inline void plot(int16_t x, int16_t y) {
+    markDirty(y / 8, x, x);
+    apply<COLOR>(buffer_[x + (y / 8) * W], 1 << (y & 7));
+  }
+
+  template <uint16_t COLOR>
+  void physicalHLine(int16_t x, int16_t y, int16_t w) {
+    if (y < 0 || y >= H) return;
+    if (x < 0) { w += x; x = 0; }
+    if (x + w > W) w = W - x;
+    if (w <= 0) return;
+
+    markDirty(y / 8, x, x + w - 1);
+    uint8_t *pBuf = &buffer_[(y / 8) * W + x];
+    uint8_t mask = 1 << (y & 7);
+    while (w--) apply<COLOR>(*pBuf++, mask);
+  }
+
+  template <uint16_t COLOR>
+  void physicalVLine(int16_t x, int16_t y, int16_t h) {
+    physicalRect<COLOR>(x, y, 1, h);
+  }
+
+  // whole bytes where the rectangle covers all 8 rows of a page, masked bytes at the top and bottom
+  template <uint16_t COLOR>
+  void physicalRect(int16_t x, int16_t y, int16_t w, int16_t h) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > W) w = W - x;
+    if (y + h > H) h = H - y;
+    if (w <= 0 || h <= 0) return;
+
+    int16_t bottom = y + h - 1;
+    for (int16_t page = y / 8; page <= bottom / 8; page++) {
+      uint8_t mask = 0xFF;
+      if (page == y / 8) mask &= 0xFF << (y & 7);
+      if (page == bottom / 8) mask &= 0xFF >> (7 - (bottom & 7));
+
+      markDirty(page, x, x + w - 1);
+      uint8_t *pBuf = &buffer_[page * W + x];
+      for (int16_t i = 0; i < w; i++) apply<COLOR>(pBuf[i], mask);
+    }
+  }
 
-  inline void drawFastVLineInternal(int16_t x, int16_t y, int16_t h, uint16_t color) __attribute__((always_inline));
-  inline void drawFastHLineInternal(int16_t x, int16_t y, int16_t w, uint16_t color) __attribute__((always_inline));
+ private:
+  uint8_t buffer_[W * H / 8];
+  uint8_t sent_[W * H / 8];
+  uint8_t dirtyFirst_[H / 8];
+  uint8_t dirtyLast_[H / 8];
+#ifdef SH1106_ASYNC
+  uint16_t stream_[SH1106_STREAM_WORDS(W, H)];
+#endif
 
+  // called from the mem-initializer before the base is built, so only the
+  // addresses of the arrays are taken, no member function of the object runs
+  static SH1106_Storage storage(SH1106 *self) {
+#ifdef SH1106_ASYNC
+    return SH1106_Storage{self->buffer_, self->sent_, self->dirtyFirst_, self->dirtyLast_, self->stream_};
+#else
+    return SH1106_Storage{self->buffer_, self->sent_, self->dirtyFirst_, self->dirtyLast_, NULL};
+#endif
+  }
 };
+
+// the panel selected by the SH1106_128_64 / SH1106_128_32 / SH1106_96_16 define above
+typedef SH1106<SH1106_LCDWIDTH, SH1106_LCDHEIGHT> Adafruit_SH1106;
+
+#endif // _ADAFRUIT_SH1106_H
@@ -0,0 +1,35 @@
+#ifndef BUFFER_PRINT_H
+#define BUFFER_PRINT_H
+
+#include <Arduino.h>
+
+// 固定長の文字列バッファに書き込むPrint。入りきらない分は切り捨てる
+class BufferPrint : public Print
+{
+public:
+    BufferPrint(char *buffer, size_t size) : buffer_(buffer), size_(size)
+    {
+        buffer_[0] = '\0';
+    }
+
+    size_t write(uint8_t c) override
+    {
+        if (length_ + 1 >= size_)
+        {
+            return 0;
+        }
+        buffer_[length_++] = c;
+        buffer_[length_] = '\0';
+        return 1;
+    }
+    using Print::write;
+
+    size_t length() const { return length_; }
+
+private:
+    char *buffer_;
+    size_t size_;
+    size_t length_ = 0;
+};
+
+#endif // BUFFER_PRINT_H
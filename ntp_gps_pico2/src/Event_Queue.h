@@ -0,0 +1,80 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// ロックフリーのSPSCリングバッファ
+// 書き込み側(割り込みハンドラや別コア)と読み出し側(loop)がそれぞれ1つの場合に限り、
+// 排他制御なしで安全に使える。Nは2のべき乗にすること。
+template <typename T, uint32_t N>
+class EventQueue
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "EventQueue size must be a power of two");
+
+public:
+    // 書き込み側から呼ぶ。満杯なら捨ててfalseを返す
+    bool push(const T &item)
+    {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        if (head - tail >= N)
+        {
+            overflowCount_++;
+            return false;
+        }
+        buffer_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+
+        uint32_t depth = head + 1 - tail;
+        if (depth > highWater_)
+        {
+            highWater_ = depth;
+        }
+        return true;
+    }
+
+    // 読み出し側から呼ぶ。空ならfalseを返す
+    bool pop(T &item)
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        if (tail == head)
+        {
+            return false;
+        }
+        item = buffer_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 読み出し側から呼ぶ。取り出さずに先頭を見る
+    bool peek(T &item) const
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        if (tail == head)
+        {
+            return false;
+        }
+        item = buffer_[tail & (N - 1)];
+        return true;
+    }
+
+    uint32_t size() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+    uint32_t capacity() const { return N; }
+    uint32_t highWater() const { return highWater_; }
+    uint32_t overflowCount() const { return overflowCount_; }
+
+private:
+    T buffer_[N];
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    volatile uint32_t highWater_ = 0;
+    volatile uint32_t overflowCount_ = 0;
+};
+
+#endif // EVENT_QUEUE_H
@@ -0,0 +1,138 @@
+#include <Gnss_Uart.h>
+
+#if defined(GNSS_TRANSPORT_UART)
+#include <hardware/dma.h>
+#include <hardware/gpio.h>
+
+// DMAのリングは大きさで揃えたアドレスに置く必要がある (インスタンスは1つだけ)
+static uint8_t gnssUartRing[GNSS_UART_RING_SIZE] __attribute__((aligned(GNSS_UART_RING_SIZE)));
+
+bool GnssUart::begin(unsigned long baud)
+{
+  uart_init(uart_, baud);
+  gpio_set_function(txPin_, GPIO_FUNC_UART);
+  gpio_set_function(rxPin_, GPIO_FUNC_UART);
+  uart_set_fifo_enabled(uart_, true);
+
+  dmaChannel_ = dma_claim_unused_channel(false);
+  if (dmaChannel_ < 0)
+  {
+    return false;
+  }
+  dma_channel_config config = dma_channel_get_default_config(dmaChannel_);
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+  channel_config_set_read_increment(&config, false);
+  channel_config_set_write_increment(&config, true);
+  channel_config_set_ring(&config, true, GNSS_UART_RING_BITS); // 書き込み先だけを折り返す
+  channel_config_set_dreq(&config, uart_get_dreq(uart_, false));
+  // 残りの転送数から書き込んだバイト数を求めてあふれを見つけるので、RP2350でも無限転送は使わない
+  // (115200bpsで2^28バイトは約6.5時間)。使い切ったらrearm()で掛け直す
+  dma_channel_configure(dmaChannel_, &config, gnssUartRing, &uart_get_hw(uart_)->dr, GNSS_UART_DMA_COUNT, true);
+  armed_ = GNSS_UART_DMA_COUNT;
+  consumed_ = 0;
+  return true;
+}
+
+// DMAがリングに書いたバイト数の合計。リングの先頭から始めているので下位ビットが次に書く位置
+uint32_t GnssUart::written() const
+{
+  return armed_ - (dma_channel_hw_addr(dmaChannel_)->transfer_count & GNSS_UART_DMA_COUNT);
+}
+
+void GnssUart::rearm()
+{
+  // 転送数を使い切って止まっていたら掛け直す
+  if (!dma_channel_is_busy(dmaChannel_))
+  {
+    armed_ += GNSS_UART_DMA_COUNT;
+    dma_channel_set_trans_count(dmaChannel_, GNSS_UART_DMA_COUNT, true);
+  }
+}
+
+// リングからフレームを1つ完成させる。完成していればtrue
+bool GnssUart::fill()
+{
+  if (dmaChannel_ < 0)
+  {
+    return false;
+  }
+  rearm();
+  while (!parser_.ready())
+  {
+    uint32_t pending = written() - consumed_;
+    if (pending >= GNSS_UART_RING_SIZE)
+    {
+      // DMAが読み出し位置に追いついた。残りは上書きされているかもしれないので全部捨てる
+      overruns_++;
+      overrunBytes_ += pending;
+      consumed_ += pending;
+      parser_.restart();
+      continue;
+    }
+    if (pending > highWater_)
+    {
+      highWater_ = pending;
+    }
+    // 折り返しの手前までの連続した範囲を渡す。0バイトでもパーサが読み直すバイトは処理される
+    uint32_t tail = consumed_ & (GNSS_UART_RING_SIZE - 1);
+    uint32_t size = min(pending, GNSS_UART_RING_SIZE - tail);
+    consumed_ += parser_.consume(&gnssUartRing[tail], size);
+    if (size == 0)
+    {
+      return parser_.ready();
+    }
+  }
+  return true;
+}
+
+int GnssUart::available()
+{
+  if (!fill())
+  {
+    return 0;
+  }
+  return parser_.length() - readPos_;
+}
+
+int GnssUart::read()
+{
+  if (!fill())
+  {
+    return -1;
+  }
+  uint8_t c = parser_.frame()[readPos_++];
+  if (readPos_ >= parser_.length())
+  {
+    parser_.release();
+    readPos_ = 0;
+  }
+  return c;
+}
+
+int GnssUart::peek()
+{
+  if (!fill())
+  {
+    return -1;
+  }
+  return parser_.frame()[readPos_];
+}
+
+size_t GnssUart::write(uint8_t c)
+{
+  uart_write_blocking(uart_, &c, 1);
+  return 1;
+}
+
+size_t GnssUart::write(const uint8_t *buffer, size_t size)
+{
+  uart_write_blocking(uart_, buffer, size);
+  return size;
+}
+
+void GnssUart::flush()
+{
+  uart_tx_wait_blocking(uart_);
+}
+
+#endif // GNSS_TRANSPORT_UART
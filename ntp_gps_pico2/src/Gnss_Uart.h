@@ -0,0 +1,58 @@
+#ifndef GNSS_UART_H
+#define GNSS_UART_H
+
+#include <Arduino.h>
+#include <hardware/uart.h>
+#include <Ubx_Frame_Parser.h>
+
+// GNSS受信機とのUART接続 (-DGNSS_TRANSPORT_UART で使う)
+// 受信はDMAでリングバッファに書き込み、CPUは関与しない。
+// 読み出し側はリングからUBXのフレームを切り出し、正しいフレームだけをStreamとして渡す。
+// 読み出し(available/read)は1つのコアからだけ呼ぶこと。
+
+#define GNSS_UART_RING_BITS 14 // リングバッファの大きさ (2^n バイト、115200bpsで約1.4秒分)
+#define GNSS_UART_RING_SIZE (1u << GNSS_UART_RING_BITS)
+#if PICO_RP2350
+#define GNSS_UART_DMA_COUNT 0x0fffffffu // TRANS_COUNTの下位28ビット (上位4ビットはモード)
+#else
+#define GNSS_UART_DMA_COUNT 0xffffffffu
+#endif
+
+class GnssUart : public Stream
+{
+public:
+    GnssUart(uart_inst_t *uart, uint8_t txPin, uint8_t rxPin) : uart_(uart), txPin_(txPin), rxPin_(rxPin) {};
+    bool begin(unsigned long baud);
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    void flush() override;
+    using Print::write;
+
+    const UbxFrameParser &getParser() const { return parser_; }
+    uint32_t getRingHighWater() const { return highWater_; } // リングに溜まった最大のバイト数
+    uint32_t getOverruns() const { return overruns_; }         // 読み出しが遅れてDMAがリングを一周した回数
+    uint32_t getOverrunBytes() const { return overrunBytes_; } // そのとき捨てたバイト数
+
+private:
+    uart_inst_t *uart_;
+    uint8_t txPin_;
+    uint8_t rxPin_;
+    int dmaChannel_ = -1;
+    uint32_t armed_ = 0;    // DMAに指示した転送数の合計 (2^32で折り返す)
+    uint32_t consumed_ = 0; // リングから読んだバイト数の合計。下位ビットが次に読む位置
+    uint16_t readPos_ = 0;  // 完成したフレームの次に返す位置
+    uint32_t highWater_ = 0;
+    uint32_t overruns_ = 0;
+    uint32_t overrunBytes_ = 0;
+    UbxFrameParser parser_;
+
+    uint32_t written() const;
+    void rearm();
+    bool fill();
+};
+
+#endif // GNSS_UART_H
@@ -1,11 +1,47 @@
 #include <Gps_Client.h>
+#include <pico/time.h>
+#include <Time_Utils.h>
 
-byte l1s_msg_buf[32]; // MAX 250 BITS
-QZQSM dc_report;
-DCXDecoder dcx_decoder;
+// スコープを抜けるまでのサイクル数をGpsCallbackStatsに記録する
+class CallbackTimer
+{
+public:
+  CallbackTimer(GpsCallbackStats &stats) : stats_(stats), start_(rp2040.getCycleCount()) {}
+  ~CallbackTimer()
+  {
+    uint32_t cycles = rp2040.getCycleCount() - start_;
+    stats_.count++;
+    stats_.cycles += cycles;
+    if (cycles > stats_.maxCycles)
+    {
+      stats_.maxCycles = cycles;
+    }
+  }
+
+private:
+  GpsCallbackStats &stats_;
+  uint32_t start_;
+};
 
 void GpsClient::getPVTdata(UBX_NAV_PVT_data_t *data)
 {
+  CallbackTimer timer(callbackStats_[GPS_MSG_NAV_PVT]);
+  // 固定位置のタイミングモードでは3D測位にならないので平均しない
+  if (data->fixType == 3 && data->flags.bits.gnssFixOK)
+  {
+    survey_.add(data->lat, data->lon, data->height, data->hAcc, data->vAcc);
+  }
+  if (data->flags.bits.gnssFixOK)
+  {
+    lastFix_.latitude = data->lat;
+    lastFix_.longitude = data->lon;
+    lastFix_.height = data->height;
+    lastFix_.hAcc = data->hAcc;
+    lastFix_.fixType = data->fixType;
+    lastFix_.receivedMicros = time_us_64();
+  }
+
+  GpsSummaryData &gpsSummaryData = gpsSummaryData_.writeBuffer();
   gpsSummaryData.latitude = data->lat;
   gpsSummaryData.longitude = data->lon;
   gpsSummaryData.altitude = data->hMSL;
@@ -20,6 +56,34 @@ void GpsClient::getPVTdata(UBX_NAV_PVT_data_t *data)
   gpsSummaryData.sec = data->sec;
   gpsSummaryData.msec = data->iTOW % 1000;
   gpsSummaryData.fixType = data->fixType;
+  gpsSummaryData.receivedMicros = time_us_64();
+  gpsSummaryData.surveyState = survey_.getState();
+  gpsSummaryData.surveySamples = survey_.getSamples();
+  gpsSummaryData.surveyAccuracy = (float)survey_.accuracy();
+  gpsSummaryData_.publish();
+
+  if (data->valid.bits.validDate)
+  {
+    year_ = data->year;
+  }
+  if (data->valid.bits.validDate && data->valid.bits.validTime)
+  {
+    // iTOWのミリ秒分だけ受信時刻を戻して、秒の境界の時刻とする
+    unixTime_ = toUnixTime(data->year, data->month, data->day, data->hour, data->min, data->sec);
+    unixMicros_ = gpsSummaryData.receivedMicros - (data->iTOW % 1000) * 1000ULL;
+  }
+}
+
+// 次のタイムパルスの量子化誤差をcore0へ渡す
+void GpsClient::newTIMTP(UBX_TIM_TP_data_t *data)
+{
+  CallbackTimer timer(callbackStats_[GPS_MSG_TIM_TP]);
+  TimePulseReport report;
+  report.receivedMicros = time_us_64();
+  report.towMS = data->towMS;
+  report.qErr = data->qErr;
+  report.qErrValid = !data->flags.bits.qErrInvalid;
+  timePulse_.push(report);
 }
 
 // https://github.com/SWITCHSCIENCE/samplecodes/blob/master/GPS_shield_for_ESPr/espr_dev_qzss_drc_drx_decode/espr_dev_qzss_drc_drx_decode.ino
@@ -43,6 +107,7 @@ const char *GpsClient::dwrd_to_str(uint32_t value)
 
 void GpsClient::newSFRBX(UBX_RXM_SFRBX_data_t *data)
 {
+  CallbackTimer timer(callbackStats_[GPS_MSG_RXM_SFRBX]);
 #if defined(DEBUG_CONSOLE_GPS)
   stream_.print("SFRBX gnssId: ");
   stream_.print(data->gnssId);
@@ -62,75 +127,27 @@ void GpsClient::newSFRBX(UBX_RXM_SFRBX_data_t *data)
   stream_.println();
 #endif
 
-  // QZSS L1Sメッセージ解析
+  // QZSS L1Sメッセージはキューに積むだけにして、デコードはprocessQzss()で行う
   if (data->gnssId == 5)
   {
-
-    // SFRBXのdwrdはリトルエンディアンなので入れ替える
-    for (int i = 0; i < min(int(data->numWords), 8); i++)
-    {
-      l1s_msg_buf[(i << 2) + 0] = (data->dwrd[i] >> 24) & 0xff;
-      l1s_msg_buf[(i << 2) + 1] = (data->dwrd[i] >> 16) & 0xff;
-      l1s_msg_buf[(i << 2) + 2] = (data->dwrd[i] >> 8) & 0xff;
-      l1s_msg_buf[(i << 2) + 3] = (data->dwrd[i]) & 0xff;
-    }
-
-    byte pab = l1s_msg_buf[0];
-    byte mt = l1s_msg_buf[1] >> 2;
-
-    if (pab == 0x53 || pab == 0x9A || pab == 0xC6)
-    {
-      // Message Typeを表示
-      struct
-      {
-        byte mt;
-        const char *desc;
-      } MTTable[] = {
-          {0, "Test Mode"},
-          {43, "DC Report"},
-          {44, "DCX message"},
-          {47, "Monitoring Station Information"},
-          {48, "PRN Mask"},
-          {49, "Data Issue Number"},
-          {50, "DGPS Correction"},
-          {51, "Satellite Health"},
-          {63, "Null message"},
-      };
-      for (int i = 0; i < sizeof(MTTable) / sizeof(MTTable[0]); i++)
-      {
-        if (MTTable[i].mt == mt)
-        {
-          stream_.print(mt);
-          stream_.print(" ");
-          stream_.println(MTTable[i].desc);
-          break;
-        }
-      }
-      // 災害・危機管理通報サービス（DC Report）のメッセージ内容を表示
-      if (mt == 43)
-      {
-        dc_report.SetYear(2024); // todo
-        dc_report.Decode(l1s_msg_buf);
-        stream_.println(dc_report.GetReport());
-      }
-      // 災害・危機管理通報サービス（拡張）（DCX）のメッセージ内容を表示
-      else if (mt == 44)
-      {
-        dcx_decoder.decode(l1s_msg_buf);
-        dcx_decoder.printSummary(stream_, dcx_decoder.r);
-        
-#if defined(DEBUG_CONSOLE_DCX_ALL)
-        dcx_decoder.printAll(stream_, dcx_decoder.r);
-#endif
-      }
-    }
+    qzss_.enqueue(data->svId, data->dwrd, data->numWords);
   }
 }
 
 void GpsClient::newNAVSAT(UBX_NAV_SAT_data_t *data)
 {
-
-  ubxNavSatData_t = data;
+  CallbackTimer timer(callbackStats_[GPS_MSG_NAV_SAT]);
+  // ライブラリのバッファは次の受信で上書きされるので、有効な衛星分だけコピーして公開する
+  UBX_NAV_SAT_data_t &navSatData = navSatData_.writeBuffer();
+  uint16_t numSvs = data->header.numSvs;
+  if (numSvs > UBX_NAV_SAT_MAX_BLOCKS)
+  {
+    numSvs = UBX_NAV_SAT_MAX_BLOCKS;
+  }
+  navSatData.header = data->header;
+  navSatData.header.numSvs = numSvs;
+  memcpy(navSatData.blocks, data->blocks, sizeof(data->blocks[0]) * numSvs);
+  navSatData_.publish();
 
 #if defined(DEBUG_CONSOLE_GPS)
 #define NUM_GNSS 7
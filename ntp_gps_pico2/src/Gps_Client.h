@@ -1,23 +1,99 @@
+#ifndef GPS_CLIENT_H
+#define GPS_CLIENT_H
+
 
 #include <SparkFun_u-blox_GNSS_Arduino_Library.h>
 #include <Gps_model.h>
-#include <QZQSM.h>
-#include <QZSSDCX.h>
+#include <Qzss_Decoder.h>
+#include <Triple_Buffer.h>
+#include <Event_Queue.h>
+#include <Survey_In.h>
+
+#define GPS_TIME_PULSE_QUEUE_SIZE 4 // core0に渡すTIM-TPの数
+
+// 計測対象のUBXメッセージ
+enum GpsMessageType
+{
+  GPS_MSG_NAV_PVT,
+  GPS_MSG_NAV_SAT,
+  GPS_MSG_RXM_SFRBX,
+  GPS_MSG_TIM_TP,
+  GPS_MSG_TYPE_COUNT,
+};
+
+// コールバックの呼び出し回数と処理時間 (core1で更新し、core0から読む)
+// cyclesは32bitで折り返すが、Prometheusのcounterとしてはリセット扱いになるだけなので許容する
+struct GpsCallbackStats
+{
+  volatile uint32_t count;
+  volatile uint32_t cycles;
+  volatile uint32_t maxCycles;
+};
+
+inline const char *gpsMessageName(uint8_t type)
+{
+  switch (type)
+  {
+  case GPS_MSG_NAV_PVT:
+    return "NAV-PVT";
+  case GPS_MSG_NAV_SAT:
+    return "NAV-SAT";
+  case GPS_MSG_RXM_SFRBX:
+    return "RXM-SFRBX";
+  case GPS_MSG_TIM_TP:
+    return "TIM-TP";
+  default:
+    return "UNKNOWN";
+  }
+}
 
 class GpsClient
 {
 public:
-    GpsClient(Stream &stream) : stream_(stream) {};
+    GpsClient(Stream &stream) : stream_(stream), qzss_(stream) {};
     void getPVTdata(UBX_NAV_PVT_data_t *ubxDataStruct);
     void newSFRBX(UBX_RXM_SFRBX_data_t *data);
     void newNAVSAT(UBX_NAV_SAT_data_t *data);
+    void newTIMTP(UBX_TIM_TP_data_t *data);
+    // core1でコールバック処理の後に呼び、受信済みのQZSSメッセージを1つデコードする
+    bool processQzss() { return qzss_.process(year_, unixTime_, unixMicros_); }
+    // survey-inの状態はcore1で読み書きし、core0へはGpsSummaryDataで渡す
+    SurveyInState getSurveyState() const { return survey_.getState(); }
+    SurveyPosition getSurveyPosition() const { return survey_.position(); }
+    void fixSurvey(const SurveyPosition &position) { survey_.fix(position); }
+    void restartSurvey() { survey_.restart(); }
+    // 直近の有効な測位 (core1から呼ぶ)。まだ測位していなければfalse
+    bool getLastFix(GpsFix &fix) const { fix = lastFix_; return lastFix_.receivedMicros != 0; }
 
-    GpsSummaryData getGpsSummaryData() { return gpsSummaryData; }
-    UBX_NAV_SAT_data_t *getUbxNavSatData_t() { return ubxNavSatData_t; }
+    // 以下は読み出し側(core0)から呼ぶ
+    // refresh*()で最新のスナップショットを取り込み、次のrefresh*()まで参照は変化しない
+    bool refreshGpsSummaryData() { return gpsSummaryData_.update(); }
+    bool refreshNavSatData() { return navSatData_.update(); }
+    const GpsSummaryData &getGpsSummaryData() const { return gpsSummaryData_.read(); }
+    const UBX_NAV_SAT_data_t &getNavSatData() const { return navSatData_.read(); }
+    uint32_t getGpsSummaryVersion() const { return gpsSummaryData_.version(); }
+    uint32_t getNavSatVersion() const { return navSatData_.version(); }
+    bool gpsSummaryChangedSince(uint32_t version) const { return gpsSummaryData_.hasChangedSince(version); }
+    bool navSatChangedSince(uint32_t version) const { return navSatData_.hasChangedSince(version); }
+    // TIM-TPは対応するPPSエッジより前に届くので、エッジを処理する時に受信時刻を見て取り出す
+    bool peekTimePulse(TimePulseReport &report) const { return timePulse_.peek(report); }
+    bool popTimePulse(TimePulseReport &report) { return timePulse_.pop(report); }
+    const QzssDecoder &getQzss() const { return qzss_; }
+    const GpsCallbackStats &getCallbackStats(GpsMessageType type) const { return callbackStats_[type]; }
 
 private:
     Stream &stream_;
-    UBX_NAV_SAT_data_t *ubxNavSatData_t;
-    GpsSummaryData gpsSummaryData;
+    TripleBuffer<UBX_NAV_SAT_data_t> navSatData_;
+    TripleBuffer<GpsSummaryData> gpsSummaryData_;
+    QzssDecoder qzss_;
+    SurveyIn survey_;
+    GpsFix lastFix_ = {};
+    EventQueue<TimePulseReport, GPS_TIME_PULSE_QUEUE_SIZE> timePulse_;
+    GpsCallbackStats callbackStats_[GPS_MSG_TYPE_COUNT] = {};
+    uint16_t year_ = 2024; // QZSSのデコードに使う年 (NAV-PVTで更新する)
+    uint32_t unixTime_ = 0;  // 直近のNAV-PVTのUTC
+    uint64_t unixMicros_ = 0;
     const char *dwrd_to_str(uint32_t value);
 };
+
+#endif // GPS_CLIENT_H
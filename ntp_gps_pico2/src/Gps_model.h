@@ -18,6 +18,56 @@ struct GpsSummaryData
   unsigned long msec;
   bool timeValid;
   bool dateValid;
+  uint64_t receivedMicros; // NAV-PVTを受信した時刻 (time_us_64)
+  uint8_t surveyState;     // SurveyInState
+  uint32_t surveySamples;  // 平均した位置の数
+  float surveyAccuracy;    // 平均位置の推定精度 (3D) [m]。負なら未計算
 };
 
+// 直近の測位 (core1で更新し、位置の保存に使う)
+struct GpsFix
+{
+  int32_t latitude;  // [1e-7 deg]
+  int32_t longitude; // [1e-7 deg]
+  int32_t height;    // 楕円体高 [mm]
+  uint32_t hAcc;     // [mm]
+  uint8_t fixType;
+  uint64_t receivedMicros; // NAV-PVTを受信した時刻 (time_us_64)
+};
+
+// UBX-TIM-TP 次のタイムパルスの量子化誤差
+struct TimePulseReport
+{
+  uint64_t receivedMicros; // TIM-TPを受信した時刻 (time_us_64)
+  uint32_t towMS;          // 次のパルスのGNSS週内時刻 [ms]
+  int32_t qErr;            // 次のパルスの量子化誤差 [ps]
+  bool qErrValid;
+};
+
+#define GNSS_ID_COUNT 7 // UBX-NAV-SATのgnssId 0..6
+
+// UBX-NAV-SATのgnssIdを衛星システム名に変換する
+inline const char *gnssIdToName(uint8_t gnssId)
+{
+  switch (gnssId)
+  {
+  case 0:
+    return "GPS";
+  case 1:
+    return "SBAS";
+  case 2:
+    return "Galileo";
+  case 3:
+    return "BeiDou";
+  case 4:
+    return "IMES";
+  case 5:
+    return "QZSS";
+  case 6:
+    return "GLONASS";
+  default:
+    return "UNKNOWN";
+  }
+}
+
 #endif // GPS_MODEL_H
\ No newline at end of file
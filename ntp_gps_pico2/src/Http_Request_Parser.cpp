@@ -0,0 +1,164 @@
+#include <Http_Request_Parser.h>
+#include <string.h>
+#include <ctype.h>
+
+static const char EMPTY[] = "";
+
+void HttpRequestParser::reset()
+{
+  state_ = REQUEST_LINE;
+  result_ = HTTP_PARSE_INCOMPLETE;
+  method_ = HTTP_METHOD_UNKNOWN;
+  errorStatus_ = 0;
+  headerBytes_ = 0;
+  requestLineLength_ = 0;
+  headerLineLength_ = 0;
+  path_ = EMPTY;
+  query_ = EMPTY;
+  ifNoneMatch_[0] = '\0';
+}
+
+HttpParseResult HttpRequestParser::fail(uint16_t status)
+{
+  state_ = FINISHED;
+  errorStatus_ = status;
+  result_ = HTTP_PARSE_ERROR;
+  return result_;
+}
+
+HttpParseResult HttpRequestParser::feed(const uint8_t *data, size_t size)
+{
+  for (size_t i = 0; i < size && state_ != FINISHED; i++)
+  {
+    char c = data[i];
+
+    if (state_ == REQUEST_LINE)
+    {
+      if (c == '\n')
+      {
+        requestLine_[requestLineLength_] = '\0';
+        if (!parseRequestLine())
+        {
+          return result_;
+        }
+        state_ = HEADER_LINE;
+      }
+      else if (c != '\r')
+      {
+        // 長すぎるリクエスト行は最後まで待たずに拒否する
+        if (requestLineLength_ >= HTTP_REQUEST_LINE_SIZE - 1)
+        {
+          return fail(414);
+        }
+        requestLine_[requestLineLength_++] = c;
+      }
+      continue;
+    }
+
+    // HEADER_LINE
+    if (++headerBytes_ > HTTP_MAX_HEADER_BYTES)
+    {
+      return fail(431);
+    }
+    if (c == '\n')
+    {
+      // an http request ends with a blank line
+      if (headerLineLength_ == 0)
+      {
+        state_ = FINISHED;
+        result_ = HTTP_PARSE_DONE;
+        return result_;
+      }
+      headerLine_[headerLineLength_ < HTTP_HEADER_LINE_SIZE ? headerLineLength_ : HTTP_HEADER_LINE_SIZE - 1] = '\0';
+      parseHeaderLine();
+      headerLineLength_ = 0;
+    }
+    else if (c != '\r')
+    {
+      if (headerLineLength_ < HTTP_HEADER_LINE_SIZE - 1)
+      {
+        headerLine_[headerLineLength_] = c;
+      }
+      if (headerLineLength_ < 0xff)
+      {
+        headerLineLength_++;
+      }
+    }
+  }
+  return result_;
+}
+
+// "METHOD SP request-target SP HTTP/1.x" をその場で分割する
+bool HttpRequestParser::parseRequestLine()
+{
+  char *target = strchr(requestLine_, ' ');
+  if (target == NULL)
+  {
+    fail(400);
+    return false;
+  }
+  *target++ = '\0';
+
+  char *version = strchr(target, ' ');
+  if (version == NULL || strncmp(version + 1, "HTTP/1.", 7) != 0 || *target != '/')
+  {
+    fail(400);
+    return false;
+  }
+  *version = '\0';
+
+  if (strcmp(requestLine_, "GET") == 0)
+  {
+    method_ = HTTP_METHOD_GET;
+  }
+  else
+  {
+    fail(405);
+    return false;
+  }
+
+  char *query = strchr(target, '?');
+  if (query != NULL)
+  {
+    *query++ = '\0';
+    query_ = query;
+  }
+  path_ = target;
+  return true;
+}
+
+// 必要なヘッダだけを取り出す
+void HttpRequestParser::parseHeaderLine()
+{
+  static const char IF_NONE_MATCH[] = "if-none-match:";
+  const size_t nameLength = sizeof(IF_NONE_MATCH) - 1;
+
+  if (headerLineLength_ <= nameLength || headerLineLength_ >= HTTP_HEADER_LINE_SIZE)
+  {
+    return;
+  }
+  for (size_t i = 0; i < nameLength; i++)
+  {
+    if (tolower((unsigned char)headerLine_[i]) != IF_NONE_MATCH[i])
+    {
+      return;
+    }
+  }
+
+  const char *value = headerLine_ + nameLength;
+  while (*value == ' ' || *value == '\t')
+  {
+    value++;
+  }
+  size_t length = strlen(value);
+  while (length > 0 && (value[length - 1] == ' ' || value[length - 1] == '\t'))
+  {
+    length--;
+  }
+  if (length >= HTTP_ETAG_SIZE)
+  {
+    return;
+  }
+  memcpy(ifNoneMatch_, value, length);
+  ifNoneMatch_[length] = '\0';
+}
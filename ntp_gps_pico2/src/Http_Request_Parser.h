@@ -0,0 +1,71 @@
+#ifndef HTTP_REQUEST_PARSER_H
+#define HTTP_REQUEST_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 固定バッファで動くインクリメンタルなHTTPリクエストパーサ
+// ヒープを使わず、受信したデータを分割したまま何度でもfeed()できる。
+// Arduinoに依存しないのでホスト上でも動作する。
+
+#define HTTP_REQUEST_LINE_SIZE 128 // リクエスト行の最大長 (超えたら414)
+#define HTTP_HEADER_LINE_SIZE 96   // 保持するヘッダ行の最大長 (超えた分は読み捨て)
+#define HTTP_MAX_HEADER_BYTES 1024 // ヘッダ全体の最大長 (超えたら431)
+#define HTTP_ETAG_SIZE 24
+
+enum HttpParseResult
+{
+  HTTP_PARSE_INCOMPLETE,
+  HTTP_PARSE_DONE,
+  HTTP_PARSE_ERROR,
+};
+
+enum HttpMethod
+{
+  HTTP_METHOD_UNKNOWN,
+  HTTP_METHOD_GET,
+};
+
+class HttpRequestParser
+{
+public:
+    HttpRequestParser() { reset(); }
+    void reset();
+    HttpParseResult feed(const uint8_t *data, size_t size);
+
+    HttpParseResult result() const { return result_; }
+    HttpMethod method() const { return method_; }
+    const char *path() const { return path_; }
+    const char *query() const { return query_; }       // '?'以降 (なければ空文字)
+    const char *ifNoneMatch() const { return ifNoneMatch_; }
+    uint16_t errorStatus() const { return errorStatus_; } // HTTP_PARSE_ERRORのときのステータスコード
+
+private:
+    enum State
+    {
+      REQUEST_LINE,
+      HEADER_LINE,
+      FINISHED,
+    };
+
+    State state_;
+    HttpParseResult result_;
+    HttpMethod method_;
+    uint16_t errorStatus_;
+    uint16_t headerBytes_;
+
+    char requestLine_[HTTP_REQUEST_LINE_SIZE];
+    uint8_t requestLineLength_;
+    const char *path_;
+    const char *query_;
+
+    char headerLine_[HTTP_HEADER_LINE_SIZE];
+    uint8_t headerLineLength_;
+    char ifNoneMatch_[HTTP_ETAG_SIZE];
+
+    HttpParseResult fail(uint16_t status);
+    bool parseRequestLine();
+    void parseHeaderLine();
+};
+
+#endif // HTTP_REQUEST_PARSER_H
@@ -0,0 +1,146 @@
+#include <Json_Writer.h>
+
+// 要素の前のカンマとキーを書く
+void JsonWriter::separator(const char *key)
+{
+  uint16_t bit = 1 << depth_;
+  if (hasItems_ & bit)
+  {
+    out_.print(',');
+  }
+  hasItems_ |= bit;
+  if (key != NULL)
+  {
+    string(key);
+    out_.print(':');
+  }
+}
+
+void JsonWriter::string(const char *value)
+{
+  out_.print('"');
+  for (const char *p = value; *p != '\0'; p++)
+  {
+    char c = *p;
+    switch (c)
+    {
+    case '"':
+      out_.print("\\\"");
+      break;
+    case '\\':
+      out_.print("\\\\");
+      break;
+    case '\n':
+      out_.print("\\n");
+      break;
+    case '\r':
+      out_.print("\\r");
+      break;
+    case '\t':
+      out_.print("\\t");
+      break;
+    default:
+      if ((uint8_t)c < 0x20)
+      {
+        static const char hex[] = "0123456789abcdef";
+        out_.print("\\u00");
+        out_.print(hex[(c >> 4) & 0xf]);
+        out_.print(hex[c & 0xf]);
+      }
+      else
+      {
+        out_.print(c);
+      }
+      break;
+    }
+  }
+  out_.print('"');
+}
+
+void JsonWriter::beginObject(const char *key)
+{
+  separator(key);
+  out_.print('{');
+  if (depth_ < JSON_MAX_DEPTH - 1)
+  {
+    depth_++;
+  }
+  hasItems_ &= ~(1 << depth_);
+}
+
+void JsonWriter::endObject()
+{
+  if (depth_ > 0)
+  {
+    depth_--;
+  }
+  out_.print('}');
+}
+
+void JsonWriter::beginArray(const char *key)
+{
+  separator(key);
+  out_.print('[');
+  if (depth_ < JSON_MAX_DEPTH - 1)
+  {
+    depth_++;
+  }
+  hasItems_ &= ~(1 << depth_);
+}
+
+void JsonWriter::endArray()
+{
+  if (depth_ > 0)
+  {
+    depth_--;
+  }
+  out_.print(']');
+}
+
+void JsonWriter::field(const char *key, const char *value)
+{
+  separator(key);
+  string(value);
+}
+
+void JsonWriter::field(const char *key, long value)
+{
+  separator(key);
+  out_.print(value);
+}
+
+void JsonWriter::field(const char *key, unsigned long value)
+{
+  separator(key);
+  out_.print(value);
+}
+
+// JSONにはNaNやInfinityがないのでnullにする
+void JsonWriter::field(const char *key, double value, uint8_t digits)
+{
+  separator(key);
+  if (isnan(value) || isinf(value))
+  {
+    out_.print("null");
+    return;
+  }
+  out_.print(value, digits);
+}
+
+void JsonWriter::field(const char *key, bool value)
+{
+  separator(key);
+  out_.print(value ? "true" : "false");
+}
+
+void JsonWriter::fieldNull(const char *key)
+{
+  separator(key);
+  out_.print("null");
+}
+
+Print &JsonWriter::raw(const char *key)
+{
+  separator(key);
+  return out_;
+}
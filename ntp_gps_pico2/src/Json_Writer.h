@@ -0,0 +1,48 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <Arduino.h>
+
+#define JSON_MAX_DEPTH 16
+
+// JSONをPrintへ逐次書き出す (ヒープもStringも使わない)
+// カンマの挿入はネストの深さごとに管理する。
+//   json.beginObject();
+//   json.field("fixType", 3);
+//   json.beginArray("satellites");
+//   ...
+//   json.endArray();
+//   json.endObject();
+class JsonWriter
+{
+public:
+    JsonWriter(Print &out) : out_(out) {};
+
+    void beginObject(const char *key = NULL);
+    void endObject();
+    void beginArray(const char *key = NULL);
+    void endArray();
+
+    // オブジェクト内ではkeyを、配列内ではNULLを渡す
+    void field(const char *key, const char *value);
+    void field(const char *key, long value);
+    void field(const char *key, unsigned long value);
+    void field(const char *key, int value) { field(key, (long)value); }
+    void field(const char *key, unsigned int value) { field(key, (unsigned long)value); }
+    void field(const char *key, double value, uint8_t digits);
+    void field(const char *key, bool value);
+    void fieldNull(const char *key);
+
+    // 値の部分を呼び出し側で書く場合 (書式付きの文字列など)
+    Print &raw(const char *key);
+
+private:
+    Print &out_;
+    uint8_t depth_ = 0;
+    uint16_t hasItems_ = 0; // 深さごとに、既に要素を書いたかどうか
+
+    void separator(const char *key);
+    void string(const char *value);
+};
+
+#endif // JSON_WRITER_H
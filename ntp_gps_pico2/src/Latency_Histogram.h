@@ -0,0 +1,60 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+
+#define LATENCY_HISTOGRAM_BUCKETS 21 // 1us .. 2^20us(約1s) と それ以上
+
+// 2のべき乗で区切ったレイテンシのヒストグラム [us]
+// バケットiには upperBound(i-1) <= x < upperBound(i) の値が入る
+class LatencyHistogram
+{
+public:
+    void record(uint64_t us)
+    {
+        uint8_t i = 0;
+        while (i < LATENCY_HISTOGRAM_BUCKETS - 1 && us >= upperBound(i))
+        {
+            i++;
+        }
+        counts_[i]++;
+        total_++;
+        sum_ += us;
+        if (us > max_)
+        {
+            max_ = us;
+        }
+    }
+
+    // 上限値 [us]。最後のバケットは上限なし
+    static uint32_t upperBound(uint8_t i) { return 1UL << i; }
+
+    uint32_t count(uint8_t i) const { return counts_[i]; }
+    uint32_t total() const { return total_; }
+    uint64_t sum() const { return sum_; }
+    uint64_t max() const { return max_; }
+
+    // 指定したパーセンタイルを含むバケットの上限 [us]
+    uint32_t percentile(uint8_t percent) const
+    {
+        uint64_t target = ((uint64_t)total_ * percent + 99) / 100;
+        uint64_t seen = 0;
+        for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        {
+            seen += counts_[i];
+            if (seen >= target && seen > 0)
+            {
+                return upperBound(i);
+            }
+        }
+        return 0;
+    }
+
+private:
+    uint32_t counts_[LATENCY_HISTOGRAM_BUCKETS] = {};
+    uint32_t total_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+};
+
+#endif // LATENCY_HISTOGRAM_H
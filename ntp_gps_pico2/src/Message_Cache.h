@@ -0,0 +1,79 @@
+#ifndef MESSAGE_CACHE_H
+#define MESSAGE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// FNV-1a (32bit)
+inline uint32_t fnv1aHash(const uint8_t *data, size_t size)
+{
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+// 最近受信したメッセージのハッシュを覚えておくLRUキャッシュ
+// 同じ内容が繰り返し送られてくるメッセージの重複を取り除く。
+// Nは小さい(数十程度)前提で線形探索する。
+template <uint8_t N>
+class MessageCache
+{
+public:
+    // 初めて見るハッシュならtrue、キャッシュにあればfalseを返す
+    // どちらの場合もそのハッシュを最も新しいものとして扱う
+    bool insert(uint32_t hash)
+    {
+        uint8_t oldest = 0;
+        for (uint8_t i = 0; i < size_; i++)
+        {
+            if (hashes_[i] == hash)
+            {
+                used_[i] = ++clock_;
+                hits_++;
+                return false;
+            }
+            if (used_[i] < used_[oldest])
+            {
+                oldest = i;
+            }
+        }
+
+        uint8_t slot = size_ < N ? size_++ : oldest;
+        hashes_[slot] = hash;
+        used_[slot] = ++clock_;
+        misses_++;
+        return true;
+    }
+
+    // 後で同じメッセージを受け付けられるようにハッシュを取り除く
+    void forget(uint32_t hash)
+    {
+        for (uint8_t i = 0; i < size_; i++)
+        {
+            if (hashes_[i] == hash)
+            {
+                hashes_[i] = hashes_[--size_];
+                used_[i] = used_[size_];
+                misses_--;
+                return;
+            }
+        }
+    }
+
+    uint32_t hits() const { return hits_; }
+    uint32_t misses() const { return misses_; }
+
+private:
+    uint32_t hashes_[N];
+    uint32_t used_[N];
+    uint8_t size_ = 0;
+    uint32_t clock_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+};
+
+#endif // MESSAGE_CACHE_H
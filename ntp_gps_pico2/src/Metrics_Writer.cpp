@@ -0,0 +1,122 @@
+#include <Metrics_Writer.h>
+
+static const char *typeName(MetricType type)
+{
+  switch (type)
+  {
+  case METRIC_COUNTER:
+    return "counter";
+  case METRIC_HISTOGRAM:
+    return "histogram";
+  default:
+    return "gauge";
+  }
+}
+
+void MetricsWriter::family(const MetricFamily &metric)
+{
+  out_.print("# HELP ");
+  out_.print(metric.name);
+  out_.print(' ');
+  out_.println(metric.help);
+  out_.print("# TYPE ");
+  out_.print(metric.name);
+  out_.print(' ');
+  out_.println(typeName(metric.type));
+  metric.collect(*this, metric.name);
+}
+
+void MetricsWriter::end()
+{
+  out_.println("# EOF");
+}
+
+MetricsWriter &MetricsWriter::sample(const char *name, const char *suffix)
+{
+  out_.print(name);
+  if (suffix != NULL)
+  {
+    out_.print(suffix);
+  }
+  hasLabels_ = false;
+  return *this;
+}
+
+MetricsWriter &MetricsWriter::label(const char *key, const char *value)
+{
+  out_.print(hasLabels_ ? ',' : '{');
+  out_.print(key);
+  out_.print("=\"");
+  out_.print(value);
+  out_.print('"');
+  hasLabels_ = true;
+  return *this;
+}
+
+MetricsWriter &MetricsWriter::label(const char *key, long value)
+{
+  out_.print(hasLabels_ ? ',' : '{');
+  out_.print(key);
+  out_.print("=\"");
+  out_.print(value);
+  out_.print('"');
+  hasLabels_ = true;
+  return *this;
+}
+
+void MetricsWriter::endLabels()
+{
+  if (hasLabels_)
+  {
+    out_.print('}');
+    hasLabels_ = false;
+  }
+  out_.print(' ');
+}
+
+void MetricsWriter::value(long value)
+{
+  endLabels();
+  out_.println(value);
+}
+
+void MetricsWriter::value(unsigned long value)
+{
+  endLabels();
+  out_.println(value);
+}
+
+void MetricsWriter::value(double value, uint8_t digits)
+{
+  endLabels();
+  if (isnan(value))
+  {
+    out_.println("NaN");
+    return;
+  }
+  out_.println(value, digits);
+}
+
+// バケットは累積値で、leは秒単位
+void MetricsWriter::histogram(const char *name, const LatencyHistogram &histogram)
+{
+  unsigned long cumulative = 0;
+  for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+  {
+    cumulative += histogram.count(i);
+    sample(name, "_bucket");
+    out_.print("{le=\"");
+    if (i == LATENCY_HISTOGRAM_BUCKETS - 1)
+    {
+      out_.print("+Inf");
+    }
+    else
+    {
+      out_.print(LatencyHistogram::upperBound(i) / 1000000.0, 6);
+    }
+    out_.print("\"}");
+    value(cumulative);
+  }
+  sample(name, "_count").value((unsigned long)histogram.total());
+  sample(name, "_sum").value(histogram.sum() / 1000000.0, 6);
+}
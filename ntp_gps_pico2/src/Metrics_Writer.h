@@ -0,0 +1,58 @@
+#ifndef METRICS_WRITER_H
+#define METRICS_WRITER_H
+
+#include <Arduino.h>
+#include <Latency_Histogram.h>
+
+#define METRICS_CONTENT_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+enum MetricType
+{
+  METRIC_GAUGE,
+  METRIC_COUNTER,
+  METRIC_HISTOGRAM,
+};
+
+class MetricsWriter;
+
+// メトリクスの定義。collectで値を書き出す
+struct MetricFamily
+{
+  const char *name;
+  MetricType type;
+  const char *help;
+  void (*collect)(MetricsWriter &writer, const char *name);
+};
+
+// OpenMetricsのテキスト形式でPrintへ直接書き出す (Stringは使わない)
+class MetricsWriter
+{
+public:
+    MetricsWriter(Print &out) : out_(out) {};
+
+    void family(const MetricFamily &metric);
+    void end();
+
+    // sample("name").label("k", "v").value(1) の順に呼ぶ
+    MetricsWriter &sample(const char *name, const char *suffix = NULL);
+    MetricsWriter &label(const char *key, const char *value);
+    MetricsWriter &label(const char *key, long value);
+    void value(long value);
+    void value(unsigned long value);
+    void value(double value, uint8_t digits = 9);
+
+    // ゲージ・カウンタをラベルなしで1行書く
+    void gauge(const char *name, long value) { sample(name).value(value); }
+    void gauge(const char *name, double value, uint8_t digits = 9) { sample(name).value(value, digits); }
+    void counter(const char *name, unsigned long value) { sample(name, "_total").value(value); }
+    // usで記録したヒストグラムを秒単位で書く
+    void histogram(const char *name, const LatencyHistogram &histogram);
+
+private:
+    Print &out_;
+    bool hasLabels_ = false;
+
+    void endLabels();
+};
+
+#endif // METRICS_WRITER_H
@@ -0,0 +1,114 @@
+#include <Ntp_Server.h>
+#include <pico/time.h>
+
+#define NTP_MODE_CLIENT 3
+#define NTP_MODE_SERVER 4
+#define NTP_LEAP_NONE 0
+#define NTP_LEAP_ALARM 3 // 未同期
+#define NTP_STRATUM_PRIMARY 1
+#define NTP_STRATUM_UNSYNC 16
+#define NTP_PRECISION -20         // 2^-20 s ≒ 1us (micros()の分解能)
+#define NTP_MIN_DISPERSION 0.000002 // 最小のRoot Dispersion [s]
+
+void NtpServer::begin()
+{
+  udp_.begin(NTP_PORT);
+}
+
+void NtpServer::writeTimestamp(uint8_t *buf, const NtpTimestamp &ts)
+{
+  buf[0] = ts.seconds >> 24;
+  buf[1] = ts.seconds >> 16;
+  buf[2] = ts.seconds >> 8;
+  buf[3] = ts.seconds;
+  buf[4] = ts.fraction >> 24;
+  buf[5] = ts.fraction >> 16;
+  buf[6] = ts.fraction >> 8;
+  buf[7] = ts.fraction;
+}
+
+void NtpServer::server(const PpsClock &clock, const RtcHoldover &holdover)
+{
+  for (int i = 0; i < NTP_MAX_PACKETS_PER_LOOP; i++)
+  {
+    int size = udp_.parsePacket();
+    if (size <= 0)
+    {
+      return;
+    }
+    // 受信時刻はパケット到着の検出直後に取得する
+    uint64_t localUs = time_us_64();
+    bool useHoldover = !clock.synchronized(localUs) && holdover.active(localUs);
+    NtpTimestamp receiveTime = useHoldover ? holdover.now(localUs) : clock.now(localUs);
+
+    requestCount_++;
+    if (size < NTP_PACKET_SIZE || udp_.read(packet_, NTP_PACKET_SIZE) != NTP_PACKET_SIZE ||
+        (packet_[0] & 0x07) != NTP_MODE_CLIENT)
+    {
+      droppedCount_++;
+      udp_.flush();
+      continue;
+    }
+    udp_.flush();
+    reply(clock, holdover, useHoldover, receiveTime);
+  }
+}
+
+// RFC 5905 サーバー応答
+void NtpServer::reply(const PpsClock &clock, const RtcHoldover &holdover, bool useHoldover, const NtpTimestamp &receiveTime)
+{
+  // ホールドオーバー中は誤差の見積もりを広げて同期中として応答する
+  bool synchronized = useHoldover || clock.synchronized(time_us_64());
+  uint8_t version = (packet_[0] >> 3) & 0x07;
+  uint8_t poll = packet_[2];
+
+  // クライアントの送信時刻をOriginate Timestampとして返す
+  uint8_t origin[8];
+  memcpy(origin, &packet_[40], 8);
+
+  memset(packet_, 0, NTP_PACKET_SIZE);
+  packet_[0] = ((synchronized ? NTP_LEAP_NONE : NTP_LEAP_ALARM) << 6) | (version << 3) | NTP_MODE_SERVER;
+  packet_[1] = synchronized ? NTP_STRATUM_PRIMARY : NTP_STRATUM_UNSYNC;
+  packet_[2] = poll;
+  packet_[3] = (uint8_t)NTP_PRECISION;
+  // Root Delay = 0, Root Dispersion = |offset| + jitter、ホールドオーバー中は推定誤差 (16.16形式)
+  double dispersion = useHoldover ? holdover.error(time_us_64()) : fabs(clock.getOffset()) + clock.getJitter();
+  if (dispersion < NTP_MIN_DISPERSION)
+    dispersion = NTP_MIN_DISPERSION;
+  uint32_t rootDispersion = toNtpShort(dispersion);
+  packet_[8] = rootDispersion >> 24;
+  packet_[9] = rootDispersion >> 16;
+  packet_[10] = rootDispersion >> 8;
+  packet_[11] = rootDispersion;
+  // Reference ID
+  if (useHoldover)
+  {
+    packet_[12] = 'R';
+    packet_[13] = 'T';
+    packet_[14] = 'C';
+    holdoverCount_++;
+  }
+  else
+  {
+    packet_[12] = 'G';
+    packet_[13] = 'P';
+    packet_[14] = 'S';
+  }
+
+  writeTimestamp(&packet_[16], useHoldover ? holdover.lastEdgeTime() : clock.lastEdgeTime());
+  memcpy(&packet_[24], origin, 8);
+  writeTimestamp(&packet_[32], receiveTime);
+
+  udp_.beginPacket(udp_.remoteIP(), udp_.remotePort());
+  // 送信時刻は書き込み直前に取得する
+  uint64_t transmitUs = time_us_64();
+  NtpTimestamp transmitTime = useHoldover ? holdover.now(transmitUs) : clock.now(transmitUs);
+  writeTimestamp(&packet_[40], transmitTime);
+  udp_.write(packet_, NTP_PACKET_SIZE);
+  udp_.endPacket();
+
+#if defined(DEBUG_CONSOLE_NTP)
+  stream_.print("NTP reply to ");
+  stream_.println(udp_.remoteIP());
+#endif
+}
@@ -0,0 +1,37 @@
+#ifndef NTP_SERVER_H
+#define NTP_SERVER_H
+
+#include <Ethernet.h>
+#include <EthernetUdp.h>
+#include <Pps_Clock.h>
+#include <Rtc_Holdover.h>
+
+#define NTP_PORT 123
+#define NTP_PACKET_SIZE 48
+#define NTP_MAX_PACKETS_PER_LOOP 8 // 1回のloopで処理する最大リクエスト数
+
+class NtpServer
+{
+public:
+    NtpServer(Stream &stream) : stream_(stream) {};
+    void begin();
+    // PPSに同期していなければRTCのホールドオーバーで応答する
+    void server(const PpsClock &clock, const RtcHoldover &holdover);
+
+    unsigned long getRequestCount() { return requestCount_; }
+    unsigned long getDroppedCount() { return droppedCount_; }
+    unsigned long getHoldoverCount() { return holdoverCount_; }
+
+private:
+    Stream &stream_;
+    EthernetUDP udp_;
+    uint8_t packet_[NTP_PACKET_SIZE];
+    unsigned long requestCount_ = 0;
+    unsigned long droppedCount_ = 0;
+    unsigned long holdoverCount_ = 0;
+
+    void reply(const PpsClock &clock, const RtcHoldover &holdover, bool useHoldover, const NtpTimestamp &receiveTime);
+    static void writeTimestamp(uint8_t *buf, const NtpTimestamp &ts);
+};
+
+#endif // NTP_SERVER_H
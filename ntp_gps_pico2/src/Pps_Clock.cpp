@@ -0,0 +1,156 @@
+#include <Pps_Clock.h>
+#include <math.h>
+
+// 基準エッジからの経過時間 (補正後) [s]
+double PpsClock::elapsed(uint64_t localUs) const
+{
+  int64_t delta = (int64_t)(localUs - anchorUs_);
+  return phase_ + (double)delta * 1e-6 * (1.0 + freq_);
+}
+
+NtpTimestamp PpsClock::now(uint64_t localUs) const
+{
+  return toNtpTimestamp(anchorSec_, elapsed(localUs));
+}
+
+NtpTimestamp PpsClock::lastEdgeTime() const
+{
+  return toNtpTimestamp(anchorSec_, phase_);
+}
+
+bool PpsClock::synchronized(uint64_t localUs) const
+{
+  return state_ == PPS_CLOCK_PLL &&
+         (localUs - anchorUs_) < (uint64_t)PPS_CLOCK_TIMEOUT_SEC * 1000000ULL;
+}
+
+// PPSエッジ (割り込みで取得したローカル時刻)
+void PpsClock::onPps(uint64_t localUs, double correction)
+{
+  edgeCount_++;
+  pendingUs_ = localUs;
+  pendingCorrection_ = correction;
+  pending_ = true;
+
+  if (!anchored_)
+  {
+    return;
+  }
+
+  // 基準エッジから何秒目のエッジかを推定する
+  long n = lround(elapsed(localUs) - correction);
+  if (n <= 0)
+  {
+    // 同じ秒の中の重複エッジ(チャタリング)は無視する
+    pending_ = false;
+    return;
+  }
+  update(localUs, anchorSec_ + n, correction);
+}
+
+// NAV-PVTのUTC秒 (PVTはエッジの後に届く)
+void PpsClock::onUtcSecond(uint32_t unixSeconds, uint64_t receivedUs)
+{
+  if (!pending_ || receivedUs < pendingUs_ || receivedUs - pendingUs_ > 1000000ULL)
+  {
+    return;
+  }
+  pending_ = false;
+
+  if (!anchored_)
+  {
+    step(pendingUs_, unixSeconds, pendingCorrection_);
+  }
+  else if (anchorUs_ == pendingUs_ && anchorSec_ != unixSeconds)
+  {
+    // 推定した秒番号がGNSSと食い違う場合は合わせ直す
+    step(pendingUs_, unixSeconds, pendingCorrection_);
+  }
+}
+
+// 基準エッジのローカル時刻は正しい秒の境界よりcorrectionだけ遅れている
+void PpsClock::step(uint64_t localUs, uint32_t unixSeconds, double correction)
+{
+  anchored_ = true;
+  anchorUs_ = localUs;
+  anchorSec_ = unixSeconds;
+  phase_ = correction;
+  offset_ = 0.0;
+  lockCount_ = 0;
+  outlierRun_ = 0;
+  lastSec_ = unixSeconds;
+  state_ = PPS_CLOCK_FLL;
+  stepCount_++;
+}
+
+void PpsClock::update(uint64_t localUs, uint32_t unixSeconds, double correction)
+{
+  if (unixSeconds - lastSec_ > 1)
+  {
+    missedCount_ += unixSeconds - lastSec_ - 1;
+  }
+  lastSec_ = unixSeconds;
+  uint32_t dt = unixSeconds - anchorSec_;
+
+  // 正ならクロックが進んでいる
+  double offset = elapsed(localUs) - correction - (double)dt;
+
+  // 1つだけ外れたエッジ (割り込みの遅れなど) は捨て、基準エッジも変えない
+  // ロック中はPLLを外れる大きさ、それ以外はステップする大きさのオフセットを外れ値とする
+  double limit = state_ == PPS_CLOCK_PLL ? PPS_CLOCK_LOCK_THRESHOLD * 10 : PPS_CLOCK_STEP_THRESHOLD;
+  if (fabs(offset) > limit && ++outlierRun_ < PPS_CLOCK_STEPOUT_COUNT)
+  {
+    outlierCount_++;
+    return;
+  }
+  outlierRun_ = 0;
+
+  if (fabs(offset) > PPS_CLOCK_STEP_THRESHOLD)
+  {
+    // 位相だけをステップさせる。周波数は続くFLLで引き込むので、このオフセットでは変えない
+    step(localUs, unixSeconds, correction);
+    offset_ = offset;
+    return;
+  }
+
+  double diff = offset - offset_;
+  jitter_ = sqrt((jitter_ * jitter_ * (PPS_CLOCK_JITTER_AVG - 1) + diff * diff) / PPS_CLOCK_JITTER_AVG);
+  offset_ = offset;
+
+  if (state_ == PPS_CLOCK_FLL)
+  {
+    // FLL: 周波数を直接補正し、位相は毎回合わせる
+    freq_ -= PPS_CLOCK_FLL_K * offset / dt;
+    phase_ = correction;
+    if (fabs(offset) < PPS_CLOCK_LOCK_THRESHOLD)
+    {
+      if (++lockCount_ >= PPS_CLOCK_LOCK_COUNT)
+      {
+        state_ = PPS_CLOCK_PLL;
+      }
+    }
+    else
+    {
+      lockCount_ = 0;
+    }
+  }
+  else
+  {
+    // PLL: PI制御で位相と周波数を補正する
+    freq_ -= PPS_CLOCK_PLL_KI * offset / dt;
+    phase_ = offset * (1.0 - PPS_CLOCK_PLL_KP) + correction;
+    if (fabs(offset) > PPS_CLOCK_LOCK_THRESHOLD * 10)
+    {
+      state_ = PPS_CLOCK_FLL;
+      lockCount_ = 0;
+    }
+  }
+
+  if (freq_ > PPS_CLOCK_MAX_FREQ)
+    freq_ = PPS_CLOCK_MAX_FREQ;
+  else if (freq_ < -PPS_CLOCK_MAX_FREQ)
+    freq_ = -PPS_CLOCK_MAX_FREQ;
+
+  anchorUs_ = localUs;
+  anchorSec_ = unixSeconds;
+}
@@ -0,0 +1,85 @@
+#ifndef PPS_CLOCK_H
+#define PPS_CLOCK_H
+
+#include <stdint.h>
+#include <Time_Utils.h>
+
+// PPSで規律するソフトウェアクロック
+// ローカルのマイクロ秒カウンタ(time_us_64)をPPSエッジに同期させ、
+// 発振器の周波数誤差をPLL/FLLサーボで推定する。
+// Arduinoに依存しないのでホスト上でも動作する。
+
+#define PPS_CLOCK_STEP_THRESHOLD 0.0005  // これを超えるオフセットはステップで補正 [s]
+#define PPS_CLOCK_STEPOUT_COUNT 3        // 外れたエッジがこれだけ続いたらステップ (PLLならFLLに戻る)
+#define PPS_CLOCK_LOCK_THRESHOLD 0.00001 // ロック判定のオフセット [s]
+#define PPS_CLOCK_LOCK_COUNT 8           // ロックに必要な連続エッジ数
+#define PPS_CLOCK_MAX_FREQ 0.0005        // 許容する周波数誤差 (500ppm)
+#define PPS_CLOCK_TIMEOUT_SEC 10         // PPSが途絶えたら未同期とみなす [s]
+#define PPS_CLOCK_PLL_KP 0.3             // PLL 位相ゲイン
+#define PPS_CLOCK_PLL_KI 0.02            // PLL 周波数ゲイン
+#define PPS_CLOCK_FLL_K 0.7              // FLL 周波数ゲイン
+#define PPS_CLOCK_JITTER_AVG 8           // ジッタ平均の時定数 [エッジ数]
+
+// 割り込みハンドラが記録するPPSイベント
+struct PpsEvent
+{
+  uint64_t localUs;  // エッジのローカル時刻 (time_us_64)
+  uint32_t sequence; // 割り込みの通し番号
+};
+
+enum PpsClockState
+{
+  PPS_CLOCK_UNSYNC = 0, // 未同期
+  PPS_CLOCK_FLL = 1,    // 周波数引き込み中
+  PPS_CLOCK_PLL = 2,    // 位相ロック
+};
+
+class PpsClock
+{
+public:
+    // correctionはTIM-TPのqErr: パルスが正しい秒の境界より遅れて出た時間 [s]
+    // ローカル時刻の分解能(1us)より細かいので、位相の計算にだけ反映する
+    void onPps(uint64_t localUs, double correction = 0.0);
+    void onUtcSecond(uint32_t unixSeconds, uint64_t receivedUs);
+
+    NtpTimestamp now(uint64_t localUs) const;
+    NtpTimestamp lastEdgeTime() const;
+    bool synchronized(uint64_t localUs) const;
+
+    PpsClockState getState() const { return state_; }
+    double getOffset() const { return offset_; }       // 最後のエッジでのオフセット [s]
+    double getFrequency() const { return freq_; }      // 周波数補正量 (1e-6 = 1ppm)
+    double getJitter() const { return jitter_; }       // オフセット差分のRMS [s]
+    uint32_t getEdgeCount() const { return edgeCount_; }
+    uint32_t getMissedCount() const { return missedCount_; }
+    uint32_t getStepCount() const { return stepCount_; }
+    uint32_t getOutlierCount() const { return outlierCount_; } // 捨てた外れ値のエッジ
+
+private:
+    PpsClockState state_ = PPS_CLOCK_UNSYNC;
+    bool anchored_ = false;
+    uint64_t anchorUs_ = 0;   // 基準にしたエッジのローカル時刻
+    uint32_t anchorSec_ = 0;  // 基準エッジのUNIX秒
+    double phase_ = 0.0;      // 基準エッジでの残留位相 [s]
+    double freq_ = 0.0;
+
+    uint64_t pendingUs_ = 0;  // UTC秒が未確定のエッジ
+    double pendingCorrection_ = 0.0;
+    bool pending_ = false;
+
+    double offset_ = 0.0;
+    double jitter_ = 0.0;
+    uint8_t lockCount_ = 0;
+    uint8_t outlierRun_ = 0;  // 続いている外れ値のエッジの数
+    uint32_t lastSec_ = 0;    // 最後に処理したエッジのUNIX秒 (外れ値を含む)
+    uint32_t edgeCount_ = 0;
+    uint32_t missedCount_ = 0;
+    uint32_t stepCount_ = 0;
+    uint32_t outlierCount_ = 0;
+
+    double elapsed(uint64_t localUs) const;
+    void step(uint64_t localUs, uint32_t unixSeconds, double correction);
+    void update(uint64_t localUs, uint32_t unixSeconds, double correction);
+};
+
+#endif // PPS_CLOCK_H
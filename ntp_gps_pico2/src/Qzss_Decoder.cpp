@@ -0,0 +1,148 @@
+#include <Qzss_Decoder.h>
+#include <Buffer_Print.h>
+#include <QZQSM.h>
+#include <QZSSDCX.h>
+#include <pico/time.h>
+
+static QZQSM dc_report;
+static DCXDecoder dcx_decoder;
+
+// u-bloxのコールバックから呼ぶ。デコードはせず、新しいメッセージだけをキューに積む
+bool QzssDecoder::enqueue(uint8_t svId, const uint32_t *dwrd, uint8_t numWords)
+{
+  QzssFrame frame;
+  frame.receivedMicros = time_us_64();
+  frame.svId = svId;
+  memset(frame.data, 0, sizeof(frame.data));
+
+  // SFRBXのdwrdはリトルエンディアンなので入れ替える
+  for (int i = 0; i < min(int(numWords), QZSS_FRAME_SIZE / 4); i++)
+  {
+    frame.data[(i << 2) + 0] = (dwrd[i] >> 24) & 0xff;
+    frame.data[(i << 2) + 1] = (dwrd[i] >> 16) & 0xff;
+    frame.data[(i << 2) + 2] = (dwrd[i] >> 8) & 0xff;
+    frame.data[(i << 2) + 3] = (dwrd[i]) & 0xff;
+  }
+  // 250bit以降は使わない
+  frame.data[QZSS_FRAME_SIZE - 1] &= 0xc0;
+
+  byte pab = frame.data[0];
+  frame.mt = frame.data[1] >> 2;
+  if (pab != 0x53 && pab != 0x9A && pab != 0xC6)
+  {
+    return false;
+  }
+  if (frame.mt != QZSS_MT_DC_REPORT && frame.mt != QZSS_MT_DCX)
+  {
+    return false;
+  }
+  frameCount_[frame.mt - QZSS_MT_DC_REPORT]++;
+
+  // 同じ内容は数秒ごとに再送されるので、どの衛星から受信したかは問わず重複を捨てる
+  // プリアンブルはフレームごとに替わり、CRCはそれに依存するので、メッセージタイプとデータだけをハッシュする
+  uint8_t content[QZSS_CONTENT_LAST_BYTE - QZSS_CONTENT_FIRST_BYTE + 1];
+  memcpy(content, &frame.data[QZSS_CONTENT_FIRST_BYTE], sizeof(content));
+  content[sizeof(content) - 1] &= QZSS_CONTENT_LAST_MASK;
+  uint32_t hash = fnv1aHash(content, sizeof(content));
+  if (!cache_.insert(hash))
+  {
+    return false;
+  }
+  if (!queue_.push(frame))
+  {
+    cache_.forget(hash);
+    return false;
+  }
+  return true;
+}
+
+// キューから1つ取り出してデコードし、履歴に追加する
+bool QzssDecoder::process(uint16_t year, uint32_t unixTime, uint64_t unixMicros)
+{
+  QzssFrame frame;
+  if (!queue_.pop(frame))
+  {
+    return false;
+  }
+
+  QzssMessage message;
+  decode(frame, message, year);
+  message.unixTime = 0;
+  if (unixTime != 0)
+  {
+    message.unixTime = unixTime + (int32_t)((int64_t)(frame.receivedMicros - unixMicros) / 1000000);
+  }
+  messageCount_[frame.mt - QZSS_MT_DC_REPORT]++;
+
+  uint32_t sequence = latest_.load(std::memory_order_relaxed) + 1;
+  message.sequence = sequence;
+
+  HistorySlot &slot = history_[(sequence - 1) % QZSS_HISTORY_SIZE];
+  uint32_t lock = slot.lock.load(std::memory_order_relaxed);
+  slot.lock.store(lock + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.message = message;
+  slot.lock.store(lock + 2, std::memory_order_release);
+  latest_.store(sequence, std::memory_order_release);
+  return true;
+}
+
+void QzssDecoder::decode(const QzssFrame &frame, QzssMessage &message, uint16_t year)
+{
+  message.receivedMicros = frame.receivedMicros;
+  message.svId = frame.svId;
+  message.mt = frame.mt;
+
+  BufferPrint summary(message.summary, sizeof(message.summary));
+
+  // 災害・危機管理通報サービス（DC Report）
+  if (frame.mt == QZSS_MT_DC_REPORT)
+  {
+    dc_report.SetYear(year);
+    dc_report.Decode((byte *)frame.data);
+    summary.print(dc_report.GetReport());
+  }
+  // 災害・危機管理通報サービス（拡張）（DCX）
+  else if (frame.mt == QZSS_MT_DCX)
+  {
+    dcx_decoder.decode((byte *)frame.data);
+    dcx_decoder.printSummary(summary, dcx_decoder.r);
+  }
+
+  stream_.print(frame.mt);
+  stream_.print(frame.mt == QZSS_MT_DC_REPORT ? " DC Report" : " DCX message");
+  stream_.print(" svId: ");
+  stream_.println(frame.svId);
+  stream_.println(message.summary);
+#if defined(DEBUG_CONSOLE_DCX_ALL)
+  if (frame.mt == QZSS_MT_DCX)
+  {
+    dcx_decoder.printAll(stream_, dcx_decoder.r);
+  }
+#endif
+}
+
+// 指定した通し番号のメッセージをコピーする。既に上書きされていればfalseを返す
+bool QzssDecoder::read(uint32_t sequence, QzssMessage &message) const
+{
+  if (sequence == 0 || sequence > latestSequence())
+  {
+    return false;
+  }
+  const HistorySlot &slot = history_[(sequence - 1) % QZSS_HISTORY_SIZE];
+  for (uint8_t retry = 0; retry < 3; retry++)
+  {
+    uint32_t lock = slot.lock.load(std::memory_order_acquire);
+    if (lock & 1)
+    {
+      continue;
+    }
+    message = slot.message;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.lock.load(std::memory_order_relaxed) == lock)
+    {
+      return message.sequence == sequence;
+    }
+  }
+  return false;
+}
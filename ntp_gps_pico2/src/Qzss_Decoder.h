@@ -0,0 +1,83 @@
+#ifndef QZSS_DECODER_H
+#define QZSS_DECODER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <Event_Queue.h>
+#include <Message_Cache.h>
+
+#define QZSS_FRAME_SIZE 32     // L1Sメッセージ 250bit
+#define QZSS_QUEUE_SIZE 8      // デコード待ちのフレーム数
+#define QZSS_CACHE_SIZE 16     // 重複判定に使う直近のメッセージ数
+#define QZSS_HISTORY_SIZE 16   // デコード結果を保持する数
+#define QZSS_SUMMARY_SIZE 320  // デコード結果の文字列の最大長
+
+#define QZSS_CONTENT_FIRST_BYTE 1 // メッセージタイプとデータ (bit 8..225) の範囲。プリアンブルとCRCは含めない
+#define QZSS_CONTENT_LAST_BYTE 28
+#define QZSS_CONTENT_LAST_MASK 0xc0
+
+#define QZSS_MT_DC_REPORT 43
+#define QZSS_MT_DCX 44
+
+// コールバックからデコード処理へ渡す生のフレーム
+struct QzssFrame
+{
+  uint64_t receivedMicros;
+  uint8_t svId;
+  uint8_t mt;
+  uint8_t data[QZSS_FRAME_SIZE];
+};
+
+// デコード済みのメッセージ
+struct QzssMessage
+{
+  uint32_t sequence; // 1から始まる通し番号
+  uint64_t receivedMicros;
+  uint32_t unixTime; // 受信時刻 (UTCが不明なら0)
+  uint8_t svId;
+  uint8_t mt;
+  char summary[QZSS_SUMMARY_SIZE];
+};
+
+// QZSS L1S 災危通報(DC Report/DCX)のデコード
+// enqueue()はu-bloxのコールバックから呼び、ハッシュで重複を除いて生のフレームを積むだけにする。
+// process()で新しいメッセージだけをデコードし、履歴のリングバッファに残す。
+// enqueue()とprocess()は同じコア(core1)から、read()は別のコアから呼んでよい。
+class QzssDecoder
+{
+public:
+    QzssDecoder(Stream &stream) : stream_(stream) {};
+
+    bool enqueue(uint8_t svId, const uint32_t *dwrd, uint8_t numWords);
+    // unixTime/unixMicrosは直近でUTCが分かっている時刻とその時のtime_us_64()
+    bool process(uint16_t year, uint32_t unixTime, uint64_t unixMicros);
+
+    // 読み出し側
+    uint32_t latestSequence() const { return latest_.load(std::memory_order_acquire); }
+    bool read(uint32_t sequence, QzssMessage &message) const;
+
+    // mtはQZSS_MT_DC_REPORTかQZSS_MT_DCX
+    uint32_t getFrameCount(uint8_t mt) const { return frameCount_[mt - QZSS_MT_DC_REPORT]; }     // 受信したフレーム数 (重複を含む)
+    uint32_t getMessageCount(uint8_t mt) const { return messageCount_[mt - QZSS_MT_DC_REPORT]; } // デコードした新しいメッセージ数
+    uint32_t getDuplicateCount() const { return cache_.hits(); }
+    uint32_t getDroppedCount() const { return queue_.overflowCount(); }
+
+private:
+    struct HistorySlot
+    {
+        std::atomic<uint32_t> lock{0}; // 奇数の間は書き込み中 (seqlock)
+        QzssMessage message;
+    };
+
+    Stream &stream_;
+    EventQueue<QzssFrame, QZSS_QUEUE_SIZE> queue_;
+    MessageCache<QZSS_CACHE_SIZE> cache_;
+    HistorySlot history_[QZSS_HISTORY_SIZE];
+    std::atomic<uint32_t> latest_{0};
+    volatile uint32_t frameCount_[2] = {};
+    volatile uint32_t messageCount_[2] = {};
+
+    void decode(const QzssFrame &frame, QzssMessage &message, uint16_t year);
+};
+
+#endif // QZSS_DECODER_H
@@ -0,0 +1,116 @@
+#include <Response_Writer.h>
+
+uint8_t ResponseWriter::buffer_[RESPONSE_BUFFER_SIZE];
+
+ResponseWriter::ResponseWriter(Client &client) : client_(client)
+{
+  startMicros_ = micros();
+}
+
+size_t ResponseWriter::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t ResponseWriter::write(const uint8_t *buffer, size_t size)
+{
+  size_t written = 0;
+  while (written < size)
+  {
+    if (length_ >= limit())
+    {
+      flush();
+    }
+    size_t n = min(size - written, limit() - length_);
+    memcpy(&buffer_[length_], &buffer[written], n);
+    length_ += n;
+    written += n;
+  }
+  return written;
+}
+
+// ここまでをヘッダとして送り、以降の本文をチャンクに分ける
+void ResponseWriter::beginChunked()
+{
+  if (chunked_)
+  {
+    return;
+  }
+  if (length_ > RESPONSE_BUFFER_SIZE - RESPONSE_CHUNK_HEADER_SIZE - RESPONSE_CHUNK_TRAILER_SIZE - 1)
+  {
+    send();
+  }
+  chunked_ = true;
+  chunkStart_ = length_;
+  length_ += RESPONSE_CHUNK_HEADER_SIZE;
+}
+
+// チャンクサイズは固定幅の16進数で予約領域に書き込む
+void ResponseWriter::closeChunk()
+{
+  size_t size = length_ - chunkStart_ - RESPONSE_CHUNK_HEADER_SIZE;
+  if (size == 0)
+  {
+    length_ = chunkStart_;
+    return;
+  }
+  static const char hex[] = "0123456789ABCDEF";
+  uint8_t *header = &buffer_[chunkStart_];
+  header[0] = hex[(size >> 12) & 0xf];
+  header[1] = hex[(size >> 8) & 0xf];
+  header[2] = hex[(size >> 4) & 0xf];
+  header[3] = hex[size & 0xf];
+  header[4] = '\r';
+  header[5] = '\n';
+  buffer_[length_++] = '\r';
+  buffer_[length_++] = '\n';
+}
+
+// バッファがあふれたときだけ呼ばれ、送信バッファが空くのを待ちながら書き込む
+void ResponseWriter::send()
+{
+  if (length_ == 0)
+  {
+    return;
+  }
+  for (size_t offset = 0; offset < length_; offset += RESPONSE_SEGMENT_SIZE)
+  {
+    client_.write(&buffer_[offset], min(length_ - offset, (size_t)RESPONSE_SEGMENT_SIZE));
+    segments_++;
+  }
+  bytes_ += length_;
+  overflows_++;
+  length_ = 0;
+}
+
+void ResponseWriter::flush()
+{
+  if (chunked_)
+  {
+    closeChunk();
+    send();
+    chunkStart_ = 0;
+    length_ = RESPONSE_CHUNK_HEADER_SIZE;
+  }
+  else
+  {
+    send();
+  }
+}
+
+// 描画を終える。チャンク転送なら終端チャンクを付ける。残りはpending()バイト
+void ResponseWriter::end()
+{
+  if (ended_)
+  {
+    return;
+  }
+  ended_ = true;
+  if (chunked_)
+  {
+    closeChunk();
+    memcpy(&buffer_[length_], "0\r\n\r\n", 5);
+    length_ += 5;
+  }
+  bytes_ += length_;
+}
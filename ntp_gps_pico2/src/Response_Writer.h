@@ -0,0 +1,56 @@
+#ifndef RESPONSE_WRITER_H
+#define RESPONSE_WRITER_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+#define RESPONSE_BUFFER_SIZE 32768   // 1つのレスポンスを描画しておくバッファ (/metricsの約2倍)
+#define RESPONSE_SEGMENT_SIZE 2048   // W5500のソケット当たりの送信バッファ (8ソケット時)
+#define RESPONSE_CHUNK_HEADER_SIZE 6  // "XXXX\r\n"
+#define RESPONSE_CHUNK_TRAILER_SIZE 7 // "\r\n" + "0\r\n\r\n"
+
+// レスポンスをバッファに描画する。送信は呼び出し側がdata()/pending()から少しずつ行う
+// バッファに入りきらない分だけはその場でソケットに書き込む
+// beginChunked()以降はチャンク転送エンコーディングで送る
+class ResponseWriter : public Print
+{
+public:
+    ResponseWriter(Client &client);
+    ~ResponseWriter() { end(); }
+
+    // 描画済みで未送信のレスポンス。次のResponseWriterを作るまで有効
+    static const uint8_t *data() { return buffer_; }
+    size_t pending() const { return length_; }
+    uint32_t getOverflows() const { return overflows_; }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    void beginChunked();
+    void flush() override;
+    void end();
+
+    uint32_t getBytes() const { return bytes_; }
+    uint16_t getSegments() const { return segments_; }
+    unsigned long getElapsedMicros() const { return micros() - startMicros_; }
+
+private:
+    static uint8_t buffer_[RESPONSE_BUFFER_SIZE]; // 送信は同時に1つだけなので共有する
+
+    Client &client_;
+    size_t length_ = 0;
+    size_t chunkStart_ = 0;
+    bool chunked_ = false;
+    bool ended_ = false;
+    uint32_t bytes_ = 0;
+    uint16_t segments_ = 0;
+    uint32_t overflows_ = 0;
+    unsigned long startMicros_;
+
+    size_t limit() const { return chunked_ ? RESPONSE_BUFFER_SIZE - RESPONSE_CHUNK_TRAILER_SIZE : RESPONSE_BUFFER_SIZE; }
+    void closeChunk();
+    void send();
+};
+
+#endif // RESPONSE_WRITER_H
@@ -0,0 +1,286 @@
+#include <Rtc_Holdover.h>
+#include <math.h>
+
+void TemperatureModel::add(double temperature, double frequency)
+{
+  double x = temperature - RTC_HOLDOVER_TEMP_REF;
+  double xk = 1.0;
+  for (uint8_t k = 0; k < 5; k++)
+  {
+    sx_[k] = sx_[k] * RTC_HOLDOVER_FORGET + xk;
+    if (k < 3)
+    {
+      sy_[k] = sy_[k] * RTC_HOLDOVER_FORGET + frequency * xk;
+    }
+    xk *= x;
+  }
+  syy_ = syy_ * RTC_HOLDOVER_FORGET + frequency * frequency;
+  points_++;
+}
+
+void TemperatureModel::shift(double frequency)
+{
+  // Σw(y-d)^2 = Σwy^2 - 2dΣwy + d^2Σw
+  syy_ += -2.0 * frequency * sy_[0] + frequency * frequency * sx_[0];
+  for (uint8_t k = 0; k < 3; k++)
+  {
+    sy_[k] -= frequency * sx_[k];
+  }
+}
+
+// 係数を求めて、使った係数の数(0-3)を返す
+uint8_t TemperatureModel::solve(double c[3]) const
+{
+  c[0] = c[1] = c[2] = 0.0;
+  if (points_ == 0 || sx_[0] <= 0.0)
+  {
+    return 0;
+  }
+
+  // 温度の幅が狭いと高次の係数は決まらない
+  double mean = sx_[1] / sx_[0];
+  double variance = sx_[2] / sx_[0] - mean * mean;
+  uint8_t n = 1;
+  if (points_ >= 4 && variance >= 4.0)
+  {
+    n = 3;
+  }
+  else if (points_ >= 3 && variance >= 0.25)
+  {
+    n = 2;
+  }
+
+  for (; n > 0; n--)
+  {
+    double a[3][4];
+    for (uint8_t i = 0; i < n; i++)
+    {
+      for (uint8_t j = 0; j < n; j++)
+      {
+        a[i][j] = sx_[i + j];
+      }
+      a[i][n] = sy_[i];
+    }
+
+    // ガウスの消去法 (部分ピボット)
+    bool singular = false;
+    for (uint8_t col = 0; col < n && !singular; col++)
+    {
+      uint8_t pivot = col;
+      for (uint8_t row = col + 1; row < n; row++)
+      {
+        if (fabs(a[row][col]) > fabs(a[pivot][col]))
+        {
+          pivot = row;
+        }
+      }
+      if (fabs(a[pivot][col]) < 1e-9 * sx_[0])
+      {
+        singular = true;
+        break;
+      }
+      for (uint8_t j = 0; j <= n; j++)
+      {
+        double t = a[col][j];
+        a[col][j] = a[pivot][j];
+        a[pivot][j] = t;
+      }
+      for (uint8_t row = 0; row < n; row++)
+      {
+        if (row == col)
+        {
+          continue;
+        }
+        double f = a[row][col] / a[col][col];
+        for (uint8_t j = col; j <= n; j++)
+        {
+          a[row][j] -= f * a[col][j];
+        }
+      }
+    }
+    if (singular)
+    {
+      continue;
+    }
+    for (uint8_t i = 0; i < n; i++)
+    {
+      c[i] = a[i][n] / a[i][i];
+    }
+    return n;
+  }
+  return 0;
+}
+
+double TemperatureModel::frequency(double temperature) const
+{
+  double c[3];
+  solve(c);
+  double x = temperature - RTC_HOLDOVER_TEMP_REF;
+  return c[0] + (c[1] + c[2] * x) * x;
+}
+
+double TemperatureModel::residual() const
+{
+  double c[3];
+  uint8_t n = solve(c);
+  if (points_ <= n)
+  {
+    return 0.0;
+  }
+  // 正規方程式の解ではΣw(y-f)^2 = Σwy^2 - Σc_k Σwyx^k
+  double rss = syy_ - (c[0] * sy_[0] + c[1] * sy_[1] + c[2] * sy_[2]);
+  if (rss <= 0.0)
+  {
+    return 0.0;
+  }
+  return sqrt(rss / sx_[0] * points_ / (points_ - n));
+}
+
+void RtcHoldover::resetWindow()
+{
+  windowCount_ = 0;
+  windowT_ = windowTT_ = windowP_ = windowTP_ = windowTemp_ = 0.0;
+}
+
+void RtcHoldover::restart()
+{
+  resetWindow();
+  state_ = RTC_HOLDOVER_IDLE;
+  phase_ = 0.0;
+}
+
+void RtcHoldover::calibrate(uint64_t edgeUs, uint32_t rtcSeconds, const NtpTimestamp &reference, double temperature)
+{
+  int32_t seconds = (int32_t)(rtcSeconds + NTP_UNIX_OFFSET - reference.seconds);
+  double phase = (double)seconds - reference.fraction / 4294967296.0;
+
+  state_ = RTC_HOLDOVER_TRACKING;
+  phase_ = phase;
+  phaseUs_ = edgeUs;
+  temperature_ = temperature;
+  if (fabs(phase) > RTC_HOLDOVER_MAX_PHASE)
+  {
+    resetWindow();
+    return;
+  }
+
+  // 観測期間の位相の傾きが周波数誤差
+  if (windowCount_ == 0)
+  {
+    windowStartUs_ = edgeUs;
+  }
+  double t = (double)(edgeUs - windowStartUs_) * 1e-6;
+  windowCount_++;
+  windowT_ += t;
+  windowTT_ += t * t;
+  windowP_ += phase;
+  windowTP_ += t * phase;
+  windowTemp_ += temperature;
+  if (t < RTC_HOLDOVER_WINDOW_SEC || windowCount_ < RTC_HOLDOVER_MIN_SAMPLES)
+  {
+    return;
+  }
+
+  double n = windowCount_;
+  double det = n * windowTT_ - windowT_ * windowT_;
+  if (det > 0.0)
+  {
+    model_.add(windowTemp_ / n, (n * windowTP_ - windowT_ * windowP_) / det);
+    agingPoints_++;
+  }
+
+  // 次の観測期間はこの位相から始める
+  resetWindow();
+  windowStartUs_ = edgeUs;
+  windowCount_ = 1;
+  windowP_ = phase;
+  windowTemp_ = temperature;
+}
+
+void RtcHoldover::holdover(uint64_t edgeUs, uint32_t rtcSeconds, double temperature, double localFreq)
+{
+  if (state_ == RTC_HOLDOVER_IDLE)
+  {
+    return;
+  }
+  if (state_ != RTC_HOLDOVER_ACTIVE)
+  {
+    // 最後にGNSSで測った位相から予測を始める
+    state_ = RTC_HOLDOVER_ACTIVE;
+    holdoverStartUs_ = phaseUs_;
+    resetWindow();
+  }
+
+  // 前回からの位相の変化を、その間の平均温度での周波数で積分する
+  double dt = (double)(int64_t)(edgeUs - phaseUs_) * 1e-6;
+  phase_ += model_.frequency((temperature + temperature_) / 2) * dt;
+  phaseUs_ = edgeUs;
+  temperature_ = temperature;
+
+  anchorUs_ = edgeUs;
+  anchorSec_ = rtcSeconds;
+  anchorPhase_ = -phase_;
+  localFreq_ = localFreq;
+}
+
+int8_t RtcHoldover::agingStep() const
+{
+  if (agingPoints_ < RTC_HOLDOVER_AGING_POINTS)
+  {
+    return 0;
+  }
+  // 正のエージングは発振器を遅くする。推定のばらつきで往復しないよう不感帯を設ける
+  double lsb = model_.frequency(RTC_HOLDOVER_TEMP_REF) / RTC_HOLDOVER_AGING_LSB;
+  if (fabs(lsb) < RTC_HOLDOVER_AGING_DEADBAND)
+  {
+    return 0;
+  }
+  long step = lround(lsb);
+  if (step > RTC_HOLDOVER_AGING_MAX_STEP)
+    step = RTC_HOLDOVER_AGING_MAX_STEP;
+  else if (step < -RTC_HOLDOVER_AGING_MAX_STEP)
+    step = -RTC_HOLDOVER_AGING_MAX_STEP;
+  return (int8_t)step;
+}
+
+void RtcHoldover::onAgingChanged(int step)
+{
+  // 学習済みの点も新しいエージングでの値に直す
+  model_.shift(step * RTC_HOLDOVER_AGING_LSB);
+  agingPoints_ = 0;
+  resetWindow();
+}
+
+double RtcHoldover::error(uint64_t localUs) const
+{
+  if (state_ != RTC_HOLDOVER_ACTIVE)
+  {
+    return 0.0;
+  }
+  double freqError = RTC_HOLDOVER_DEFAULT_ERROR;
+  if (model_.getPoints() >= RTC_HOLDOVER_AGING_POINTS)
+  {
+    freqError = model_.residual();
+    if (freqError < RTC_HOLDOVER_FREQ_ERROR)
+      freqError = RTC_HOLDOVER_FREQ_ERROR;
+  }
+  return RTC_HOLDOVER_PHASE_ERROR + freqError * (double)(localUs - holdoverStartUs_) * 1e-6;
+}
+
+bool RtcHoldover::active(uint64_t localUs) const
+{
+  return state_ == RTC_HOLDOVER_ACTIVE &&
+         (localUs - anchorUs_) < (uint64_t)RTC_HOLDOVER_EDGE_TIMEOUT_SEC * 1000000ULL &&
+         error(localUs) < RTC_HOLDOVER_MAX_ERROR;
+}
+
+NtpTimestamp RtcHoldover::now(uint64_t localUs) const
+{
+  int64_t delta = (int64_t)(localUs - anchorUs_);
+  return toNtpTimestamp(anchorSec_, anchorPhase_ + (double)delta * 1e-6 * (1.0 + localFreq_));
+}
+
+NtpTimestamp RtcHoldover::lastEdgeTime() const
+{
+  return toNtpTimestamp(anchorSec_, anchorPhase_);
+}
@@ -0,0 +1,107 @@
+#ifndef RTC_HOLDOVER_H
+#define RTC_HOLDOVER_H
+
+#include <stdint.h>
+#include <Time_Utils.h>
+
+// DS3231によるホールドオーバー
+// GNSSロック中はRTCの秒の切り替わりの位相をPPSで規律したクロックと比べ、
+// 一定期間ごとの周波数誤差から温度-周波数モデルを学習する。
+// GNSSを失ったらRTCの切り替わりで時刻を合わせ直し、学習した周波数で位相を補正する。
+// Arduinoに依存しないのでホスト上でも動作する。
+
+#define RTC_HOLDOVER_WINDOW_SEC 1800       // 周波数を1点求める観測期間 [s]
+#define RTC_HOLDOVER_MIN_SAMPLES 8         // 1つの観測期間に必要な位相の数
+#define RTC_HOLDOVER_MAX_PHASE 0.5         // これよりずれた位相は時刻が違うとみなす [s]
+#define RTC_HOLDOVER_FORGET 0.98           // 温度モデルの忘却係数 (1点追加ごと)
+#define RTC_HOLDOVER_TEMP_REF 25.0         // 温度モデルの基準温度 [℃]
+#define RTC_HOLDOVER_AGING_LSB 0.1e-6      // DS3231 エージングレジスタ1LSBの周波数変化 (25℃)
+#define RTC_HOLDOVER_AGING_MAX_STEP 10     // 1回に変えるエージングの最大値 [LSB]
+#define RTC_HOLDOVER_AGING_DEADBAND 1.5    // 25℃の周波数誤差がこれ以下ならエージングを変えない [LSB]
+#define RTC_HOLDOVER_AGING_POINTS 4        // エージングを変えるまでに必要な周波数の点数
+#define RTC_HOLDOVER_PHASE_ERROR 0.001     // 切り替わりの検出誤差 [s]
+#define RTC_HOLDOVER_FREQ_ERROR 0.1e-6     // 学習したモデルの周波数誤差の下限
+#define RTC_HOLDOVER_DEFAULT_ERROR 2e-6    // モデルがない時の周波数誤差 (DS3231の仕様)
+#define RTC_HOLDOVER_EDGE_TIMEOUT_SEC 60   // RTCの切り替わりが途絶えたら時刻を提供しない [s]
+#define RTC_HOLDOVER_MAX_ERROR 0.1         // 推定誤差がこれを超えたら時刻を提供しない [s]
+
+enum RtcHoldoverState
+{
+  RTC_HOLDOVER_IDLE = 0,     // まだRTCの位相を測っていない
+  RTC_HOLDOVER_TRACKING = 1, // GNSSロック中、学習している
+  RTC_HOLDOVER_ACTIVE = 2,   // ホールドオーバー中
+};
+
+// 温度-周波数の2次モデル
+// 重み付き最小二乗の正規方程式の和だけを持ち、古い点ほど軽くする。
+// 温度の幅が狭い間は1次または定数で近似する。
+class TemperatureModel
+{
+public:
+    void add(double temperature, double frequency);
+    // 全ての点の周波数からfrequencyを引く (エージングを変えた時)
+    void shift(double frequency);
+    double frequency(double temperature) const;
+    double residual() const; // 周波数の残差のRMS
+    uint32_t getPoints() const { return points_; }
+
+private:
+    double sx_[5] = {}; // Σw x^k (xは基準温度からの差)
+    double sy_[3] = {}; // Σw y x^k
+    double syy_ = 0.0;  // Σw y^2
+    uint32_t points_ = 0;
+
+    uint8_t solve(double c[3]) const;
+};
+
+class RtcHoldover
+{
+public:
+    // GNSSロック中: RTCがrtcSecondsになった瞬間のローカル時刻edgeUsと、その時の基準時刻
+    void calibrate(uint64_t edgeUs, uint32_t rtcSeconds, const NtpTimestamp &reference, double temperature);
+    // GNSS喪失中: RTCの切り替わりで時刻を合わせ直す。localFreqはPpsClockの周波数補正
+    void holdover(uint64_t edgeUs, uint32_t rtcSeconds, double temperature, double localFreq);
+    // RTCの時刻を設定し直したので位相の観測をやり直す
+    void restart();
+
+    // エージングレジスタに加える値 [LSB]。0なら変えなくてよい
+    int8_t agingStep() const;
+    // エージングレジスタをstepだけ変えた
+    void onAgingChanged(int step);
+
+    bool active(uint64_t localUs) const;
+    NtpTimestamp now(uint64_t localUs) const;
+    NtpTimestamp lastEdgeTime() const;
+    double error(uint64_t localUs) const; // ホールドオーバー中の推定誤差 [s]
+
+    RtcHoldoverState getState() const { return state_; }
+    double getPhase() const { return phase_; } // RTC - 基準 [s] (ホールドオーバー中は予測値)
+    double getFrequency(double temperature) const { return model_.frequency(temperature); } // 正ならRTCが進む
+    double getResidual() const { return model_.residual(); }
+    uint32_t getPoints() const { return model_.getPoints(); }
+
+private:
+    RtcHoldoverState state_ = RTC_HOLDOVER_IDLE;
+    TemperatureModel model_;
+    uint32_t agingPoints_ = 0; // 前回エージングを変えてから追加した点数
+
+    // 観測期間の位相の回帰
+    uint64_t windowStartUs_ = 0;
+    uint32_t windowCount_ = 0;
+    double windowT_ = 0.0, windowTT_ = 0.0, windowP_ = 0.0, windowTP_ = 0.0, windowTemp_ = 0.0;
+
+    double phase_ = 0.0;
+    uint64_t phaseUs_ = 0;
+    double temperature_ = RTC_HOLDOVER_TEMP_REF;
+
+    // ホールドオーバー中の時刻
+    uint64_t holdoverStartUs_ = 0;
+    uint64_t anchorUs_ = 0;
+    uint32_t anchorSec_ = 0;
+    double anchorPhase_ = 0.0; // 基準エッジでのRTC秒からのずれ [s]
+    double localFreq_ = 0.0;
+
+    void resetWindow();
+};
+
+#endif // RTC_HOLDOVER_H
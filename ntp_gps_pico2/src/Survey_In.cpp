@@ -0,0 +1,93 @@
+#include <Survey_In.h>
+#include <math.h>
+
+#define SURVEY_IN_EARTH_RADIUS 6378137.0 // WGS84の赤道半径 [m]
+#define SURVEY_IN_NORTH_SCALE (SURVEY_IN_EARTH_RADIUS * M_PI / 180.0 * 1e-7) // 緯度1e-7度あたりの距離 [m]
+
+bool SurveyIn::add(int32_t lat, int32_t lon, int32_t height, uint32_t hAcc, uint32_t vAcc)
+{
+  if (state_ != SURVEY_IN_RUNNING || hAcc > SURVEY_IN_MAX_HACC || vAcc > SURVEY_IN_MAX_VACC)
+  {
+    return false;
+  }
+  if (count_ == 0)
+  {
+    lat0_ = lat;
+    lon0_ = lon;
+    height0_ = height;
+    eastScale_ = SURVEY_IN_NORTH_SCALE * cos(lat * 1e-7 * M_PI / 180.0);
+  }
+
+  // 基準点からの差は小さいので、平均を引いても桁落ちしない
+  double x[3] = {
+      (double)(lat - lat0_) * SURVEY_IN_NORTH_SCALE,
+      (double)(lon - lon0_) * eastScale_,
+      (double)(height - height0_) * 1e-3,
+  };
+  count_++;
+  for (uint8_t k = 0; k < 3; k++)
+  {
+    double delta = x[k] - mean_[k];
+    mean_[k] += delta / count_;
+    m2_[k] += delta * (x[k] - mean_[k]);
+  }
+
+  double acc = accuracy();
+  if (count_ >= SURVEY_IN_MIN_SAMPLES && acc >= 0.0 && acc <= SURVEY_IN_TARGET_ACCURACY)
+  {
+    state_ = SURVEY_IN_COMPLETE;
+  }
+  return true;
+}
+
+void SurveyIn::fix(const SurveyPosition &position)
+{
+  fixed_ = position;
+  state_ = SURVEY_IN_FIXED;
+}
+
+void SurveyIn::restart()
+{
+  state_ = SURVEY_IN_RUNNING;
+  count_ = 0;
+  for (uint8_t k = 0; k < 3; k++)
+  {
+    mean_[k] = 0.0;
+    m2_[k] = 0.0;
+  }
+}
+
+// 平均の標準誤差 σ/√n を、相関を考えて独立な点の数で割り引く
+double SurveyIn::accuracy() const
+{
+  if (state_ == SURVEY_IN_FIXED)
+  {
+    return fixed_.accuracy;
+  }
+  if (count_ < 2)
+  {
+    return -1.0;
+  }
+  double variance = (m2_[0] + m2_[1] + m2_[2]) / (count_ - 1);
+  double independent = (double)count_ / SURVEY_IN_CORRELATION_SAMPLES;
+  if (independent < 1.0)
+  {
+    independent = 1.0;
+  }
+  return sqrt(variance / independent);
+}
+
+SurveyPosition SurveyIn::position() const
+{
+  if (state_ == SURVEY_IN_FIXED)
+  {
+    return fixed_;
+  }
+  SurveyPosition p;
+  p.latitude = (lat0_ + mean_[0] / SURVEY_IN_NORTH_SCALE) * 1e-7;
+  p.longitude = eastScale_ > 0.0 ? (lon0_ + mean_[1] / eastScale_) * 1e-7 : lon0_ * 1e-7;
+  p.height = height0_ * 1e-3 + mean_[2];
+  p.accuracy = (float)accuracy();
+  p.samples = count_;
+  return p;
+}
@@ -0,0 +1,62 @@
+#ifndef SURVEY_IN_H
+#define SURVEY_IN_H
+
+#include <stdint.h>
+
+// 固定位置のタイミングモードのための位置の平均 (survey-in)
+// NAV-PVTの位置を基準点からの北・東・上の距離に直して平均と分散を逐次計算し、
+// 平均位置の推定精度が目標に達したら完了とする。
+// 位置の誤差は数十秒程度の相関を持つので、独立な点の数を割り引いて精度を見積もる。
+// Arduinoに依存しないのでホスト上でも動作する。
+
+#define SURVEY_IN_MIN_SAMPLES 1800        // 最低限平均する点の数 (NAV-PVTは1Hz)
+#define SURVEY_IN_TARGET_ACCURACY 2.0     // 平均位置の目標精度 (3D) [m]
+#define SURVEY_IN_CORRELATION_SAMPLES 120 // 独立とみなせる点の間隔
+#define SURVEY_IN_MAX_HACC 10000          // これより水平精度が悪い解は使わない [mm]
+#define SURVEY_IN_MAX_VACC 20000          // これより垂直精度が悪い解は使わない [mm]
+
+enum SurveyInState
+{
+  SURVEY_IN_RUNNING = 0,  // 位置を平均している
+  SURVEY_IN_COMPLETE = 1, // 目標精度に達した (受信機への設定待ち)
+  SURVEY_IN_FIXED = 2,    // 受信機が固定位置のタイミングモードで動いている
+};
+
+// 平均した位置 (フラッシュに保存する)
+struct SurveyPosition
+{
+  double latitude;  // [deg]
+  double longitude; // [deg]
+  double height;    // 楕円体高 [m] (CFG-TMODE3はhMSLではなく楕円体高を使う)
+  float accuracy;   // 平均位置の推定精度 (3D) [m]
+  uint32_t samples;
+};
+
+class SurveyIn
+{
+public:
+    // lat/lonは1e-7度、heightは楕円体高 [mm]、hAcc/vAccは [mm]
+    // 使った点ならtrueを返す
+    bool add(int32_t lat, int32_t lon, int32_t height, uint32_t hAcc, uint32_t vAcc);
+    // 保存しておいた位置、または受信機に設定した位置で固定する
+    void fix(const SurveyPosition &position);
+    void restart();
+
+    SurveyInState getState() const { return state_; }
+    uint32_t getSamples() const { return state_ == SURVEY_IN_FIXED ? fixed_.samples : count_; }
+    double accuracy() const; // 平均位置の推定精度 (3D) [m]。点が足りなければ負
+    SurveyPosition position() const;
+
+private:
+    SurveyInState state_ = SURVEY_IN_RUNNING;
+    SurveyPosition fixed_ = {};
+
+    // 最初の点を基準にした北・東・上の距離 [m] のWelfordの平均と偏差平方和
+    int32_t lat0_ = 0, lon0_ = 0, height0_ = 0;
+    double eastScale_ = 0.0; // 経度1e-7度あたりの東西の距離 [m]
+    uint32_t count_ = 0;
+    double mean_[3] = {};
+    double m2_[3] = {};
+};
+
+#endif // SURVEY_IN_H
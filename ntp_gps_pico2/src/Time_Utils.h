@@ -0,0 +1,84 @@
+#ifndef TIME_UTILS_H
+#define TIME_UTILS_H
+
+#include <stdint.h>
+#include <math.h>
+
+// NTPエポック(1900-01-01)とUNIXエポック(1970-01-01)の差 [s]
+#define NTP_UNIX_OFFSET 2208988800UL
+
+// NTPタイムスタンプ (32.32固定小数点)
+struct NtpTimestamp
+{
+  uint32_t seconds;
+  uint32_t fraction;
+};
+
+// 1970-01-01からの経過日数 (Howard Hinnant days_from_civil)
+inline int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d)
+{
+  y -= m <= 2;
+  const int32_t era = (y >= 0 ? y : y - 399) / 400;
+  const uint32_t yoe = (uint32_t)(y - era * 400);
+  const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+// 1970-01-01からの経過日数を年月日に変換する (Howard Hinnant civil_from_days)
+inline void civilFromDays(int32_t z, int32_t &y, uint32_t &m, uint32_t &d)
+{
+  z += 719468;
+  const int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const uint32_t doe = (uint32_t)(z - era * 146097);
+  const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const uint32_t mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = (int32_t)yoe + era * 400 + (m <= 2);
+}
+
+// UTCの年月日時分秒をUNIX時刻に変換する
+inline uint32_t toUnixTime(uint16_t year, uint8_t month, uint8_t day,
+                           uint8_t hour, uint8_t min, uint8_t sec)
+{
+  return (uint32_t)daysFromCivil(year, month, day) * 86400UL +
+         hour * 3600UL + min * 60UL + sec;
+}
+
+// マイクロ秒をNTPタイムスタンプの小数部(2^-32 s)に変換する
+inline uint32_t microsToNtpFraction(uint32_t us)
+{
+  return (uint32_t)(((uint64_t)us << 32) / 1000000ULL);
+}
+
+// NTPタイムスタンプの小数部をマイクロ秒に変換する
+inline uint32_t ntpFractionToMicros(uint32_t fraction)
+{
+  return (uint32_t)(((uint64_t)fraction * 1000000ULL) >> 32);
+}
+
+// UNIX秒にt秒(小数を含む)を加えた時刻をNTPタイムスタンプにする
+inline NtpTimestamp toNtpTimestamp(uint32_t unixSeconds, double t)
+{
+  double whole = floor(t);
+  double frac = t - whole;
+  NtpTimestamp ts;
+  ts.seconds = unixSeconds + NTP_UNIX_OFFSET + (int32_t)whole;
+  ts.fraction = frac >= 1.0 ? 0xffffffffUL : (uint32_t)(frac * 4294967296.0);
+  return ts;
+}
+
+// 秒をNTPの短い形式 (16.16、Root DelayとRoot Dispersion) にする
+// 誤差の見積もりなので切り上げ、表せない大きさは最大値にする
+inline uint32_t toNtpShort(double seconds)
+{
+  if (seconds <= 0.0)
+    return 0;
+  if (seconds >= 65535.0)
+    return 0xffffffffUL;
+  return (uint32_t)(seconds * 65536.0 + 1.0);
+}
+
+#endif // TIME_UTILS_H
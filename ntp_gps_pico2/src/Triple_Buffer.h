@@ -0,0 +1,75 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stdint.h>
+#include <atomic>
+
+// コア間でスナップショットを受け渡すバージョン付きトリプルバッファ
+// 書き込み側(core1)と読み出し側(core0)がそれぞれ1つの場合、
+// どちらもブロックせず(wait-free)、読み出し側はコピーせずに完全な値を参照できる。
+// 公開ごとにバージョンが1ずつ増える (0は未公開)。
+template <typename T>
+class TripleBuffer
+{
+public:
+    // 書き込み側: 次に公開するバッファ (前回の内容は残っていない)
+    T &writeBuffer() { return slots_[back_].value; }
+
+    // 書き込み側: writeBuffer()の内容を公開する
+    void publish()
+    {
+        uint32_t version = writerVersion_ + 1;
+        writerVersion_ = version;
+        slots_[back_].version = version;
+        uint8_t prev = middle_.exchange(back_ | DIRTY, std::memory_order_acq_rel);
+        back_ = prev & INDEX_MASK;
+        latestVersion_.store(version, std::memory_order_release);
+    }
+
+    void publish(const T &value)
+    {
+        writeBuffer() = value;
+        publish();
+    }
+
+    // 読み出し側: 新しい値があれば取り込みtrueを返す
+    bool update()
+    {
+        if ((middle_.load(std::memory_order_relaxed) & DIRTY) == 0)
+        {
+            return false;
+        }
+        uint8_t prev = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & INDEX_MASK;
+        return true;
+    }
+
+    // 読み出し側: 最後にupdate()で取り込んだ値。次のupdate()まで変化しない
+    const T &read() const { return slots_[front_].value; }
+    uint32_t version() const { return slots_[front_].version; }
+
+    // update()せずに、指定したバージョンより新しい値が公開されたかを調べる
+    bool hasChangedSince(uint32_t version) const
+    {
+        return latestVersion_.load(std::memory_order_acquire) != version;
+    }
+
+private:
+    static const uint8_t DIRTY = 0x80;
+    static const uint8_t INDEX_MASK = 0x03;
+
+    struct Slot
+    {
+        T value;
+        uint32_t version;
+    };
+
+    Slot slots_[3] = {};
+    std::atomic<uint8_t> middle_{1};
+    std::atomic<uint32_t> latestVersion_{0};
+    uint32_t writerVersion_ = 0; // 書き込み側専用
+    uint8_t back_ = 0;           // 書き込み側専用
+    uint8_t front_ = 2;          // 読み出し側専用
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -0,0 +1,123 @@
+#include <Ubx_Frame_Parser.h>
+
+#include <string.h>
+
+size_t UbxFrameParser::consume(const uint8_t *data, size_t length)
+{
+  size_t used = 0;
+  while (!ready_)
+  {
+    // 読み直すバイトが残っていれば、新しい入力より先に使う
+    if (replay_ < replayEnd_)
+    {
+      push(buffer_[replay_++]);
+    }
+    else if (used < length)
+    {
+      push(data[used++]);
+    }
+    else
+    {
+      break;
+    }
+  }
+  return used;
+}
+
+void UbxFrameParser::release()
+{
+  ready_ = false;
+  pos_ = 0;
+  length_ = 0;
+}
+
+void UbxFrameParser::restart()
+{
+  discarded_ += pos_ + (replayEnd_ - replay_);
+  ready_ = false;
+  pos_ = 0;
+  length_ = 0;
+  replay_ = replayEnd_ = 0;
+}
+
+// 読みかけのフレームの先頭の同期文字だけを捨て、残りを読み直して次の同期文字を探す
+// 読み直しは書き込み位置 (pos_) より後ろから読むので、同じバッファの中で行える
+void UbxFrameParser::resync()
+{
+  uint16_t rest = replayEnd_ - replay_;
+  memmove(&buffer_[pos_], &buffer_[replay_], rest);
+  replayEnd_ = pos_ + rest;
+  replay_ = 1;
+  discarded_++;
+  pos_ = 0;
+  length_ = 0;
+}
+
+void UbxFrameParser::push(uint8_t c)
+{
+  if (pos_ == 0)
+  {
+    if (c == UBX_FRAME_SYNC1)
+    {
+      buffer_[pos_++] = c;
+    }
+    else
+    {
+      discarded_++;
+    }
+    return;
+  }
+  if (pos_ == 1)
+  {
+    if (c == UBX_FRAME_SYNC2)
+    {
+      buffer_[pos_++] = c;
+      ckA_ = ckB_ = 0;
+    }
+    else if (c == UBX_FRAME_SYNC1)
+    {
+      // 0xB5 0xB5 なら後の方を先頭とみなす
+      discarded_++;
+    }
+    else
+    {
+      discarded_ += 2;
+      pos_ = 0;
+    }
+    return;
+  }
+
+  buffer_[pos_++] = c;
+  if (length_ == 0 || pos_ <= length_ - 2)
+  {
+    // クラスからペイロードの終わりまでがチェックサムの対象
+    ckA_ += c;
+    ckB_ += ckA_;
+  }
+
+  if (pos_ == 6)
+  {
+    uint16_t payload = buffer_[4] | buffer_[5] << 8;
+    if (payload > UBX_FRAME_MAX_PAYLOAD)
+    {
+      oversized_++;
+      resync();
+      return;
+    }
+    length_ = payload + UBX_FRAME_OVERHEAD;
+    return;
+  }
+  if (length_ == 0 || pos_ < length_)
+  {
+    return;
+  }
+
+  if (buffer_[length_ - 2] == ckA_ && buffer_[length_ - 1] == ckB_)
+  {
+    frames_++;
+    ready_ = true;
+    return;
+  }
+  checksumErrors_++;
+  resync();
+}
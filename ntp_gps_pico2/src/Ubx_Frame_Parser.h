@@ -0,0 +1,55 @@
+#ifndef UBX_FRAME_PARSER_H
+#define UBX_FRAME_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// UARTで受けたバイト列からUBXのフレームを切り出す
+// 同期文字・長さ・チェックサムを確かめ、正しいフレームだけを丸ごと渡す。
+// フレームの途中で入力が途切れても、続きを渡せばそこから再開する。
+// 壊れたフレームは2バイト目から読み直すので、その中に始まる次のフレームも失わない。
+// Arduinoに依存しないのでホスト上でも動作する。
+
+#define UBX_FRAME_SYNC1 0xB5
+#define UBX_FRAME_SYNC2 0x62
+#define UBX_FRAME_OVERHEAD 8        // 同期文字2, クラス, ID, 長さ2, チェックサム2
+#define UBX_FRAME_MAX_PAYLOAD 3072  // NAV-SATの最大 (8 + 12 * 255) が入る大きさ
+
+class UbxFrameParser
+{
+public:
+    // フレームが完成するまでdataを読み、使ったバイト数を返す
+    // ready()の間は何も読まない
+    size_t consume(const uint8_t *data, size_t length);
+    bool ready() const { return ready_; }
+    const uint8_t *frame() const { return buffer_; }
+    uint16_t length() const { return length_; }
+    // 完成したフレームを使い終わったら呼ぶ
+    void release();
+    // 入力が途切れたとき (受信バッファのあふれなど) に、読みかけのバイトを捨てる
+    void restart();
+
+    uint32_t getFrames() const { return frames_; }
+    uint32_t getChecksumErrors() const { return checksumErrors_; }
+    uint32_t getDiscarded() const { return discarded_; } // フレーム以外として捨てたバイト数
+    uint32_t getOversized() const { return oversized_; }
+
+private:
+    uint8_t buffer_[UBX_FRAME_MAX_PAYLOAD + UBX_FRAME_OVERHEAD];
+    uint16_t pos_ = 0;
+    uint16_t length_ = 0; // フレーム全体の長さ (ヘッダを読むまで0)
+    uint16_t replay_ = 0; // buffer_[replay_, replayEnd_) は読み直す前のバイト
+    uint16_t replayEnd_ = 0;
+    uint8_t ckA_ = 0, ckB_ = 0;
+    bool ready_ = false;
+
+    uint32_t frames_ = 0;
+    uint32_t checksumErrors_ = 0;
+    uint32_t discarded_ = 0;
+    uint32_t oversized_ = 0;
+
+    void push(uint8_t c);
+    void resync();
+};
+
+#endif // UBX_FRAME_PARSER_H
@@ -1,57 +1,385 @@
 #include <Ethernet.h>
 #include <Wire.h>
+#include <EEPROM.h>
+#if defined(GNSS_ASSIST_DBD)
+#include <LittleFS.h>
+#endif
 #include <SparkFun_u-blox_GNSS_Arduino_Library.h> //http://librarymanager/All#SparkFun_u-blox_GNSS
 #include <Adafruit_GFX.h>
 #include <Adafruit_SH1106.h>
 #include <uRTCLib.h>
 #include <WebServer.h>
 #include <Gps_Client.h>
+#include <Ntp_Server.h>
+#include <Pps_Clock.h>
+#include <Rtc_Holdover.h>
+#include <Survey_In.h>
+#include <Event_Queue.h>
+#include <Latency_Histogram.h>
+#include <Metrics_Writer.h>
+#include <pico/time.h>
+#include <atomic>
+#if defined(GNSS_TRANSPORT_UART)
+#include <Gnss_Uart.h>
+#endif
 
 #define GPS_PPS_PIN 8
 #define GPS_SDA_PIN 6
 #define GPS_SCL_PIN 7
+#define GPS_UART_TX_PIN 0 // -DGNSS_TRANSPORT_UART の時、受信機のUART1とuart0でつなぐ
+#define GPS_UART_RX_PIN 1
 #define BTN_DISPLAY_PIN 11
 #define LED_ERROR_PIN 14
 #define LED_PPS_PIN 15
 #define LED_ONBOARD_PIN 25
 
+#define PPS_LED_ON_MS 50
+#define DEBUG_CONSOLE_INTERVAL_MS 1000 // デバッグ表示の間隔
+#define PPS_QUEUE_SIZE 8
+#define RTC_TEMP_INTERVAL_MS 10000 // RTCの温度を読む間隔
+#define RTC_ADDRESS 0x68
+#define RTC_REG_SECONDS 0x00
+#define RTC_REG_AGING 0x10                // DS3231 エージングオフセット (符号付き、1LSB ≒ 0.1ppm)
+#define RTC_EDGE_INTERVAL_SEC 64          // GNSSロック中にRTCの位相を測る間隔
+#define RTC_EDGE_HOLDOVER_INTERVAL_SEC 16 // ホールドオーバー中にRTCで時刻を合わせ直す間隔
+#define RTC_EDGE_WINDOW_US 20000          // 秒の切り替わりの予想時刻の前後で秒を読む範囲
+#define RTC_EDGE_MAX_GAP_US 2000          // 読み出しの間隔がこれより長い切り替わりは位相に使わない
+#define RTC_EDGE_LOST_SEC 5               // 予想時刻を過ぎても見つからなければ探し直す
+#define RTC_RETRY_MS 1000                 // RTCが読めなかった時に待つ時間
+#define RTC_SET_THRESHOLD 0.01            // RTCの位相がこれよりずれていたらGNSSの時刻で設定する [s]
+#define RTC_SET_MAX_DELAY_US 2000         // PPSエッジからこれ以内に書き込めた時だけRTCを設定する
+
+#define EEPROM_SIZE 256
+#define EEPROM_SURVEY_ADDRESS 0          // 平均した位置の保存場所
+#define EEPROM_SURVEY_MAGIC 0x31565653   // "SVV1"
+#define EEPROM_POSITION_ADDRESS 64       // 直近の測位位置の保存場所 (ホットスタート用)
+#define EEPROM_POSITION_MAGIC 0x31534f50 // "POS1"
+#define SURVEY_RETRY_MS 60000            // 受信機が固定位置の設定を受け付けなかった時に待つ時間
+#define FLASH_WRITE_WINDOW_US 100000     // PPSエッジを処理してからこの間だけフラッシュに書く
+#define FLASH_WRITE_NO_PPS_US 3000000    // PPSがこれより長く来ていなければ待たずに書く
+#define FLASH_WRITE_GUARD_US 1000        // 書き込みの終わりからこれ以内のエッジもサーボに渡さない
+
+#define GNSS_BUS_MEASURE_MS 3000     // 起動時に設定前のバスの転送量を測る時間
+#define GNSS_BUS_INTERVAL_MS 10000   // バスの転送量を測る間隔
+#define GNSS_UBX_MON_COMMS 0x36      // UBX-MON-COMMS (ポートごとの送受信バイト数)
+#define GNSS_UBX_ACK_SIZE 10         // UBX-ACK-ACKのフレームの大きさ
+#if !defined(GNSS_UART_BAUD)
+#define GNSS_UART_BAUD 38400         // 受信機のUART1の初期値
+#endif
+
+// 受信機とつなぐポートによって設定項目とMON-COMMSのポートIDが変わる
+#if defined(GNSS_TRANSPORT_UART)
+#define GNSS_CFG_OUTPROT_UBX UBLOX_CFG_UART1OUTPROT_UBX
+#define GNSS_CFG_OUTPROT_NMEA UBLOX_CFG_UART1OUTPROT_NMEA
+#define GNSS_CFG_MSGOUT(msg) UBLOX_CFG_MSGOUT_UBX_##msg##_UART1
+#define GNSS_MON_COMMS_PORT 0x0100
+#else
+#define GNSS_CFG_OUTPROT_UBX UBLOX_CFG_I2COUTPROT_UBX
+#define GNSS_CFG_OUTPROT_NMEA UBLOX_CFG_I2COUTPROT_NMEA
+#define GNSS_CFG_MSGOUT(msg) UBLOX_CFG_MSGOUT_UBX_##msg##_I2C
+#define GNSS_MON_COMMS_PORT 0x0000
+#endif
+
+#define GNSS_ASSIST_RTC_WAIT_MS 5000           // RTCの時刻を待つ時間。過ぎたら位置だけで支援する
+#define GNSS_ASSIST_TIME_ACC_SEC 2             // RTCの時刻の精度 (秒単位でしか読まないため)
+#define GNSS_ASSIST_MIN_POS_ACC 100.0          // 保存した位置の精度の下限 (アンテナの移動を見込む) [m]
+#define GNSS_ASSIST_SAVE_INTERVAL_MS 600000    // 測位位置の保存を確認する間隔
+#define GNSS_ASSIST_SAVE_DISTANCE 100.0        // 保存した位置からこれ以上離れたら保存し直す [m]
+#define GNSS_ASSIST_DBD_INTERVAL_MS 7200000UL  // 航法データベースを保存する間隔 (エフェメリスは約4時間有効)
+#define GNSS_ASSIST_DBD_FILE "/mga_dbd.ubx"
+#define GNSS_ASSIST_DBD_SIZE 8192
+#define GNSS_ASSISTED_TIME 0x01     // MGA-INI-TIME_UTCを送った
+#define GNSS_ASSISTED_POSITION 0x02 // MGA-INI-POS_LLHを送った
+#define GNSS_ASSISTED_DATABASE 0x04 // MGA-DBDを送った
+
 #define SCREEN_WIDTH 128    // OLED display width, in pixels
 #define SCREEN_HEIGHT 64    // OLED display height, in pixels
 #define OLED_RESET -1       // Reset pin # (or -1 if sharing Arduino reset pin)
 #define SCREEN_ADDRESS 0x3C ///< See datasheet for Address; 0x3D for 128x64, 0x3C for 128x32
+#define SCREEN_REFRESH_MS 1000  // ボタンを押した後の表示の更新間隔
+#define SCREEN_FRAMES 10        // 表示する回数
+#define SCREEN_I2C_CLOCK 400000 // OLEDとRTC(DS3231)のI2Cクロック。どちらも400kHzに対応
 
 SFE_UBLOX_GNSS myGNSS;
 EthernetServer server(80);
 WebServer webServer;
+NtpServer ntpServer(Serial);
+PpsClock ppsClock;
+RtcHoldover rtcHoldover;
 GpsClient gpsClient(Serial);
+#if defined(GNSS_TRANSPORT_UART)
+GnssUart gnssUart(uart0, GPS_UART_TX_PIN, GPS_UART_RX_PIN);
+#endif
 Adafruit_SH1106 display(OLED_RESET);
 uRTCLib rtc;
 byte rtcModel = URTCLIB_MODEL_DS3231;
 
+LatencyHistogram gpsSnapshotLatency; // NAV-PVT受信からcore0で参照できるまで [us]
+LatencyHistogram loopDuration;       // loop()1回の処理時間 [us]
+LatencyHistogram displayFlush;       // display()1回の転送時間 [us]
+
 // Enter a MAC address for your controller below.
 // https://www.hellion.org.uk/cgi-bin/randmac.pl?scope=local&type=unicast
 byte mac[] = {
     0x6e, 0xc9, 0x4c, 0x32, 0x3a, 0xf6};
 
-volatile unsigned long lastPps = 0;
+unsigned long lastPps = 0;
+unsigned long ppsInterval = 0; // 直近のPPSの間隔 [us]
+float rtcTemperature = NAN;
+unsigned long lastRtcTemperature = 0;
+int ethernetMaintainStatus = 0; // 最後のEthernet.maintain()の結果 (0以外)
+int8_t rtcAging = 0;            // DS3231のエージングオフセット
+bool rtcSetPending = false;     // 次のPPSエッジでRTCを設定する
+unsigned long rtcSetCount = 0;
+uint64_t rtcEdgeUs = 0;         // 直近に検出したRTCの秒の切り替わり (0なら未検出)
+bool rtcEdgeSearching = false;  // RTCの秒の切り替わりを探している (読み出しの間隔を空けない)
+volatile float gnssBusRate = NAN;     // 受信機とのバスで受信機が送ったバイト数 [B/s]
+volatile float gnssBusBootRate = NAN; // 起動時、設定を適用する前の値 [B/s]
+volatile bool gnssProfileApplied = false; // CFG-VALSETで設定できた (falseなら従来の設定)
+
+// GNSSのホットスタート (core0が起動時のRTCの時刻を渡し、core1が受信機へ送る)
+std::atomic<bool> rtcBootReady{false};
+uint32_t rtcBootSeconds = 0;          // 起動時に読んだRTCの時刻 (0なら使えない)
+uint64_t rtcBootMicros = 0;           // それを読んだ時刻 (time_us_64)
+volatile uint8_t gnssAssisted = 0;    // 送った支援データ (GNSS_ASSISTED_*)
+double gnssTtff = NAN;                // 起動から最初の測位までの時間 [s]
+
+// PPS割り込みからloopへ渡すイベント
+EventQueue<PpsEvent, PPS_QUEUE_SIZE> ppsQueue;
+volatile uint32_t ppsSequence = 0;
+volatile uint32_t ppsIsrCycles = 0;    // 直近の割り込み処理時間 [cycles]
+volatile uint32_t ppsIsrMaxCycles = 0; // 最大の割り込み処理時間 [cycles]
 
+// フラッシュの書き込み中はcore0も止まり、PPS割り込みが遅れる
+// core1はエッジを処理した直後にだけ書き、core0は書き込みと重なったエッジをサーボに渡さない
+// (時刻はtime_us_64の下位32ビット)
+std::atomic<uint32_t> ppsHandledUs{0};      // core0が最後に処理したエッジ
+std::atomic<uint32_t> flashWriteStartUs{0};
+std::atomic<uint32_t> flashWriteEndUs{0};
+std::atomic<uint32_t> flashWrites{0};       // 始めた書き込みの数
+std::atomic<bool> flashWriting{false};
+unsigned long ppsFlashSkipped = 0;          // 書き込みと重なって捨てたエッジ
+
+// 割り込みではタイムスタンプと通し番号の記録だけを行う
 void trigerPps()
 {
-#if defined(DEBUG_CONSOLE_PPS)
-  Serial.println("PPS");
-  Serial.println(micros() - lastPps);
-#endif
-  lastPps = micros();
-  analogWrite(LED_ONBOARD_PIN, 255);
-  analogWrite(LED_PPS_PIN, 100);
-  delay(50);
+  uint64_t now = time_us_64();
+  uint32_t start = rp2040.getCycleCount();
+  PpsEvent event = {now, ++ppsSequence};
+  ppsQueue.push(event);
+  uint32_t cycles = rp2040.getCycleCount() - start;
+  ppsIsrCycles = cycles;
+  if (cycles > ppsIsrMaxCycles)
+  {
+    ppsIsrMaxCycles = cycles;
+  }
+}
+
+int64_t ppsLedOff(alarm_id_t id, void *user_data)
+{
   analogWrite(LED_ONBOARD_PIN, 0);
   analogWrite(LED_PPS_PIN, 0);
+  return 0;
+}
+
+// DS3231のレジスタを直接読み書きする (uRTCLibのrefresh()は全レジスタを読むため)
+bool readRtcRegister(uint8_t reg, uint8_t &value)
+{
+  URTCLIB_WIRE.beginTransmission(RTC_ADDRESS);
+  URTCLIB_WIRE.write(reg);
+  if (URTCLIB_WIRE.endTransmission() != 0 || URTCLIB_WIRE.requestFrom(RTC_ADDRESS, 1) != 1)
+  {
+    return false;
+  }
+  value = URTCLIB_WIRE.read();
+  return true;
+}
+
+bool writeRtcRegister(uint8_t reg, uint8_t value)
+{
+  URTCLIB_WIRE.beginTransmission(RTC_ADDRESS);
+  URTCLIB_WIRE.write(reg);
+  URTCLIB_WIRE.write(value);
+  return URTCLIB_WIRE.endTransmission() == 0;
+}
+
+// GNSSの時刻でRTCを設定する
+// 秒のレジスタを書くとDS3231の分周器がリセットされるので、PPSエッジの直後に書けば位相も揃う
+void setRtcAtEdge(uint64_t edgeUs)
+{
+  if (!rtcSetPending || !ppsClock.synchronized(edgeUs) ||
+      time_us_64() - edgeUs > RTC_SET_MAX_DELAY_US || display.flushing())
+  {
+    return;
+  }
+  NtpTimestamp edge = ppsClock.lastEdgeTime();
+  uint32_t unixSeconds = edge.seconds - NTP_UNIX_OFFSET + (edge.fraction >= 0x80000000UL ? 1 : 0);
+  int32_t days = unixSeconds / 86400;
+  uint32_t seconds = unixSeconds % 86400;
+  int32_t year;
+  uint32_t month, day;
+  civilFromDays(days, year, month, day);
+  // dayOfWeekは日曜が1 (1970-01-01は木曜)
+  rtc.set(seconds % 60, seconds / 60 % 60, seconds / 3600, (days + 4) % 7 + 1, day, month, year - 2000);
+
+  rtcSetPending = false;
+  rtcSetCount++;
+  rtcHoldover.restart();
+  rtcEdgeUs = 0;
+  Serial.print("RTC set: ");
+  Serial.println(unixSeconds);
+}
+
+// エッジの直前に届いたTIM-TPのqErrを補正量 [s] にする
+// TIM-TPは次のパルスについての報告なので、エッジより前の1秒以内に届いたものだけを使う
+unsigned long timePulseMatched = 0;
+unsigned long timePulseUnmatched = 0;
+double timePulseCorrection = 0.0;
+double matchTimePulse(uint64_t edgeUs)
+{
+  TimePulseReport report;
+  bool found = false;
+  while (gpsClient.peekTimePulse(report) && report.receivedMicros < edgeUs)
+  {
+    gpsClient.popTimePulse(report);
+    found = edgeUs - report.receivedMicros < 1000000ULL && report.qErrValid;
+  }
+  if (!found)
+  {
+    timePulseUnmatched++;
+    timePulseCorrection = 0.0;
+    return 0.0;
+  }
+  timePulseMatched++;
+  timePulseCorrection = report.qErr * 1e-12; // ps
+  return timePulseCorrection;
+}
+
+// core1: 直前のエッジを処理してからFLASH_WRITE_WINDOW_US以内なら書いてよい
+bool flashWriteReady()
+{
+  uint32_t sinceEdge = (uint32_t)time_us_64() - ppsHandledUs.load();
+  return sinceEdge < FLASH_WRITE_WINDOW_US || sinceEdge > FLASH_WRITE_NO_PPS_US;
+}
+
+void beginFlashWrite()
+{
+  flashWriteStartUs.store((uint32_t)time_us_64());
+  flashWrites++;
+  flashWriting.store(true);
+}
+
+void endFlashWrite()
+{
+  flashWriteEndUs.store((uint32_t)time_us_64());
+  flashWriting.store(false);
+}
+
+// core0: 書き込みの間か、終わった直後に割り込みが入ったエッジ
+bool overlapsFlashWrite(uint64_t edgeUs)
+{
+  uint32_t edge = (uint32_t)edgeUs;
+  if (flashWrites.load() == 0 || (int32_t)(edge - flashWriteStartUs.load()) < 0)
+  {
+    return false;
+  }
+  return flashWriting.load() || (int32_t)(edge - flashWriteEndUs.load()) <= FLASH_WRITE_GUARD_US;
+}
+
+// PPSイベントとNAV-PVTのUTC秒をクロックに渡す
+uint32_t handledPpsSequence = 0;
+uint32_t handledPvtVersion = 0;
+void updatePpsClock()
+{
+  PpsEvent event;
+  while (ppsQueue.pop(event))
+  {
+#if defined(DEBUG_CONSOLE_PPS)
+    Serial.print("PPS ");
+    Serial.print((unsigned long)event.localUs - lastPps);
+    Serial.print(" isr: ");
+    Serial.print(ppsIsrCycles);
+    Serial.print(" cycles (max ");
+    Serial.print(ppsIsrMaxCycles);
+    Serial.print(") queue depth: ");
+    Serial.print(ppsQueue.size() + 1);
+    Serial.print(" max: ");
+    Serial.println(ppsQueue.highWater());
+    if (handledPpsSequence != 0 && event.sequence != handledPpsSequence + 1)
+    {
+      Serial.print("PPS events lost: ");
+      Serial.println(event.sequence - handledPpsSequence - 1);
+    }
+#endif
+    handledPpsSequence = event.sequence;
+    if (lastPps != 0)
+    {
+      ppsInterval = (unsigned long)event.localUs - lastPps;
+    }
+    lastPps = (unsigned long)event.localUs;
+    double correction = matchTimePulse(event.localUs);
+    if (overlapsFlashWrite(event.localUs))
+    {
+      ppsFlashSkipped++;
+    }
+    else
+    {
+      ppsClock.onPps(event.localUs, correction);
+      setRtcAtEdge(event.localUs);
+    }
+    ppsHandledUs.store((uint32_t)time_us_64());
+
+    // LEDはタイマーで消灯する
+    analogWrite(LED_ONBOARD_PIN, 255);
+    analogWrite(LED_PPS_PIN, 100);
+    add_alarm_in_ms(PPS_LED_ON_MS, ppsLedOff, NULL, true);
+  }
+
+  if (gpsClient.getGpsSummaryVersion() != handledPvtVersion)
+  {
+    const GpsSummaryData &gpsSummaryData = gpsClient.getGpsSummaryData();
+    handledPvtVersion = gpsClient.getGpsSummaryVersion();
+    if (isnan(gnssTtff) && gpsSummaryData.fixType >= 3)
+    {
+      // time_us_64は起動時に0から始まる
+      gnssTtff = gpsSummaryData.receivedMicros * 1e-6;
+      Serial.print("TTFF: ");
+      Serial.print(gnssTtff, 1);
+      Serial.println(" s");
+    }
+    if (gpsSummaryData.timeValid && gpsSummaryData.dateValid && gpsSummaryData.fixType > 0)
+    {
+      uint32_t unixSeconds = toUnixTime(gpsSummaryData.year, gpsSummaryData.month, gpsSummaryData.day,
+                                        gpsSummaryData.hour, gpsSummaryData.min, gpsSummaryData.sec);
+      if (gpsSummaryData.msec >= 500)
+      {
+        unixSeconds++;
+      }
+      ppsClock.onUtcSecond(unixSeconds, gpsSummaryData.receivedMicros);
+    }
+
+#if defined(DEBUG_CONSOLE_PPS)
+    Serial.print("Clock state: ");
+    Serial.print(ppsClock.getState());
+    Serial.print(" offset: ");
+    Serial.print(ppsClock.getOffset() * 1e6, 3);
+    Serial.print(" us freq: ");
+    Serial.print(ppsClock.getFrequency() * 1e6, 3);
+    Serial.print(" ppm jitter: ");
+    Serial.print(ppsClock.getJitter() * 1e6, 3);
+    Serial.println(" us");
+#endif
+  }
 }
 
 void printEtherStatus()
 {
-  switch (Ethernet.maintain())
+  int status = Ethernet.maintain();
+  if (status != 0)
+  {
+    ethernetMaintainStatus = status;
+  }
+  switch (status)
   {
   case 1:
     // renewed fail
@@ -87,7 +415,27 @@ void printEtherStatus()
   }
 }
 
-void displayInfo(GpsSummaryData gpsSummaryData)
+// 転送はDMAで行い、完了はcheckDisplayFlush()で確認する
+// 前のフレームを転送中なら今回は送らず、変更は次の更新で送られる
+bool displayPending = false;
+void flushDisplay()
+{
+  if (display.displayAsync())
+  {
+    displayPending = true;
+  }
+}
+
+void checkDisplayFlush()
+{
+  if (displayPending && !display.flushing())
+  {
+    displayPending = false;
+    displayFlush.record(display.getLastFlushMicros());
+  }
+}
+
+void displayInfo(const GpsSummaryData &gpsSummaryData)
 {
   char dateTimechr[20];
   sprintf(dateTimechr, "%04d/%02d/%02d %02d:%02d:%02d",
@@ -110,9 +458,7 @@ void displayInfo(GpsSummaryData gpsSummaryData)
   display.println("Position:");
   display.setCursor(0, 30);
   display.println(poschr);
-  display.display(); // Show initial text
-
-  delay(1000);
+  flushDisplay(); // Show initial text
 }
 
 // QZSSのL1S信号を受信するよう設定する
@@ -142,8 +488,550 @@ bool enableQZSSL1S(void)
   return (myGNSS.sendCommand(&customCfg) == SFE_UBLOX_STATUS_DATA_SENT);
 }
 
+// フラッシュに保存する位置
+struct StoredPosition
+{
+  uint32_t magic;
+  SurveyPosition position;
+  uint32_t checksum;
+};
+
+uint32_t positionChecksum(const SurveyPosition &position)
+{
+  // FNV-1a
+  const uint8_t *p = (const uint8_t *)&position;
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < sizeof(position); i++)
+  {
+    hash = (hash ^ p[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+bool loadPosition(int address, uint32_t magic, SurveyPosition &position)
+{
+  StoredPosition stored;
+  EEPROM.get(address, stored);
+  if (stored.magic != magic || stored.checksum != positionChecksum(stored.position))
+  {
+    return false;
+  }
+  position = stored.position;
+  return true;
+}
+
+bool savePosition(int address, uint32_t magic, const SurveyPosition &position)
+{
+  StoredPosition stored;
+  memset(&stored, 0, sizeof(stored));
+  stored.magic = magic;
+  stored.position = position;
+  stored.checksum = positionChecksum(stored.position);
+  EEPROM.put(address, stored);
+  beginFlashWrite();
+  bool committed = EEPROM.commit();
+  endFlashWrite();
+  return committed;
+}
+
+// CFG-TMODE3でタイミングモードを設定する。positionがNULLなら通常の測位に戻す
+// SparkFunのsetStaticPosition()はfixedPosAccを設定しないので、自前でパケットを組み立てる
+bool setTimeMode(const SurveyPosition *position)
+{
+  uint8_t customPayload[40];
+  ubxPacket customCfg = {0, 0, 0, 0, 0, customPayload, 0, 0, SFE_UBLOX_PACKET_VALIDITY_NOT_DEFINED, SFE_UBLOX_PACKET_VALIDITY_NOT_DEFINED};
+  memset(customPayload, 0, sizeof(customPayload));
+
+  customCfg.cls = UBX_CLASS_CFG;
+  customCfg.id = UBX_CFG_TMODE3;
+  customCfg.len = sizeof(customPayload);
+  customCfg.startingSpot = 0;
+
+  if (position != NULL)
+  {
+    // 緯度経度は1e-7度と1e-9度、高さはcmと0.1mmに分ける
+    int64_t lat = llround(position->latitude * 1e9);
+    int64_t lon = llround(position->longitude * 1e9);
+    int64_t height = llround(position->height * 1e4);
+    int32_t values[3] = {(int32_t)(lat / 100), (int32_t)(lon / 100), (int32_t)(height / 100)};
+    int8_t hp[3] = {(int8_t)(lat % 100), (int8_t)(lon % 100), (int8_t)(height % 100)};
+    uint32_t accuracy = (uint32_t)(position->accuracy * 1e4); // [0.1mm]
+
+    customPayload[2] = 2;    // fixed mode
+    customPayload[3] = 0x01; // LLA
+    for (int i = 0; i < 3; i++)
+    {
+      memcpy(&customPayload[4 + i * 4], &values[i], 4);
+      customPayload[16 + i] = (uint8_t)hp[i];
+    }
+    memcpy(&customPayload[20], &accuracy, 4);
+  }
+
+  return (myGNSS.sendCommand(&customCfg) == SFE_UBLOX_STATUS_DATA_SENT);
+}
+
+// 平均が終わったら位置を保存し、受信機を固定位置のタイミングモードにする
+unsigned long lastSurveyAttempt = 0;
+void updateSurvey()
+{
+  if (gpsClient.getSurveyState() != SURVEY_IN_COMPLETE ||
+      (lastSurveyAttempt != 0 && millis() - lastSurveyAttempt < SURVEY_RETRY_MS))
+  {
+    return;
+  }
+  // 位置の保存はPPSエッジの直後まで待つ
+  if (lastSurveyAttempt == 0 && !flashWriteReady())
+  {
+    return;
+  }
+  SurveyPosition position = gpsClient.getSurveyPosition();
+  if (lastSurveyAttempt == 0 && !savePosition(EEPROM_SURVEY_ADDRESS, EEPROM_SURVEY_MAGIC, position))
+  {
+    Serial.println("Survey position not saved");
+  }
+  lastSurveyAttempt = millis();
+  if (!setTimeMode(&position))
+  {
+    Serial.println("CFG-TMODE3 rejected");
+    return;
+  }
+  gpsClient.fixSurvey(position);
+  Serial.print("Survey complete: ");
+  Serial.print(position.accuracy, 3);
+  Serial.print(" m, ");
+  Serial.print(position.samples);
+  Serial.println(" samples");
+}
+
+// 保存した位置があればすぐにタイミングモードで起動し、なければsurvey-inから始める
+void setupSurvey()
+{
+  SurveyPosition position;
+  if (loadPosition(EEPROM_SURVEY_ADDRESS, EEPROM_SURVEY_MAGIC, position) && setTimeMode(&position))
+  {
+    gpsClient.fixSurvey(position);
+    Serial.println("Time mode: stored position");
+    return;
+  }
+  // 受信機のBBRに前回の固定位置が残っていると平均できないので解除しておく
+  setTimeMode(NULL);
+}
+
+#if defined(GNSS_ASSIST_DBD)
+// 受信機の航法データベース (エフェメリス・アルマナック等のMGA-DBDの列) をファイルに保存する
+uint8_t dbdBuffer[GNSS_ASSIST_DBD_SIZE];
+size_t dbdPending = 0; // 読み出してまだ書いていない長さ
+unsigned long lastDbdSave = 0;
+
+bool loadNavigationDatabase()
+{
+  File file = LittleFS.open(GNSS_ASSIST_DBD_FILE, "r");
+  if (!file)
+  {
+    return false;
+  }
+  size_t length = file.read(dbdBuffer, sizeof(dbdBuffer));
+  file.close();
+  return length > 0 && myGNSS.pushAssistNowData(dbdBuffer, length) == length;
+}
+
+// 受信機から読み出しておき、ファイルにはPPSエッジの直後に書く
+void updateNavigationDatabase()
+{
+  if (dbdPending > 0)
+  {
+    if (!flashWriteReady())
+    {
+      return;
+    }
+    beginFlashWrite();
+    File file = LittleFS.open(GNSS_ASSIST_DBD_FILE, "w");
+    if (file)
+    {
+      file.write(dbdBuffer, dbdPending);
+      file.close();
+    }
+    endFlashWrite();
+    dbdPending = 0;
+    return;
+  }
+  GpsFix fix;
+  if (!gpsClient.getLastFix(fix) || (lastDbdSave != 0 && millis() - lastDbdSave < GNSS_ASSIST_DBD_INTERVAL_MS))
+  {
+    return;
+  }
+  lastDbdSave = millis();
+  dbdPending = myGNSS.readNavigationDatabase(dbdBuffer, sizeof(dbdBuffer));
+}
+#endif
+
+// 保存した位置と起動時のRTCの時刻を受信機に送り、初回の測位を早める (起動後1回だけ)
+// 時刻を先に送る。RTCが読めないまま時間が過ぎたら位置だけを送る
+bool gnssAssistDone = false;
+void updateAssist()
+{
+  if (gnssAssistDone)
+  {
+    return;
+  }
+  bool rtcReady = rtcBootReady.load(std::memory_order_acquire);
+  if (!rtcReady && millis() < GNSS_ASSIST_RTC_WAIT_MS)
+  {
+    return;
+  }
+  gnssAssistDone = true;
+
+  uint8_t assisted = 0;
+  if (rtcReady && rtcBootSeconds != 0)
+  {
+    // 読んでからの経過時間を足す
+    uint64_t elapsed = time_us_64() - rtcBootMicros;
+    uint32_t unixSeconds = rtcBootSeconds + (uint32_t)(elapsed / 1000000);
+    int32_t year;
+    uint32_t month, day;
+    civilFromDays(unixSeconds / 86400, year, month, day);
+    uint32_t seconds = unixSeconds % 86400;
+    if (myGNSS.setUTCTimeAssistance(year, month, day, seconds / 3600, seconds / 60 % 60, seconds % 60,
+                                    (uint32_t)(elapsed % 1000000) * 1000, GNSS_ASSIST_TIME_ACC_SEC, 0))
+    {
+      assisted |= GNSS_ASSISTED_TIME;
+    }
+  }
+
+  SurveyPosition position;
+  if (loadPosition(EEPROM_SURVEY_ADDRESS, EEPROM_SURVEY_MAGIC, position) ||
+      loadPosition(EEPROM_POSITION_ADDRESS, EEPROM_POSITION_MAGIC, position))
+  {
+    double accuracy = max((double)position.accuracy, GNSS_ASSIST_MIN_POS_ACC);
+    if (myGNSS.setPositionAssistanceLLH(llround(position.latitude * 1e7), llround(position.longitude * 1e7),
+                                        llround(position.height * 100), (uint32_t)(accuracy * 100)))
+    {
+      assisted |= GNSS_ASSISTED_POSITION;
+    }
+  }
+
+#if defined(GNSS_ASSIST_DBD)
+  if (loadNavigationDatabase())
+  {
+    assisted |= GNSS_ASSISTED_DATABASE;
+  }
+#endif
+  gnssAssisted = assisted;
+  Serial.print("GNSS assist: ");
+  Serial.println(assisted);
+}
+
+// 3D測位の位置を定期的に確認し、保存した位置から離れていたら保存し直す
+// (フラッシュの書き換えを減らすため、同じ場所にある間は書かない)
+unsigned long lastPositionCheck = 0;
+void updateSavedPosition()
+{
+  // 保存するかもしれないので、PPSエッジの直後まで待つ
+  if (millis() - lastPositionCheck < GNSS_ASSIST_SAVE_INTERVAL_MS || !flashWriteReady())
+  {
+    return;
+  }
+  lastPositionCheck = millis();
+  GpsFix fix;
+  if (!gpsClient.getLastFix(fix) || fix.fixType != 3 || time_us_64() - fix.receivedMicros > 10000000ULL)
+  {
+    return;
+  }
+
+  SurveyPosition position;
+  position.latitude = fix.latitude * 1e-7;
+  position.longitude = fix.longitude * 1e-7;
+  position.height = fix.height * 1e-3;
+  position.accuracy = fix.hAcc * 1e-3f;
+  position.samples = 1;
+
+  SurveyPosition saved;
+  if (loadPosition(EEPROM_POSITION_ADDRESS, EEPROM_POSITION_MAGIC, saved))
+  {
+    double north = (position.latitude - saved.latitude) * 111319.49;
+    double east = (position.longitude - saved.longitude) * 111319.49 * cos(saved.latitude * DEG_TO_RAD);
+    if (sqrt(north * north + east * east) < GNSS_ASSIST_SAVE_DISTANCE)
+    {
+      return;
+    }
+  }
+  savePosition(EEPROM_POSITION_ADDRESS, EEPROM_POSITION_MAGIC, position);
+}
+
+// 受信機の設定。受信機とつなぐポートにはGpsClientが使うUBXメッセージだけを出力する
+// 使わないUBXメッセージも、以前の設定がBBRに残っていることがあるので明示的に止める
+struct GpsConfigItem
+{
+  uint32_t key;
+  uint8_t value;
+};
+
+const GpsConfigItem gpsProfile[] = {
+    {GNSS_CFG_OUTPROT_UBX, 1},
+    {GNSS_CFG_OUTPROT_NMEA, 0},
+    {GNSS_CFG_MSGOUT(NAV_PVT), 1},
+    {GNSS_CFG_MSGOUT(NAV_SAT), 1},
+    {GNSS_CFG_MSGOUT(RXM_SFRBX), 1},
+    {GNSS_CFG_MSGOUT(TIM_TP), 1},
+    {GNSS_CFG_MSGOUT(NAV_CLOCK), 0},
+    {GNSS_CFG_MSGOUT(NAV_DOP), 0},
+    {GNSS_CFG_MSGOUT(NAV_HPPOSLLH), 0},
+    {GNSS_CFG_MSGOUT(NAV_POSLLH), 0},
+    {GNSS_CFG_MSGOUT(NAV_SIG), 0},
+    {GNSS_CFG_MSGOUT(NAV_STATUS), 0},
+    {GNSS_CFG_MSGOUT(NAV_TIMEGPS), 0},
+    {GNSS_CFG_MSGOUT(NAV_TIMEUTC), 0},
+    {GNSS_CFG_MSGOUT(NAV_VELNED), 0},
+    {GNSS_CFG_MSGOUT(RXM_RAWX), 0},
+    {GNSS_CFG_MSGOUT(MON_COMMS), 0},
+    {GNSS_CFG_MSGOUT(MON_RF), 0},
+    {UBLOX_CFG_SIGNAL_QZSS_ENA, 1},
+    {UBLOX_CFG_SIGNAL_QZSS_L1CA_ENA, 1},
+    {UBLOX_CFG_SIGNAL_QZSS_L1S_ENA, 1},
+};
+
+#define GPS_PROFILE_SIZE (sizeof(gpsProfile) / sizeof(gpsProfile[0]))
+
+// CFG-VALGETの値の大きさ。キーのビット28-30で決まる
+static uint8_t cfgValueSize(uint32_t key)
+{
+  switch ((key >> 28) & 0x7)
+  {
+  case 1: // 1ビット
+  case 2:
+    return 1;
+  case 3:
+    return 2;
+  case 4:
+    return 4;
+  case 5:
+    return 8;
+  }
+  return 0;
+}
+
+// プロファイルの全項目を1回のCFG-VALGETで読む。応答になかった項目 (未対応) はfoundがfalse
+// busBytesにはこのやりとりでバスに流れたUBXのバイト数を足す
+// 受信機がまとめた要求を拒否したら、1項目ずつのCFG-VALGETで読み直す
+bool readGpsProfile(uint8_t *values, bool *found, uint32_t &busBytes)
+{
+  uint8_t customPayload[MAX_PAYLOAD_SIZE];
+  ubxPacket customCfg = {0, 0, 0, 0, 0, customPayload, 0, 0, SFE_UBLOX_PACKET_VALIDITY_NOT_DEFINED, SFE_UBLOX_PACKET_VALIDITY_NOT_DEFINED};
+
+  customCfg.cls = UBX_CLASS_CFG;
+  customCfg.id = UBX_CFG_VALGET;
+  customCfg.len = 4 + 4 * GPS_PROFILE_SIZE;
+  customCfg.startingSpot = 0;
+
+  memset(customPayload, 0, customCfg.len); // version 0, layer 0 (RAM), position 0
+  for (size_t i = 0; i < GPS_PROFILE_SIZE; i++)
+  {
+    memcpy(&customPayload[4 + 4 * i], &gpsProfile[i].key, 4);
+    found[i] = false;
+  }
+  busBytes += customCfg.len + 8;
+
+  if (myGNSS.sendCommand(&customCfg) != SFE_UBLOX_STATUS_DATA_RECEIVED)
+  {
+    busBytes += GNSS_UBX_ACK_SIZE;
+    bool any = false;
+    for (size_t i = 0; i < GPS_PROFILE_SIZE; i++)
+    {
+      found[i] = myGNSS.getVal8(gpsProfile[i].key, &values[i], VAL_LAYER_RAM);
+      busBytes += 16 + (found[i] ? 16 + cfgValueSize(gpsProfile[i].key) : 0) + GNSS_UBX_ACK_SIZE;
+      any |= found[i];
+    }
+    return any;
+  }
+  busBytes += customCfg.len + 8 + GNSS_UBX_ACK_SIZE;
+
+  // 応答はキーと値の組の並び
+  uint16_t pos = 4;
+  while (pos + 4 <= customCfg.len)
+  {
+    uint32_t key;
+    memcpy(&key, &customPayload[pos], 4);
+    uint8_t size = cfgValueSize(key);
+    if (size == 0 || pos + 4 + size > customCfg.len)
+    {
+      break;
+    }
+    for (size_t i = 0; i < GPS_PROFILE_SIZE; i++)
+    {
+      if (gpsProfile[i].key == key)
+      {
+        values[i] = customPayload[pos + 4];
+        found[i] = true;
+      }
+    }
+    pos += 4 + size;
+  }
+  return true;
+}
+
+// 現在値と違う項目だけを1回のCFG-VALSETで書き込み、読み戻して確かめる
+// (信号の設定を書くとGNSSが再起動するので、同じ値は書かない)
+// CFG-VALGETに対応しない受信機ならfalseを返す
+bool applyGpsProfile()
+{
+  uint8_t values[GPS_PROFILE_SIZE];
+  bool supported[GPS_PROFILE_SIZE];
+  bool found[GPS_PROFILE_SIZE];
+  uint8_t supportedCount = 0;
+  uint8_t changed = 0;
+  uint32_t busBytes = 0;
+  unsigned long start = millis();
+
+  if (!readGpsProfile(values, supported, busBytes))
+  {
+    return false;
+  }
+  myGNSS.newCfgValset(VAL_LAYER_RAM_BBR);
+  for (size_t i = 0; i < GPS_PROFILE_SIZE; i++)
+  {
+    if (!supported[i])
+    {
+      Serial.print("GNSS config key not supported: 0x");
+      Serial.println(gpsProfile[i].key, HEX);
+      continue;
+    }
+    supportedCount++;
+    if (values[i] != gpsProfile[i].value)
+    {
+      myGNSS.addCfgValset8(gpsProfile[i].key, gpsProfile[i].value);
+      changed++;
+    }
+  }
+  if (changed > 0 && !myGNSS.sendCfgValset())
+  {
+    Serial.println("CFG-VALSET failed");
+    return false;
+  }
+
+  uint8_t mismatch = 0;
+  bool readBack = readGpsProfile(values, found, busBytes);
+  for (size_t i = 0; i < GPS_PROFILE_SIZE; i++)
+  {
+    if (supported[i] && (!readBack || !found[i] || values[i] != gpsProfile[i].value))
+    {
+      Serial.print("GNSS config mismatch: 0x");
+      Serial.println(gpsProfile[i].key, HEX);
+      mismatch++;
+    }
+  }
+  Serial.print("GNSS profile: ");
+  Serial.print(changed);
+  Serial.print(" of ");
+  Serial.print(supportedCount);
+  Serial.print(" keys changed, CFG-VALGET ");
+  Serial.print(busBytes);
+  Serial.print(" bytes, ");
+  Serial.print(millis() - start);
+  Serial.println(" ms");
+  return mismatch == 0;
+}
+
+// UBX-MON-COMMSで受信機とつないだポートの送信バイト数を読む
+// replyBytesにはこのポーリングの応答の大きさを返す (転送量から除くため)
+bool readGpsBusBytes(uint32_t &txBytes, uint32_t &replyBytes)
+{
+  uint8_t customPayload[MAX_PAYLOAD_SIZE];
+  ubxPacket customCfg = {0, 0, 0, 0, 0, customPayload, 0, 0, SFE_UBLOX_PACKET_VALIDITY_NOT_DEFINED, SFE_UBLOX_PACKET_VALIDITY_NOT_DEFINED};
+
+  customCfg.cls = UBX_CLASS_MON;
+  customCfg.id = GNSS_UBX_MON_COMMS;
+  customCfg.len = 0;
+  customCfg.startingSpot = 0;
+
+  if (myGNSS.sendCommand(&customCfg) != SFE_UBLOX_STATUS_DATA_RECEIVED)
+    return (false);
+
+  replyBytes = customCfg.len + 8;
+  uint8_t nPorts = customPayload[1];
+  for (int port = 0; port < nPorts && 8 + (port + 1) * 40 <= customCfg.len; port++)
+  {
+    const uint8_t *block = &customPayload[8 + port * 40];
+    if ((block[0] | block[1] << 8) == GNSS_MON_COMMS_PORT)
+    {
+      memcpy(&txBytes, &block[4], 4);
+      return (true);
+    }
+  }
+  return (false);
+}
+
+// 前回からのバスの転送量 [B/s]。測れなければNAN
+uint32_t gnssBusBytes = 0;
+uint64_t gnssBusMicros = 0;
+float measureGpsBus()
+{
+  uint32_t txBytes, replyBytes;
+  uint64_t now = time_us_64();
+  if (!readGpsBusBytes(txBytes, replyBytes))
+  {
+    gnssBusMicros = 0;
+    return NAN;
+  }
+  float rate = NAN;
+  if (gnssBusMicros != 0)
+  {
+    rate = (float)(txBytes - gnssBusBytes - replyBytes) * 1e6f / (float)(now - gnssBusMicros);
+  }
+  gnssBusBytes = txBytes;
+  gnssBusMicros = now;
+  return rate;
+}
+
+unsigned long lastGpsBusMeasure = 0;
+void updateGpsBus()
+{
+  if (millis() - lastGpsBusMeasure < GNSS_BUS_INTERVAL_MS)
+  {
+    return;
+  }
+  lastGpsBusMeasure = millis();
+  gnssBusRate = measureGpsBus();
+#if defined(DEBUG_CONSOLE_GPS)
+  Serial.print("GNSS bus: ");
+  Serial.print(gnssBusRate, 1);
+  Serial.println(" B/s");
+#endif
+}
+
+// 受信したUBXメッセージをGpsClientに渡す
+void onNavPvt(UBX_NAV_PVT_data_t *data) { gpsClient.getPVTdata(data); }
+void onRxmSfrbx(UBX_RXM_SFRBX_data_t *data) { gpsClient.newSFRBX(data); }
+void onNavSat(UBX_NAV_SAT_data_t *data) { gpsClient.newNAVSAT(data); }
+void onTimTp(UBX_TIM_TP_data_t *data) { gpsClient.newTIMTP(data); } // PPSの量子化誤差
+
+// コールバックだけを登録する (setAuto*callbackPtr()と同じ処理から、出力を設定するCFG-MSGの送信を除いたもの)
+// 出力はプロファイルのCFG-VALSETで設定済みなので、assumeAuto*()で自動送信として扱わせてから使う
+template <typename Packet, typename Data>
+void registerCallback(Packet *packet, void (*callback)(Data *))
+{
+  if (packet == NULL)
+  {
+    return;
+  }
+  if (packet->callbackData == NULL)
+  {
+    packet->callbackData = new Data;
+  }
+  packet->callbackPointerPtr = callback;
+}
+
 void setupGps()
 {
+#if defined(GNSS_TRANSPORT_UART)
+  // 受信はDMAでリングバッファに溜め、checkUblox()は完成したUBXフレームだけを読む
+  if (!gnssUart.begin(GNSS_UART_BAUD) || myGNSS.begin(gnssUart) == false)
+  {
+    Serial.println(F("u-blox GNSS not detected on UART. Please check wiring. Freezing."));
+    analogWrite(LED_ERROR_PIN, 255);
+    while (1)
+      ;
+  }
+#else
   Wire1.setSDA(GPS_SDA_PIN);
   Wire1.setSCL(GPS_SCL_PIN);
   Wire1.begin();
@@ -159,18 +1047,56 @@ void setupGps()
     while (1)
       ;
   }
+#endif
 
-  myGNSS.setI2COutput(COM_TYPE_UBX);                 // Set the I2C port to output both NMEA and UBX messages
-  myGNSS.saveConfigSelective(VAL_CFG_SUBSEC_IOPORT); // Save (only) the communications port settings to flash and BBR
-  enableQZSSL1S();                                   // QZSS L1S信号の受信を有効にする
+  // 設定前の転送量を測る
+  measureGpsBus();
+  unsigned long start = millis();
+  while (millis() - start < GNSS_BUS_MEASURE_MS)
+  {
+    myGNSS.checkUblox();
+  }
+  // BBRに設定が残っていれば2回目以降の起動では設定後の値になる
+  gnssBusBootRate = measureGpsBus();
+  Serial.print("GNSS bus before profile: ");
+  Serial.print(gnssBusBootRate, 1);
+  Serial.println(" B/s");
 
-  myGNSS.setAutoPVTcallbackPtr([](UBX_NAV_PVT_data_t *data)
-                               { gpsClient.getPVTdata(data); });
+  gnssProfileApplied = applyGpsProfile();
+  if (!gnssProfileApplied)
+  {
+    // CFG-VALSETに対応しない受信機は従来の方法で設定する
+#if defined(GNSS_TRANSPORT_UART)
+    myGNSS.setUART1Output(COM_TYPE_UBX);
+#else
+    myGNSS.setI2COutput(COM_TYPE_UBX);                 // Set the I2C port to output both NMEA and UBX messages
+#endif
+    myGNSS.saveConfigSelective(VAL_CFG_SUBSEC_IOPORT); // Save (only) the communications port settings to flash and BBR
+    enableQZSSL1S();                                   // QZSS L1S信号の受信を有効にする
 
-  myGNSS.setAutoRXMSFRBXcallbackPtr([](UBX_RXM_SFRBX_data_t *data)
-                                    { gpsClient.newSFRBX(data); }); // UBX-RXM-SFRBXメッセージ受信コールバック関数を登録
-  myGNSS.setAutoNAVSATcallbackPtr([](UBX_NAV_SAT_data_t *data)
-                                  { gpsClient.newNAVSAT(data); }); // UBX-NAV-SATメッセージ受信コールバック関数を登録
+    // 出力の設定 (CFG-MSG) も兼ねてコールバックを登録する
+    myGNSS.setAutoPVTcallbackPtr(onNavPvt);
+    myGNSS.setAutoRXMSFRBXcallbackPtr(onRxmSfrbx);
+    myGNSS.setAutoNAVSATcallbackPtr(onNavSat);
+    myGNSS.setAutoTIMTPcallbackPtr(onTimTp);
+  }
+  else
+  {
+    // 受信機には何も送らない
+    myGNSS.assumeAutoPVT(true, false);
+    myGNSS.assumeAutoRXMSFRBX(true, false);
+    myGNSS.assumeAutoNAVSAT(true, false);
+    myGNSS.assumeAutoTIMTP(true, false);
+    registerCallback(myGNSS.packetUBXNAVPVT, onNavPvt);
+    registerCallback(myGNSS.packetUBXRXMSFRBX, onRxmSfrbx);
+    registerCallback(myGNSS.packetUBXNAVSAT, onNavSat);
+    registerCallback(myGNSS.packetUBXTIMTP, onTimTp);
+  }
+  EEPROM.begin(EEPROM_SIZE);
+#if defined(GNSS_ASSIST_DBD)
+  LittleFS.begin();
+#endif
+  setupSurvey();
 }
 
 void setupRtc()
@@ -179,7 +1105,8 @@ void setupRtc()
   rtc.set_rtc_address(0x68);
   rtc.set_model(rtcModel);
   // refresh data from RTC HW in RTC class object so flags like rtc.lostPower(), rtc.getEOSCFlag(), etc, can get populated
-  rtc.refresh();
+  bool rtcRead = rtc.refresh();
+  uint64_t rtcReadMicros = time_us_64();
   // Only use once, then disable
   // rtc.set(0, 45, 10, 1, 29, 12, 24);
   //  RTCLib::set(byte second, byte minute, byte hour (0-23:24-hr mode only), byte dayOfWeek (Sun = 1, Sat = 7), byte dayOfMonth (1-12), byte month, byte year)
@@ -201,6 +1128,14 @@ void setupRtc()
   else
     Serial.println(F("Oscillator will use VBAT when VCC cuts off."));
 
+  // 電源を失っていなければ、RTCの時刻をGNSSのホットスタートに使う
+  if (rtcRead && !rtc.lostPower() && rtc.year() >= 24)
+  {
+    rtcBootSeconds = toUnixTime(2000 + rtc.year(), rtc.month(), rtc.day(), rtc.hour(), rtc.minute(), rtc.second());
+    rtcBootMicros = rtcReadMicros;
+  }
+  rtcBootReady.store(true, std::memory_order_release);
+
   Serial.print("Lost power status: ");
   if (rtc.lostPower())
   {
@@ -212,8 +1147,270 @@ void setupRtc()
   {
     Serial.println("POWER OK");
   }
+
+  uint8_t aging;
+  if (readRtcRegister(RTC_REG_AGING, aging))
+  {
+    rtcAging = (int8_t)aging;
+    Serial.print("RTC aging offset: ");
+    Serial.println(rtcAging);
+  }
 }
 
+// /metricsで公開するメトリクス
+// collectはスクレイプのたびにcore0で呼ばれ、レスポンスへ直接書き込む
+const MetricFamily metrics[] = {
+    {"gnss_fix_type", METRIC_GAUGE, "GNSS fix type (0=no fix, 3=3D, 5=time only)",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)gpsClient.getGpsSummaryData().fixType); }},
+    {"gnss_satellites_used", METRIC_GAUGE, "Satellites used in the navigation solution",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)gpsClient.getGpsSummaryData().SIV); }},
+#if defined(GNSS_TRANSPORT_UART)
+    {"gnss_uart_frames", METRIC_COUNTER, "UBX frames received over the GNSS UART",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, gnssUart.getParser().getFrames()); }},
+    {"gnss_uart_checksum_errors", METRIC_COUNTER, "UBX frames dropped because of a bad checksum",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, gnssUart.getParser().getChecksumErrors()); }},
+    {"gnss_uart_discarded_bytes", METRIC_COUNTER, "Bytes outside valid UBX frames (NMEA, noise)",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, gnssUart.getParser().getDiscarded()); }},
+    {"gnss_uart_ring_high_water_bytes", METRIC_GAUGE, "Most bytes waiting in the UART DMA ring buffer",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)gnssUart.getRingHighWater()); }},
+    {"gnss_uart_overruns", METRIC_COUNTER, "Times the UART DMA wrapped past unread bytes in the ring buffer",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, gnssUart.getOverruns()); }},
+    {"gnss_uart_overrun_bytes", METRIC_COUNTER, "Bytes dropped from the ring buffer after an overrun",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, gnssUart.getOverrunBytes()); }},
+#endif
+    {"gnss_bus_bytes_per_second", METRIC_GAUGE, "Bytes sent by the receiver on the GNSS bus (UBX-MON-COMMS)",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (double)gnssBusRate, 1); }},
+    {"gnss_bus_boot_bytes_per_second", METRIC_GAUGE, "GNSS bus bytes per second at boot before the receiver profile was applied",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (double)gnssBusBootRate, 1); }},
+    {"gnss_profile_applied", METRIC_GAUGE, "Receiver configured with CFG-VALSET (0=legacy configuration)",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)gnssProfileApplied); }},
+    {"gnss_ttff_seconds", METRIC_GAUGE, "Time from boot to the first GNSS fix",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, gnssTtff, 1); }},
+    {"gnss_assist_flags", METRIC_GAUGE, "Assistance sent to the receiver at boot (1=time, 2=position, 4=navigation database)",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)gnssAssisted); }},
+    {"gnss_survey_state", METRIC_GAUGE, "Survey-in state (0=averaging, 1=complete, 2=fixed position timing mode)",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)gpsClient.getGpsSummaryData().surveyState); }},
+    {"gnss_survey_samples", METRIC_GAUGE, "Positions averaged by the survey-in",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)gpsClient.getGpsSummaryData().surveySamples); }},
+    {"gnss_survey_accuracy_meters", METRIC_GAUGE, "Estimated 3D accuracy of the surveyed position",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (double)gpsClient.getGpsSummaryData().surveyAccuracy, 3); }},
+    {"gnss_satellites_tracked", METRIC_GAUGE, "Satellites reported by NAV-SAT per constellation",
+     [](MetricsWriter &w, const char *name)
+     {
+       const UBX_NAV_SAT_data_t &navSat = gpsClient.getNavSatData();
+       uint8_t counts[GNSS_ID_COUNT] = {};
+       for (uint16_t i = 0; i < navSat.header.numSvs; i++)
+       {
+         if (navSat.blocks[i].gnssId < GNSS_ID_COUNT)
+         {
+           counts[navSat.blocks[i].gnssId]++;
+         }
+       }
+       for (uint8_t id = 0; id < GNSS_ID_COUNT; id++)
+       {
+         w.sample(name).label("constellation", gnssIdToName(id)).value((long)counts[id]);
+       }
+     }},
+    {"gnss_sv_cno_dbhz", METRIC_GAUGE, "Carrier to noise ratio per satellite",
+     [](MetricsWriter &w, const char *name)
+     {
+       const UBX_NAV_SAT_data_t &navSat = gpsClient.getNavSatData();
+       for (uint16_t i = 0; i < navSat.header.numSvs; i++)
+       {
+         w.sample(name)
+             .label("constellation", gnssIdToName(navSat.blocks[i].gnssId))
+             .label("sv", (long)navSat.blocks[i].svId)
+             .value((long)navSat.blocks[i].cno);
+       }
+     }},
+    {"gnss_snapshot_latency_seconds", METRIC_HISTOGRAM, "Time from NAV-PVT reception to core0 snapshot",
+     [](MetricsWriter &w, const char *name)
+     { w.histogram(name, gpsSnapshotLatency); }},
+    {"pps_interval_seconds", METRIC_GAUGE, "Interval between the last two PPS edges",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, ppsInterval / 1000000.0, 6); }},
+    {"pps_jitter_seconds", METRIC_GAUGE, "RMS of PPS offset differences",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, ppsClock.getJitter()); }},
+    {"pps_offset_seconds", METRIC_GAUGE, "Clock offset at the last PPS edge",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, ppsClock.getOffset()); }},
+    {"pps_frequency_ratio", METRIC_GAUGE, "Frequency correction of the local clock",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, ppsClock.getFrequency(), 12); }},
+    {"pps_clock_state", METRIC_GAUGE, "PPS clock state (0=unsync, 1=FLL, 2=PLL)",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)ppsClock.getState()); }},
+    {"pps_edges", METRIC_COUNTER, "PPS edges processed",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, ppsClock.getEdgeCount()); }},
+    {"pps_missed", METRIC_COUNTER, "PPS edges missed",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, ppsClock.getMissedCount()); }},
+    {"pps_outliers", METRIC_COUNTER, "PPS edges discarded as outliers before a step",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, ppsClock.getOutlierCount()); }},
+    {"pps_flash_skipped", METRIC_COUNTER, "PPS edges not used because they overlapped a flash write",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, ppsFlashSkipped); }},
+    {"pps_queue_overflows", METRIC_COUNTER, "PPS events dropped because the queue was full",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, ppsQueue.overflowCount()); }},
+    {"pps_queue_depth", METRIC_GAUGE, "PPS events waiting in the queue",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)ppsQueue.size()); }},
+    {"pps_queue_high_water", METRIC_GAUGE, "Most PPS events ever waiting in the queue",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)ppsQueue.highWater()); }},
+    {"pps_qerr_seconds", METRIC_GAUGE, "Quantization error of the last PPS edge from UBX-TIM-TP",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, timePulseCorrection, 12); }},
+    {"pps_qerr_matched", METRIC_COUNTER, "PPS edges corrected with a UBX-TIM-TP quantization error",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, timePulseMatched); }},
+    {"pps_qerr_unmatched", METRIC_COUNTER, "PPS edges without a matching UBX-TIM-TP report",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, timePulseUnmatched); }},
+    {"pps_isr_max_cycles", METRIC_GAUGE, "Longest PPS interrupt handler",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)ppsIsrMaxCycles); }},
+    {"pps_isr_last_cycles", METRIC_GAUGE, "Last PPS interrupt handler",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)ppsIsrCycles); }},
+    {"rtc_temperature_celsius", METRIC_GAUGE, "DS3231 temperature",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (double)rtcTemperature, 2); }},
+    {"rtc_holdover_state", METRIC_GAUGE, "RTC holdover state (0=idle, 1=tracking, 2=holdover)",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)rtcHoldover.getState()); }},
+    {"rtc_phase_seconds", METRIC_GAUGE, "RTC second boundary minus GNSS time (predicted during holdover)",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, rtcHoldover.getPhase()); }},
+    {"rtc_frequency_ratio", METRIC_GAUGE, "Learned RTC frequency error at the current temperature",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, rtcHoldover.getFrequency(rtcTemperature), 12); }},
+    {"rtc_model_residual_ratio", METRIC_GAUGE, "RMS residual of the RTC temperature model",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, rtcHoldover.getResidual(), 12); }},
+    {"rtc_model_points", METRIC_GAUGE, "Frequency measurements in the RTC temperature model",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (unsigned long)rtcHoldover.getPoints()); }},
+    {"rtc_holdover_error_seconds", METRIC_GAUGE, "Estimated time error while serving from the RTC",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, rtcHoldover.error(time_us_64())); }},
+    {"rtc_aging_offset", METRIC_GAUGE, "DS3231 aging offset register",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)rtcAging); }},
+    {"rtc_sets", METRIC_COUNTER, "RTC time set from GNSS",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, rtcSetCount); }},
+    {"ethernet_link_up", METRIC_GAUGE, "Ethernet link status",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)(Ethernet.linkStatus() == LinkON)); }},
+    {"ethernet_dhcp_status", METRIC_GAUGE, "Last non-zero Ethernet.maintain() result (1=renew fail, 2=renewed, 3=rebind fail, 4=rebound)",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)ethernetMaintainStatus); }},
+    {"ntp_requests", METRIC_COUNTER, "NTP requests answered",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, ntpServer.getRequestCount()); }},
+    {"ntp_dropped", METRIC_COUNTER, "NTP packets dropped",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, ntpServer.getDroppedCount()); }},
+    {"ntp_holdover_replies", METRIC_COUNTER, "NTP replies served from the RTC holdover",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, ntpServer.getHoldoverCount()); }},
+    {"http_last_response_bytes", METRIC_GAUGE, "Size of the previous HTTP response",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, (long)webServer.getLastResponseBytes()); }},
+    {"http_last_response_seconds", METRIC_GAUGE, "Time spent rendering the previous HTTP response",
+     [](MetricsWriter &w, const char *name)
+     { w.gauge(name, webServer.getLastResponseMicros() / 1000000.0, 6); }},
+    {"http_response_overflows", METRIC_COUNTER, "HTTP responses larger than the render buffer, partly sent while rendering",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, (unsigned long)webServer.getResponseOverflows()); }},
+    {"http_response_segments", METRIC_COUNTER, "Socket writes used to send HTTP responses",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, (unsigned long)webServer.getResponseSegments()); }},
+    {"http_send_timeouts", METRIC_COUNTER, "HTTP connections closed because the socket send buffer did not drain",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, (unsigned long)webServer.getSendTimeouts()); }},
+    {"http_metrics_render_seconds", METRIC_HISTOGRAM, "Time to render the /metrics body (goal: under 1 ms)",
+     [](MetricsWriter &w, const char *name)
+     { w.histogram(name, webServer.getMetricsRender()); }},
+    {"qzss_frames", METRIC_COUNTER, "QZSS L1S DC Report (MT43) and DCX (MT44) frames received, including repeats",
+     [](MetricsWriter &w, const char *name)
+     {
+       const QzssDecoder &qzss = gpsClient.getQzss();
+       w.sample(name, "_total").label("mt", (long)QZSS_MT_DC_REPORT).value((unsigned long)qzss.getFrameCount(QZSS_MT_DC_REPORT));
+       w.sample(name, "_total").label("mt", (long)QZSS_MT_DCX).value((unsigned long)qzss.getFrameCount(QZSS_MT_DCX));
+     }},
+    {"qzss_messages", METRIC_COUNTER, "New QZSS messages decoded into the history",
+     [](MetricsWriter &w, const char *name)
+     {
+       const QzssDecoder &qzss = gpsClient.getQzss();
+       w.sample(name, "_total").label("mt", (long)QZSS_MT_DC_REPORT).value((unsigned long)qzss.getMessageCount(QZSS_MT_DC_REPORT));
+       w.sample(name, "_total").label("mt", (long)QZSS_MT_DCX).value((unsigned long)qzss.getMessageCount(QZSS_MT_DCX));
+     }},
+    {"qzss_duplicates", METRIC_COUNTER, "QZSS frames dropped as repeats of a recent message",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, gpsClient.getQzss().getDuplicateCount()); }},
+    {"qzss_dropped", METRIC_COUNTER, "QZSS frames dropped because the decode queue was full",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, gpsClient.getQzss().getDroppedCount()); }},
+    {"gnss_messages", METRIC_COUNTER, "UBX messages handled by GpsClient callbacks",
+     [](MetricsWriter &w, const char *name)
+     {
+       for (uint8_t type = 0; type < GPS_MSG_TYPE_COUNT; type++)
+       {
+         w.sample(name, "_total").label("type", gpsMessageName(type)).value((unsigned long)gpsClient.getCallbackStats((GpsMessageType)type).count);
+       }
+     }},
+    {"gnss_callback_cycles", METRIC_COUNTER, "CPU cycles spent in GpsClient callbacks on core1",
+     [](MetricsWriter &w, const char *name)
+     {
+       for (uint8_t type = 0; type < GPS_MSG_TYPE_COUNT; type++)
+       {
+         w.sample(name, "_total").label("type", gpsMessageName(type)).value((unsigned long)gpsClient.getCallbackStats((GpsMessageType)type).cycles);
+       }
+     }},
+    {"gnss_callback_max_cycles", METRIC_GAUGE, "Longest GpsClient callback in CPU cycles",
+     [](MetricsWriter &w, const char *name)
+     {
+       for (uint8_t type = 0; type < GPS_MSG_TYPE_COUNT; type++)
+       {
+         w.sample(name).label("type", gpsMessageName(type)).value((unsigned long)gpsClient.getCallbackStats((GpsMessageType)type).maxCycles);
+       }
+     }},
+    {"display_bytes_sent", METRIC_COUNTER, "Bytes written to the OLED bus",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, display.getBytesSent()); }},
+    {"display_flush_seconds", METRIC_HISTOGRAM, "Duration of one OLED frame flush",
+     [](MetricsWriter &w, const char *name)
+     { w.histogram(name, displayFlush); }},
+    {"display_flush_errors", METRIC_COUNTER, "OLED frames aborted by the I2C controller",
+     [](MetricsWriter &w, const char *name)
+     { w.counter(name, display.getFlushErrors()); }},
+    {"loop_duration_seconds", METRIC_HISTOGRAM, "Duration of one core0 loop",
+     [](MetricsWriter &w, const char *name)
+     { w.histogram(name, loopDuration); }},
+};
+
 void setup()
 {
   // Open serial communications and wait for port to open:
@@ -238,6 +1435,7 @@ void setup()
   Wire.begin();
 
   // OLED setup
+  display.setBusClock(SCREEN_I2C_CLOCK);
   display.begin(SH1106_SWITCHCAPVCC, SCREEN_ADDRESS, false);
   display.clearDisplay();
   display.display();
@@ -271,47 +1469,228 @@ void setup()
   Serial.println(Ethernet.localIP());
 
   // Webサーバーを起動
+  webServer.setMetrics(metrics, sizeof(metrics) / sizeof(metrics[0]));
   server.begin();
 
-  // setup GPS
-  setupGps();
+  // NTPサーバーを起動
+  ntpServer.begin();
 
   // GPS PPS
   pinMode(GPS_PPS_PIN, INPUT_PULLUP);
   attachInterrupt(digitalPinToInterrupt(GPS_PPS_PIN), trigerPps, FALLING);
 }
 
-int displayCount = 0;
-void loop()
+// core1: GNSSの受信とUBXの解析だけを行う
+void setup1()
+{
+  // setup GPS
+  setupGps();
+}
+
+void loop1()
 {
   myGNSS.checkUblox();     // Check for the arrival of new data and process it.
   myGNSS.checkCallbacks(); // Check if any callbacks are waiting to be processed.
+  gpsClient.processQzss();  // 新しいQZSSメッセージがあれば1つだけデコードする
+  updateAssist();
+  updateGpsBus();
+  updateSurvey();
+  updateSavedPosition();
+#if defined(GNSS_ASSIST_DBD)
+  updateNavigationDatabase();
+#endif
+}
 
-  webServer.server(Serial, server, gpsClient.getUbxNavSatData_t(), gpsClient.getGpsSummaryData());
+// RTCの温度は変化が遅いので間隔をあけて読む
+void updateRtcTemperature()
+{
+  if (lastRtcTemperature != 0 && millis() - lastRtcTemperature < RTC_TEMP_INTERVAL_MS)
+  {
+    return;
+  }
+  // RTCはOLEDとI2Cバスを共有しているので、転送中や切り替わりを探している間は次の機会に読む
+  if (display.flushing() || rtcEdgeSearching)
+  {
+    return;
+  }
+  lastRtcTemperature = millis();
+  if (rtc.refresh())
+  {
+    rtcTemperature = (float)rtc.temp() / 100;
+  }
+}
 
-  if (digitalRead(BTN_DISPLAY_PIN) == LOW)
+// 学習したモデルでエージングレジスタを補正する
+void updateRtcAging()
+{
+  int8_t step = rtcHoldover.agingStep();
+  if (step == 0)
   {
-    Serial.println("Button Display");
-    displayCount = 1;
+    return;
+  }
+  int aging = constrain(rtcAging + step, -128, 127);
+  if (aging != rtcAging && writeRtcRegister(RTC_REG_AGING, (uint8_t)(int8_t)aging))
+  {
+    rtcHoldover.onAgingChanged(aging - rtcAging);
+    rtcAging = aging;
+    Serial.print("RTC aging offset: ");
+    Serial.println(rtcAging);
+  }
+}
+
+// RTCの秒が切り替わった時刻edgeUsを、ロック中は学習に、ホールドオーバー中は時刻合わせに使う
+void handleRtcEdge(uint64_t edgeUs, uint8_t second)
+{
+  if (!rtc.refresh() || rtc.second() != second)
+  {
+    return;
   }
+  rtcTemperature = (float)rtc.temp() / 100;
+  lastRtcTemperature = millis();
+  uint32_t rtcSeconds = toUnixTime(2000 + rtc.year(), rtc.month(), rtc.day(), rtc.hour(), rtc.minute(), rtc.second());
 
-  if (micros() - lastPps > 1000 && displayCount > 0)
+  if (ppsClock.synchronized(edgeUs))
   {
-    if (displayCount < 10)
+    rtcHoldover.calibrate(edgeUs, rtcSeconds, ppsClock.now(edgeUs), rtcTemperature);
+    if (fabs(rtcHoldover.getPhase()) > RTC_SET_THRESHOLD)
     {
-      displayInfo(gpsClient.getGpsSummaryData());
-      displayCount++;
+      rtcSetPending = true;
     }
     else
     {
-      displayCount = 0;
-      display.clearDisplay();
-      display.display();
+      updateRtcAging();
+    }
+  }
+  else
+  {
+    rtcHoldover.holdover(edgeUs, rtcSeconds, rtcTemperature, ppsClock.getFrequency());
+  }
+
+#if defined(DEBUG_CONSOLE_RTC)
+  Serial.print("RTC holdover state: ");
+  Serial.print(rtcHoldover.getState());
+  Serial.print(" phase: ");
+  Serial.print(rtcHoldover.getPhase() * 1e3, 3);
+  Serial.print(" ms freq: ");
+  Serial.print(rtcHoldover.getFrequency(rtcTemperature) * 1e6, 3);
+  Serial.print(" ppm error: ");
+  Serial.print(rtcHoldover.error(edgeUs) * 1e3, 3);
+  Serial.println(" ms");
+#endif
+}
+
+// RTCの秒のレジスタを読んで切り替わりを検出する
+// 一度見つけたら次の測定の予想時刻の前後だけ読み、I2Cバスの使用を抑える
+void updateRtcHoldover()
+{
+  static int lastSecond = -1;
+  static uint64_t lastReadUs = 0;
+  static unsigned long retryMillis = 0;
+
+  uint64_t now = time_us_64();
+  rtcEdgeSearching = false;
+  if (rtcEdgeUs != 0)
+  {
+    uint64_t interval = (uint64_t)(ppsClock.synchronized(now) ? RTC_EDGE_INTERVAL_SEC : RTC_EDGE_HOLDOVER_INTERVAL_SEC) * 1000000ULL;
+    uint64_t elapsed = now - rtcEdgeUs;
+    uint32_t fromEdge = elapsed % 1000000ULL;
+    bool nearEdge = fromEdge < RTC_EDGE_WINDOW_US || fromEdge > 1000000UL - RTC_EDGE_WINDOW_US;
+    if (elapsed + RTC_EDGE_WINDOW_US < interval || !nearEdge)
+    {
+      lastSecond = -1;
+      if (elapsed > interval + RTC_EDGE_LOST_SEC * 1000000ULL)
+      {
+        rtcEdgeUs = 0;
+      }
+      return;
     }
   }
+  else if (retryMillis != 0 && millis() - retryMillis < RTC_RETRY_MS)
+  {
+    return;
+  }
+  // RTCはOLEDとI2Cバスを共有しているので、転送中は読まない
+  if (display.flushing())
+  {
+    lastSecond = -1;
+    return;
+  }
+  // 読み出しの間隔がRTC_EDGE_MAX_GAP_USを超えないよう、loopの他の重い処理を後回しにさせる
+  rtcEdgeSearching = true;
+
+  uint64_t before = time_us_64();
+  uint8_t bcd;
+  if (!readRtcRegister(RTC_REG_SECONDS, bcd))
+  {
+    lastSecond = -1;
+    rtcEdgeSearching = false;
+    retryMillis = millis();
+    return;
+  }
+  retryMillis = 0;
+  uint64_t readUs = (before + time_us_64()) / 2;
+  int second = (bcd >> 4) * 10 + (bcd & 0x0f);
+
+  if (lastSecond >= 0 && second != lastSecond)
+  {
+    // 切り替わりは前回と今回の読み出しの間
+    uint64_t gap = readUs - lastReadUs;
+    uint64_t edgeUs = lastReadUs + gap / 2;
+    rtcEdgeUs = edgeUs;
+    lastSecond = -1;
+    rtcEdgeSearching = false;
+    if (gap <= RTC_EDGE_MAX_GAP_US)
+    {
+      handleRtcEdge(edgeUs, second);
+    }
+    return;
+  }
+  lastSecond = second;
+  lastReadUs = readUs;
+}
 
 #if defined(DEBUG_CONSOLE_GPS)
-  printEtherStatus();
+// loopを止めないよう、間隔をあけて表示する
+void printDebugConsole()
+{
+  static GpsCallbackStats lastStats[GPS_MSG_TYPE_COUNT];
+  static unsigned long lastStatsMillis = 0;
+  unsigned long statsMillis = millis();
+  // RTCはOLEDとI2Cバスを共有しているので、転送中や切り替わりを探している間は次の機会に表示する
+  if (statsMillis - lastStatsMillis < DEBUG_CONSOLE_INTERVAL_MS || display.flushing() || rtcEdgeSearching)
+  {
+    return;
+  }
+
+  // 前回の表示からのメッセージ数と1回あたりの平均処理時間
+  for (uint8_t type = 0; type < GPS_MSG_TYPE_COUNT; type++)
+  {
+    const GpsCallbackStats &stats = gpsClient.getCallbackStats((GpsMessageType)type);
+    uint32_t count = stats.count;
+    uint32_t cycles = stats.cycles;
+    uint32_t messages = count - lastStats[type].count;
+    Serial.print(gpsMessageName(type));
+    Serial.print(": ");
+    Serial.print(messages * 1000.0 / (statsMillis - lastStatsMillis), 2);
+    Serial.print(" msg/s ");
+    Serial.print(messages > 0 ? (cycles - lastStats[type].cycles) / messages : 0);
+    Serial.print(" cycles/msg (max ");
+    Serial.print(stats.maxCycles);
+    Serial.println(")");
+    lastStats[type].count = count;
+    lastStats[type].cycles = cycles;
+  }
+  lastStatsMillis = statsMillis;
+
+  Serial.print("GNSS snapshot latency: n=");
+  Serial.print(gpsSnapshotLatency.total());
+  Serial.print(" p50<");
+  Serial.print(gpsSnapshotLatency.percentile(50));
+  Serial.print("us p99<");
+  Serial.print(gpsSnapshotLatency.percentile(99));
+  Serial.print("us max=");
+  Serial.print((unsigned long)gpsSnapshotLatency.max());
+  Serial.println("us");
 
   rtc.refresh();
   Serial.print("RTC DateTime: ");
@@ -354,6 +1733,57 @@ void loop()
   Serial.print((float)rtc.temp() / 100);
 
   Serial.println();
-  delay(1000);
+}
 #endif
-}
\ No newline at end of file
+
+int displayCount = 0;
+unsigned long lastDisplayMillis = 0;
+void loop()
+{
+  uint64_t loopStart = time_us_64();
+
+  // core1が公開した最新のスナップショットを取り込む
+  if (gpsClient.refreshGpsSummaryData())
+  {
+    gpsSnapshotLatency.record(time_us_64() - gpsClient.getGpsSummaryData().receivedMicros);
+  }
+  gpsClient.refreshNavSatData();
+
+  updatePpsClock();
+  ntpServer.server(ppsClock, rtcHoldover);
+
+  webServer.server(Serial, server, gpsClient);
+
+  if (digitalRead(BTN_DISPLAY_PIN) == LOW)
+  {
+    Serial.println("Button Display");
+    displayCount = 1;
+  }
+
+  checkDisplayFlush();
+  if (micros() - lastPps > 1000 && displayCount > 0 && millis() - lastDisplayMillis >= SCREEN_REFRESH_MS && !rtcEdgeSearching)
+  {
+    lastDisplayMillis = millis();
+    if (displayCount < SCREEN_FRAMES)
+    {
+      displayInfo(gpsClient.getGpsSummaryData());
+      displayCount++;
+    }
+    else
+    {
+      displayCount = 0;
+      display.clearDisplay();
+      flushDisplay();
+    }
+  }
+
+  printEtherStatus();
+  updateRtcTemperature();
+  updateRtcHoldover();
+
+  loopDuration.record(time_us_64() - loopStart);
+
+#if defined(DEBUG_CONSOLE_GPS)
+  printDebugConsole();
+#endif
+}
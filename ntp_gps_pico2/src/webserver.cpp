@@ -1,72 +1,377 @@
 #include <webserver.h>
 
-void WebServer::server(Stream &stream, EthernetServer &server, UBX_NAV_SAT_data_t *ubxNavSatData_t, GpsSummaryData gpsSummaryData)
+// クエリ文字列 "a=1&b=2" から数値のパラメータを取り出す
+static bool queryParam(const char *query, const char *name, unsigned long &value)
 {
-  EthernetClient client = server.available();
-  if (client)
+  size_t length = strlen(name);
+  const char *p = query;
+  while (*p != '\0')
   {
-    stream.println("new client");
-    String s;
-    // an http request ends with a blank line
-    boolean currentLineIsBlank = true;
-    while (client.connected())
+    if (strncmp(p, name, length) == 0 && p[length] == '=')
     {
-      if (client.available())
+      char *end;
+      value = strtoul(p + length + 1, &end, 10);
+      return end != p + length + 1;
+    }
+    p = strchr(p, '&');
+    if (p == NULL)
+    {
+      break;
+    }
+    p++;
+  }
+  return false;
+}
+
+// ソケットを直ちに閉じる。EthernetClient::stop()は切断の完了を最大1秒待つので使わない
+static void closeSocket(EthernetClient &client)
+{
+  uint8_t sock = client.getSocketNumber();
+  if (sock < MAX_SOCK_NUM)
+  {
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+    W5100.execCmdSn(sock, Sock_CLOSE);
+    SPI.endTransaction();
+  }
+  client = EthernetClient();
+}
+
+// 1回の呼び出しで使う時間は HTTP_TIME_SLICE_MICROS までに制限し、
+// 残りの接続は次の呼び出しで処理する
+void WebServer::server(Stream &stream, EthernetServer &server, GpsClient &gpsClient)
+{
+  unsigned long start = micros();
+
+  accept(stream, server);
+
+  for (uint8_t n = 0; n < HTTP_MAX_CONNECTIONS; n++)
+  {
+    if (micros() - start > HTTP_TIME_SLICE_MICROS)
+    {
+      break;
+    }
+
+    uint8_t index = next_;
+    HttpConnection &conn = connections_[index];
+    next_ = (next_ + 1) % HTTP_MAX_CONNECTIONS;
+
+    switch (conn.state)
+    {
+    case HTTP_READING:
+      if (!readRequest(conn))
       {
-        char c = client.read();
-        s += c;
-        if (c == '\n' && currentLineIsBlank)
-        {
-          break;
-        }
-        if (c == '\n')
+        if (millis() - conn.lastActivity > HTTP_IDLE_TIMEOUT_MS || !conn.client.connected())
         {
-          // you're starting a new line
-          currentLineIsBlank = true;
+#if defined(DEBUG_CONSOLE_HTTP)
+          stream.println("client timeout");
+#endif
+          close(conn);
         }
-        else if (c != '\r')
+        break;
+      }
+#if defined(DEBUG_CONSOLE_HTTP)
+      stream.print("request: ");
+      stream.println(conn.parser.path());
+#endif
+      conn.state = HTTP_WAITING;
+      // fall through
+
+    case HTTP_WAITING:
+      // 描画バッファは1つなので、送信中の接続があれば次の呼び出しまで待つ
+      if (sending_ >= 0)
+      {
+        if (!conn.client.connected())
         {
-          // you've gotten a character on the current line
-          currentLineIsBlank = false;
+          close(conn);
         }
+        break;
+      }
+      respond(conn, gpsClient);
+      if (conn.sendLength == 0)
+      {
+        close(conn);
+        break;
+      }
+      sending_ = index;
+      conn.state = HTTP_SENDING;
+      conn.lastActivity = millis();
+      // fall through
+
+    case HTTP_SENDING:
+      if (sendResponse(conn))
+      {
+        sending_ = -1;
+        close(conn);
+#if defined(DEBUG_CONSOLE_HTTP)
+        stream.print("response: ");
+        stream.print(lastResponseBytes_);
+        stream.print(" bytes ");
+        stream.print(lastResponseSegments_);
+        stream.print(" segments ");
+        stream.print(lastResponseMicros_);
+        stream.println(" us");
+#endif
+      }
+      else if (millis() - conn.lastActivity > HTTP_SEND_TIMEOUT_MS || !conn.client.connected())
+      {
+#if defined(DEBUG_CONSOLE_HTTP)
+        stream.println("send timeout");
+#endif
+        sendTimeouts_++;
+        sending_ = -1;
+        close(conn);
+      }
+      break;
+
+    case HTTP_CLOSING:
+      // FIN送信後、相手が閉じるのを待つ
+      if (conn.client.status() == SnSR::CLOSED || millis() - conn.lastActivity > HTTP_CLOSE_TIMEOUT_MS)
+      {
+        closeSocket(conn.client);
+        conn.state = HTTP_FREE;
+#if defined(DEBUG_CONSOLE_HTTP)
+        stream.println("client disonnected");
+#endif
       }
+      break;
+
+    default:
+      break;
     }
+  }
+}
 
-    stream.print(s);
+void WebServer::accept(Stream &stream, EthernetServer &server)
+{
+  EthernetClient client = server.accept();
+  if (!client)
+  {
+    return;
+  }
 
-    if (s.indexOf("GET /gps ") >= 0)
+  for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
+  {
+    HttpConnection &conn = connections_[i];
+    if (conn.state == HTTP_FREE)
     {
-      stream.println("GPS");
-      gpsPage(client, ubxNavSatData_t);
+#if defined(DEBUG_CONSOLE_HTTP)
+      stream.println("new client");
+#endif
+      conn.client = client;
+      conn.state = HTTP_READING;
+      conn.lastActivity = millis();
+      conn.parser.reset();
+      return;
     }
-    else if (s.indexOf("GET /metrics ") >= 0)
+  }
+
+  // 空きがなければ即座に切断する
+  closeSocket(client);
+}
+
+// 受信済みのデータだけを読み、リクエストの解析が終わったらtrueを返す
+bool WebServer::readRequest(HttpConnection &conn)
+{
+  uint8_t buf[HTTP_READ_CHUNK_SIZE];
+  int available = conn.client.available();
+  if (available <= 0)
+  {
+    return false;
+  }
+  int size = conn.client.read(buf, min(available, HTTP_READ_CHUNK_SIZE));
+  if (size <= 0)
+  {
+    return false;
+  }
+  conn.lastActivity = millis();
+
+  return conn.parser.feed(buf, size) != HTTP_PARSE_INCOMPLETE;
+}
+
+// レスポンスを描画バッファに描画する。送信はsendResponse()で行う
+void WebServer::respond(HttpConnection &conn, GpsClient &gpsClient)
+{
+  ResponseWriter writer(conn.client);
+  dispatch(writer, conn.parser, gpsClient);
+  writer.end();
+
+  conn.sendOffset = 0;
+  conn.sendLength = writer.pending();
+  lastResponseBytes_ = writer.getBytes();
+  lastResponseSegments_ = writer.getSegments();
+  lastResponseMicros_ = writer.getElapsedMicros();
+  responseOverflows_ += writer.getOverflows();
+  responseSegments_ += writer.getSegments();
+}
+
+// ソケットの送信バッファに入る分だけを書き込み、送り終えたらtrueを返す
+bool WebServer::sendResponse(HttpConnection &conn)
+{
+  int space = conn.client.availableForWrite();
+  if (space > 0)
+  {
+    size_t size = min(conn.sendLength - conn.sendOffset, (size_t)space);
+    size = min(size, (size_t)RESPONSE_SEGMENT_SIZE);
+    size_t written = conn.client.write(&ResponseWriter::data()[conn.sendOffset], size);
+    if (written > 0)
     {
-      stream.println("METRICS");
+      conn.sendOffset += written;
+      conn.lastActivity = millis();
+      lastResponseSegments_++;
+      responseSegments_++;
     }
-    else
+  }
+  return conn.sendOffset >= conn.sendLength;
+}
+
+void WebServer::dispatch(ResponseWriter &writer, const HttpRequestParser &parser, GpsClient &gpsClient)
+{
+  char etag[HTTP_ETAG_SIZE];
+
+  if (parser.result() == HTTP_PARSE_ERROR)
+  {
+    errorPage(writer, parser.errorStatus());
+    return;
+  }
+
+  for (const HttpRoute &route : HTTP_ROUTES)
+  {
+    if (strcmp(parser.path(), route.path) != 0)
     {
-      stream.println("ROOT");
-      rootPage(client, gpsSummaryData);
+      continue;
     }
+    switch (route.id)
+    {
+    case HTTP_ROUTE_ROOT:
+      rootPage(writer, gpsClient.getGpsSummaryData());
+      break;
+    case HTTP_ROUTE_GPS:
+      gpsPage(writer, gpsClient.getNavSatData());
+      break;
+    case HTTP_ROUTE_METRICS:
+      metricsPage(writer);
+      break;
+    case HTTP_ROUTE_API_STATUS:
+      // ETagはスナップショットのバージョン。更新がなければ304を返す
+      snprintf(etag, sizeof(etag), "\"pvt-%lu\"", (unsigned long)gpsClient.getGpsSummaryVersion());
+      if (!notModified(writer, parser, etag))
+      {
+        statusApi(writer, gpsClient.getGpsSummaryData(), etag);
+      }
+      break;
+    case HTTP_ROUTE_API_SATELLITES:
+      snprintf(etag, sizeof(etag), "\"sat-%lu\"", (unsigned long)gpsClient.getNavSatVersion());
+      if (!notModified(writer, parser, etag))
+      {
+        satellitesApi(writer, gpsClient.getNavSatData(), etag);
+      }
+      break;
+    case HTTP_ROUTE_QZSS:
+    {
+      // ?since=N でNより新しいメッセージだけを返す
+      unsigned long since = 0;
+      queryParam(parser.query(), "since", since);
+      snprintf(etag, sizeof(etag), "\"qz-%lu\"", (unsigned long)gpsClient.getQzss().latestSequence());
+      if (!notModified(writer, parser, etag))
+      {
+        qzssApi(writer, gpsClient.getQzss(), since, etag);
+      }
+      break;
+    }
+    }
+    return;
+  }
+  errorPage(writer, 404);
+}
 
-    stream.println("sending response");
-    // give the web browser time to receive the data
-    delay(1);
-    // close the connection:
-    client.stop();
-    stream.println("client disonnected");
+// If-None-Matchが一致したら本文なしの304を返す
+bool WebServer::notModified(ResponseWriter &writer, const HttpRequestParser &parser, const char *etag)
+{
+  if (strcmp(parser.ifNoneMatch(), etag) != 0)
+  {
+    return false;
   }
+  writer.println("HTTP/1.1 304 Not Modified");
+  writer.print("ETag: ");
+  writer.println(etag);
+  writer.println("Connection: close");
+  writer.println();
+  return true;
 }
 
-void WebServer::printHeader(EthernetClient &client, String contentType)
+// FINを送るだけで、切断の完了は待たない
+void WebServer::close(HttpConnection &conn)
+{
+  uint8_t sock = conn.client.getSocketNumber();
+  if (sock < MAX_SOCK_NUM)
+  {
+    SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+    W5100.execCmdSn(sock, Sock_DISCON);
+    SPI.endTransaction();
+  }
+  conn.state = HTTP_CLOSING;
+  conn.lastActivity = millis();
+}
+
+void WebServer::printHeader(ResponseWriter &client, const char *contentType, bool chunked, const char *etag)
 {
   client.println("HTTP/1.1 200 OK");
-  client.println("Content-Type: " + contentType);
-  client.println("Connnection: close");
+  client.print("Content-Type: ");
+  client.println(contentType);
+  client.println("Connection: close");
+  if (etag != NULL)
+  {
+    client.print("ETag: ");
+    client.println(etag);
+    client.println("Cache-Control: no-cache");
+  }
+  if (chunked)
+  {
+    client.println("Transfer-Encoding: chunked");
+  }
+  client.println();
+  if (chunked)
+  {
+    client.beginChunked();
+  }
+}
+
+void WebServer::errorPage(ResponseWriter &client, uint16_t status)
+{
+  const char *reason;
+  switch (status)
+  {
+  case 400:
+    reason = "Bad Request";
+    break;
+  case 404:
+    reason = "Not Found";
+    break;
+  case 405:
+    reason = "Method Not Allowed";
+    break;
+  case 414:
+    reason = "URI Too Long";
+    break;
+  case 431:
+    reason = "Request Header Fields Too Large";
+    break;
+  default:
+    status = 500;
+    reason = "Internal Server Error";
+    break;
+  }
+  client.print("HTTP/1.1 ");
+  client.print(status);
+  client.print(" ");
+  client.println(reason);
+  client.println("Content-Type: text/plain");
+  client.println("Connection: close");
   client.println();
+  client.println(reason);
 }
 
-void WebServer::rootPage(EthernetClient &client, GpsSummaryData gpsSummaryData)
+void WebServer::rootPage(ResponseWriter &client, const GpsSummaryData &gpsSummaryData)
 {
   printHeader(client, "text/html");
 
@@ -115,20 +420,21 @@ void WebServer::rootPage(EthernetClient &client, GpsSummaryData gpsSummaryData)
   client.println("</body></html>");
 }
 
-void WebServer::gpsPage(EthernetClient &client, UBX_NAV_SAT_data_t *ubxNavSatData_t)
+void WebServer::gpsPage(ResponseWriter &client, const UBX_NAV_SAT_data_t &ubxNavSatData_t)
 {
-  printHeader(client, "text/html");
+  // 衛星数によって長さが変わるのでチャンク転送で送る
+  printHeader(client, "text/html", true);
 
   client.println("<!DOCTYPE HTML>");
   client.println("<html>");
   client.print("New NAV SAT data received. It contains data for SVs: ");
-  client.print(ubxNavSatData_t->header.numSvs);
+  client.print(ubxNavSatData_t.header.numSvs);
   client.println("<br>");
 
   // Just for giggles, print the signal strength for each SV as a barchart
-  for (uint16_t block = 0; block < ubxNavSatData_t->header.numSvs; block++) // For each SV
+  for (uint16_t block = 0; block < ubxNavSatData_t.header.numSvs; block++) // For each SV
   {
-    switch (ubxNavSatData_t->blocks[block].gnssId) // Print the GNSS ID
+    switch (ubxNavSatData_t.blocks[block].gnssId) // Print the GNSS ID
     {
     case 0:
       client.print(F("GPS     "));
@@ -156,13 +462,13 @@ void WebServer::gpsPage(EthernetClient &client, UBX_NAV_SAT_data_t *ubxNavSatDat
       break;
     }
 
-    client.print(ubxNavSatData_t->blocks[block].svId); // Print the SV ID
+    client.print(ubxNavSatData_t.blocks[block].svId); // Print the SV ID
 
-    if (ubxNavSatData_t->blocks[block].svId < 10)
+    if (ubxNavSatData_t.blocks[block].svId < 10)
     {
       client.print(F("   "));
     }
-    else if (ubxNavSatData_t->blocks[block].svId < 100)
+    else if (ubxNavSatData_t.blocks[block].svId < 100)
     {
       client.print(F("  "));
     }
@@ -171,14 +477,132 @@ void WebServer::gpsPage(EthernetClient &client, UBX_NAV_SAT_data_t *ubxNavSatDat
       client.print(F(" "));
     }
 
-    client.print(ubxNavSatData_t->blocks[block].cno);
+    client.print(ubxNavSatData_t.blocks[block].cno);
     client.print("<br>");
   }
   client.println("</body></html>");
 }
 
-void WebServer::metricsPage(EthernetClient &client)
+// 登録されたメトリクスをOpenMetrics形式で送る
+void WebServer::metricsPage(ResponseWriter &client)
+{
+  unsigned long start = micros();
+  printHeader(client, METRICS_CONTENT_TYPE, true);
+
+  MetricsWriter writer(client);
+  for (size_t i = 0; i < metricsCount_; i++)
+  {
+    writer.family(metrics_[i]);
+  }
+  writer.end();
+  metricsRender_.record(micros() - start);
+}
+
+void WebServer::statusApi(ResponseWriter &client, const GpsSummaryData &gpsSummaryData, const char *etag)
 {
-  printHeader(client, "text/plain");
-  
-}
\ No newline at end of file
+  printHeader(client, "application/json", true, etag);
+
+  char utc[24];
+  snprintf(utc, sizeof(utc), "%04d-%02d-%02dT%02d:%02d:%02d.%03luZ",
+           gpsSummaryData.year, gpsSummaryData.month, gpsSummaryData.day,
+           gpsSummaryData.hour, gpsSummaryData.min, gpsSummaryData.sec, gpsSummaryData.msec % 1000);
+
+  JsonWriter json(client);
+  json.beginObject();
+  json.field("utc", utc);
+  json.field("timeValid", gpsSummaryData.timeValid);
+  json.field("dateValid", gpsSummaryData.dateValid);
+  json.field("fixType", (unsigned int)gpsSummaryData.fixType);
+  json.field("satellitesUsed", (unsigned int)gpsSummaryData.SIV);
+  json.beginObject("position");
+  json.field("latitude", gpsSummaryData.latitude / 10000000.0, 7);   // [deg]
+  json.field("longitude", gpsSummaryData.longitude / 10000000.0, 7); // [deg]
+  json.field("altitudeMsl", gpsSummaryData.altitude / 1000.0, 3);    // [m]
+  json.endObject();
+  json.beginObject("survey");
+  json.field("state", (unsigned int)gpsSummaryData.surveyState); // SurveyInState
+  json.field("samples", (unsigned long)gpsSummaryData.surveySamples);
+  json.field("accuracy", (double)gpsSummaryData.surveyAccuracy, 3); // [m]
+  json.endObject();
+  json.endObject();
+  client.println();
+}
+
+void WebServer::satellitesApi(ResponseWriter &client, const UBX_NAV_SAT_data_t &ubxNavSatData_t, const char *etag)
+{
+  printHeader(client, "application/json", true, etag);
+
+  JsonWriter json(client);
+  json.beginObject();
+  json.field("iTOW", (unsigned long)ubxNavSatData_t.header.iTOW);
+  json.field("numSvs", (unsigned int)ubxNavSatData_t.header.numSvs);
+  json.beginArray("satellites");
+  for (uint16_t block = 0; block < ubxNavSatData_t.header.numSvs; block++)
+  {
+    const UBX_NAV_SAT_block_t &sv = ubxNavSatData_t.blocks[block];
+    json.beginObject();
+    json.field("gnss", gnssIdToName(sv.gnssId));
+    json.field("gnssId", (unsigned int)sv.gnssId);
+    json.field("svId", (unsigned int)sv.svId);
+    json.field("cno", (unsigned int)sv.cno);       // [dBHz]
+    json.field("elevation", (int)sv.elev);         // [deg]
+    json.field("azimuth", (int)sv.azim);           // [deg]
+    json.field("prResidual", sv.prRes / 10.0, 1);  // [m]
+    json.field("quality", (unsigned int)sv.flags.bits.qualityInd);
+    json.field("used", (bool)sv.flags.bits.svUsed);
+    json.field("health", (unsigned int)sv.flags.bits.health);
+    json.field("diffCorr", (bool)sv.flags.bits.diffCorr);
+    json.field("orbitSource", (unsigned int)sv.flags.bits.orbitSource);
+    json.field("ephemeris", (bool)sv.flags.bits.ephAvail);
+    json.field("almanac", (bool)sv.flags.bits.almAvail);
+    json.field("flags", (unsigned long)sv.flags.all);
+    json.endObject();
+  }
+  json.endArray();
+  json.endObject();
+  client.println();
+}
+
+void WebServer::qzssApi(ResponseWriter &client, const QzssDecoder &qzss, uint32_t since, const char *etag)
+{
+  printHeader(client, "application/json", true, etag);
+
+  // 履歴に残っている範囲だけを返す
+  uint32_t latest = qzss.latestSequence();
+  uint32_t first = latest > QZSS_HISTORY_SIZE ? latest - QZSS_HISTORY_SIZE + 1 : 1;
+  if (since >= first)
+  {
+    first = since + 1;
+  }
+
+  JsonWriter json(client);
+  json.beginObject();
+  json.field("latest", (unsigned long)latest);
+  json.beginArray("messages");
+  QzssMessage message;
+  for (uint32_t sequence = first; sequence <= latest; sequence++)
+  {
+    if (!qzss.read(sequence, message))
+    {
+      continue;
+    }
+    json.beginObject();
+    json.field("sequence", (unsigned long)message.sequence);
+    json.field("mt", (unsigned int)message.mt);
+    json.field("type", message.mt == QZSS_MT_DC_REPORT ? "DC Report" : "DCX");
+    json.field("svId", (unsigned int)message.svId);
+    if (message.unixTime != 0)
+    {
+      json.field("time", (unsigned long)message.unixTime);
+    }
+    else
+    {
+      json.fieldNull("time");
+    }
+    json.field("summary", message.summary);
+    json.endObject();
+  }
+  json.endArray();
+  json.endObject();
+  client.println();
+}
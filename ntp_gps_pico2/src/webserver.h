@@ -2,20 +2,116 @@
 #define WEBSERVER_H
 
 #include <Ethernet.h>
+#include <utility/w5100.h>
 #include <SparkFun_u-blox_GNSS_Arduino_Library.h>
 #include <Gps_model.h>
+#include <Gps_Client.h>
+#include <Http_Request_Parser.h>
+#include <Response_Writer.h>
+#include <Metrics_Writer.h>
+#include <Json_Writer.h>
 
+#define HTTP_MAX_CONNECTIONS 4         // 同時接続数 (W5500のソケット8個のうちNTP/DHCP/待ち受け分を残す)
+#define HTTP_TIME_SLICE_MICROS 300     // 1回のserver()で使う時間の目安
+#define HTTP_IDLE_TIMEOUT_MS 2000      // リクエストを送ってこない接続を切る時間
+#define HTTP_CLOSE_TIMEOUT_MS 1000     // 切断完了を待つ時間
+#define HTTP_SEND_TIMEOUT_MS 5000      // 送信バッファが空かない接続を切る時間
+#define HTTP_READ_CHUNK_SIZE 64
+
+enum HttpConnectionState
+{
+  HTTP_FREE,
+  HTTP_READING,
+  HTTP_WAITING, // リクエストを受け取り、描画バッファが空くのを待っている
+  HTTP_SENDING, // 描画済みのレスポンスを送信中
+  HTTP_CLOSING,
+};
+
+struct HttpConnection
+{
+  EthernetClient client;
+  HttpConnectionState state = HTTP_FREE;
+  unsigned long lastActivity = 0;
+  HttpRequestParser parser;
+  size_t sendOffset = 0; // 描画バッファ中の送信済みの位置
+  size_t sendLength = 0;
+};
+
+enum HttpRouteId
+{
+  HTTP_ROUTE_ROOT,
+  HTTP_ROUTE_GPS,
+  HTTP_ROUTE_METRICS,
+  HTTP_ROUTE_API_STATUS,
+  HTTP_ROUTE_API_SATELLITES,
+  HTTP_ROUTE_QZSS,
+};
+
+struct HttpRoute
+{
+  const char *path;
+  HttpRouteId id;
+};
+
+// パスとページの対応表
+static constexpr HttpRoute HTTP_ROUTES[] = {
+    {"/", HTTP_ROUTE_ROOT},
+    {"/gps", HTTP_ROUTE_GPS},
+    {"/metrics", HTTP_ROUTE_METRICS},
+    {"/api/v1/status", HTTP_ROUTE_API_STATUS},
+    {"/api/v1/satellites", HTTP_ROUTE_API_SATELLITES},
+    {"/qzss", HTTP_ROUTE_QZSS},
+};
 
 class WebServer
 {
 public:
-    void server(Stream &stream, EthernetServer &server, UBX_NAV_SAT_data_t *ubxNavSatData_t, GpsSummaryData gpsSummaryData);
+    void server(Stream &stream, EthernetServer &server, GpsClient &gpsClient);
+    void setMetrics(const MetricFamily *metrics, size_t count)
+    {
+        metrics_ = metrics;
+        metricsCount_ = count;
+    }
+
+    uint32_t getLastResponseBytes() { return lastResponseBytes_; }
+    uint16_t getLastResponseSegments() { return lastResponseSegments_; }
+    unsigned long getLastResponseMicros() { return lastResponseMicros_; }
+    uint32_t getResponseOverflows() { return responseOverflows_; }
+    uint32_t getResponseSegments() { return responseSegments_; }
+    uint32_t getSendTimeouts() { return sendTimeouts_; }
+    // /metricsの本文を描画バッファに書き終えるまでの時間 [us]。目標は1ms以内
+    const LatencyHistogram &getMetricsRender() { return metricsRender_; }
 
 private:
-    void rootPage(EthernetClient &client, GpsSummaryData gpsSummaryData);
-    void gpsPage(EthernetClient &client, UBX_NAV_SAT_data_t *ubxNavSatData_t);
-    void metricsPage(EthernetClient &client);
-    void printHeader(EthernetClient &client, String contentType);
+    HttpConnection connections_[HTTP_MAX_CONNECTIONS];
+    uint8_t next_ = 0;
+    int8_t sending_ = -1; // 描画バッファを使っている接続
+    const MetricFamily *metrics_ = NULL;
+    size_t metricsCount_ = 0;
+    uint32_t lastResponseBytes_ = 0;
+    uint16_t lastResponseSegments_ = 0;
+    unsigned long lastResponseMicros_ = 0;
+    uint32_t responseOverflows_ = 0;
+    uint32_t responseSegments_ = 0; // 全レスポンスでclient.write()した回数
+    uint32_t sendTimeouts_ = 0;
+    LatencyHistogram metricsRender_;
+
+    void accept(Stream &stream, EthernetServer &server);
+    bool readRequest(HttpConnection &conn);
+    void respond(HttpConnection &conn, GpsClient &gpsClient);
+    bool sendResponse(HttpConnection &conn);
+    void dispatch(ResponseWriter &writer, const HttpRequestParser &parser, GpsClient &gpsClient);
+    bool notModified(ResponseWriter &writer, const HttpRequestParser &parser, const char *etag);
+    void close(HttpConnection &conn);
+
+    void rootPage(ResponseWriter &client, const GpsSummaryData &gpsSummaryData);
+    void gpsPage(ResponseWriter &client, const UBX_NAV_SAT_data_t &ubxNavSatData_t);
+    void metricsPage(ResponseWriter &client);
+    void statusApi(ResponseWriter &client, const GpsSummaryData &gpsSummaryData, const char *etag);
+    void satellitesApi(ResponseWriter &client, const UBX_NAV_SAT_data_t &ubxNavSatData_t, const char *etag);
+    void qzssApi(ResponseWriter &client, const QzssDecoder &qzss, uint32_t since, const char *etag);
+    void printHeader(ResponseWriter &client, const char *contentType, bool chunked = false, const char *etag = NULL);
+    void errorPage(ResponseWriter &client, uint16_t status);
 
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,212 @@
+#ifndef HOST_ADAFRUIT_GFX_H
+#define HOST_ADAFRUIT_GFX_H
+
+// [env:native] 用のAdafruit_GFX
+// Adafruit-GFX-Library 1.11 のうちSH1106のドライバが使う部分だけを、同じ宣言 (virtualかどうかも同じ) で持つ。
+// drawChar() はvirtualではなく、print() は virtual な write() から drawChar() を呼ぶ。
+// 本体は上流の Adafruit_GFX.cpp と同じ処理 (GFXfontは持たない) 。
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include "glcdfont.c"
+
+typedef struct GFXfont GFXfont;
+
+class Adafruit_GFX : public Print
+{
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h)
+  {
+    _width = WIDTH;
+    _height = HEIGHT;
+    rotation = 0;
+    cursor_y = cursor_x = 0;
+    textsize_x = textsize_y = 1;
+    textcolor = textbgcolor = 0xFFFF;
+    wrap = true;
+    _cp437 = false;
+    gfxFont = NULL;
+  }
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+  virtual void startWrite(void) {}
+  virtual void writePixel(int16_t x, int16_t y, uint16_t color) { drawPixel(x, y, color); }
+  virtual void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) { fillRect(x, y, w, h, color); }
+  virtual void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) { drawFastVLine(x, y, h, color); }
+  virtual void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) { drawFastHLine(x, y, w, color); }
+  virtual void endWrite(void) {}
+
+  virtual void setRotation(uint8_t r)
+  {
+    rotation = (r & 3);
+    switch (rotation)
+    {
+    case 0:
+    case 2:
+      _width = WIDTH;
+      _height = HEIGHT;
+      break;
+    case 1:
+    case 3:
+      _width = HEIGHT;
+      _height = WIDTH;
+      break;
+    }
+  }
+  virtual void invertDisplay(bool i) { (void)i; }
+
+  // 上流は writeLine() で引くが、縦横の線なので結果は同じ
+  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+  {
+    startWrite();
+    for (int16_t i = 0; i < h; i++)
+    {
+      writePixel(x, y + i, color);
+    }
+    endWrite();
+  }
+  virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+  {
+    startWrite();
+    for (int16_t i = 0; i < w; i++)
+    {
+      writePixel(x + i, y, color);
+    }
+    endWrite();
+  }
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+  {
+    startWrite();
+    for (int16_t i = x; i < x + w; i++)
+    {
+      writeFastVLine(i, y, h, color);
+    }
+    endWrite();
+  }
+  virtual void fillScreen(uint16_t color) { fillRect(0, 0, _width, _height, color); }
+
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size)
+  {
+    drawChar(x, y, c, color, bg, size, size);
+  }
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y)
+  {
+    if ((x >= _width) || (y >= _height) || ((x + 6 * size_x - 1) < 0) || ((y + 8 * size_y - 1) < 0))
+    {
+      return;
+    }
+    if (!_cp437 && (c >= 176))
+    {
+      c++; // Handle 'classic' charset behavior
+    }
+    startWrite();
+    for (int8_t i = 0; i < 5; i++)
+    {
+      uint8_t line = pgm_read_byte(&font[c * 5 + i]);
+      for (int8_t j = 0; j < 8; j++, line >>= 1)
+      {
+        if (line & 1)
+        {
+          if (size_x == 1 && size_y == 1)
+          {
+            writePixel(x + i, y + j, color);
+          }
+          else
+          {
+            writeFillRect(x + i * size_x, y + j * size_y, size_x, size_y, color);
+          }
+        }
+        else if (bg != color)
+        {
+          if (size_x == 1 && size_y == 1)
+          {
+            writePixel(x + i, y + j, bg);
+          }
+          else
+          {
+            writeFillRect(x + i * size_x, y + j * size_y, size_x, size_y, bg);
+          }
+        }
+      }
+    }
+    if (bg != color)
+    {
+      if (size_x == 1 && size_y == 1)
+      {
+        writeFastVLine(x + 5, y, 8, bg);
+      }
+      else
+      {
+        writeFillRect(x + 5 * size_x, y, size_x, 8 * size_y, bg);
+      }
+    }
+    endWrite();
+  }
+
+  using Print::write;
+  virtual size_t write(uint8_t c)
+  {
+    if (c == '\n')
+    {
+      cursor_x = 0;
+      cursor_y += textsize_y * 8;
+    }
+    else if (c != '\r')
+    {
+      if (wrap && ((cursor_x + textsize_x * 6) > _width))
+      {
+        cursor_x = 0;
+        cursor_y += textsize_y * 8;
+      }
+      drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize_x, textsize_y);
+      cursor_x += textsize_x * 6;
+    }
+    return 1;
+  }
+
+  void setCursor(int16_t x, int16_t y)
+  {
+    cursor_x = x;
+    cursor_y = y;
+  }
+  void setTextColor(uint16_t c) { textcolor = textbgcolor = c; }
+  void setTextColor(uint16_t c, uint16_t bg)
+  {
+    textcolor = c;
+    textbgcolor = bg;
+  }
+  void setTextSize(uint8_t s) { setTextSize(s, s); }
+  void setTextSize(uint8_t sx, uint8_t sy)
+  {
+    textsize_x = (sx > 0) ? sx : 1;
+    textsize_y = (sy > 0) ? sy : 1;
+  }
+  void setTextWrap(bool w) { wrap = w; }
+  void cp437(bool x = true) { _cp437 = x; }
+  void setFont(const GFXfont *f = NULL) { gfxFont = (GFXfont *)f; }
+
+  int16_t width(void) const { return _width; }
+  int16_t height(void) const { return _height; }
+  uint8_t getRotation(void) const { return rotation; }
+  int16_t getCursorX(void) const { return cursor_x; }
+  int16_t getCursorY(void) const { return cursor_y; }
+
+protected:
+  int16_t WIDTH;
+  int16_t HEIGHT;
+  int16_t _width;
+  int16_t _height;
+  int16_t cursor_x;
+  int16_t cursor_y;
+  uint16_t textcolor;
+  uint16_t textbgcolor;
+  uint8_t textsize_x;
+  uint8_t textsize_y;
+  uint8_t rotation;
+  bool wrap;
+  bool _cp437;
+  GFXfont *gfxFont;
+};
+
+#endif // HOST_ADAFRUIT_GFX_H
@@ -0,0 +1,178 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// [env:native] 用のArduino APIの代用品
+// src/ のうちハードウェアに依存しないモジュールとテストをホストでビルドするための最小限だけを持つ。
+// 時刻は hostClockMicros を進めて動かす。rp2040.getCycleCount() は実時間 (ns) を返す。
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <functional>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define DEC 10
+#define HEX 16
+#define OUTPUT 1
+#define INPUT 0
+#define HIGH 1
+#define LOW 0
+#define PI 3.1415926535897932384626433832795
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+
+using std::isinf;
+using std::isnan;
+
+template <class T, class L>
+auto min(const T &a, const L &b) -> decltype((b < a) ? b : a)
+{
+  return (b < a) ? b : a;
+}
+
+template <class T, class L>
+auto max(const T &a, const L &b) -> decltype((b < a) ? b : a)
+{
+  return (a < b) ? b : a;
+}
+
+// テストが進める時計 [us]。micros()/millis()/time_us_64() はこれを返す
+inline uint64_t hostClockMicros = 0;
+
+inline unsigned long micros() { return (unsigned long)hostClockMicros; }
+inline unsigned long millis() { return (unsigned long)(hostClockMicros / 1000); }
+inline void delay(unsigned long ms) { hostClockMicros += ms * 1000ULL; }
+inline void delayMicroseconds(unsigned int us) { hostClockMicros += us; }
+inline void yield() {}
+
+// GPIOは最後に書いた値と書き込み回数だけを残す。hostPinListener があれば書き込みごとに呼ぶ
+#define HOST_PINS 64
+inline uint8_t hostPinLevel[HOST_PINS];
+inline uint32_t hostPinWrites = 0;
+inline std::function<void(int pin, int level)> hostPinListener;
+inline void pinMode(int, int) {}
+inline void digitalWrite(int pin, int level)
+{
+  hostPinWrites++;
+  if (pin >= 0 && pin < HOST_PINS)
+  {
+    hostPinLevel[pin] = level;
+  }
+  if (hostPinListener)
+  {
+    hostPinListener(pin, level);
+  }
+}
+
+// CallbackTimerが使うサイクルカウンタ。ホストではナノ秒を数える
+struct HostRp2040
+{
+  uint32_t getCycleCount()
+  {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+};
+inline HostRp2040 rp2040;
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t n = 0;
+    while (size--)
+    {
+      if (write(*buffer++) == 0)
+      {
+        break;
+      }
+      n++;
+    }
+    return n;
+  }
+  size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *)str, strlen(str)); }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const __FlashStringHelper *s) { return write(reinterpret_cast<const char *>(s)); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char n, int base = DEC) { return printNumber(n, base); }
+  size_t print(int n, int base = DEC) { return printSigned(n, base); }
+  size_t print(unsigned int n, int base = DEC) { return printNumber(n, base); }
+  size_t print(long n, int base = DEC) { return printSigned(n, base); }
+  size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+  size_t print(long long n, int base = DEC) { return printSigned(n, base); }
+  size_t print(unsigned long long n, int base = DEC) { return printNumber(n, base); }
+  size_t print(double n, int digits = 2) { return printFloat(n, digits); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(T value) { return print(value) + println(); }
+  template <typename T>
+  size_t println(T value, int format) { return print(value, format) + println(); }
+
+private:
+  size_t printNumber(unsigned long long n, int base)
+  {
+    char buf[8 * sizeof(n) + 1];
+    char *p = &buf[sizeof(buf) - 1];
+    *p = '\0';
+    if (base < 2)
+    {
+      base = 10;
+    }
+    do
+    {
+      char d = n % base;
+      n /= base;
+      *--p = d < 10 ? d + '0' : d + 'A' - 10;
+    } while (n);
+    return write(p);
+  }
+  size_t printSigned(long long n, int base)
+  {
+    if (base == DEC && n < 0)
+    {
+      return print('-') + printNumber(0ULL - (unsigned long long)n, base);
+    }
+    return printNumber((unsigned long long)n & (base == DEC ? ~0ULL : 0xffffffffULL), base);
+  }
+  size_t printFloat(double n, int digits)
+  {
+    if (isnan(n))
+    {
+      return write("nan");
+    }
+    if (isinf(n))
+    {
+      return write("inf");
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return write(buf);
+  }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,100 @@
+#ifndef HOST_ETHERNET_H
+#define HOST_ETHERNET_H
+
+// [env:native] 用のEthernetライブラリの代用品
+// EthernetUDP は inbox に積んだデータグラムを parsePacket() で1つずつ取り出し、送ったものを sent に残す。
+// read() は hostUdpReadMicros だけ時計を進める (W5500からSPIで読み出す時間の代わり) 。
+// 最後に begin() したソケットは hostUdp から見える。
+
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+
+class IPAddress
+{
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes_{a, b, c, d} {}
+  uint8_t operator[](int i) const { return bytes_[i]; }
+  bool operator==(const IPAddress &other) const { return memcmp(bytes_, other.bytes_, 4) == 0; }
+
+private:
+  uint8_t bytes_[4] = {};
+};
+
+struct HostDatagram
+{
+  IPAddress ip;
+  uint16_t port;
+  std::vector<uint8_t> data;
+};
+
+inline uint32_t hostUdpReadMicros = 0;
+
+class EthernetUDP;
+inline EthernetUDP *hostUdp = NULL;
+
+class EthernetUDP
+{
+public:
+  std::deque<HostDatagram> inbox;
+  std::vector<HostDatagram> sent;
+  uint16_t localPort = 0;
+
+  uint8_t begin(uint16_t port)
+  {
+    localPort = port;
+    hostUdp = this;
+    return 1;
+  }
+
+  int parsePacket()
+  {
+    if (inbox.empty())
+    {
+      return 0;
+    }
+    current_ = inbox.front();
+    inbox.pop_front();
+    pos_ = 0;
+    return (int)current_.data.size();
+  }
+
+  int read(uint8_t *buffer, size_t size)
+  {
+    hostClockMicros += hostUdpReadMicros;
+    size_t n = min(size, current_.data.size() - pos_);
+    memcpy(buffer, &current_.data[pos_], n);
+    pos_ += n;
+    return (int)n;
+  }
+
+  // 読み残しを捨てる
+  void flush() { pos_ = current_.data.size(); }
+
+  IPAddress remoteIP() const { return current_.ip; }
+  uint16_t remotePort() const { return current_.port; }
+
+  int beginPacket(IPAddress ip, uint16_t port)
+  {
+    out_ = {ip, port, {}};
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size)
+  {
+    out_.data.insert(out_.data.end(), buffer, buffer + size);
+    return size;
+  }
+  int endPacket()
+  {
+    sent.push_back(out_);
+    return 1;
+  }
+
+private:
+  HostDatagram current_;
+  size_t pos_ = 0;
+  HostDatagram out_;
+};
+
+#endif // HOST_ETHERNET_H
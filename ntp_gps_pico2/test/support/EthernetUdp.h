@@ -0,0 +1,6 @@
+#ifndef HOST_ETHERNET_UDP_H
+#define HOST_ETHERNET_UDP_H
+
+#include <Ethernet.h>
+
+#endif // HOST_ETHERNET_UDP_H
@@ -0,0 +1,42 @@
+#ifndef HOST_MOCK_STREAM_H
+#define HOST_MOCK_STREAM_H
+
+// [env:native] 用のStream。input_ から読み、書き込まれた文字は output_ に残す
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+class MockStream : public Stream
+{
+public:
+  void feed(const std::vector<uint8_t> &data) { input_.insert(input_.end(), data.begin(), data.end()); }
+  // 最大size バイトを読む (UARTのFIFOからまとめて取り出す代わり)
+  size_t readBytes(uint8_t *buffer, size_t size)
+  {
+    size_t n = min(size, input_.size() - pos_);
+    memcpy(buffer, &input_[pos_], n);
+    pos_ += n;
+    return n;
+  }
+
+  int available() override { return (int)(input_.size() - pos_); }
+  int read() override { return pos_ < input_.size() ? input_[pos_++] : -1; }
+  int peek() override { return pos_ < input_.size() ? input_[pos_] : -1; }
+  size_t write(uint8_t c) override
+  {
+    output_ += (char)c;
+    return 1;
+  }
+  using Print::write;
+
+  const std::string &output() const { return output_; }
+  void clearOutput() { output_.clear(); }
+
+private:
+  std::vector<uint8_t> input_;
+  size_t pos_ = 0;
+  std::string output_;
+};
+
+#endif // HOST_MOCK_STREAM_H
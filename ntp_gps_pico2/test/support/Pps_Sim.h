@@ -0,0 +1,94 @@
+#ifndef HOST_PPS_SIM_H
+#define HOST_PPS_SIM_H
+
+// [env:native] 用のPPSのシミュレーション
+// 真の時刻 t [s] に対して、周波数誤差のある1MHzのローカルカウンタ (time_us_64) と、
+// 受信機のクロックの刻みで量子化されたPPSエッジ (のこぎり波のqErr) 、割り込みの遅れ、欠けたエッジを作り、
+// PpsClockに渡す。probe()は秒の中ほどでのクロックの誤差を返す。
+
+#include <Pps_Clock.h>
+#include <math.h>
+
+struct PpsSimConfig
+{
+  double freqError = 36.7e-6;   // ローカル発振器の周波数誤差 (1秒あたりのずれが整数usだと量子化の雑音が出ない)
+  double latency = 1.5e-6;      // 割り込みの固定の遅れ [s]
+  double latencyJitter = 0.0;   // 遅れのばらつき (0..latencyJitter の一様分布) [s]
+  double qErrTick = 0.0;        // 受信機がパルスを出すクロックの周期 (のこぎり波の振幅) [s]
+  double qErrBeat = 0.0137;     // 1秒ごとにパルスが刻みの中でずれる割合
+  bool applyQErr = false;       // qErrをPpsClockに渡すか
+  double missProbability = 0.0; // エッジが欠ける確率
+  uint32_t unixStart = 1792152000UL;
+};
+
+class PpsSim
+{
+public:
+  PpsSim(const PpsSimConfig &config, uint32_t seed = 2463534242UL) : config_(config), rng_(seed) {}
+
+  // 次の秒のエッジとNAV-PVTを渡す。missならエッジだけを落とす。delayはこのエッジだけの割り込みの遅れ [s]
+  void tick(PpsClock &clock, bool miss = false, double delay = 0.0)
+  {
+    second_++;
+    double qErr = config_.qErrTick * (fraction(0.3 + second_ * config_.qErrBeat) - 0.5);
+    double edge = second_ + qErr + config_.latency + config_.latencyJitter * uniform() + delay;
+    if (miss || uniform() < config_.missProbability)
+    {
+      missed_++;
+    }
+    else
+    {
+      clock.onPps(localUs(edge), config_.applyQErr ? qErr : 0.0);
+    }
+    clock.onUtcSecond(config_.unixStart + second_, localUs(second_ + 0.05));
+  }
+
+  // 秒の中ほど (真の時刻) でクロックが示す時刻との差 [s]。正ならクロックが進んでいる
+  double probe(const PpsClock &clock) const
+  {
+    double t = second_ + 0.5;
+    NtpTimestamp ts = clock.now(localUs(t));
+    double shown = (double)(int32_t)(ts.seconds - NTP_UNIX_OFFSET - config_.unixStart) + ts.fraction / 4294967296.0;
+    return shown - t;
+  }
+
+  uint64_t localUs(double t) const { return (uint64_t)floor(100.0e6 + t * (1.0 + config_.freqError) * 1e6); }
+  uint32_t second() const { return second_; }
+  uint32_t missed() const { return missed_; }
+
+private:
+  PpsSimConfig config_;
+  uint32_t rng_;
+  uint32_t second_ = 0;
+  uint32_t missed_ = 0;
+
+  static double fraction(double x) { return x - floor(x); }
+  double uniform()
+  {
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    return rng_ / 4294967296.0;
+  }
+};
+
+// 誤差の平均と標準偏差、最大値
+struct PpsErrorStats
+{
+  uint32_t count = 0;
+  double sum = 0.0;
+  double sumSquares = 0.0;
+  double maxAbs = 0.0;
+
+  void add(double error)
+  {
+    count++;
+    sum += error;
+    sumSquares += error * error;
+    maxAbs = fabs(error) > maxAbs ? fabs(error) : maxAbs;
+  }
+  double mean() const { return count ? sum / count : 0.0; }
+  double stddev() const { return count ? sqrt(fmax(sumSquares / count - mean() * mean(), 0.0)) : 0.0; }
+};
+
+#endif // HOST_PPS_SIM_H
@@ -0,0 +1,24 @@
+#ifndef HOST_QZQSM_H
+#define HOST_QZQSM_H
+
+// [env:native] 用。DC Reportのデコーダの代わりに、フレームの先頭を16進数で返す
+
+#include <Arduino.h>
+
+class QZQSM
+{
+public:
+  void SetYear(uint16_t year) { year_ = year; }
+  void Decode(byte *dat)
+  {
+    snprintf(report_, sizeof(report_), "DC Report %u %02X%02X%02X%02X%02X%02X", year_,
+             dat[1], dat[2], dat[3], dat[4], dat[5], dat[6]);
+  }
+  char *GetReport() { return report_; }
+
+private:
+  uint16_t year_ = 0;
+  char report_[64] = {};
+};
+
+#endif // HOST_QZQSM_H
@@ -0,0 +1,29 @@
+#ifndef HOST_QZSSDCX_H
+#define HOST_QZSSDCX_H
+
+// [env:native] 用。DCXのデコーダの代わりに、フレームの先頭を16進数で返す
+
+#include <Arduino.h>
+
+struct DCXMessage
+{
+  uint8_t head[6];
+};
+
+class DCXDecoder
+{
+public:
+  DCXMessage r = {};
+
+  void decode(const byte *dat) { memcpy(r.head, &dat[1], sizeof(r.head)); }
+  void printSummary(Print &out, const DCXMessage &m)
+  {
+    char text[32];
+    snprintf(text, sizeof(text), "DCX %02X%02X%02X%02X%02X%02X",
+             m.head[0], m.head[1], m.head[2], m.head[3], m.head[4], m.head[5]);
+    out.print(text);
+  }
+  void printAll(Print &out, const DCXMessage &m) { printSummary(out, m); }
+};
+
+#endif // HOST_QZSSDCX_H
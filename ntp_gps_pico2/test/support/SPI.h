@@ -0,0 +1,66 @@
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+
+// [env:native] 用のSPIClass
+// 送ったバイトとトランザクションの数を数え、onTransfer があれば1バイトごとに渡す (D/CやCSはピンの値を見る)。
+
+#include <Arduino.h>
+#include <functional>
+
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0
+
+class SPISettings
+{
+public:
+  SPISettings(uint32_t clock = 4000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0) : clock(clock)
+  {
+    (void)bitOrder;
+    (void)dataMode;
+  }
+  uint32_t clock;
+};
+
+class SPIClass
+{
+public:
+  std::function<void(uint8_t data)> onTransfer;
+  uint32_t clock = 0;
+  uint32_t transactions = 0;
+  uint32_t bytes = 0;
+
+  void begin() {}
+  void beginTransaction(SPISettings settings)
+  {
+    clock = settings.clock;
+    transactions++;
+  }
+  void endTransaction() {}
+  uint8_t transfer(uint8_t data)
+  {
+    bytes++;
+    if (onTransfer)
+    {
+      onTransfer(data);
+    }
+    return 0;
+  }
+  // arduino-picoのまとめて送る版
+  void transfer(const void *txbuf, void *rxbuf, size_t count)
+  {
+    const uint8_t *tx = (const uint8_t *)txbuf;
+    for (size_t i = 0; i < count; i++)
+    {
+      uint8_t r = transfer(tx[i]);
+      if (rxbuf != NULL)
+      {
+        ((uint8_t *)rxbuf)[i] = r;
+      }
+    }
+  }
+};
+
+inline SPIClass SPI;
+
+#endif // HOST_SPI_H
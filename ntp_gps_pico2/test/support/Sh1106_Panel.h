@@ -0,0 +1,239 @@
+#ifndef HOST_SH1106_PANEL_H
+#define HOST_SH1106_PANEL_H
+
+// [env:native] 用のSH1106パネルのエミュレータ
+// I2C (Wire.h) 、ハードウェアSPI (SPI.h) 、ピンを叩くソフトウェアSPI (digitalWrite) で届いたバイトを
+// SH1106と同じように解釈して132列 x 8ページの表示RAMに書き、バスに流れたバイトを数える。
+// 表示されるのは列 SH1106_PANEL_OFFSET から幅の分。
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <Wire.h>
+
+#define SH1106_PANEL_COLUMNS 132
+#define SH1106_PANEL_PAGES 8
+#define SH1106_PANEL_OFFSET 2 // 128列のパネルはRAMの列2..129を表示する
+
+class Sh1106Panel
+{
+public:
+  uint8_t ram[SH1106_PANEL_PAGES][SH1106_PANEL_COLUMNS];
+  uint32_t commandBytes = 0;  // コマンドとその引数
+  uint32_t dataBytes = 0;     // 表示RAMへのデータ
+  uint32_t controlBytes = 0;  // I2Cのコントロールバイト
+  uint32_t transmissions = 0; // I2Cの送信またはSPIのCSの区間
+  uint32_t ignoredBytes = 0;  // CSが上がっている間のSPIのバイト、別のアドレスへのI2C
+
+  Sh1106Panel() { memset(ram, 0, sizeof(ram)); }
+  ~Sh1106Panel() { detach(); }
+
+  void attachI2C(TwoWire &wire, uint8_t address = 0x3C)
+  {
+    wire_ = &wire;
+    wire.onTransmission = [this, address](uint8_t to, const uint8_t *data, size_t length)
+    {
+      if (to != address)
+      {
+        ignoredBytes += length;
+        return;
+      }
+      transmissions++;
+      receiveI2C(data, length);
+    };
+  }
+
+  // D/CとCSはピンの値を見る
+  void attachSPI(SPIClass &spi, int dc, int cs)
+  {
+    spi_ = &spi;
+    watchSelect(-1, -1, dc, cs);
+    spi.onTransfer = [this](uint8_t data)
+    {
+      receiveSPI(data);
+    };
+  }
+
+  // SCLKの立ち上がりでSIDを読む (モード0、MSBから)
+  void attachSoftSPI(int sid, int sclk, int dc, int cs) { watchSelect(sid, sclk, dc, cs); }
+
+  void detach()
+  {
+    if (wire_ != NULL)
+    {
+      wire_->onTransmission = nullptr;
+      wire_ = NULL;
+    }
+    if (spi_ != NULL)
+    {
+      spi_->onTransfer = nullptr;
+      spi_ = NULL;
+    }
+    if (cs_ >= 0)
+    {
+      hostPinListener = nullptr;
+      cs_ = -1;
+    }
+  }
+
+  uint32_t busBytes() const { return commandBytes + dataBytes + controlBytes; }
+  void resetCounters() { commandBytes = dataBytes = controlBytes = transmissions = ignoredBytes = 0; }
+
+  // 表示されている部分がページ順のバッファ (幅 width) と同じか
+  bool shows(const uint8_t *buffer, int width, int pages) const
+  {
+    for (int page = 0; page < pages; page++)
+    {
+      if (memcmp(&ram[page][SH1106_PANEL_OFFSET], &buffer[page * width], width) != 0)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void command(uint8_t c)
+  {
+    commandBytes++;
+    if (argument_)
+    {
+      argument_ = false;
+      return;
+    }
+    if (c >= 0xB0 && c <= 0xB7)
+    {
+      page_ = c & 0x07;
+    }
+    else if (c <= 0x0F)
+    {
+      column_ = (column_ & 0xF0) | c;
+    }
+    else if (c <= 0x1F)
+    {
+      column_ = ((c & 0x0F) << 4) | (column_ & 0x0F);
+    }
+    else
+    {
+      // 引数を1バイトとるコマンド (0x20はSH1106にはないが、SSD1306と共通の初期化列が送る)
+      switch (c)
+      {
+      case 0x20:
+      case 0x81:
+      case 0x8D:
+      case 0xA8:
+      case 0xAD:
+      case 0xD3:
+      case 0xD5:
+      case 0xD9:
+      case 0xDA:
+      case 0xDB:
+        argument_ = true;
+        break;
+      }
+    }
+  }
+
+  // 列アドレスは書くごとに進む
+  void data(uint8_t d)
+  {
+    dataBytes++;
+    if (column_ < SH1106_PANEL_COLUMNS)
+    {
+      ram[page_][column_++] = d;
+    }
+  }
+
+private:
+  TwoWire *wire_ = NULL;
+  SPIClass *spi_ = NULL;
+  int sid_ = -1;
+  int sclk_ = -1;
+  int dc_ = -1;
+  int cs_ = -1;
+  uint8_t page_ = 0;
+  uint8_t column_ = 0;
+  bool argument_ = false;
+  uint8_t shift_ = 0;
+  uint8_t bits_ = 0;
+
+  // コントロールバイト: Co (0x80) が立っていれば1バイトだけ続き、また制御バイトが来る。
+  // Coが0なら残りはすべて D/C (0x40) の示すデータかコマンド
+  void receiveI2C(const uint8_t *p, size_t n)
+  {
+    size_t i = 0;
+    while (i < n)
+    {
+      uint8_t control = p[i++];
+      controlBytes++;
+      bool isData = control & 0x40;
+      if (control & 0x80)
+      {
+        if (i < n)
+        {
+          deliver(isData, p[i++]);
+        }
+        continue;
+      }
+      while (i < n)
+      {
+        deliver(isData, p[i++]);
+      }
+    }
+  }
+
+  void receiveSPI(uint8_t d)
+  {
+    if (hostPinLevel[cs_] != LOW)
+    {
+      ignoredBytes++;
+      return;
+    }
+    deliver(hostPinLevel[dc_] == HIGH, d);
+  }
+
+  void deliver(bool isData, uint8_t d)
+  {
+    if (isData)
+    {
+      data(d);
+    }
+    else
+    {
+      command(d);
+    }
+  }
+
+  void watchSelect(int sid, int sclk, int dc, int cs)
+  {
+    sid_ = sid;
+    sclk_ = sclk;
+    dc_ = dc;
+    cs_ = cs;
+    hostPinListener = [this](int pin, int level)
+    {
+      onPin(pin, level);
+    };
+  }
+
+  void onPin(int pin, int level)
+  {
+    if (pin == cs_)
+    {
+      // CSを下げてからのビットを数え直す
+      shift_ = bits_ = 0;
+      transmissions += level == LOW;
+      return;
+    }
+    if (pin != sclk_ || level != HIGH || hostPinLevel[cs_] != LOW)
+    {
+      return;
+    }
+    shift_ = (shift_ << 1) | (hostPinLevel[sid_] ? 1 : 0);
+    if (++bits_ == 8)
+    {
+      deliver(hostPinLevel[dc_] == HIGH, shift_);
+      shift_ = bits_ = 0;
+    }
+  }
+};
+
+#endif // HOST_SH1106_PANEL_H
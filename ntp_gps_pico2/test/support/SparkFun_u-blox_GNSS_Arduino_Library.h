@@ -0,0 +1,163 @@
+#ifndef HOST_SPARKFUN_UBLOX_GNSS_H
+#define HOST_SPARKFUN_UBLOX_GNSS_H
+
+// [env:native] 用。SparkFun u-blox GNSS v2 のうちGpsClientが受け取る構造体だけを同じ配置で定義する
+// ペイロードからの展開は Ubx_Log.h の ubxDispatch() がライブラリの代わりに行う
+
+#include <Arduino.h>
+
+#define UBX_NAV_SAT_MAX_BLOCKS 255
+#define UBX_RXM_SFRBX_MAX_WORDS 16
+
+typedef struct
+{
+  uint32_t iTOW;
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  uint8_t hour;
+  uint8_t min;
+  uint8_t sec;
+  union
+  {
+    uint8_t all;
+    struct
+    {
+      uint8_t validDate : 1;
+      uint8_t validTime : 1;
+      uint8_t fullyResolved : 1;
+      uint8_t validMag : 1;
+    } bits;
+  } valid;
+  uint32_t tAcc;
+  int32_t nano;
+  uint8_t fixType;
+  union
+  {
+    uint8_t all;
+    struct
+    {
+      uint8_t gnssFixOK : 1;
+      uint8_t diffSoln : 1;
+      uint8_t psmState : 3;
+      uint8_t headVehValid : 1;
+      uint8_t carrSoln : 2;
+    } bits;
+  } flags;
+  union
+  {
+    uint8_t all;
+    struct
+    {
+      uint8_t reserved : 5;
+      uint8_t confirmedAvai : 1;
+      uint8_t confirmedDate : 1;
+      uint8_t confirmedTime : 1;
+    } bits;
+  } flags2;
+  uint8_t numSV;
+  int32_t lon;
+  int32_t lat;
+  int32_t height;
+  int32_t hMSL;
+  uint32_t hAcc;
+  uint32_t vAcc;
+  int32_t velN;
+  int32_t velE;
+  int32_t velD;
+  int32_t gSpeed;
+  int32_t headMot;
+  uint32_t sAcc;
+  uint32_t headAcc;
+  uint16_t pDOP;
+  uint8_t flags3;
+  uint8_t reserved1[5];
+  int32_t headVeh;
+  int16_t magDec;
+  uint16_t magAcc;
+} UBX_NAV_PVT_data_t;
+
+typedef struct
+{
+  uint32_t iTOW;
+  uint8_t version;
+  uint8_t numSvs;
+  uint8_t reserved1[2];
+} UBX_NAV_SAT_header_t;
+
+typedef struct
+{
+  uint8_t gnssId;
+  uint8_t svId;
+  uint8_t cno;
+  int8_t elev;
+  int16_t azim;
+  int16_t prRes;
+  union
+  {
+    uint32_t all;
+    struct
+    {
+      uint32_t qualityInd : 3;
+      uint32_t svUsed : 1;
+      uint32_t health : 2;
+      uint32_t diffCorr : 1;
+      uint32_t smoothed : 1;
+      uint32_t orbitSource : 3;
+      uint32_t ephAvail : 1;
+      uint32_t almAvail : 1;
+      uint32_t anoAvail : 1;
+      uint32_t aopAvail : 1;
+      uint32_t reserved1 : 1;
+      uint32_t sbasCorrUsed : 1;
+      uint32_t rtcmCorrUsed : 1;
+      uint32_t slasCorrUsed : 1;
+      uint32_t spartnCorrUsed : 1;
+      uint32_t prCorrUsed : 1;
+      uint32_t crCorrUsed : 1;
+      uint32_t doCorrUsed : 1;
+      uint32_t clasCorrUsed : 1;
+    } bits;
+  } flags;
+} UBX_NAV_SAT_block_t;
+
+typedef struct
+{
+  UBX_NAV_SAT_header_t header;
+  UBX_NAV_SAT_block_t blocks[UBX_NAV_SAT_MAX_BLOCKS];
+} UBX_NAV_SAT_data_t;
+
+typedef struct
+{
+  uint8_t gnssId;
+  uint8_t svId;
+  uint8_t reserved1;
+  uint8_t freqId;
+  uint8_t numWords;
+  uint8_t chn;
+  uint8_t version;
+  uint8_t reserved2;
+  uint32_t dwrd[UBX_RXM_SFRBX_MAX_WORDS];
+} UBX_RXM_SFRBX_data_t;
+
+typedef struct
+{
+  uint32_t towMS;
+  uint32_t towSubMS;
+  int32_t qErr;
+  uint16_t week;
+  union
+  {
+    uint8_t all;
+    struct
+    {
+      uint8_t timeBase : 1;
+      uint8_t utc : 1;
+      uint8_t raim : 2;
+      uint8_t qErrInvalid : 1;
+    } bits;
+  } flags;
+  uint8_t refInfo;
+} UBX_TIM_TP_data_t;
+
+#endif // HOST_SPARKFUN_UBLOX_GNSS_H
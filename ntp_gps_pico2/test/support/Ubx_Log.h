@@ -0,0 +1,243 @@
+#ifndef HOST_UBX_LOG_H
+#define HOST_UBX_LOG_H
+
+// [env:native] 用のUBXログ
+// UbxLogで合成したNAV-PVT/NAV-SAT/RXM-SFRBX/TIM-TPのバイト列を作る。受信機の出力 (合成したものか.ubxファイル) はUbxFrameParserでフレームに区切り、
+// ubxDispatch()がSparkFunライブラリの代わりにペイロードを構造体に展開してGpsClientのコールバックを呼ぶ。
+
+#include <Gps_Client.h>
+#include <Ubx_Frame_Parser.h>
+#include <vector>
+
+#define UBX_CLASS_NAV 0x01
+#define UBX_CLASS_RXM 0x02
+#define UBX_CLASS_TIM 0x0D
+#define UBX_NAV_PVT 0x07
+#define UBX_NAV_SAT 0x35
+#define UBX_RXM_SFRBX 0x13
+#define UBX_TIM_TP 0x01
+
+#define UBX_NAV_PVT_LEN 92
+#define UBX_TIM_TP_LEN 16
+#define QZSS_L1S_WORDS 8
+
+class UbxLog
+{
+public:
+  std::vector<uint8_t> bytes;
+  uint32_t frames = 0;
+
+  void addFrame(uint8_t cls, uint8_t id, const std::vector<uint8_t> &payload)
+  {
+    size_t start = bytes.size();
+    bytes.push_back(UBX_FRAME_SYNC1);
+    bytes.push_back(UBX_FRAME_SYNC2);
+    bytes.push_back(cls);
+    bytes.push_back(id);
+    bytes.push_back(payload.size() & 0xff);
+    bytes.push_back(payload.size() >> 8);
+    bytes.insert(bytes.end(), payload.begin(), payload.end());
+    uint8_t a = 0, b = 0;
+    for (size_t i = start + 2; i < bytes.size(); i++)
+    {
+      a += bytes[i];
+      b += a;
+    }
+    bytes.push_back(a);
+    bytes.push_back(b);
+    frames++;
+  }
+
+  // 1秒分の測位結果。hourなどはUTC、lat/lonは [1e-7 deg]
+  void addNavPvt(uint32_t iTOW, uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec,
+                 uint8_t fixType, uint8_t numSV, int32_t lat, int32_t lon, int32_t height, int32_t hMSL)
+  {
+    std::vector<uint8_t> p(UBX_NAV_PVT_LEN, 0);
+    put(p, 0, iTOW, 4);
+    put(p, 4, year, 2);
+    p[6] = month;
+    p[7] = day;
+    p[8] = hour;
+    p[9] = min;
+    p[10] = sec;
+    p[11] = 0x07; // validDate | validTime | fullyResolved
+    p[20] = fixType;
+    p[21] = fixType >= 2 ? 0x01 : 0x00; // gnssFixOK
+    p[23] = numSV;
+    put(p, 24, lon, 4);
+    put(p, 28, lat, 4);
+    put(p, 32, height, 4);
+    put(p, 36, hMSL, 4);
+    put(p, 40, 1500, 4); // hAcc [mm]
+    put(p, 44, 2500, 4); // vAcc [mm]
+    addFrame(UBX_CLASS_NAV, UBX_NAV_PVT, p);
+  }
+
+  // numSvs機の衛星。gnssIdは順に回す
+  void addNavSat(uint32_t iTOW, uint8_t numSvs)
+  {
+    std::vector<uint8_t> p(8 + 12 * numSvs, 0);
+    put(p, 0, iTOW, 4);
+    p[4] = 1;
+    p[5] = numSvs;
+    static const uint8_t gnss[] = {0, 2, 3, 5, 6};
+    for (uint8_t i = 0; i < numSvs; i++)
+    {
+      uint8_t *b = &p[8 + 12 * i];
+      b[0] = gnss[i % sizeof(gnss)];
+      b[1] = 1 + i;
+      b[2] = 20 + i % 30;
+      b[3] = 10 + i;
+      b[4] = (i * 37) & 0xff;
+      b[8] = 0x0f; // qualityInd 7, svUsed
+    }
+    addFrame(UBX_CLASS_NAV, UBX_NAV_SAT, p);
+  }
+
+  void addSfrbx(uint8_t gnssId, uint8_t svId, const uint32_t *dwrd, uint8_t numWords)
+  {
+    std::vector<uint8_t> p(8 + 4 * numWords, 0);
+    p[0] = gnssId;
+    p[1] = svId;
+    p[4] = numWords;
+    p[6] = 2;
+    for (uint8_t i = 0; i < numWords; i++)
+    {
+      put(p, 8 + 4 * i, dwrd[i], 4);
+    }
+    addFrame(UBX_CLASS_RXM, UBX_RXM_SFRBX, p);
+  }
+
+  // QZSS L1Sの250bitのフレーム。contentが同じなら同じメッセージとして扱われる
+  void addL1s(uint8_t svId, uint8_t preamble, uint8_t mt, uint32_t content)
+  {
+    uint32_t dwrd[QZSS_L1S_WORDS];
+    makeL1s(dwrd, preamble, mt, content);
+    addSfrbx(5, svId, dwrd, QZSS_L1S_WORDS);
+  }
+
+  void addTimTp(uint32_t towMS, int32_t qErr)
+  {
+    std::vector<uint8_t> p(UBX_TIM_TP_LEN, 0);
+    put(p, 0, towMS, 4);
+    put(p, 8, (uint32_t)qErr, 4);
+    p[14] = 0x01; // timeBase GNSS
+    addFrame(UBX_CLASS_TIM, UBX_TIM_TP, p);
+  }
+
+  static void makeL1s(uint32_t *dwrd, uint8_t preamble, uint8_t mt, uint32_t content)
+  {
+    uint8_t data[QZSS_L1S_WORDS * 4] = {};
+    data[0] = preamble;
+    data[1] = (mt << 2) | (content & 0x03);
+    uint32_t x = content * 2654435761UL + 1;
+    for (uint8_t i = 2; i < 29; i++)
+    {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      data[i] = x & 0xff;
+    }
+    // CRCの代わりにプリアンブルに依存するバイトを入れる (重複判定に含まれないこと)
+    data[28] = (data[28] & 0xc0) | (preamble & 0x3f);
+    data[29] = preamble;
+    data[30] = ~preamble;
+    for (uint8_t i = 0; i < QZSS_L1S_WORDS; i++)
+    {
+      dwrd[i] = (uint32_t)data[4 * i] << 24 | (uint32_t)data[4 * i + 1] << 16 | (uint32_t)data[4 * i + 2] << 8 | data[4 * i + 3];
+    }
+  }
+
+private:
+  static void put(std::vector<uint8_t> &p, size_t offset, uint32_t value, uint8_t size)
+  {
+    for (uint8_t i = 0; i < size; i++)
+    {
+      p[offset + i] = (value >> (8 * i)) & 0xff;
+    }
+  }
+};
+
+inline uint32_t ubxU4(const uint8_t *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+inline uint16_t ubxU2(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+// 完成したフレームを構造体に展開してコールバックを呼び、種類を返す。対象外ならGPS_MSG_TYPE_COUNT
+inline GpsMessageType ubxDispatch(GpsClient &gps, const uint8_t *frame, uint16_t length)
+{
+  static UBX_NAV_PVT_data_t pvt;
+  static UBX_NAV_SAT_data_t sat;
+  static UBX_RXM_SFRBX_data_t sfrbx;
+  static UBX_TIM_TP_data_t tp;
+  const uint8_t *p = &frame[6];
+  uint16_t payload = length - UBX_FRAME_OVERHEAD;
+
+  if (frame[2] == UBX_CLASS_NAV && frame[3] == UBX_NAV_PVT && payload == UBX_NAV_PVT_LEN)
+  {
+    memset(&pvt, 0, sizeof(pvt));
+    pvt.iTOW = ubxU4(&p[0]);
+    pvt.year = ubxU2(&p[4]);
+    pvt.month = p[6];
+    pvt.day = p[7];
+    pvt.hour = p[8];
+    pvt.min = p[9];
+    pvt.sec = p[10];
+    pvt.valid.all = p[11];
+    pvt.fixType = p[20];
+    pvt.flags.all = p[21];
+    pvt.numSV = p[23];
+    pvt.lon = (int32_t)ubxU4(&p[24]);
+    pvt.lat = (int32_t)ubxU4(&p[28]);
+    pvt.height = (int32_t)ubxU4(&p[32]);
+    pvt.hMSL = (int32_t)ubxU4(&p[36]);
+    pvt.hAcc = ubxU4(&p[40]);
+    pvt.vAcc = ubxU4(&p[44]);
+    gps.getPVTdata(&pvt);
+    return GPS_MSG_NAV_PVT;
+  }
+  if (frame[2] == UBX_CLASS_NAV && frame[3] == UBX_NAV_SAT && payload >= 8)
+  {
+    sat.header.iTOW = ubxU4(&p[0]);
+    sat.header.version = p[4];
+    sat.header.numSvs = min(p[5], (payload - 8) / 12);
+    for (uint16_t i = 0; i < sat.header.numSvs; i++)
+    {
+      const uint8_t *b = &p[8 + 12 * i];
+      sat.blocks[i].gnssId = b[0];
+      sat.blocks[i].svId = b[1];
+      sat.blocks[i].cno = b[2];
+      sat.blocks[i].elev = (int8_t)b[3];
+      sat.blocks[i].azim = (int16_t)ubxU2(&b[4]);
+      sat.blocks[i].prRes = (int16_t)ubxU2(&b[6]);
+      sat.blocks[i].flags.all = ubxU4(&b[8]);
+    }
+    gps.newNAVSAT(&sat);
+    return GPS_MSG_NAV_SAT;
+  }
+  if (frame[2] == UBX_CLASS_RXM && frame[3] == UBX_RXM_SFRBX && payload >= 8)
+  {
+    sfrbx.gnssId = p[0];
+    sfrbx.svId = p[1];
+    sfrbx.freqId = p[3];
+    sfrbx.numWords = min(min(p[4], (payload - 8) / 4), UBX_RXM_SFRBX_MAX_WORDS);
+    sfrbx.version = p[6];
+    for (uint8_t i = 0; i < sfrbx.numWords; i++)
+    {
+      sfrbx.dwrd[i] = ubxU4(&p[8 + 4 * i]);
+    }
+    gps.newSFRBX(&sfrbx);
+    return GPS_MSG_RXM_SFRBX;
+  }
+  if (frame[2] == UBX_CLASS_TIM && frame[3] == UBX_TIM_TP && payload == UBX_TIM_TP_LEN)
+  {
+    tp.towMS = ubxU4(&p[0]);
+    tp.towSubMS = ubxU4(&p[4]);
+    tp.qErr = (int32_t)ubxU4(&p[8]);
+    tp.week = ubxU2(&p[12]);
+    tp.flags.all = p[14];
+    gps.newTIMTP(&tp);
+    return GPS_MSG_TIM_TP;
+  }
+  return GPS_MSG_TYPE_COUNT;
+}
+
+#endif // HOST_UBX_LOG_H
@@ -0,0 +1,66 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+// [env:native] 用のTwoWire
+// 送ったバイト (アドレスを除く) と送信 (START..STOP) の数を数え、onTransmission があれば送信ごとに中身を渡す。
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+
+#define WIRE_BUFFER_SIZE 256 // arduino-picoと同じ
+
+class TwoWire
+{
+public:
+  std::function<void(uint8_t address, const uint8_t *data, size_t length)> onTransmission;
+  uint32_t clock = 100000;
+  uint32_t transmissions = 0;
+  uint32_t bytes = 0;
+
+  void begin() {}
+  void setClock(uint32_t hz) { clock = hz; }
+  void beginTransmission(uint8_t address)
+  {
+    address_ = address;
+    buffer_.clear();
+  }
+  size_t write(uint8_t data)
+  {
+    if (buffer_.size() >= WIRE_BUFFER_SIZE)
+    {
+      return 0;
+    }
+    buffer_.push_back(data);
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t length)
+  {
+    size_t n = 0;
+    while (n < length && write(data[n]))
+    {
+      n++;
+    }
+    return n;
+  }
+  uint8_t endTransmission(bool stop = true)
+  {
+    (void)stop;
+    transmissions++;
+    bytes += buffer_.size();
+    if (onTransmission)
+    {
+      onTransmission(address_, buffer_.data(), buffer_.size());
+    }
+    return 0;
+  }
+
+private:
+  uint8_t address_ = 0;
+  std::vector<uint8_t> buffer_;
+};
+
+inline TwoWire Wire;
+inline TwoWire Wire1;
+
+#endif // HOST_WIRE_H
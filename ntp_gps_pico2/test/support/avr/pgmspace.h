@@ -0,0 +1,13 @@
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+// [env:native] 用。ホストではフラッシュとRAMを区別しない
+
+#include <string.h>
+#include <stdint.h>
+
+#define PROGMEM
+#define memcpy_P memcpy
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+
+#endif // HOST_AVR_PGMSPACE_H
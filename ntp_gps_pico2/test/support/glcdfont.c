@@ -0,0 +1,271 @@
+// [env:native] 用の5x7フォント
+// Adafruit-GFXの glcdfont.c と同じ並び (256文字 x 5列、列の下位ビットが上) だが、形は疑似乱数で作ったもの。
+// テストは描き方の違う経路の結果を比べるだけなので、どのビットも使われるようにしてある。' ' だけは空白にする。
+
+#ifndef FONT5X7_H
+#define FONT5X7_H
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+
+static const unsigned char font[] PROGMEM = {
+    0x63, 0x7A, 0xA0, 0x7E, 0xE1,
+    0xEA, 0xF2, 0x3D, 0xC7, 0x39,
+    0x6D, 0x0D, 0xA6, 0x78, 0x16,
+    0x80, 0x05, 0x12, 0x3A, 0xA7,
+    0x4E, 0xDE, 0x9F, 0x78, 0x9C,
+    0x70, 0x63, 0x00, 0x0B, 0xE6,
+    0xC8, 0x25, 0x21, 0x3D, 0xAD,
+    0x22, 0xBC, 0x70, 0xB3, 0x85,
+    0xDA, 0x21, 0x23, 0x63, 0x36,
+    0x17, 0x7B, 0xC3, 0x79, 0xFD,
+    0x62, 0x6C, 0xF9, 0x66, 0x43,
+    0xF1, 0x1F, 0xBD, 0x61, 0x63,
+    0xBD, 0x7C, 0x99, 0x90, 0x67,
+    0xF3, 0xD1, 0x98, 0xF0, 0x8C,
+    0x88, 0xD3, 0x90, 0x34, 0x3F,
+    0x14, 0xD1, 0xAA, 0xFF, 0x72,
+    0x48, 0x27, 0x35, 0xF9, 0xDE,
+    0x34, 0x4E, 0xB0, 0x4A, 0x10,
+    0xD8, 0xD5, 0x83, 0x7E, 0x10,
+    0xA4, 0x57, 0x4D, 0xD7, 0x31,
+    0x39, 0x3C, 0x26, 0x9F, 0x56,
+    0x69, 0x48, 0x3B, 0x0D, 0x32,
+    0x34, 0xA7, 0x0C, 0x79, 0x3D,
+    0x1A, 0x24, 0x37, 0xBF, 0xC2,
+    0x8B, 0xD2, 0x16, 0x20, 0xCF,
+    0x84, 0x7C, 0xBE, 0xC6, 0xBA,
+    0xBB, 0xF4, 0x77, 0x3F, 0x32,
+    0x89, 0xC9, 0xBB, 0xAE, 0xED,
+    0x0B, 0x7D, 0x14, 0xA7, 0x1E,
+    0xE0, 0xED, 0x3C, 0x0F, 0x8F,
+    0x3E, 0xB7, 0x78, 0xB6, 0x7E,
+    0x23, 0x38, 0x04, 0x7C, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00,
+    0x4D, 0x4B, 0x54, 0x38, 0xBD,
+    0xCC, 0x3A, 0xF0, 0x63, 0x23,
+    0x20, 0xC6, 0x4B, 0x4B, 0xFB,
+    0xFF, 0xBD, 0x42, 0x33, 0x75,
+    0x5F, 0xFF, 0x20, 0xE5, 0x40,
+    0x6D, 0x89, 0x6F, 0xF6, 0x43,
+    0x77, 0xF8, 0xF4, 0x1F, 0x1E,
+    0x04, 0x87, 0xBA, 0x00, 0xE4,
+    0x21, 0x6E, 0x90, 0xF1, 0x46,
+    0xFD, 0xFD, 0x02, 0x47, 0x05,
+    0x2A, 0x17, 0x9E, 0x5F, 0xD9,
+    0x80, 0x78, 0x69, 0x83, 0x0A,
+    0x73, 0x67, 0xD2, 0x82, 0x9C,
+    0x0B, 0x03, 0xE3, 0xC0, 0xF4,
+    0x9D, 0x33, 0x74, 0xF1, 0x9F,
+    0x58, 0x1A, 0x8E, 0x02, 0x27,
+    0x78, 0x51, 0xB6, 0xEB, 0x45,
+    0x10, 0x6D, 0x4A, 0xAD, 0xFE,
+    0x90, 0x66, 0xC1, 0xE1, 0xE6,
+    0xBF, 0x8C, 0x9D, 0x9F, 0x30,
+    0xE8, 0xE4, 0x1A, 0xDC, 0x28,
+    0xB7, 0x40, 0xD7, 0xE3, 0x78,
+    0x2C, 0xCB, 0x8C, 0x01, 0x96,
+    0x34, 0x26, 0x51, 0xCB, 0x32,
+    0xAB, 0x0A, 0x18, 0x14, 0x3F,
+    0x03, 0xAD, 0x2E, 0x12, 0x58,
+    0x57, 0xD6, 0x7B, 0x4D, 0xDA,
+    0x20, 0xC6, 0xEE, 0xF2, 0x4F,
+    0xE2, 0x32, 0xE1, 0x2F, 0x21,
+    0x7A, 0x79, 0x04, 0x23, 0x65,
+    0x59, 0xC3, 0x27, 0x19, 0xA5,
+    0x14, 0x3F, 0x4E, 0x2F, 0x73,
+    0xA9, 0xE6, 0x5D, 0x22, 0x07,
+    0xC5, 0x1D, 0xBF, 0x1E, 0xB3,
+    0xD0, 0x2E, 0x12, 0x0A, 0x33,
+    0x3B, 0x66, 0x66, 0x47, 0xE7,
+    0x7D, 0xA4, 0x3B, 0xBD, 0x19,
+    0x43, 0xBD, 0xE0, 0x5B, 0x02,
+    0x14, 0x4C, 0x10, 0x96, 0xD5,
+    0xE4, 0x05, 0x23, 0x57, 0x10,
+    0x8A, 0x7B, 0xEA, 0xDA, 0x70,
+    0x66, 0x51, 0x22, 0xC7, 0x7A,
+    0xBD, 0x57, 0x66, 0xED, 0xDB,
+    0x6A, 0x81, 0x37, 0x07, 0x40,
+    0x35, 0x68, 0x62, 0xE3, 0x54,
+    0x33, 0x55, 0x93, 0x89, 0x99,
+    0x15, 0x43, 0x3D, 0x77, 0x50,
+    0x7E, 0xE9, 0x2C, 0x42, 0x6C,
+    0x4F, 0x63, 0xCE, 0x48, 0x4A,
+    0x99, 0x3A, 0x57, 0x1A, 0x56,
+    0x1F, 0x79, 0xF9, 0xB5, 0xAB,
+    0xC9, 0x2E, 0x6C, 0xCC, 0x04,
+    0xCB, 0x99, 0x3E, 0x50, 0x0D,
+    0x19, 0x4C, 0x1E, 0x4D, 0x32,
+    0x50, 0xB0, 0xB7, 0x68, 0xD7,
+    0x76, 0xCB, 0xB2, 0x4E, 0x60,
+    0x87, 0x73, 0xA0, 0xA3, 0xF3,
+    0x34, 0x81, 0x8A, 0x59, 0xE1,
+    0x21, 0x3F, 0x7C, 0x10, 0x2D,
+    0x2D, 0xAC, 0xDC, 0x16, 0xFB,
+    0xAC, 0xC8, 0x10, 0xEA, 0x12,
+    0x24, 0x18, 0xF6, 0x21, 0xB5,
+    0xEB, 0x01, 0xB2, 0xC0, 0xD3,
+    0x78, 0x2B, 0xA5, 0x86, 0x17,
+    0x0C, 0xB3, 0xC8, 0xBF, 0x61,
+    0x67, 0x27, 0x5B, 0x97, 0x3E,
+    0xE7, 0xFE, 0x21, 0x60, 0x61,
+    0x67, 0x6A, 0xBB, 0xA8, 0x8B,
+    0x92, 0xA7, 0x3A, 0x79, 0x9D,
+    0xEA, 0x70, 0x5E, 0x2A, 0x9D,
+    0x68, 0x86, 0xBE, 0x2E, 0x8D,
+    0x58, 0x56, 0xA5, 0x74, 0xBF,
+    0x7D, 0xE4, 0x76, 0xAA, 0xE3,
+    0x56, 0xFE, 0xBB, 0x5C, 0xD8,
+    0x9B, 0xAD, 0x5D, 0xBB, 0x9F,
+    0x2D, 0x9D, 0xB4, 0x55, 0x18,
+    0x49, 0xA2, 0x3D, 0x19, 0x63,
+    0x4F, 0x27, 0xD5, 0x60, 0xCF,
+    0x83, 0xBC, 0xFB, 0xEF, 0x79,
+    0x62, 0x24, 0x1A, 0xA2, 0xBC,
+    0x41, 0x04, 0x77, 0x53, 0xBC,
+    0x79, 0xD3, 0x8B, 0x1A, 0x4A,
+    0xB5, 0xC0, 0xFB, 0x9E, 0x02,
+    0x48, 0xF4, 0x45, 0x35, 0xEA,
+    0x56, 0x5D, 0x70, 0x93, 0x5F,
+    0xA7, 0xD4, 0xFE, 0x3A, 0x6F,
+    0xD6, 0x7B, 0x03, 0x22, 0x1E,
+    0x25, 0x0E, 0xC8, 0x2A, 0x24,
+    0x66, 0x52, 0x55, 0x5B, 0x5A,
+    0x52, 0xF3, 0xE7, 0x51, 0xAD,
+    0x58, 0xE5, 0x24, 0x31, 0xE9,
+    0x7D, 0xF1, 0x75, 0x81, 0x98,
+    0x58, 0xD1, 0x52, 0x11, 0x6A,
+    0xA4, 0xBB, 0xA8, 0x95, 0x30,
+    0x62, 0x3A, 0x49, 0xA3, 0x37,
+    0x86, 0x76, 0xA8, 0xEF, 0xEC,
+    0x9C, 0xFE, 0xAA, 0x63, 0xE5,
+    0x43, 0x64, 0xB9, 0x93, 0x2C,
+    0xF2, 0x7C, 0xAB, 0x20, 0x64,
+    0x61, 0x39, 0xD2, 0x0E, 0xC1,
+    0xE2, 0x4F, 0xD6, 0xB3, 0xAC,
+    0xAE, 0x85, 0xF4, 0xDF, 0x98,
+    0x7D, 0xBE, 0x61, 0x59, 0xA7,
+    0x5C, 0xD0, 0x9A, 0xC3, 0x95,
+    0xD8, 0x17, 0x78, 0x82, 0xF8,
+    0x40, 0x0F, 0x74, 0x6A, 0x49,
+    0x2E, 0x8A, 0x07, 0xAB, 0x5D,
+    0xDE, 0x8B, 0xB7, 0x36, 0xBB,
+    0x00, 0x0B, 0x73, 0x33, 0x8F,
+    0xFF, 0x7B, 0x70, 0x58, 0x13,
+    0x8C, 0xF8, 0x2C, 0xED, 0x54,
+    0x89, 0xCB, 0x67, 0x95, 0x0F,
+    0x7F, 0xD1, 0x21, 0xAA, 0x97,
+    0xAA, 0xC1, 0x12, 0xEF, 0xCF,
+    0xB7, 0xEC, 0xE6, 0xA0, 0x55,
+    0x4C, 0x13, 0x54, 0x34, 0xA7,
+    0xB9, 0x76, 0x1C, 0x16, 0x69,
+    0x76, 0x12, 0xFB, 0xE5, 0x6C,
+    0xCE, 0xD2, 0x60, 0x6B, 0x07,
+    0x4F, 0x70, 0x0A, 0x44, 0xD8,
+    0xF2, 0x66, 0x72, 0x90, 0x36,
+    0x15, 0xE2, 0xC2, 0x3C, 0x94,
+    0x04, 0x4C, 0x8D, 0x06, 0xFF,
+    0x14, 0xF7, 0xAA, 0x3A, 0xCB,
+    0x97, 0x4D, 0x67, 0xB0, 0x35,
+    0x03, 0xE1, 0x18, 0xEF, 0x35,
+    0x83, 0x33, 0xEE, 0x0F, 0x99,
+    0x21, 0x69, 0xFA, 0xDE, 0x39,
+    0x9E, 0x9F, 0x7C, 0x17, 0x67,
+    0x95, 0x68, 0xEA, 0x07, 0xD3,
+    0xA3, 0x5B, 0xE7, 0x04, 0x7B,
+    0x42, 0x58, 0xFF, 0x48, 0xEA,
+    0x24, 0x4F, 0xE7, 0x61, 0xE5,
+    0xC7, 0x45, 0x2B, 0xE2, 0xEF,
+    0xF7, 0xF5, 0x2A, 0xE2, 0x80,
+    0x9C, 0x89, 0x9A, 0x8B, 0xB0,
+    0xA1, 0xC9, 0x17, 0x27, 0xAB,
+    0x8A, 0x12, 0xAD, 0x97, 0x80,
+    0xFA, 0x24, 0x5B, 0xC2, 0x0B,
+    0x46, 0x13, 0xA0, 0x22, 0x97,
+    0xEA, 0x26, 0x8B, 0xC4, 0x10,
+    0x33, 0xE1, 0x43, 0xF6, 0x0C,
+    0x54, 0x88, 0xA7, 0x39, 0x03,
+    0xED, 0x6C, 0x55, 0x86, 0xA6,
+    0x18, 0x3C, 0x38, 0x3D, 0xB3,
+    0x2A, 0x27, 0x34, 0x99, 0xFB,
+    0x1B, 0x69, 0xB8, 0x8C, 0x4B,
+    0x2E, 0xFD, 0xBD, 0x38, 0x01,
+    0xFE, 0x83, 0x23, 0x60, 0xB3,
+    0x07, 0x7C, 0x2E, 0xA5, 0x83,
+    0x62, 0x55, 0x58, 0xA7, 0xB7,
+    0x76, 0x69, 0x7C, 0x4A, 0xA6,
+    0x5F, 0x28, 0x6C, 0x18, 0x1A,
+    0x5A, 0x98, 0xA8, 0x9D, 0x32,
+    0xD5, 0x15, 0x27, 0x27, 0x63,
+    0x94, 0x86, 0xB0, 0x4D, 0x49,
+    0xDF, 0xF7, 0x2A, 0xFC, 0xF8,
+    0xFB, 0xBD, 0xD2, 0x79, 0x42,
+    0x5E, 0xC8, 0x9E, 0x41, 0x65,
+    0xF6, 0xCE, 0xD2, 0x93, 0xC1,
+    0x37, 0xE5, 0x66, 0x0F, 0xF9,
+    0xC3, 0xFF, 0x05, 0x0F, 0xBB,
+    0x00, 0x96, 0xE1, 0xA5, 0xFD,
+    0x23, 0x03, 0x0C, 0xC8, 0x11,
+    0x2A, 0x9F, 0x4C, 0xD2, 0x7B,
+    0xC3, 0xE5, 0xC8, 0x89, 0x4C,
+    0xDE, 0xA9, 0xCD, 0xE0, 0xCA,
+    0xC1, 0x3C, 0x50, 0xCF, 0x6C,
+    0x4B, 0xCF, 0xD0, 0xE9, 0x8D,
+    0x29, 0x4F, 0x4F, 0x7C, 0xF7,
+    0x58, 0xF5, 0xFF, 0x83, 0xD1,
+    0xFC, 0xB4, 0x55, 0x20, 0xD3,
+    0x88, 0xF5, 0x43, 0x0D, 0xEB,
+    0x6F, 0x47, 0xC9, 0x27, 0x10,
+    0x9F, 0xF1, 0x05, 0x5D, 0x58,
+    0x4C, 0x9A, 0xDB, 0x36, 0xE3,
+    0x60, 0xEB, 0x2B, 0x5C, 0x82,
+    0x93, 0xDE, 0xBB, 0xFE, 0x88,
+    0x82, 0x6A, 0x4E, 0x00, 0xCB,
+    0x8B, 0x71, 0xFD, 0xAD, 0x44,
+    0x53, 0x25, 0xD2, 0xD7, 0x93,
+    0xBD, 0x76, 0x50, 0x06, 0x1C,
+    0xAF, 0x73, 0x14, 0x65, 0x04,
+    0x2A, 0xE7, 0x78, 0xB2, 0x33,
+    0x4C, 0x79, 0x0F, 0xDD, 0x51,
+    0x69, 0x79, 0x36, 0x16, 0x38,
+    0x2B, 0xCC, 0xDB, 0xAC, 0xEC,
+    0xA3, 0x4B, 0x26, 0xD7, 0xC5,
+    0xA0, 0x42, 0xBC, 0x45, 0x38,
+    0x05, 0x4F, 0x62, 0xE8, 0x3E,
+    0x7E, 0xD3, 0x94, 0xC0, 0x66,
+    0xEC, 0x42, 0xA7, 0xB6, 0xD7,
+    0xDB, 0xB4, 0x81, 0xEF, 0xA4,
+    0xC0, 0xD2, 0x05, 0xF0, 0xB2,
+    0xB1, 0xD1, 0xF2, 0x7F, 0xB4,
+    0x5B, 0x59, 0x64, 0x04, 0x96,
+    0x12, 0x0B, 0xA8, 0x6D, 0x1E,
+    0x3A, 0xA3, 0xC4, 0xCE, 0x6F,
+    0x6E, 0x91, 0xBB, 0x21, 0xD7,
+    0x0D, 0x12, 0x63, 0x4C, 0x0D,
+    0x19, 0x36, 0xC0, 0xDB, 0x90,
+    0xF9, 0xBB, 0x1D, 0xBE, 0x67,
+    0x79, 0xBD, 0x09, 0x10, 0xBF,
+    0x32, 0x54, 0xA1, 0x2E, 0x70,
+    0xE7, 0x63, 0x18, 0xBD, 0xDD,
+    0x2D, 0xE5, 0x75, 0x87, 0xE1,
+    0x41, 0xA9, 0x33, 0xF6, 0x67,
+    0xC6, 0x91, 0xDC, 0xD9, 0xC5,
+    0xDE, 0xAC, 0x56, 0x8E, 0x18,
+    0xC0, 0x4E, 0xD9, 0x93, 0x56,
+    0xD4, 0xC4, 0xF0, 0x38, 0x14,
+    0xD8, 0xDA, 0xB6, 0xA3, 0x34,
+    0x76, 0xEE, 0xC1, 0x00, 0x5F,
+    0xE3, 0x32, 0x2E, 0x8F, 0x2B,
+    0xF3, 0x37, 0xB3, 0x6D, 0x00,
+    0x3B, 0xF0, 0x1D, 0x5E, 0x3B,
+    0xAB, 0x39, 0xC8, 0x06, 0x90,
+    0x76, 0x14, 0xA4, 0x87, 0x88,
+    0xBF, 0x16, 0xBE, 0xC7, 0xF3,
+    0x17, 0xB5, 0x78, 0x78, 0x93,
+    0x95, 0xD8, 0xDC, 0xFB, 0x3C,
+    0x9E, 0x29, 0x8D, 0x09, 0xF6,
+    0x22, 0x4D, 0x0D, 0xFA, 0x6D
+};
+
+#endif // FONT5X7_H
@@ -0,0 +1,8 @@
+#ifndef HOST_PICO_TIME_H
+#define HOST_PICO_TIME_H
+
+#include <Arduino.h>
+
+inline uint64_t time_us_64() { return hostClockMicros; }
+
+#endif // HOST_PICO_TIME_H
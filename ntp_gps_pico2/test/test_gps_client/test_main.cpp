@@ -0,0 +1,334 @@
+// GpsClientにUBXのログを流し、GpsSummaryDataとQZSSの重複除去、コールバックの処理時間を確かめる
+// ログは合成する。1秒ごとにNAV-PVT, NAV-SAT(40機), TIM-TP, GPSのSFRBX 2つ, QZSS 4機のL1S(SFRBX)を含む。
+// L1Sは4秒ごとにMT43 (DC Report, 1分ごとに内容が変わる)、2秒ずれてMT44 (DCX, 2分ごと)、それ以外はMT47。
+// test/logs/*.ubx (受信機のUART出力をそのまま保存したもの。u-centerの.ubxと同じ形式) も同じ経路で再生する。
+// synthetic_l1s_120s.ubx はUbxLogで作ったもの (NMEAのGGAを挟み、L1Sのプリアンブルを実機と同じように回す)。
+
+#include <unity.h>
+#include <Mock_Stream.h>
+#include <Ubx_Log.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#define LOG_SECONDS 600
+#define LOG_NAV_SAT_SVS 40
+#define LOG_QZSS_SVS 4
+#define LOG_MAX_CHUNK 64
+
+static const uint8_t qzssSvIds[LOG_QZSS_SVS] = {1, 2, 3, 7}; // u-bloxのsvId (PRN 193..)
+static const uint8_t preambles[] = {0x53, 0x9A, 0xC6};
+
+struct Replay
+{
+  MockStream stream;
+  std::unique_ptr<GpsClient> gps;
+  UbxFrameParser parser;
+  uint32_t logFrames = 0;
+  uint32_t dispatched[GPS_MSG_TYPE_COUNT + 1] = {};
+  uint32_t mt43Frames = 0;
+  uint32_t mt44Frames = 0;
+  uint32_t timePulses = 0;
+  TimePulseReport lastPulse = {};
+  double elapsedNs = 0;
+};
+
+static uint32_t rng = 2463534242UL;
+static uint32_t nextRandom()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static void buildSecond(UbxLog &log, Replay &replay, uint32_t second)
+{
+  uint32_t t = 12 * 3600 + second; // 2026-10-16 12:00:00 UTCから
+  uint32_t iTOW = (4 * 86400 + t) * 1000;
+  log.addNavPvt(iTOW, 2026, 10, 16, t / 3600, t / 60 % 60, t % 60, 3, 24,
+                356812345 + second, 1397654321 - second, 45000, 8000);
+  log.addNavSat(iTOW, LOG_NAV_SAT_SVS);
+  log.addTimTp(iTOW + 1000, (int32_t)(second * 997 % 4000) - 2000);
+
+  uint32_t gps[10];
+  for (uint8_t i = 0; i < 10; i++)
+  {
+    gps[i] = nextRandom();
+  }
+  log.addSfrbx(0, 1 + second % 32, gps, 10);
+  log.addSfrbx(0, 1 + (second + 7) % 32, gps, 10);
+
+  for (uint8_t i = 0; i < LOG_QZSS_SVS; i++)
+  {
+    uint8_t preamble = preambles[(second + i) % 3];
+    if (second % 4 == 0)
+    {
+      log.addL1s(qzssSvIds[i], preamble, QZSS_MT_DC_REPORT, second / 60);
+      replay.mt43Frames++;
+    }
+    else if (second % 4 == 2)
+    {
+      log.addL1s(qzssSvIds[i], preamble, QZSS_MT_DCX, 1000 + second / 120);
+      replay.mt44Frames++;
+    }
+    else
+    {
+      log.addL1s(qzssSvIds[i], preamble, 47, second);
+    }
+  }
+}
+
+// UARTから細切れに届いたバイトをパーサに渡し、完成したフレームごとにコールバックとprocessQzss()を呼ぶ
+static void feed(Replay &replay)
+{
+  uint8_t chunk[LOG_MAX_CHUNK];
+  size_t n;
+  while ((n = replay.stream.readBytes(chunk, 1 + nextRandom() % LOG_MAX_CHUNK)) > 0)
+  {
+    size_t used = 0;
+    while (used < n || replay.parser.ready())
+    {
+      used += replay.parser.consume(&chunk[used], n - used);
+      if (!replay.parser.ready())
+      {
+        continue;
+      }
+      GpsMessageType type = ubxDispatch(*replay.gps, replay.parser.frame(), replay.parser.length());
+      replay.dispatched[type]++;
+      replay.parser.release();
+      replay.gps->processQzss();
+    }
+  }
+}
+
+static Replay &runReplay()
+{
+  static Replay replay;
+  if (replay.gps)
+  {
+    return replay;
+  }
+  replay.gps.reset(new GpsClient(replay.stream));
+  for (uint32_t second = 0; second < LOG_SECONDS; second++)
+  {
+    UbxLog log;
+    buildSecond(log, replay, second);
+    replay.logFrames += log.frames;
+    replay.stream.feed(log.bytes);
+
+    hostClockMicros = 1000000ULL * (second + 1) + 30000;
+    auto start = std::chrono::steady_clock::now();
+    feed(replay);
+    replay.elapsedNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    // core0がPPSエッジごとにTIM-TPを取り出す
+    TimePulseReport report;
+    while (replay.gps->popTimePulse(report))
+    {
+      replay.lastPulse = report;
+      replay.timePulses++;
+    }
+  }
+  return replay;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_every_frame_is_parsed(void)
+{
+  Replay &replay = runReplay();
+  TEST_ASSERT_EQUAL_UINT32(replay.logFrames, replay.parser.getFrames());
+  TEST_ASSERT_EQUAL_UINT32(0, replay.parser.getChecksumErrors());
+  TEST_ASSERT_EQUAL_UINT32(0, replay.parser.getDiscarded());
+  TEST_ASSERT_EQUAL_UINT32(0, replay.dispatched[GPS_MSG_TYPE_COUNT]);
+  TEST_ASSERT_EQUAL_UINT32(LOG_SECONDS, replay.dispatched[GPS_MSG_NAV_PVT]);
+  TEST_ASSERT_EQUAL_UINT32(LOG_SECONDS, replay.dispatched[GPS_MSG_NAV_SAT]);
+  TEST_ASSERT_EQUAL_UINT32(LOG_SECONDS * (2 + LOG_QZSS_SVS), replay.dispatched[GPS_MSG_RXM_SFRBX]);
+  TEST_ASSERT_EQUAL_UINT32(LOG_SECONDS, replay.timePulses);
+}
+
+void test_summary_matches_last_nav_pvt(void)
+{
+  Replay &replay = runReplay();
+  TEST_ASSERT_TRUE(replay.gps->refreshGpsSummaryData());
+  const GpsSummaryData &summary = replay.gps->getGpsSummaryData();
+  uint32_t t = 12 * 3600 + LOG_SECONDS - 1;
+  TEST_ASSERT_EQUAL_UINT16(2026, summary.year);
+  TEST_ASSERT_EQUAL_UINT8(10, summary.month);
+  TEST_ASSERT_EQUAL_UINT8(16, summary.day);
+  TEST_ASSERT_EQUAL_UINT8(t / 3600, summary.hour);
+  TEST_ASSERT_EQUAL_UINT8(t / 60 % 60, summary.min);
+  TEST_ASSERT_EQUAL_UINT8(t % 60, summary.sec);
+  TEST_ASSERT_TRUE(summary.timeValid);
+  TEST_ASSERT_TRUE(summary.dateValid);
+  TEST_ASSERT_EQUAL_UINT8(3, summary.fixType);
+  TEST_ASSERT_EQUAL_UINT8(24, summary.SIV);
+  TEST_ASSERT_EQUAL_INT32(356812345 + LOG_SECONDS - 1, summary.latitude);
+  TEST_ASSERT_EQUAL_INT32(1397654321 - (LOG_SECONDS - 1), summary.longitude);
+  TEST_ASSERT_EQUAL_INT32(8000, summary.altitude);
+  TEST_ASSERT_EQUAL_UINT64(1000000ULL * LOG_SECONDS + 30000, summary.receivedMicros);
+
+  TEST_ASSERT_TRUE(replay.gps->refreshNavSatData());
+  const UBX_NAV_SAT_data_t &sat = replay.gps->getNavSatData();
+  TEST_ASSERT_EQUAL_UINT8(LOG_NAV_SAT_SVS, sat.header.numSvs);
+  TEST_ASSERT_EQUAL_UINT8(LOG_NAV_SAT_SVS, sat.blocks[LOG_NAV_SAT_SVS - 1].svId);
+
+  TEST_ASSERT_EQUAL_UINT32((4 * 86400 + t) * 1000 + 1000, replay.lastPulse.towMS);
+  TEST_ASSERT_TRUE(replay.lastPulse.qErrValid);
+}
+
+void test_qzss_duplicates_are_dropped(void)
+{
+  Replay &replay = runReplay();
+  const QzssDecoder &qzss = replay.gps->getQzss();
+  uint32_t dcReports = (LOG_SECONDS + 59) / 60;
+  uint32_t dcx = (LOG_SECONDS + 119) / 120;
+  TEST_ASSERT_EQUAL_UINT32(replay.mt43Frames, qzss.getFrameCount(QZSS_MT_DC_REPORT));
+  TEST_ASSERT_EQUAL_UINT32(replay.mt44Frames, qzss.getFrameCount(QZSS_MT_DCX));
+  TEST_ASSERT_EQUAL_UINT32(dcReports, qzss.getMessageCount(QZSS_MT_DC_REPORT));
+  TEST_ASSERT_EQUAL_UINT32(dcx, qzss.getMessageCount(QZSS_MT_DCX));
+  TEST_ASSERT_EQUAL_UINT32(replay.mt43Frames + replay.mt44Frames - dcReports - dcx, qzss.getDuplicateCount());
+  TEST_ASSERT_EQUAL_UINT32(0, qzss.getDroppedCount());
+  TEST_ASSERT_EQUAL_UINT32(dcReports + dcx, qzss.latestSequence());
+
+  // 最後のメッセージは540秒目に内容が変わったDC Report、その前は482秒目のDCX
+  QzssMessage message;
+  TEST_ASSERT_TRUE(qzss.read(qzss.latestSequence(), message));
+  TEST_ASSERT_EQUAL_UINT8(QZSS_MT_DC_REPORT, message.mt);
+  TEST_ASSERT_EQUAL_UINT8(qzssSvIds[0], message.svId);
+  TEST_ASSERT_EQUAL_STRING_LEN("DC Report 2026 ", message.summary, 15);
+  TEST_ASSERT_EQUAL_UINT32(1792152000UL + 540, message.unixTime); // 2026-10-16 12:09:00 UTC
+
+  TEST_ASSERT_TRUE(qzss.read(qzss.latestSequence() - 1, message));
+  TEST_ASSERT_EQUAL_UINT8(QZSS_MT_DCX, message.mt);
+  TEST_ASSERT_EQUAL_STRING_LEN("DCX ", message.summary, 4);
+  TEST_ASSERT_EQUAL_UINT32(1792152000UL + 482, message.unixTime);
+  TEST_ASSERT_NOT_NULL(strstr(replay.stream.output().c_str(), "43 DC Report svId: 1"));
+}
+
+void test_callback_cost(void)
+{
+  Replay &replay = runReplay();
+  uint32_t total = 0;
+  char line[128];
+  for (uint8_t type = 0; type < GPS_MSG_TYPE_COUNT; type++)
+  {
+    const GpsCallbackStats &stats = replay.gps->getCallbackStats((GpsMessageType)type);
+    TEST_ASSERT_EQUAL_UINT32(replay.dispatched[type], stats.count);
+    total += stats.count;
+    // ホストのgetCycleCount()はナノ秒を返す
+    snprintf(line, sizeof(line), "%-9s %6u callbacks, mean %7.1f ns, max %7u ns", gpsMessageName(type),
+             (unsigned)stats.count, stats.count ? (double)stats.cycles / stats.count : 0.0, (unsigned)stats.maxCycles);
+    TEST_MESSAGE(line);
+  }
+  double rate = total / (replay.elapsedNs / 1e9);
+  snprintf(line, sizeof(line), "replay: %u messages, %.0f messages/s (parser + callbacks + processQzss)",
+           (unsigned)total, rate);
+  TEST_MESSAGE(line);
+  // 受信機が送るのは毎秒数十メッセージなので、ホストで処理できないほど遅ければ何かがおかしい
+  TEST_ASSERT_TRUE(rate > 10000);
+}
+
+// 保存したログの中身は分からないので、ログを別に数えた結果とGpsClientの数が合うことを見る
+static void replayFile(const std::filesystem::path &path)
+{
+  std::ifstream in(path, std::ios::binary);
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  TEST_ASSERT_TRUE(bytes.size() > 0);
+
+  // ファイル全体を一度にパーサに渡して、種類ごとに数える
+  UbxFrameParser count;
+  uint32_t expected[GPS_MSG_TYPE_COUNT] = {};
+  uint32_t l1sFrames[2] = {};
+  for (size_t used = 0; used < bytes.size() || count.ready(); count.release())
+  {
+    used += count.consume(&bytes[used], bytes.size() - used);
+    if (!count.ready())
+    {
+      continue;
+    }
+    const uint8_t *frame = count.frame();
+    if (frame[2] == UBX_CLASS_NAV && frame[3] == UBX_NAV_PVT)
+    {
+      expected[GPS_MSG_NAV_PVT]++;
+    }
+    else if (frame[2] == UBX_CLASS_NAV && frame[3] == UBX_NAV_SAT)
+    {
+      expected[GPS_MSG_NAV_SAT]++;
+    }
+    else if (frame[2] == UBX_CLASS_RXM && frame[3] == UBX_RXM_SFRBX)
+    {
+      expected[GPS_MSG_RXM_SFRBX]++;
+      // L1Sの先頭のワードはプリアンブル8bit、メッセージタイプ6bitの順
+      uint8_t mt = frame[6 + 8 + 2] >> 2;
+      if (frame[6] == 5 && (mt == QZSS_MT_DC_REPORT || mt == QZSS_MT_DCX))
+      {
+        l1sFrames[mt - QZSS_MT_DC_REPORT]++;
+      }
+    }
+    else if (frame[2] == UBX_CLASS_TIM && frame[3] == UBX_TIM_TP)
+    {
+      expected[GPS_MSG_TIM_TP]++;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, count.getChecksumErrors());
+  TEST_ASSERT_TRUE(expected[GPS_MSG_NAV_PVT] > 0);
+
+  Replay replay;
+  replay.gps.reset(new GpsClient(replay.stream));
+  replay.stream.feed(bytes);
+  hostClockMicros = 1000000;
+  feed(replay);
+
+  for (uint8_t type = 0; type < GPS_MSG_TYPE_COUNT; type++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(expected[type], replay.dispatched[type]);
+    TEST_ASSERT_EQUAL_UINT32(expected[type], replay.gps->getCallbackStats((GpsMessageType)type).count);
+  }
+  TEST_ASSERT_TRUE(replay.gps->refreshGpsSummaryData());
+
+  const QzssDecoder &qzss = replay.gps->getQzss();
+  uint32_t frames = qzss.getFrameCount(QZSS_MT_DC_REPORT) + qzss.getFrameCount(QZSS_MT_DCX);
+  uint32_t messages = qzss.getMessageCount(QZSS_MT_DC_REPORT) + qzss.getMessageCount(QZSS_MT_DCX);
+  TEST_ASSERT_EQUAL_UINT32(l1sFrames[0], qzss.getFrameCount(QZSS_MT_DC_REPORT));
+  TEST_ASSERT_EQUAL_UINT32(l1sFrames[1], qzss.getFrameCount(QZSS_MT_DCX));
+  TEST_ASSERT_EQUAL_UINT32(0, qzss.getDroppedCount());
+  TEST_ASSERT_EQUAL_UINT32(frames, messages + qzss.getDuplicateCount());
+  TEST_ASSERT_EQUAL_UINT32(messages, qzss.latestSequence());
+
+  char line[160];
+  snprintf(line, sizeof(line), "%s: %u bytes, %u NAV-PVT, %u NAV-SAT, %u RXM-SFRBX, L1S %u frames -> %u messages",
+           path.filename().c_str(), (unsigned)bytes.size(), (unsigned)expected[GPS_MSG_NAV_PVT],
+           (unsigned)expected[GPS_MSG_NAV_SAT], (unsigned)expected[GPS_MSG_RXM_SFRBX], (unsigned)frames, (unsigned)messages);
+  TEST_MESSAGE(line);
+}
+
+void test_replay_logs(void)
+{
+  std::filesystem::path dir = std::filesystem::path(__FILE__).parent_path().parent_path() / "logs";
+  uint32_t files = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(dir))
+  {
+    if (entry.path().extension() == ".ubx")
+    {
+      replayFile(entry.path());
+      files++;
+    }
+  }
+  TEST_ASSERT_TRUE(files > 0);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_every_frame_is_parsed);
+  RUN_TEST(test_summary_matches_last_nav_pvt);
+  RUN_TEST(test_qzss_duplicates_are_dropped);
+  RUN_TEST(test_callback_cost);
+  RUN_TEST(test_replay_logs);
+  return UNITY_END();
+}
@@ -0,0 +1,353 @@
+// HttpRequestParserのファズテストとベンチマーク
+// 正しいリクエストをどこで分割しても同じ結果になること、壊れた入力でもバッファの外に触れず
+// 決まったステータスで止まること、解析中にヒープを一度も使わないことを確かめる。
+// operator new (glibcではmallocも) を置き換えて確保の回数を数える。
+
+#include <unity.h>
+#include <Http_Request_Parser.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <new>
+#include <vector>
+
+#define FUZZ_ITERATIONS 200000
+#define BENCH_REQUESTS 200000
+
+static volatile size_t allocations = 0;
+
+// 置き換えたoperator newはmallocで確保するので、freeで解放してよい
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t size)
+{
+  allocations++;
+  void *p = malloc(size);
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+extern "C" void *malloc(size_t size)
+{
+  allocations++;
+  return __libc_malloc(size);
+}
+extern "C" void *calloc(size_t count, size_t size)
+{
+  allocations++;
+  return __libc_calloc(count, size);
+}
+extern "C" void *realloc(void *p, size_t size)
+{
+  allocations++;
+  return __libc_realloc(p, size);
+}
+#endif
+
+static const char REQUEST[] =
+    "GET /api/status?since=42 HTTP/1.1\r\n"
+    "Host: ntp-gps.local\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: application/json\r\n"
+    "If-None-Match:  \"5f3a-12\" \t\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static uint32_t rng = 88172645UL;
+static uint32_t nextRandom()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// 1回の解析結果。分割の仕方によらず同じになるはず
+struct Outcome
+{
+  HttpParseResult result;
+  uint16_t status;
+  char path[HTTP_REQUEST_LINE_SIZE];
+  char query[HTTP_REQUEST_LINE_SIZE];
+  char etag[HTTP_ETAG_SIZE];
+};
+
+static void capture(const HttpRequestParser &parser, Outcome &outcome)
+{
+  outcome.result = parser.result();
+  outcome.status = parser.errorStatus();
+  snprintf(outcome.path, sizeof(outcome.path), "%s", parser.path());
+  snprintf(outcome.query, sizeof(outcome.query), "%s", parser.query());
+  snprintf(outcome.etag, sizeof(outcome.etag), "%s", parser.ifNoneMatch());
+}
+
+static void assertSame(const Outcome &expected, const Outcome &actual)
+{
+  TEST_ASSERT_EQUAL_INT(expected.result, actual.result);
+  TEST_ASSERT_EQUAL_UINT16(expected.status, actual.status);
+  TEST_ASSERT_EQUAL_STRING(expected.path, actual.path);
+  TEST_ASSERT_EQUAL_STRING(expected.query, actual.query);
+  TEST_ASSERT_EQUAL_STRING(expected.etag, actual.etag);
+}
+
+// 終わった後に続きを渡しても結果は変わらず、取り出せる値は常に範囲内にある
+static void assertInvariants(HttpRequestParser &parser)
+{
+  HttpParseResult result = parser.result();
+  TEST_ASSERT_TRUE(strlen(parser.path()) < HTTP_REQUEST_LINE_SIZE);
+  TEST_ASSERT_TRUE(strlen(parser.query()) < HTTP_REQUEST_LINE_SIZE);
+  TEST_ASSERT_TRUE(strlen(parser.ifNoneMatch()) < HTTP_ETAG_SIZE);
+  if (result == HTTP_PARSE_DONE)
+  {
+    TEST_ASSERT_EQUAL_INT(HTTP_METHOD_GET, parser.method());
+    TEST_ASSERT_EQUAL_INT('/', parser.path()[0]);
+    TEST_ASSERT_EQUAL_UINT16(0, parser.errorStatus());
+  }
+  else if (result == HTTP_PARSE_ERROR)
+  {
+    uint16_t status = parser.errorStatus();
+    TEST_ASSERT_TRUE(status == 400 || status == 405 || status == 414 || status == 431);
+  }
+  else
+  {
+    TEST_ASSERT_EQUAL_INT(HTTP_PARSE_INCOMPLETE, result);
+  }
+  if (result != HTTP_PARSE_INCOMPLETE)
+  {
+    TEST_ASSERT_EQUAL_INT(result, parser.feed((const uint8_t *)REQUEST, sizeof(REQUEST) - 1));
+  }
+}
+
+static HttpRequestParser parser;
+
+void setUp(void) { parser.reset(); }
+void tearDown(void) {}
+
+void test_request_is_parsed(void)
+{
+  TEST_ASSERT_EQUAL_INT(HTTP_PARSE_DONE, parser.feed((const uint8_t *)REQUEST, sizeof(REQUEST) - 1));
+  TEST_ASSERT_EQUAL_INT(HTTP_METHOD_GET, parser.method());
+  TEST_ASSERT_EQUAL_STRING("/api/status", parser.path());
+  TEST_ASSERT_EQUAL_STRING("since=42", parser.query());
+  TEST_ASSERT_EQUAL_STRING("\"5f3a-12\"", parser.ifNoneMatch());
+}
+
+// 2つに分けるすべての位置と、1バイトずつの場合
+void test_every_split_gives_the_same_result(void)
+{
+  const uint8_t *data = (const uint8_t *)REQUEST;
+  size_t size = sizeof(REQUEST) - 1;
+  Outcome expected, actual;
+  parser.feed(data, size);
+  capture(parser, expected);
+
+  for (size_t split = 0; split <= size; split++)
+  {
+    parser.reset();
+    parser.feed(data, split);
+    parser.feed(data + split, size - split);
+    capture(parser, actual);
+    assertSame(expected, actual);
+  }
+  parser.reset();
+  for (size_t i = 0; i < size; i++)
+  {
+    parser.feed(data + i, 1);
+  }
+  capture(parser, actual);
+  assertSame(expected, actual);
+}
+
+void test_limits_and_errors(void)
+{
+  char line[HTTP_REQUEST_LINE_SIZE + 32];
+  memset(line, 'a', sizeof(line));
+  memcpy(line, "GET /", 5);
+  TEST_ASSERT_EQUAL_INT(HTTP_PARSE_ERROR, parser.feed((const uint8_t *)line, sizeof(line)));
+  TEST_ASSERT_EQUAL_UINT16(414, parser.errorStatus());
+
+  parser.reset();
+  const char *post = "POST / HTTP/1.1\r\n\r\n";
+  TEST_ASSERT_EQUAL_INT(HTTP_PARSE_ERROR, parser.feed((const uint8_t *)post, strlen(post)));
+  TEST_ASSERT_EQUAL_UINT16(405, parser.errorStatus());
+
+  parser.reset();
+  const char *bad = "GET index.html HTTP/1.1\r\n\r\n";
+  TEST_ASSERT_EQUAL_INT(HTTP_PARSE_ERROR, parser.feed((const uint8_t *)bad, strlen(bad)));
+  TEST_ASSERT_EQUAL_UINT16(400, parser.errorStatus());
+
+  parser.reset();
+  const char *get = "GET / HTTP/1.0\r\n";
+  parser.feed((const uint8_t *)get, strlen(get));
+  char header[64];
+  memset(header, 'x', sizeof(header) - 2);
+  header[sizeof(header) - 2] = '\r';
+  header[sizeof(header) - 1] = '\n';
+  HttpParseResult result = HTTP_PARSE_INCOMPLETE;
+  for (int i = 0; i < 20 && result == HTTP_PARSE_INCOMPLETE; i++)
+  {
+    result = parser.feed((const uint8_t *)header, sizeof(header));
+  }
+  TEST_ASSERT_EQUAL_INT(HTTP_PARSE_ERROR, result);
+  TEST_ASSERT_EQUAL_UINT16(431, parser.errorStatus());
+
+  // 保持できない長さのIf-None-Matchは無視する
+  parser.reset();
+  char longEtag[160];
+  snprintf(longEtag, sizeof(longEtag), "GET / HTTP/1.1\r\nIf-None-Match: \"%0100d\"\r\n\r\n", 7);
+  TEST_ASSERT_EQUAL_INT(HTTP_PARSE_DONE, parser.feed((const uint8_t *)longEtag, strlen(longEtag)));
+  TEST_ASSERT_EQUAL_STRING("", parser.ifNoneMatch());
+}
+
+// 正しいリクエストを壊したものと、まったくの乱数の入力を、ランダムな大きさに分けて渡す
+void test_fuzz(void)
+{
+  static const char alphabet[] = "GET /?: \r\n\tHTTP/1.If-None-Match\"";
+  uint8_t input[2048];
+  HttpRequestParser whole;
+  Outcome expected, actual;
+  uint32_t results[3] = {};
+
+  for (uint32_t iteration = 0; iteration < FUZZ_ITERATIONS; iteration++)
+  {
+    size_t size;
+    uint32_t kind = nextRandom() % 4;
+    if (kind == 0)
+    {
+      size = nextRandom() % sizeof(input);
+      for (size_t i = 0; i < size; i++)
+      {
+        input[i] = nextRandom();
+      }
+    }
+    else if (kind == 1)
+    {
+      size = nextRandom() % sizeof(input);
+      for (size_t i = 0; i < size; i++)
+      {
+        input[i] = alphabet[nextRandom() % (sizeof(alphabet) - 1)];
+      }
+    }
+    else
+    {
+      size = sizeof(REQUEST) - 1;
+      memcpy(input, REQUEST, size);
+      for (uint32_t n = nextRandom() % 6; n > 0; n--)
+      {
+        size_t at = nextRandom() % size;
+        switch (nextRandom() % 4)
+        {
+        case 0: // ビット反転
+          input[at] ^= 1 << (nextRandom() % 8);
+          break;
+        case 1: // 挿入
+          if (size < sizeof(input))
+          {
+            memmove(&input[at + 1], &input[at], size - at);
+            input[at] = alphabet[nextRandom() % (sizeof(alphabet) - 1)];
+            size++;
+          }
+          break;
+        case 2: // 削除
+          memmove(&input[at], &input[at + 1], size - at - 1);
+          size--;
+          break;
+        default: // 同じ部分の繰り返し (長い行を作る)
+        {
+          size_t length = nextRandom() % 200;
+          length = length < sizeof(input) - size ? length : sizeof(input) - size;
+          memmove(&input[at + length], &input[at], size - at);
+          size += length;
+          break;
+        }
+        }
+      }
+    }
+
+    whole.reset();
+    whole.feed(input, size);
+    capture(whole, expected);
+    assertInvariants(whole);
+
+    parser.reset();
+    size_t offset = 0;
+    while (offset < size)
+    {
+      size_t chunk = 1 + nextRandom() % 96;
+      chunk = chunk < size - offset ? chunk : size - offset;
+      parser.feed(&input[offset], chunk);
+      offset += chunk;
+    }
+    capture(parser, actual);
+    assertSame(expected, actual);
+    results[expected.result]++;
+  }
+
+  char line[128];
+  snprintf(line, sizeof(line), "%u inputs: %u incomplete, %u done, %u error", FUZZ_ITERATIONS,
+           (unsigned)results[HTTP_PARSE_INCOMPLETE], (unsigned)results[HTTP_PARSE_DONE], (unsigned)results[HTTP_PARSE_ERROR]);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(results[HTTP_PARSE_DONE] > 0);
+  TEST_ASSERT_TRUE(results[HTTP_PARSE_ERROR] > 0);
+}
+
+// ブラウザ程度のリクエストをTCPのセグメントのように分けて渡し、確保の回数と処理時間を測る
+void test_zero_allocation_benchmark(void)
+{
+  const uint8_t *data = (const uint8_t *)REQUEST;
+  size_t size = sizeof(REQUEST) - 1;
+  size_t before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  uint32_t done = 0;
+  for (uint32_t i = 0; i < BENCH_REQUESTS; i++)
+  {
+    parser.reset();
+    size_t split = i % size;
+    parser.feed(data, split);
+    if (parser.feed(data + split, size - split) == HTTP_PARSE_DONE)
+    {
+      done++;
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  size_t used = allocations - before;
+
+  TEST_ASSERT_EQUAL_UINT32(BENCH_REQUESTS, done);
+  TEST_ASSERT_EQUAL_UINT32(0, used);
+
+  // 確保を数えていることを確かめる
+  before = allocations;
+  std::vector<uint8_t> probe(size);
+  TEST_ASSERT_TRUE(allocations - before >= 1);
+
+  char line[128];
+  snprintf(line, sizeof(line), "%u requests (%u bytes each): %.1f ns/request, %.0f MB/s, %u allocations",
+           BENCH_REQUESTS, (unsigned)size, ns / BENCH_REQUESTS, size * (double)BENCH_REQUESTS / ns * 1e3, (unsigned)used);
+  TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_request_is_parsed);
+  RUN_TEST(test_every_split_gives_the_same_result);
+  RUN_TEST(test_limits_and_errors);
+  RUN_TEST(test_fuzz);
+  RUN_TEST(test_zero_allocation_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,280 @@
+// /metricsの本文をMetricsWriterとResponseWriterで描画する時間を測る
+// main.cppのレジストリ (-DGNSS_TRANSPORT_UART の時) と同じ形 (ゲージ・カウンタ約60、衛星40機分のC/N0、ヒストグラム4つ) で
+// 16KB前後の本文を作り、描画バッファに余裕を残して収まること、書式が正しいこと、描画が1msに収まることを確かめる。
+// ホストの時間は実機 (RP2350) の時間ではない。実機ではhttp_metrics_render_secondsのヒストグラムで確かめる。
+
+#include <unity.h>
+#include <Metrics_Writer.h>
+#include <Response_Writer.h>
+#include <Gps_model.h>
+#include <chrono>
+#include <string>
+
+#define RENDER_ITERATIONS 2000
+#define RENDER_GOAL_US 1000
+#define SATELLITES 40
+
+// 送信されたバイトを残すだけのClient
+class MockClient : public Client
+{
+public:
+  std::string sent;
+
+  int connect(const char *, uint16_t) override { return 1; }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    sent.append((const char *)buffer, size);
+    return size;
+  }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int read(uint8_t *, size_t) override { return -1; }
+  int peek() override { return -1; }
+  void flush() override {}
+  void stop() override {}
+  uint8_t connected() override { return 1; }
+  operator bool() override { return true; }
+};
+
+static LatencyHistogram histograms[4];
+static uint8_t satGnss[SATELLITES];
+static uint8_t satSv[SATELLITES];
+static uint8_t satCno[SATELLITES];
+
+static void collectGauge(MetricsWriter &w, const char *name) { w.gauge(name, 123456L); }
+static void collectRatio(MetricsWriter &w, const char *name) { w.gauge(name, -3.6712345e-5, 12); }
+static void collectSeconds(MetricsWriter &w, const char *name) { w.gauge(name, 0.000123456); }
+static void collectCounter(MetricsWriter &w, const char *name) { w.counter(name, 4000000000UL); }
+static void collectTracked(MetricsWriter &w, const char *name)
+{
+  for (uint8_t id = 0; id < GNSS_ID_COUNT; id++)
+  {
+    w.sample(name).label("constellation", gnssIdToName(id)).value((long)id * 3);
+  }
+}
+static void collectCno(MetricsWriter &w, const char *name)
+{
+  for (uint8_t i = 0; i < SATELLITES; i++)
+  {
+    w.sample(name).label("constellation", gnssIdToName(satGnss[i])).label("sv", (long)satSv[i]).value((long)satCno[i]);
+  }
+}
+static void collectPerType(MetricsWriter &w, const char *name)
+{
+  static const char *types[] = {"NAV-PVT", "NAV-SAT", "RXM-SFRBX", "TIM-TP"};
+  for (const char *type : types)
+  {
+    w.sample(name, "_total").label("type", type).value(987654321UL);
+  }
+}
+static void collectHistogram0(MetricsWriter &w, const char *name) { w.histogram(name, histograms[0]); }
+static void collectHistogram1(MetricsWriter &w, const char *name) { w.histogram(name, histograms[1]); }
+static void collectHistogram2(MetricsWriter &w, const char *name) { w.histogram(name, histograms[2]); }
+static void collectHistogram3(MetricsWriter &w, const char *name) { w.histogram(name, histograms[3]); }
+
+#define GAUGE(name) {name, METRIC_GAUGE, "Gauge value from the registry", collectGauge}
+#define COUNTER(name) {name, METRIC_COUNTER, "Counter value from the registry", collectCounter}
+
+static const MetricFamily metrics[] = {
+    GAUGE("gnss_fix_type"),
+    GAUGE("gnss_satellites_used"),
+    COUNTER("gnss_uart_frames"),
+    COUNTER("gnss_uart_checksum_errors"),
+    COUNTER("gnss_uart_discarded_bytes"),
+    GAUGE("gnss_uart_ring_high_water_bytes"),
+    COUNTER("gnss_uart_overruns"),
+    COUNTER("gnss_uart_overrun_bytes"),
+    {"gnss_bus_bytes_per_second", METRIC_GAUGE, "Bytes sent by the receiver on the GNSS bus (UBX-MON-COMMS)", collectSeconds},
+    {"gnss_bus_boot_bytes_per_second", METRIC_GAUGE, "GNSS bus bytes per second at boot", collectSeconds},
+    GAUGE("gnss_profile_applied"),
+    {"gnss_ttff_seconds", METRIC_GAUGE, "Time from boot to the first GNSS fix", collectSeconds},
+    GAUGE("gnss_assist_flags"),
+    GAUGE("gnss_survey_state"),
+    GAUGE("gnss_survey_samples"),
+    {"gnss_survey_accuracy_meters", METRIC_GAUGE, "Estimated 3D accuracy of the surveyed position", collectSeconds},
+    {"gnss_satellites_tracked", METRIC_GAUGE, "Satellites reported by NAV-SAT per constellation", collectTracked},
+    {"gnss_sv_cno_dbhz", METRIC_GAUGE, "Carrier to noise ratio per satellite", collectCno},
+    {"gnss_snapshot_latency_seconds", METRIC_HISTOGRAM, "Time from NAV-PVT reception to core0 snapshot", collectHistogram0},
+    {"pps_interval_seconds", METRIC_GAUGE, "Interval between the last two PPS edges", collectSeconds},
+    {"pps_jitter_seconds", METRIC_GAUGE, "RMS of PPS offset differences", collectSeconds},
+    {"pps_offset_seconds", METRIC_GAUGE, "Clock offset at the last PPS edge", collectSeconds},
+    {"pps_frequency_ratio", METRIC_GAUGE, "Frequency correction of the local clock", collectRatio},
+    GAUGE("pps_clock_state"),
+    COUNTER("pps_edges"),
+    COUNTER("pps_missed"),
+    COUNTER("pps_outliers"),
+    COUNTER("pps_flash_skipped"),
+    COUNTER("pps_queue_overflows"),
+    GAUGE("pps_queue_depth"),
+    GAUGE("pps_queue_high_water"),
+    {"pps_qerr_seconds", METRIC_GAUGE, "Quantization error of the last PPS edge from UBX-TIM-TP", collectRatio},
+    COUNTER("pps_qerr_matched"),
+    COUNTER("pps_qerr_unmatched"),
+    GAUGE("pps_isr_max_cycles"),
+    GAUGE("pps_isr_last_cycles"),
+    {"rtc_temperature_celsius", METRIC_GAUGE, "DS3231 temperature", collectSeconds},
+    GAUGE("rtc_holdover_state"),
+    {"rtc_phase_seconds", METRIC_GAUGE, "RTC second boundary minus GNSS time", collectSeconds},
+    {"rtc_frequency_ratio", METRIC_GAUGE, "Learned RTC frequency error at the current temperature", collectRatio},
+    {"rtc_model_residual_ratio", METRIC_GAUGE, "RMS residual of the RTC temperature model", collectRatio},
+    GAUGE("rtc_model_points"),
+    {"rtc_holdover_error_seconds", METRIC_GAUGE, "Estimated time error while serving from the RTC", collectSeconds},
+    GAUGE("rtc_aging_offset"),
+    COUNTER("rtc_sets"),
+    GAUGE("ethernet_link_up"),
+    GAUGE("ethernet_dhcp_status"),
+    COUNTER("ntp_requests"),
+    COUNTER("ntp_dropped"),
+    COUNTER("ntp_holdover_replies"),
+    GAUGE("http_last_response_bytes"),
+    {"http_last_response_seconds", METRIC_GAUGE, "Time spent rendering the previous HTTP response", collectSeconds},
+    COUNTER("http_response_overflows"),
+    COUNTER("http_response_segments"),
+    COUNTER("http_send_timeouts"),
+    {"http_metrics_render_seconds", METRIC_HISTOGRAM, "Time to render the /metrics body (goal: under 1 ms)", collectHistogram1},
+    {"qzss_frames", METRIC_COUNTER, "QZSS L1S DC Report (MT43) and DCX (MT44) frames received", collectPerType},
+    {"qzss_messages", METRIC_COUNTER, "New QZSS messages decoded into the history", collectPerType},
+    COUNTER("qzss_duplicates"),
+    COUNTER("qzss_dropped"),
+    {"gnss_messages", METRIC_COUNTER, "UBX messages handled by GpsClient callbacks", collectPerType},
+    {"gnss_callback_cycles", METRIC_COUNTER, "CPU cycles spent in GpsClient callbacks on core1", collectPerType},
+    {"gnss_callback_max_cycles", METRIC_GAUGE, "Longest GpsClient callback in CPU cycles", collectPerType},
+    COUNTER("display_bytes_sent"),
+    {"display_flush_seconds", METRIC_HISTOGRAM, "Duration of one OLED frame flush", collectHistogram2},
+    COUNTER("display_flush_errors"),
+    {"loop_duration_seconds", METRIC_HISTOGRAM, "Duration of one core0 loop", collectHistogram3},
+};
+
+// WebServer::metricsPage()と同じ順に書く
+static void render(ResponseWriter &writer)
+{
+  writer.print("HTTP/1.1 200 OK\r\nContent-Type: " METRICS_CONTENT_TYPE "\r\nTransfer-Encoding: chunked\r\n\r\n");
+  writer.beginChunked();
+  MetricsWriter metricsWriter(writer);
+  for (const MetricFamily &metric : metrics)
+  {
+    metricsWriter.family(metric);
+  }
+  metricsWriter.end();
+  writer.end();
+}
+
+// チャンク転送を解いて本文を返す
+static std::string dechunk(const std::string &response)
+{
+  size_t pos = response.find("\r\n\r\n");
+  TEST_ASSERT_TRUE(pos != std::string::npos);
+  pos += 4;
+  std::string body;
+  for (;;)
+  {
+    size_t size = strtoul(response.c_str() + pos, NULL, 16);
+    pos = response.find("\r\n", pos) + 2;
+    if (size == 0)
+    {
+      break;
+    }
+    body.append(response, pos, size);
+    pos += size + 2;
+  }
+  return body;
+}
+
+void setUp(void)
+{
+  for (LatencyHistogram &histogram : histograms)
+  {
+    histogram = LatencyHistogram();
+  }
+  for (uint32_t i = 0; i < 5000; i++)
+  {
+    histograms[i % 4].record((i * 2654435761UL) % (1000u << (i % 4 * 3)));
+  }
+  for (uint8_t i = 0; i < SATELLITES; i++)
+  {
+    satGnss[i] = i % GNSS_ID_COUNT;
+    satSv[i] = 1 + i * 5;
+    satCno[i] = 20 + i % 30;
+  }
+}
+void tearDown(void) {}
+
+void test_body_is_valid_openmetrics(void)
+{
+  MockClient client;
+  size_t segments = 0;
+  {
+    ResponseWriter writer(client);
+    render(writer);
+    TEST_ASSERT_EQUAL_UINT32(0, writer.getOverflows());
+    // メトリクスが増えても描画中に送らずに済むよう、バッファの1/4以上を空けておく
+    TEST_ASSERT_TRUE(writer.pending() <= RESPONSE_BUFFER_SIZE * 3 / 4);
+    segments = (writer.pending() + RESPONSE_SEGMENT_SIZE - 1) / RESPONSE_SEGMENT_SIZE;
+    client.sent.append((const char *)ResponseWriter::data(), writer.pending());
+  }
+  std::string body = dechunk(client.sent);
+  TEST_ASSERT_TRUE(body.size() >= 10 * 1024);
+  TEST_ASSERT_EQUAL_STRING("# EOF\r\n", body.c_str() + body.size() - 7);
+
+  size_t families = 0, samples = 0;
+  for (size_t pos = 0; pos < body.size();)
+  {
+    size_t end = body.find("\r\n", pos);
+    std::string line = body.substr(pos, end - pos);
+    pos = end + 2;
+    if (line.compare(0, 7, "# HELP ") == 0)
+    {
+      families++;
+    }
+    else if (line[0] != '#')
+    {
+      // 名前、任意のラベル、空白、値
+      size_t space = line.rfind(' ');
+      TEST_ASSERT_TRUE(space != std::string::npos && space + 1 < line.size());
+      TEST_ASSERT_TRUE(line.find('{') == std::string::npos || line[space - 1] == '}');
+      samples++;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(sizeof(metrics) / sizeof(metrics[0]), families);
+  TEST_ASSERT_NOT_NULL(strstr(body.c_str(), "gnss_sv_cno_dbhz{constellation=\"QZSS\",sv=\"26\"} 25\r\n"));
+  TEST_ASSERT_NOT_NULL(strstr(body.c_str(), "loop_duration_seconds_bucket{le=\"+Inf\"} 1250\r\n"));
+  TEST_ASSERT_NOT_NULL(strstr(body.c_str(), "pps_frequency_ratio -0.000036712345\r\n"));
+
+  char line[128];
+  snprintf(line, sizeof(line), "body %u bytes, %u families, %u samples, %u segments of %u bytes", (unsigned)body.size(),
+           (unsigned)families, (unsigned)samples, (unsigned)segments, RESPONSE_SEGMENT_SIZE);
+  TEST_MESSAGE(line);
+}
+
+void test_render_time(void)
+{
+  MockClient client;
+  double total = 0, worst = 0;
+  uint32_t bytes = 0;
+  for (uint32_t i = 0; i < RENDER_ITERATIONS; i++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    ResponseWriter writer(client);
+    render(writer);
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    total += us;
+    worst = us > worst ? us : worst;
+    bytes = writer.getBytes();
+  }
+  double mean = total / RENDER_ITERATIONS;
+
+  char line[160];
+  snprintf(line, sizeof(line), "host render: mean %.1f us, worst %.1f us for %u bytes (%.1f ns/byte), goal %u us",
+           mean, worst, (unsigned)bytes, mean * 1000 / bytes, RENDER_GOAL_US);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(mean < RENDER_GOAL_US);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_body_is_valid_openmetrics);
+  RUN_TEST(test_render_time);
+  return UNITY_END();
+}
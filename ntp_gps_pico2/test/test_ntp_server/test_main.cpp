@@ -0,0 +1,259 @@
+// NtpServerの応答をシミュレーションした時計と比べる
+// PpsSimのPPSエッジとUTC秒でPpsClockを動かし、EthernetUDPの代用品にクライアントのリクエストを積んで server() を呼ぶ。
+// 受信と送信のタイムスタンプが真の時刻と一致すること、LI、Stratum、Reference ID (GPS/RTC) とクライアント以外のモードの扱いを見る。
+// RtcHoldoverには誤差のないRTCの切り替わりを渡す。
+
+#include <unity.h>
+#include <Ntp_Server.h>
+#include <Mock_Stream.h>
+#include <Pps_Sim.h>
+
+#define READ_US 37     // W5500から48バイトを読む時間
+#define TOLERANCE_US 3 // 割り込みの遅れ (1.5us) とタイムスタンプの丸め
+#define LOCK_SECONDS 60
+
+static const IPAddress clientIp(192, 168, 1, 20);
+static const uint16_t clientPort = 50123;
+static const uint8_t clientTransmit[8] = {0xEE, 0x7A, 0x11, 0x02, 0x12, 0x34, 0x56, 0x78};
+
+static PpsSimConfig config;
+static PpsSim *sim;
+static PpsClock *pps;
+static RtcHoldover *holdover;
+static NtpServer *ntp;
+static MockStream console;
+
+static void request(uint8_t mode, size_t size = NTP_PACKET_SIZE)
+{
+  HostDatagram d = {clientIp, clientPort, std::vector<uint8_t>(size, 0)};
+  d.data[0] = (0 << 6) | (4 << 3) | mode;
+  d.data[2] = 6; // poll
+  if (size >= NTP_PACKET_SIZE)
+  {
+    memcpy(&d.data[40], clientTransmit, 8);
+  }
+  hostUdp->inbox.push_back(d);
+}
+
+// 真の時刻 t [s] にリクエストが届く
+static void serveAt(double t)
+{
+  hostClockMicros = sim->localUs(t);
+  ntp->server(*pps, *holdover);
+}
+
+static void run(uint32_t seconds)
+{
+  for (uint32_t s = 0; s < seconds; s++)
+  {
+    sim->tick(*pps);
+  }
+}
+
+// タイムスタンプが真の時刻 t [s] を示す
+static void assertTimestamp(double t, const uint8_t *p)
+{
+  uint32_t seconds = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+  uint32_t fraction = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+  double shown = (double)(int32_t)(seconds - NTP_UNIX_OFFSET - config.unixStart) + fraction / 4294967296.0;
+  TEST_ASSERT_DOUBLE_WITHIN(TOLERANCE_US * 1e-6, t, shown);
+}
+
+static const std::vector<uint8_t> &lastReply()
+{
+  TEST_ASSERT_EQUAL_UINT32(1, hostUdp->sent.size());
+  const HostDatagram &d = hostUdp->sent.back();
+  TEST_ASSERT_TRUE(d.ip == clientIp);
+  TEST_ASSERT_EQUAL_UINT32(clientPort, d.port);
+  TEST_ASSERT_EQUAL_UINT32(NTP_PACKET_SIZE, d.data.size());
+  return d.data;
+}
+
+void setUp(void)
+{
+  hostUdpReadMicros = READ_US;
+  sim = new PpsSim(config);
+  pps = new PpsClock();
+  holdover = new RtcHoldover();
+  ntp = new NtpServer(console);
+  ntp->begin();
+}
+
+void tearDown(void)
+{
+  delete ntp;
+  delete holdover;
+  delete pps;
+  delete sim;
+  hostUdp = NULL;
+}
+
+void test_reply_timestamps(void)
+{
+  TEST_ASSERT_EQUAL_UINT32(NTP_PORT, hostUdp->localPort);
+  run(LOCK_SECONDS);
+  double t = sim->second() + 0.25;
+  request(3);
+  serveAt(t);
+
+  const std::vector<uint8_t> &r = lastReply();
+  TEST_ASSERT_EQUAL_HEX8((0 << 6) | (4 << 3) | 4, r[0]); // LI=0, VN=4, サーバー
+  TEST_ASSERT_EQUAL_UINT8(1, r[1]);
+  TEST_ASSERT_EQUAL_UINT8(6, r[2]);
+  TEST_ASSERT_EQUAL_INT(-20, (int8_t)r[3]);
+  // Root Delayは0、Root Dispersionはロック中なので数us (16.16形式で1)
+  TEST_ASSERT_EQUAL_MEMORY("\0\0\0\0\0\0\0\1", &r[4], 8);
+  TEST_ASSERT_EQUAL_MEMORY("GPS\0", &r[12], 4);
+  // Reference Timestampは最後のPPSエッジ
+  assertTimestamp(sim->second(), &r[16]);
+  TEST_ASSERT_EQUAL_MEMORY(clientTransmit, &r[24], 8);
+  // 受信はparsePacket()の直後、送信は読み出しの後
+  assertTimestamp(t, &r[32]);
+  assertTimestamp(t + READ_US * 1e-6, &r[40]);
+  TEST_ASSERT_EQUAL_UINT32(1, ntp->getRequestCount());
+  TEST_ASSERT_EQUAL_UINT32(0, ntp->getDroppedCount());
+}
+
+// エッジの間も周波数を補正して内挿する
+void test_interpolates_between_edges(void)
+{
+  run(LOCK_SECONDS);
+  for (int i = 1; i < 10; i++)
+  {
+    hostUdp->sent.clear();
+    double t = sim->second() + i / 10.0;
+    request(3);
+    serveAt(t);
+    assertTimestamp(t, &lastReply()[32]);
+  }
+}
+
+void test_unsynchronized(void)
+{
+  // まだPPSを受けていない
+  request(3);
+  serveAt(0.5);
+  TEST_ASSERT_EQUAL_HEX8((3 << 6) | (4 << 3) | 4, lastReply()[0]);
+  TEST_ASSERT_EQUAL_UINT8(16, lastReply()[1]);
+
+  // 周波数を引き込んでいる間も未同期
+  run(2);
+  hostUdp->sent.clear();
+  request(3);
+  serveAt(sim->second() + 0.5);
+  TEST_ASSERT_EQUAL_UINT8(16, lastReply()[1]);
+
+  // ロックした後、PPSがPPS_CLOCK_TIMEOUT_SECより長く途絶えた
+  run(LOCK_SECONDS);
+  hostUdp->sent.clear();
+  request(3);
+  serveAt(sim->second() + PPS_CLOCK_TIMEOUT_SEC + 0.5);
+  TEST_ASSERT_EQUAL_HEX8((3 << 6) | (4 << 3) | 4, lastReply()[0]);
+  TEST_ASSERT_EQUAL_UINT8(16, lastReply()[1]);
+}
+
+// RTCの秒の切り替わり (真の時刻 t = second) を渡す。PPSがあればcalibrate、なければholdover
+static void rtcEdge(uint32_t second)
+{
+  uint64_t edgeUs = sim->localUs(second);
+  if (pps->synchronized(edgeUs))
+  {
+    holdover->calibrate(edgeUs, config.unixStart + second, pps->now(edgeUs), 25.0);
+  }
+  else
+  {
+    holdover->holdover(edgeUs, config.unixStart + second, 25.0, pps->getFrequency());
+  }
+}
+
+// PPSが途絶えたらRTCのホールドオーバーで、Reference IDをRTCにして同期中として応答する
+void test_holdover_reply(void)
+{
+  run(LOCK_SECONDS);
+  // 最後のPPSエッジの次の秒まで学習する
+  uint32_t lost = sim->second();
+  rtcEdge(lost + 1);
+
+  // PPSが途絶えた後のRTCの切り替わり
+  uint32_t second = lost + PPS_CLOCK_TIMEOUT_SEC + 10;
+  rtcEdge(second);
+  double t = second + 0.5;
+  request(3);
+  serveAt(t);
+
+  const std::vector<uint8_t> &r = lastReply();
+  TEST_ASSERT_EQUAL_HEX8((0 << 6) | (4 << 3) | 4, r[0]);
+  TEST_ASSERT_EQUAL_UINT8(1, r[1]);
+  TEST_ASSERT_EQUAL_MEMORY("RTC\0", &r[12], 4);
+  // Root Dispersionはホールドオーバーの推定誤差 (1ms + 2ppm x 経過時間)
+  uint32_t dispersion = ((uint32_t)r[8] << 24) | ((uint32_t)r[9] << 16) | ((uint32_t)r[10] << 8) | r[11];
+  double expected = RTC_HOLDOVER_PHASE_ERROR + RTC_HOLDOVER_DEFAULT_ERROR * (t - lost);
+  TEST_ASSERT_DOUBLE_WITHIN(2.0 / 65536, expected, dispersion / 65536.0);
+  // RTCは正確なので、時刻はPPSのロック中と同じ精度
+  assertTimestamp(second, &r[16]);
+  assertTimestamp(t, &r[32]);
+  assertTimestamp(t + READ_US * 1e-6, &r[40]);
+  TEST_ASSERT_EQUAL_UINT32(1, ntp->getHoldoverCount());
+
+  // RTCの切り替わりもRTC_HOLDOVER_EDGE_TIMEOUT_SECより長く途絶えたら未同期
+  hostUdp->sent.clear();
+  request(3);
+  serveAt(second + RTC_HOLDOVER_EDGE_TIMEOUT_SEC + 0.5);
+  TEST_ASSERT_EQUAL_UINT8(16, lastReply()[1]);
+  TEST_ASSERT_EQUAL_MEMORY("GPS\0", &lastReply()[12], 4);
+  TEST_ASSERT_EQUAL_UINT32(1, ntp->getHoldoverCount());
+}
+
+// クライアント (モード3) 以外と48バイトに足りないパケットには応答しない
+void test_rejects_non_client_modes(void)
+{
+  run(LOCK_SECONDS);
+  double t = sim->second() + 0.1;
+  for (uint8_t mode = 0; mode < 8; mode++)
+  {
+    if (mode != 3)
+    {
+      request(mode);
+    }
+  }
+  request(3, NTP_PACKET_SIZE - 1);
+  serveAt(t);
+  TEST_ASSERT_EQUAL_UINT32(0, hostUdp->sent.size());
+  TEST_ASSERT_EQUAL_UINT32(8, ntp->getRequestCount());
+  TEST_ASSERT_EQUAL_UINT32(8, ntp->getDroppedCount());
+
+  // 1回に処理するのはNTP_MAX_PACKETS_PER_LOOP個まで
+  for (int i = 0; i < NTP_MAX_PACKETS_PER_LOOP + 2; i++)
+  {
+    request(3);
+  }
+  serveAt(t);
+  TEST_ASSERT_EQUAL_UINT32(NTP_MAX_PACKETS_PER_LOOP, hostUdp->sent.size());
+  serveAt(t);
+  TEST_ASSERT_EQUAL_UINT32(NTP_MAX_PACKETS_PER_LOOP + 2, hostUdp->sent.size());
+  TEST_ASSERT_EQUAL_UINT32(8, ntp->getDroppedCount());
+}
+
+// Root Dispersionは切り上げ、16.16形式で表せない大きさは最大値にする
+void test_short_format_saturates(void)
+{
+  TEST_ASSERT_EQUAL_HEX32(0, toNtpShort(0.0));
+  TEST_ASSERT_EQUAL_HEX32(0x00000001, toNtpShort(2e-6));
+  TEST_ASSERT_EQUAL_HEX32(0x00008001, toNtpShort(0.5));
+  TEST_ASSERT_EQUAL_HEX32(0x00018001, toNtpShort(1.5));
+  TEST_ASSERT_EQUAL_HEX32(0x00100001, toNtpShort(16.0));
+  TEST_ASSERT_EQUAL_HEX32(0xffffffff, toNtpShort(65535.0));
+  TEST_ASSERT_EQUAL_HEX32(0xffffffff, toNtpShort(1e9));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_reply_timestamps);
+  RUN_TEST(test_interpolates_between_edges);
+  RUN_TEST(test_unsynchronized);
+  RUN_TEST(test_holdover_reply);
+  RUN_TEST(test_rejects_non_client_modes);
+  RUN_TEST(test_short_format_saturates);
+  return UNITY_END();
+}
@@ -0,0 +1,212 @@
+// PpsClockのサーボをシミュレーションしたPPSで確かめる
+// 36.7ppmずれた発振器、最大5usの割り込みの遅れのばらつき、欠けたエッジと長い途絶、チャタリング、外れ値を与え、
+// ロックまでの時間、周波数の推定、秒の中ほどでのクロックの誤差を見る。
+
+#include <unity.h>
+#include <Pps_Sim.h>
+#include <stdio.h>
+
+#define SETTLE_SECONDS 120
+#define RUN_SECONDS 3600
+
+static PpsClock pps;
+
+void setUp(void) { pps = PpsClock(); }
+void tearDown(void) {}
+
+static void report(const char *name, const PpsErrorStats &stats)
+{
+  char line[160];
+  snprintf(line, sizeof(line), "%s: error mean %+.3f us, stddev %.3f us, max %.3f us, jitter %.3f us, freq %+.4f ppm",
+           name, stats.mean() * 1e6, stats.stddev() * 1e6, stats.maxAbs * 1e6, pps.getJitter() * 1e6,
+           pps.getFrequency() * 1e6);
+  TEST_MESSAGE(line);
+}
+
+void test_locks_and_tracks_frequency(void)
+{
+  PpsSimConfig config;
+  config.latencyJitter = 5e-6;
+  PpsSim sim(config);
+  uint32_t lockedAt = 0;
+  PpsErrorStats stats;
+  for (uint32_t s = 0; s < RUN_SECONDS; s++)
+  {
+    sim.tick(pps);
+    if (lockedAt == 0 && pps.getState() == PPS_CLOCK_PLL)
+    {
+      lockedAt = sim.second();
+    }
+    if (s >= SETTLE_SECONDS)
+    {
+      TEST_ASSERT_TRUE(pps.synchronized(sim.localUs(sim.second() + 0.5)));
+      stats.add(sim.probe(pps));
+    }
+  }
+  report("jitter 0..5 us", stats);
+
+  TEST_ASSERT_TRUE(lockedAt > 0 && lockedAt < 60);
+  TEST_ASSERT_EQUAL_UINT32(1, pps.getStepCount());
+  TEST_ASSERT_EQUAL_UINT32(0, pps.getMissedCount());
+  // ローカルカウンタが速いと補正は負になる
+  TEST_ASSERT_DOUBLE_WITHIN(0.05e-6, -config.freqError / (1.0 + config.freqError), pps.getFrequency());
+  // 割り込みの遅れの平均 (1.5 + 2.5 us) だけ遅れ、ばらつきはサーボで小さくなる
+  TEST_ASSERT_DOUBLE_WITHIN(1e-6, -4e-6, stats.mean());
+  TEST_ASSERT_TRUE(stats.stddev() < 1.5e-6);
+  TEST_ASSERT_TRUE(stats.maxAbs < 10e-6);
+}
+
+void test_missed_edges_are_bridged(void)
+{
+  PpsSimConfig config;
+  config.latencyJitter = 5e-6;
+  config.missProbability = 0.05;
+  PpsSim sim(config, 12345);
+  PpsErrorStats stats;
+  for (uint32_t s = 0; s < RUN_SECONDS; s++)
+  {
+    // 途中で5秒続けて欠ける
+    sim.tick(pps, s >= 1800 && s < 1805);
+    if (s >= SETTLE_SECONDS)
+    {
+      TEST_ASSERT_TRUE(pps.synchronized(sim.localUs(sim.second() + 0.5)));
+      stats.add(sim.probe(pps));
+    }
+  }
+  report("5% missed", stats);
+
+  // 最初のエッジが欠けていなければ、欠けた数はそのまま数えられる
+  TEST_ASSERT_TRUE(sim.missed() > RUN_SECONDS * 0.05 * 0.7);
+  TEST_ASSERT_UINT32_WITHIN(2, sim.missed(), pps.getMissedCount());
+  TEST_ASSERT_EQUAL_UINT32(1, pps.getStepCount());
+  TEST_ASSERT_EQUAL_INT(PPS_CLOCK_PLL, pps.getState());
+  TEST_ASSERT_TRUE(stats.stddev() < 2e-6);
+  TEST_ASSERT_TRUE(stats.maxAbs < 15e-6);
+}
+
+// PPS_CLOCK_TIMEOUT_SECより長く途絶えたら未同期になり、戻ればステップせずに再びロックする
+void test_outage_and_recovery(void)
+{
+  PpsSimConfig config;
+  config.latencyJitter = 5e-6;
+  PpsSim sim(config, 777);
+  for (uint32_t s = 0; s < 300; s++)
+  {
+    sim.tick(pps);
+  }
+  TEST_ASSERT_TRUE(pps.synchronized(sim.localUs(sim.second() + 0.5)));
+
+  bool lost = false;
+  for (uint32_t s = 0; s < 30; s++)
+  {
+    sim.tick(pps, true);
+    lost |= !pps.synchronized(sim.localUs(sim.second() + 0.5));
+  }
+  TEST_ASSERT_TRUE(lost);
+  // 30秒の途絶でも周波数を推定済みなので、誤差は20us以内に収まっている
+  TEST_ASSERT_TRUE(fabs(sim.probe(pps)) < 20e-6);
+
+  for (uint32_t s = 0; s < 60; s++)
+  {
+    sim.tick(pps);
+  }
+  TEST_ASSERT_TRUE(pps.synchronized(sim.localUs(sim.second() + 0.5)));
+  TEST_ASSERT_EQUAL_UINT32(1, pps.getStepCount());
+  TEST_ASSERT_EQUAL_UINT32(30, pps.getMissedCount());
+  TEST_ASSERT_TRUE(fabs(sim.probe(pps)) < 10e-6);
+}
+
+// 同じ秒の中の2つ目のエッジは使わない
+void test_chattering_edge_is_ignored(void)
+{
+  PpsSimConfig config;
+  PpsSim sim(config);
+  for (uint32_t s = 0; s < 200; s++)
+  {
+    sim.tick(pps);
+  }
+  double before = sim.probe(pps);
+  uint32_t edges = pps.getEdgeCount();
+  pps.onPps(sim.localUs(sim.second() + 0.0002));
+  TEST_ASSERT_EQUAL_UINT32(edges + 1, pps.getEdgeCount());
+  TEST_ASSERT_EQUAL_INT(PPS_CLOCK_PLL, pps.getState());
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, before, sim.probe(pps));
+
+  sim.tick(pps);
+  TEST_ASSERT_EQUAL_UINT32(0, pps.getMissedCount());
+  TEST_ASSERT_TRUE(fabs(sim.probe(pps)) < 5e-6);
+}
+
+// 1つだけ5ms遅れたエッジ (フラッシュの書き込みなどで割り込みが止まった) はステップせずに捨てる
+void test_single_outlier_is_ignored(void)
+{
+  PpsSimConfig config;
+  config.latencyJitter = 5e-6;
+  PpsSim sim(config, 4242);
+  for (uint32_t s = 0; s < 300; s++)
+  {
+    sim.tick(pps);
+  }
+  double freq = pps.getFrequency();
+  double jitter = pps.getJitter();
+
+  sim.tick(pps, false, 0.005);
+  TEST_ASSERT_EQUAL_UINT32(1, pps.getOutlierCount());
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, freq, pps.getFrequency());
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, jitter, pps.getJitter());
+  for (uint32_t s = 0; s < 60; s++)
+  {
+    sim.tick(pps);
+    TEST_ASSERT_TRUE(fabs(sim.probe(pps)) < 10e-6);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, pps.getStepCount());
+  TEST_ASSERT_EQUAL_UINT32(0, pps.getMissedCount());
+  TEST_ASSERT_EQUAL_INT(PPS_CLOCK_PLL, pps.getState());
+  // 後のエッジでは、ばらつきの分しか周波数は動かない
+  TEST_ASSERT_DOUBLE_WITHIN(0.1e-6, freq, pps.getFrequency());
+}
+
+// 外れたエッジがPPS_CLOCK_STEPOUT_COUNT続いたら位相だけをステップさせ、周波数は変えない
+void test_persistent_offset_steps(void)
+{
+  PpsSimConfig config;
+  PpsSim sim(config, 4242);
+  for (uint32_t s = 0; s < 300; s++)
+  {
+    sim.tick(pps);
+  }
+  double freq = pps.getFrequency();
+
+  // 配線を変えるなどしてエッジがずっと5ms遅れる
+  for (uint32_t s = 1; s < PPS_CLOCK_STEPOUT_COUNT; s++)
+  {
+    sim.tick(pps, false, 0.005);
+    TEST_ASSERT_EQUAL_UINT32(1, pps.getStepCount());
+  }
+  sim.tick(pps, false, 0.005);
+  TEST_ASSERT_EQUAL_UINT32(2, pps.getStepCount());
+  TEST_ASSERT_EQUAL_UINT32(PPS_CLOCK_STEPOUT_COUNT - 1, pps.getOutlierCount());
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, freq, pps.getFrequency());
+
+  for (uint32_t s = 0; s < 60; s++)
+  {
+    sim.tick(pps, false, 0.005);
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, pps.getStepCount());
+  TEST_ASSERT_EQUAL_INT(PPS_CLOCK_PLL, pps.getState());
+  TEST_ASSERT_DOUBLE_WITHIN(0.01e-6, freq, pps.getFrequency());
+  // 遅れたエッジに合わせている
+  TEST_ASSERT_DOUBLE_WITHIN(5e-6, -0.005, sim.probe(pps));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_locks_and_tracks_frequency);
+  RUN_TEST(test_missed_edges_are_bridged);
+  RUN_TEST(test_outage_and_recovery);
+  RUN_TEST(test_chattering_edge_is_ignored);
+  RUN_TEST(test_single_outlier_is_ignored);
+  RUN_TEST(test_persistent_offset_steps);
+  return UNITY_END();
+}
@@ -0,0 +1,91 @@
+// TIM-TPのqErrによる補正で、PPSの量子化誤差 (のこぎり波) がクロックから取り除かれることを確かめる
+// 同じエッジの列をqErrを渡す場合と渡さない場合でPpsClockに与え、秒の中ほどでのクロックの誤差を比べる。
+// ローカル時刻の分解能は1usなので、48MHz (刻み20.8ns) の受信機ではのこぎり波は量子化の雑音に埋もれる。
+// 効果が見えるように、刻みが4usの粗い受信機と、ずれがゆっくりで誤差が長く同じ向きに偏る場合 (hanging bridge) も試す。
+
+#include <unity.h>
+#include <Pps_Sim.h>
+#include <stdio.h>
+
+#define SETTLE_SECONDS 120
+#define RUN_SECONDS 3600
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static PpsErrorStats run(PpsSimConfig config, bool applyQErr, double &jitter)
+{
+  config.applyQErr = applyQErr;
+  PpsSim sim(config);
+  PpsClock pps;
+  PpsErrorStats stats;
+  for (uint32_t s = 0; s < RUN_SECONDS; s++)
+  {
+    sim.tick(pps);
+    if (s >= SETTLE_SECONDS)
+    {
+      stats.add(sim.probe(pps));
+    }
+  }
+  TEST_ASSERT_EQUAL_INT(PPS_CLOCK_PLL, pps.getState());
+  TEST_ASSERT_EQUAL_UINT32(1, pps.getStepCount());
+  jitter = pps.getJitter();
+  return stats;
+}
+
+// qErrなしとありの標準偏差を返す
+static void compare(const char *name, const PpsSimConfig &config, double &without, double &with)
+{
+  double jitterWithout, jitterWith;
+  PpsErrorStats a = run(config, false, jitterWithout);
+  PpsErrorStats b = run(config, true, jitterWith);
+  without = a.stddev();
+  with = b.stddev();
+
+  char line[200];
+  snprintf(line, sizeof(line), "%s: stddev %.3f -> %.3f us, max %.3f -> %.3f us, jitter %.3f -> %.3f us",
+           name, without * 1e6, with * 1e6, a.maxAbs * 1e6, b.maxAbs * 1e6, jitterWithout * 1e6, jitterWith * 1e6);
+  TEST_MESSAGE(line);
+}
+
+// 48MHzの受信機: 補正しても悪くならない
+void test_realistic_sawtooth(void)
+{
+  PpsSimConfig config;
+  config.qErrTick = 1.0 / 48e6;
+  double without, with;
+  compare("48 MHz tick", config, without, with);
+  TEST_ASSERT_TRUE(with <= without + 2e-9);
+}
+
+// 刻み4usの受信機: のこぎり波が量子化の雑音より大きい
+void test_coarse_sawtooth(void)
+{
+  PpsSimConfig config;
+  config.qErrTick = 4e-6;
+  double without, with;
+  compare("4 us tick", config, without, with);
+  TEST_ASSERT_TRUE(with * 2 < without);
+  TEST_ASSERT_TRUE(with < 0.5e-6);
+}
+
+// 1000秒かけて刻みの中を一周する: サーボが誤差に追従してしまう
+void test_hanging_bridge(void)
+{
+  PpsSimConfig config;
+  config.qErrTick = 4e-6;
+  config.qErrBeat = 0.001;
+  double without, with;
+  compare("4 us tick, 1000 s beat", config, without, with);
+  TEST_ASSERT_TRUE(with * 3 < without);
+  TEST_ASSERT_TRUE(with < 0.5e-6);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_realistic_sawtooth);
+  RUN_TEST(test_coarse_sawtooth);
+  RUN_TEST(test_hanging_bridge);
+  return UNITY_END();
+}
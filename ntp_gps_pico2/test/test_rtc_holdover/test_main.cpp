@@ -0,0 +1,309 @@
+// RtcHoldoverの温度モデル、エージングの調整とホールドオーバー中の誤差をシミュレーションしたDS3231で確かめる
+// RtcSim は温度の2次式とエージングによる経年変化で周波数がずれるRTCで、main.cppと同じく64秒ごとに
+// 秒の切り替わりを検出誤差つきで渡す。温度は1日周期で25±10℃、それに数時間周期の揺れを重ねる。
+
+#include <unity.h>
+#include <Rtc_Holdover.h>
+#include <stdio.h>
+
+#define UNIX_START 1792152000UL
+#define CALIBRATE_SEC 64 // GNSSロック中に切り替わりを読む間隔 (main.cpp)
+#define HOLDOVER_SEC 16  // ホールドオーバー中に切り替わりを読む間隔 (main.cpp)
+#define DAY_SEC 86400.0
+#define EDGE_NOISE 0.25e-3 // 切り替わりの検出誤差 (読み出しの間隔の半分) [s]
+
+struct RtcSimConfig
+{
+  double c0 = 0.12e-6;   // 25℃の周波数誤差
+  double c1 = 0.01e-6;   // [1/℃]
+  double c2 = -0.002e-6; // [1/℃^2]
+  double aging = 0.05e-6 / DAY_SEC; // 周波数の経年変化 [1/s]
+  double edgeNoise = 0.0;
+};
+
+class RtcSim
+{
+public:
+  explicit RtcSim(const RtcSimConfig &config) : config_(config) {}
+
+  double time() const { return t_; }
+
+  double temperature(double t) const
+  {
+    return 25.0 + 10.0 * sin(2 * M_PI * t / DAY_SEC) + 2.0 * sin(2 * M_PI * t / 13000.0);
+  }
+
+  // 真の時刻 t での周波数誤差 (正ならRTCが進む)
+  double frequency(double temperature, double t) const
+  {
+    double x = temperature - RTC_HOLDOVER_TEMP_REF;
+    return config_.c0 - aging_ + config_.aging * t + (config_.c1 + config_.c2 * x) * x;
+  }
+
+  // エージングレジスタを変えた
+  void setAging(int step) { aging_ += step * RTC_HOLDOVER_AGING_LSB; }
+
+  // dt秒進めて、RTC - 真の時刻 を積分する
+  void advance(double dt)
+  {
+    const int steps = 16;
+    for (int i = 0; i < steps; i++)
+    {
+      double mid = t_ + (i + 0.5) * dt / steps;
+      phase_ += frequency(temperature(mid), mid) * dt / steps;
+    }
+    t_ += dt;
+  }
+
+  // 今に一番近いRTCの秒の切り替わり。edgeはその真の時刻、detectedは検出したローカル時刻 (ローカルカウンタは正確とする)
+  uint32_t edge(double &edge, uint64_t &detectedUs)
+  {
+    double n = floor(t_ + phase_ + 0.5);
+    edge = n - phase_;
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    double noise = config_.edgeNoise * (2.0 * (rng_ / 4294967296.0) - 1.0);
+    detectedUs = (uint64_t)llround((edge + noise) * 1e6);
+    return UNIX_START + (uint32_t)n;
+  }
+
+  // GNSSロック中の1回分
+  void calibrate(RtcHoldover &holdover)
+  {
+    double e;
+    uint64_t us;
+    uint32_t seconds = edge(e, us);
+    holdover.calibrate(us, seconds, toNtpTimestamp(UNIX_START, us * 1e-6), temperature(e));
+  }
+
+private:
+  RtcSimConfig config_;
+  double t_ = 100.0;
+  double phase_ = 0.2e-3;
+  double aging_ = 0.0;
+  uint32_t rng_ = 2463534242UL;
+};
+
+// GNSSロック中にseconds秒学習する。writeAgingならmain.cppと同じくエージングを書き換え、書き換えた回数を返す
+static int train(RtcHoldover &holdover, RtcSim &sim, double seconds, bool writeAging = true)
+{
+  int writes = 0;
+  for (double end = sim.time() + seconds; sim.time() < end;)
+  {
+    sim.advance(CALIBRATE_SEC);
+    sim.calibrate(holdover);
+    int8_t step = writeAging ? holdover.agingStep() : 0;
+    if (step != 0)
+    {
+      sim.setAging(step);
+      holdover.onAgingChanged(step);
+      writes++;
+    }
+  }
+  return writes;
+}
+
+static double toSeconds(const NtpTimestamp &ts)
+{
+  return (double)(int32_t)(ts.seconds - NTP_UNIX_OFFSET - UNIX_START) + ts.fraction / 4294967296.0;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// 2次式の点からは係数がそのまま求まる。温度の幅が狭い間は定数で近似する
+void test_model_fits_quadratic(void)
+{
+  TemperatureModel model;
+  for (double t = 5.0; t <= 45.0; t += 2.5)
+  {
+    double x = t - RTC_HOLDOVER_TEMP_REF;
+    model.add(t, 0.3e-6 + 0.02e-6 * x - 0.003e-6 * x * x);
+  }
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, 0.3e-6, model.frequency(25.0));
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, 0.3e-6 - 0.2e-6 - 0.3e-6, model.frequency(15.0));
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, 0.3e-6 + 0.4e-6 - 1.2e-6, model.frequency(45.0));
+  TEST_ASSERT_TRUE(model.residual() < 1e-12);
+
+  // 学習済みの点をずらすと定数項だけが変わる
+  model.shift(0.5e-6);
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, -0.2e-6, model.frequency(25.0));
+  TEST_ASSERT_DOUBLE_WITHIN(1e-12, -0.2e-6 - 0.2e-6 - 0.3e-6, model.frequency(15.0));
+
+  TemperatureModel narrow;
+  for (int i = 0; i < 10; i++)
+  {
+    narrow.add(25.0 + (i % 2 ? 0.2 : -0.2), 1e-6 + (i % 2 ? 0.02e-6 : -0.02e-6));
+  }
+  TEST_ASSERT_DOUBLE_WITHIN(1e-3 * 1e-6, 1e-6, narrow.frequency(25.0));
+  TEST_ASSERT_DOUBLE_WITHIN(1e-3 * 1e-6, 1e-6, narrow.frequency(45.0));
+}
+
+// 6日間学習した温度モデルと、その時点の真の周波数の差の最大 (15-35℃)
+static double learn(RtcSim &sim, RtcHoldover &holdover, const char *name)
+{
+  int writes = train(holdover, sim, 6 * DAY_SEC);
+  double worst = 0.0;
+  for (double t = 15.0; t <= 35.0; t += 5.0)
+  {
+    worst = fmax(worst, fabs(holdover.getFrequency(t) - sim.frequency(t, sim.time())));
+  }
+  char line[160];
+  snprintf(line, sizeof(line), "%s: %d aging writes, %lu points, worst model error %.4f ppm over 15..35 C, residual %.4f ppm",
+           name, writes, (unsigned long)holdover.getPoints(), worst * 1e6, holdover.getResidual() * 1e6);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL_INT(RTC_HOLDOVER_TRACKING, holdover.getState());
+  // 25℃での誤差はエージングで不感帯の中に入れる
+  TEST_ASSERT_TRUE(writes >= 1);
+  TEST_ASSERT_TRUE(fabs(sim.frequency(25.0, sim.time())) < RTC_HOLDOVER_AGING_DEADBAND * RTC_HOLDOVER_AGING_LSB + 0.02e-6);
+  return worst;
+}
+
+// 2次の温度特性を学習する。経年変化があると、忘却係数で決まる約1日分だけ遅れて追従する
+void test_learns_temperature_curve_with_aging(void)
+{
+  RtcSimConfig config;
+  config.aging = 0.0;
+  RtcSim fixed(config);
+  RtcHoldover holdover;
+  TEST_ASSERT_TRUE(learn(fixed, holdover, "no aging") < 0.005e-6);
+  TEST_ASSERT_TRUE(holdover.getResidual() < 0.005e-6);
+  // 曲率 (2次の係数) も求まっている
+  double c2 = (holdover.getFrequency(35.0) + holdover.getFrequency(15.0) - 2 * holdover.getFrequency(25.0)) / 200.0;
+  TEST_ASSERT_DOUBLE_WITHIN(0.0001e-6, config.c2, c2);
+
+  RtcSimConfig drifting;
+  RtcSim sim(drifting);
+  RtcHoldover aged;
+  double worst = learn(sim, aged, "aging 0.05 ppm/day");
+  TEST_ASSERT_TRUE(worst < 1.5 * drifting.aging * DAY_SEC);
+  // 遅れは残差に表れ、ホールドオーバーの誤差の見積もりを広げる
+  TEST_ASSERT_TRUE(aged.getResidual() > RTC_HOLDOVER_FREQ_ERROR / 10);
+}
+
+// 25℃の周波数誤差が不感帯 (1.5LSB) 以下ならエージングを変えず、超えたら丸めて最大10LSBまで変える
+void test_aging_step_deadband(void)
+{
+  const double errors[] = {0.14e-6, -0.14e-6, 0.16e-6, -0.26e-6, 3e-6};
+  const int8_t steps[] = {0, 0, 2, -3, RTC_HOLDOVER_AGING_MAX_STEP};
+  for (int i = 0; i < 5; i++)
+  {
+    RtcSimConfig config;
+    config.c0 = errors[i];
+    config.c1 = config.c2 = config.aging = 0.0;
+    RtcSim sim(config);
+    RtcHoldover holdover;
+
+    // 周波数の点がRTC_HOLDOVER_AGING_POINTSに揃うまでは変えない
+    for (int points = 0; points < RTC_HOLDOVER_AGING_POINTS; points++)
+    {
+      TEST_ASSERT_EQUAL_INT8(0, holdover.agingStep());
+      while (holdover.getPoints() == (uint32_t)points)
+      {
+        sim.advance(CALIBRATE_SEC);
+        sim.calibrate(holdover);
+      }
+    }
+    TEST_ASSERT_EQUAL_INT8(steps[i], holdover.agingStep());
+    if (steps[i] == 0)
+    {
+      continue;
+    }
+
+    // 書き換えた後は、モデルを同じだけずらし、また点が揃うまで待つ
+    sim.setAging(steps[i]);
+    holdover.onAgingChanged(steps[i]);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, errors[i] - steps[i] * RTC_HOLDOVER_AGING_LSB, holdover.getFrequency(25.0));
+    TEST_ASSERT_EQUAL_INT8(0, holdover.agingStep());
+    train(holdover, sim, RTC_HOLDOVER_AGING_POINTS * (RTC_HOLDOVER_WINDOW_SEC + CALIBRATE_SEC), false);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01e-6, sim.frequency(25.0, sim.time()), holdover.getFrequency(25.0));
+    // 残りが不感帯に入るまで続ける
+    TEST_ASSERT_EQUAL_INT8(steps[i] == RTC_HOLDOVER_AGING_MAX_STEP ? RTC_HOLDOVER_AGING_MAX_STEP : 0, holdover.agingStep());
+  }
+}
+
+// 5日間学習した後の1日のホールドオーバーで、時刻の誤差がerror()を超えない
+void test_error_bounds_holdover(void)
+{
+  RtcSimConfig config;
+  config.edgeNoise = EDGE_NOISE;
+  RtcSim sim(config);
+  RtcHoldover holdover;
+  train(holdover, sim, 5 * DAY_SEC);
+
+  double worst = 0.0, bound = 0.0;
+  bool active = true;
+  for (double end = sim.time() + DAY_SEC; sim.time() < end;)
+  {
+    sim.advance(HOLDOVER_SEC);
+    double e;
+    uint64_t us;
+    uint32_t seconds = sim.edge(e, us);
+    holdover.holdover(us, seconds, sim.temperature(e), 0.0);
+    TEST_ASSERT_EQUAL_INT(RTC_HOLDOVER_ACTIVE, holdover.getState());
+
+    // 次の切り替わりまでの間
+    for (double q = 0.1; q < HOLDOVER_SEC; q += 3.7)
+    {
+      uint64_t queryUs = (uint64_t)llround((e + q) * 1e6);
+      double error = fabs(toSeconds(holdover.now(queryUs)) - (e + q));
+      bound = holdover.error(queryUs);
+      worst = fmax(worst, error);
+      active = active && holdover.active(queryUs);
+      TEST_ASSERT_TRUE(error <= bound);
+    }
+  }
+  char line[160];
+  snprintf(line, sizeof(line), "1 day holdover: max error %.3f ms, bound at the end %.3f ms", worst * 1e3, bound * 1e3);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(active);
+  TEST_ASSERT_TRUE(worst > 0.0);
+}
+
+// 温度モデルがない時はDS3231の仕様の周波数誤差で見積もり、誤差が大きくなったら時刻を提供しない
+void test_error_without_model(void)
+{
+  RtcSimConfig config;
+  config.c0 = 1.5e-6;
+  config.c1 = config.c2 = config.aging = 0.0;
+  config.edgeNoise = EDGE_NOISE;
+  RtcSim sim(config);
+  RtcHoldover holdover;
+
+  // 切り替わりを1度も測っていなければホールドオーバーにならない
+  holdover.holdover(1000000, UNIX_START, 25.0, 0.0);
+  TEST_ASSERT_EQUAL_INT(RTC_HOLDOVER_IDLE, holdover.getState());
+
+  train(holdover, sim, 600);
+  TEST_ASSERT_EQUAL_UINT32(0, holdover.getPoints());
+  uint64_t lastCalibrationUs = (uint64_t)llround(sim.time() * 1e6);
+  while (true)
+  {
+    sim.advance(HOLDOVER_SEC);
+    double e;
+    uint64_t us;
+    uint32_t seconds = sim.edge(e, us);
+    holdover.holdover(us, seconds, sim.temperature(e), 0.0);
+    uint64_t queryUs = us + 500000;
+    TEST_ASSERT_TRUE(fabs(toSeconds(holdover.now(queryUs)) - (e + 0.5)) <= holdover.error(queryUs));
+    if (!holdover.active(queryUs))
+    {
+      break;
+    }
+  }
+  // 1ms + 2ppm x 経過時間 が0.1sを超えるまで
+  double hours = (sim.time() * 1e6 - lastCalibrationUs) / 3.6e9;
+  TEST_ASSERT_DOUBLE_WITHIN(0.1, (RTC_HOLDOVER_MAX_ERROR - RTC_HOLDOVER_PHASE_ERROR) / RTC_HOLDOVER_DEFAULT_ERROR / 3600, hours);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_model_fits_quadratic);
+  RUN_TEST(test_learns_temperature_curve_with_aging);
+  RUN_TEST(test_aging_step_deadband);
+  RUN_TEST(test_error_bounds_holdover);
+  RUN_TEST(test_error_without_model);
+  return UNITY_END();
+}
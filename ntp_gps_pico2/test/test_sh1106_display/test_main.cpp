@@ -0,0 +1,325 @@
+// SH1106のdisplay()が変わった列の範囲だけを送り、それでもパネルの表示がバッファと同じになることを確かめる
+// Sh1106Panel がI2C/SPIで届いたコマンドとデータを表示RAMに書き、バスのバイトを数える。
+// displayInfo() と同じく毎秒画面を消して描き直す場合と、ランダムな描画を続けた場合に、全画面を送るのと比べたバイト数を出す。
+// 同じ範囲をページごとに11回の送信に分けていた以前のフレーミングで送り直し、I2Cのビット時間を比べる。
+
+#include <unity.h>
+#include <Adafruit_SH1106.h>
+#include <Sh1106_Panel.h>
+
+#define PIN_RST 20
+#define PIN_DC 21
+#define PIN_CS 22
+#define PIN_SID 23
+#define PIN_SCLK 24
+
+// 1ページ = 7バイト (コントロールバイトとページ・列アドレス) + 128列。WIRE_BUFFER_SIZEに収まる
+#define FULL_FRAME_I2C_BYTES (8 * (7 + 128))
+
+class TestDisplay : public Adafruit_SH1106
+{
+public:
+  using Adafruit_SH1106::Adafruit_SH1106;
+  const uint8_t *frame() const { return buffer; }
+};
+
+static uint32_t rng = 88172645UL;
+static uint32_t nextRandom()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static void assertShows(const Sh1106Panel &panel, TestDisplay &display)
+{
+  TEST_ASSERT_TRUE(panel.shows(display.frame(), SH1106_LCDWIDTH, SH1106_PAGES));
+}
+
+// 送ったバイトを数えながらdisplay()する
+static uint32_t flush(TestDisplay &display, Sh1106Panel &panel)
+{
+  uint32_t sent = display.getBytesSent();
+  panel.resetCounters();
+  display.display();
+  TEST_ASSERT_EQUAL_UINT32(display.getBytesSent() - sent, panel.busBytes());
+  assertShows(panel, display);
+  return panel.busBytes();
+}
+
+// ランダムな図形と文字を描く
+static void drawRandom(TestDisplay &display)
+{
+  uint16_t color = nextRandom() % 3;
+  int16_t x = (int16_t)(nextRandom() % 160) - 16;
+  int16_t y = (int16_t)(nextRandom() % 96) - 16;
+  int16_t w = nextRandom() % 40;
+  int16_t h = nextRandom() % 40;
+  switch (nextRandom() % 6)
+  {
+  case 0:
+    display.drawPixel(x, y, color);
+    break;
+  case 1:
+    display.drawFastHLine(x, y, w, color);
+    break;
+  case 2:
+    display.drawFastVLine(x, y, h, color);
+    break;
+  case 3:
+    display.fillRect(x, y, w, h, color);
+    break;
+  case 4:
+    display.setCursor(x, y);
+    display.setTextColor(color, nextRandom() % 2 ? color : (uint16_t)(nextRandom() % 3));
+    display.print((char)(' ' + nextRandom() % 95));
+    break;
+  case 5:
+    if (nextRandom() % 8 == 0)
+    {
+      display.clearDisplay();
+    }
+    break;
+  }
+}
+
+// フレームごとに0..5回描いてdisplay()する。全画面を送った場合のバイト数との比を返す
+static double replay(TestDisplay &display, Sh1106Panel &panel, uint32_t fullFrame, int frames)
+{
+  uint32_t total = 0;
+  for (int frame = 0; frame < frames; frame++)
+  {
+    for (uint32_t n = nextRandom() % 6; n > 0; n--)
+    {
+      drawRandom(display);
+    }
+    total += flush(display, panel);
+  }
+  // 何も描かなければ何も送らない
+  TEST_ASSERT_EQUAL_UINT32(0, flush(display, panel));
+  return (double)total / ((double)fullFrame * frames);
+}
+
+// displayInfo() と同じく画面を消して描き直す
+static void drawInfo(TestDisplay &display, int sec)
+{
+  char line[32];
+  snprintf(line, sizeof(line), "2026/10/16 12:%02d:%02d", 34 + sec / 60, sec % 60);
+  display.clearDisplay();
+  display.setTextSize(1);
+  display.setTextColor(WHITE);
+  display.setCursor(0, 0);
+  display.println("DateTime:");
+  display.setCursor(0, 10);
+  display.println(line);
+  display.setCursor(0, 20);
+  display.println("Position:");
+  display.setCursor(0, 30);
+  display.println("Lat: 35.6812 Long:  139.7671 Height above MSL:   40.12 m");
+}
+
+// I2Cのビット時間: 送信ごとにSTART, アドレス (8bit + ACK), STOP、バイトごとに8bit + ACK
+static uint32_t i2cBitTimes(const Sh1106Panel &panel)
+{
+  return panel.transmissions * (1 + 9 + 1) + panel.busBytes() * 9;
+}
+
+// display() が送ったページと列の範囲
+struct Span
+{
+  uint8_t page;
+  uint8_t column;
+  std::vector<uint8_t> data;
+};
+
+// Wireの送信を横取りしてパネルに渡し、アドレスのコマンドとデータからSpanを作る
+static void captureSpans(Sh1106Panel &panel, std::vector<Span> &spans)
+{
+  panel.attachI2C(Wire);
+  auto receive = Wire.onTransmission;
+  Wire.onTransmission = [receive, &spans](uint8_t address, const uint8_t *data, size_t length)
+  {
+    receive(address, data, length);
+    if (length >= 7 && data[0] == 0x80 && data[6] == 0x40)
+    {
+      spans.push_back({(uint8_t)(data[1] & 0x07), (uint8_t)((data[5] & 0x0F) << 4 | (data[3] & 0x0F)),
+                       std::vector<uint8_t>(&data[7], &data[length])});
+    }
+    else if (length >= 1 && data[0] == 0x40 && !spans.empty())
+    {
+      spans.back().data.insert(spans.back().data.end(), &data[1], &data[length]);
+    }
+  };
+}
+
+// 以前のフレーミング: コマンドごとに1回の送信、データは16列ずつの送信
+static void sendLegacy(TwoWire &wire, const Span &span)
+{
+  const uint8_t commands[3] = {(uint8_t)(0xB0 + span.page), (uint8_t)(span.column & 0x0F), (uint8_t)(0x10 | span.column >> 4)};
+  for (uint8_t c : commands)
+  {
+    wire.beginTransmission(SH1106_I2C_ADDRESS);
+    wire.write(0x00);
+    wire.write(c);
+    wire.endTransmission();
+  }
+  for (size_t i = 0; i < span.data.size(); i += 16)
+  {
+    wire.beginTransmission(SH1106_I2C_ADDRESS);
+    wire.write(0x40);
+    wire.write(&span.data[i], min((size_t)16, span.data.size() - i));
+    wire.endTransmission();
+  }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// begin() の後の最初のdisplay()はすべてのページを送る
+void test_first_frame_is_complete(void)
+{
+  TestDisplay display(PIN_RST, Wire);
+  Sh1106Panel panel;
+  panel.attachI2C(Wire);
+  display.begin(SH1106_SWITCHCAPVCC, SH1106_I2C_ADDRESS);
+  // 初期化列はコマンドごとに1つの送信
+  TEST_ASSERT_EQUAL_UINT32(0, panel.dataBytes);
+  TEST_ASSERT_EQUAL_UINT32(panel.transmissions * 2, panel.busBytes());
+
+  TEST_ASSERT_EQUAL_UINT32(FULL_FRAME_I2C_BYTES, flush(display, panel));
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES, panel.transmissions);
+
+  // invalidate() の後も全部送る
+  display.invalidate();
+  TEST_ASSERT_EQUAL_UINT32(FULL_FRAME_I2C_BYTES, flush(display, panel));
+}
+
+// displayInfo() と同じく毎秒消して描き直す。秒の桁が変わった列だけが送られる
+void test_seconds_tick(void)
+{
+  TestDisplay display(PIN_RST, Wire);
+  Sh1106Panel panel;
+  panel.attachI2C(Wire);
+  display.begin(SH1106_SWITCHCAPVCC, SH1106_I2C_ADDRESS);
+
+  uint32_t total = 0, worst = 0;
+  for (int sec = 0; sec < 120; sec++)
+  {
+    drawInfo(display, sec);
+    uint32_t bytes = flush(display, panel);
+    if (sec > 0)
+    {
+      total += bytes;
+      worst = max(worst, bytes);
+    }
+  }
+
+  char message[160];
+  snprintf(message, sizeof(message), "seconds tick: %.1f bytes/frame on average, %u at most, full frame %u bytes",
+           total / 119.0, (unsigned)worst, (unsigned)FULL_FRAME_I2C_BYTES);
+  TEST_MESSAGE(message);
+  // y=10の行は2ページにまたがる。1つのページに送るのは、分が変わっても分の1の位から秒の1の位までの5文字分まで
+  TEST_ASSERT_TRUE(worst <= 2 * (7 + 5 * 6));
+  TEST_ASSERT_TRUE(total < 119 * FULL_FRAME_I2C_BYTES / 20);
+}
+
+void test_random_drawing_i2c(void)
+{
+  TestDisplay display(PIN_RST, Wire);
+  Sh1106Panel panel;
+  panel.attachI2C(Wire);
+  display.begin(SH1106_SWITCHCAPVCC, SH1106_I2C_ADDRESS);
+  flush(display, panel);
+
+  double ratio = replay(display, panel, FULL_FRAME_I2C_BYTES, 3000);
+  char message[100];
+  snprintf(message, sizeof(message), "random drawing over I2C: %.1f%% of full frames", ratio * 100);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(ratio < 0.5);
+}
+
+void test_random_drawing_hw_spi(void)
+{
+  TestDisplay display(PIN_DC, PIN_RST, PIN_CS);
+  Sh1106Panel panel;
+  panel.attachSPI(SPI, PIN_DC, PIN_CS);
+  display.begin(SH1106_SWITCHCAPVCC);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES * (3 + 128), flush(display, panel));
+
+  double ratio = replay(display, panel, SH1106_PAGES * (3 + 128), 3000);
+  TEST_ASSERT_TRUE(ratio < 0.5);
+  TEST_ASSERT_EQUAL_UINT32(0, panel.ignoredBytes);
+}
+
+void test_random_drawing_soft_spi(void)
+{
+  TestDisplay display(PIN_SID, PIN_SCLK, PIN_DC, PIN_RST, PIN_CS);
+  Sh1106Panel panel;
+  panel.attachSoftSPI(PIN_SID, PIN_SCLK, PIN_DC, PIN_CS);
+  display.begin(SH1106_SWITCHCAPVCC);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES * (3 + 128), flush(display, panel));
+
+  double ratio = replay(display, panel, SH1106_PAGES * (3 + 128), 500);
+  TEST_ASSERT_TRUE(ratio < 0.5);
+}
+
+// 同じフレームを以前のフレーミングでWire1のパネルに送り直し、全画面と毎秒の描き直し (最初の描画を除く) のビット時間を比べる
+void test_framing_bus_time(void)
+{
+  TestDisplay display(PIN_RST, Wire);
+  Sh1106Panel panel, legacy;
+  std::vector<Span> spans;
+  captureSpans(panel, spans);
+  legacy.attachI2C(Wire1);
+  display.begin(SH1106_SWITCHCAPVCC, SH1106_I2C_ADDRESS);
+  display.clearDisplay();
+
+  uint32_t bits[2][2] = {}; // [全画面, 毎秒][今, 以前]
+  for (int sec = -1; sec < 120; sec++)
+  {
+    if (sec >= 0)
+    {
+      drawInfo(display, sec);
+    }
+    spans.clear();
+    flush(display, panel);
+    legacy.resetCounters();
+    for (const Span &span : spans)
+    {
+      sendLegacy(Wire1, span);
+    }
+    TEST_ASSERT_TRUE(legacy.shows(display.frame(), SH1106_LCDWIDTH, SH1106_PAGES));
+    if (sec != 0)
+    {
+      uint32_t *b = bits[sec < 0 ? 0 : 1];
+      b[0] += i2cBitTimes(panel);
+      b[1] += i2cBitTimes(legacy);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES * (7 + 128) * 9 + SH1106_PAGES * 11, bits[0][0]);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES * (3 * (2 * 9 + 11) + 8 * (17 * 9 + 11)), bits[0][1]);
+
+  char message[160];
+  const char *names[2] = {"full frame", "seconds tick"};
+  for (int i = 0; i < 2; i++)
+  {
+    double frames = i == 0 ? 1 : 119;
+    snprintf(message, sizeof(message), "%s: %.0f bit-times (%.2f ms at 400 kHz) before, %.0f (%.2f ms) after",
+             names[i], bits[i][1] / frames, bits[i][1] / frames / 400.0, bits[i][0] / frames, bits[i][0] / frames / 400.0);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(bits[i][0] < bits[i][1]);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_first_frame_is_complete);
+  RUN_TEST(test_seconds_tick);
+  RUN_TEST(test_random_drawing_i2c);
+  RUN_TEST(test_random_drawing_hw_spi);
+  RUN_TEST(test_random_drawing_soft_spi);
+  RUN_TEST(test_framing_bus_time);
+  return UNITY_END();
+}
@@ -0,0 +1,551 @@
+// SH1106<W, H, ROT> の描画をテンプレート化する前のドライバと比べる
+// LegacySh1106 は以前の Adafruit_SH1106 の描画部分 (回転と色を画素ごとに判定するdrawPixel、
+// drawFastH/VLineInternal、Adafruit_GFXの既定のfillRectとdrawChar) をそのまま移したもの。
+// 4つの回転で同じ画素になることを確かめ、fillRect、文字、全画面の消去と塗りつぶしの時間を測る。
+
+#include <unity.h>
+#include <Adafruit_SH1106.h>
+#include <chrono>
+
+#define PIN_RST 20
+#define BENCH_RECTS 20000
+#define BENCH_TEXT_FRAMES 2000
+#define BENCH_CLEARS 20000
+
+#define sh1106_swap(a, b) \
+  {                       \
+    int16_t t = a;        \
+    a = b;                \
+    b = t;                \
+  }
+
+// 以前のドライバの描画部分
+class LegacySh1106 : public Adafruit_GFX
+{
+public:
+  uint8_t buffer[SH1106_LCDHEIGHT * SH1106_LCDWIDTH / 8];
+
+  LegacySh1106() : Adafruit_GFX(SH1106_LCDWIDTH, SH1106_LCDHEIGHT) { clearDisplay(); }
+
+  void clearDisplay(void) { memset(buffer, 0, (SH1106_LCDWIDTH * SH1106_LCDHEIGHT / 8)); }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color)
+  {
+    if ((x < 0) || (x >= width()) || (y < 0) || (y >= height()))
+      return;
+
+    // check rotation, move pixel around if necessary
+    switch (getRotation())
+    {
+    case 1:
+      sh1106_swap(x, y);
+      x = WIDTH - x - 1;
+      break;
+    case 2:
+      x = WIDTH - x - 1;
+      y = HEIGHT - y - 1;
+      break;
+    case 3:
+      sh1106_swap(x, y);
+      y = HEIGHT - y - 1;
+      break;
+    }
+
+    // x is which column
+    switch (color)
+    {
+    case WHITE:
+      buffer[x + (y / 8) * SH1106_LCDWIDTH] |= (1 << (y & 7));
+      break;
+    case BLACK:
+      buffer[x + (y / 8) * SH1106_LCDWIDTH] &= ~(1 << (y & 7));
+      break;
+    case INVERSE:
+      buffer[x + (y / 8) * SH1106_LCDWIDTH] ^= (1 << (y & 7));
+      break;
+    }
+  }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+  {
+    bool bSwap = false;
+    switch (rotation)
+    {
+    case 0:
+      break;
+    case 1:
+      bSwap = true;
+      sh1106_swap(x, y);
+      x = WIDTH - x - 1;
+      break;
+    case 2:
+      x = WIDTH - x - 1;
+      y = HEIGHT - y - 1;
+      x -= (w - 1);
+      break;
+    case 3:
+      bSwap = true;
+      sh1106_swap(x, y);
+      y = HEIGHT - y - 1;
+      y -= (w - 1);
+      break;
+    }
+
+    if (bSwap)
+    {
+      drawFastVLineInternal(x, y, w, color);
+    }
+    else
+    {
+      drawFastHLineInternal(x, y, w, color);
+    }
+  }
+
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+  {
+    bool bSwap = false;
+    switch (rotation)
+    {
+    case 0:
+      break;
+    case 1:
+      bSwap = true;
+      sh1106_swap(x, y);
+      x = WIDTH - x - 1;
+      x -= (h - 1);
+      break;
+    case 2:
+      x = WIDTH - x - 1;
+      y = HEIGHT - y - 1;
+      y -= (h - 1);
+      break;
+    case 3:
+      bSwap = true;
+      sh1106_swap(x, y);
+      y = HEIGHT - y - 1;
+      break;
+    }
+
+    if (bSwap)
+    {
+      drawFastHLineInternal(x, y, h, color);
+    }
+    else
+    {
+      drawFastVLineInternal(x, y, h, color);
+    }
+  }
+
+private:
+  void drawFastHLineInternal(int16_t x, int16_t y, int16_t w, uint16_t color)
+  {
+    if (y < 0 || y >= HEIGHT)
+      return;
+    if (x < 0)
+    {
+      w += x;
+      x = 0;
+    }
+    if ((x + w) > WIDTH)
+      w = (WIDTH - x);
+    if (w <= 0)
+      return;
+
+    uint8_t *pBuf = buffer;
+    pBuf += ((y / 8) * SH1106_LCDWIDTH);
+    pBuf += x;
+
+    uint8_t mask = 1 << (y & 7);
+    switch (color)
+    {
+    case WHITE:
+      while (w--)
+        *pBuf++ |= mask;
+      break;
+    case BLACK:
+      mask = ~mask;
+      while (w--)
+        *pBuf++ &= mask;
+      break;
+    case INVERSE:
+      while (w--)
+        *pBuf++ ^= mask;
+      break;
+    }
+  }
+
+  void drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h, uint16_t color)
+  {
+    if (x < 0 || x >= WIDTH)
+      return;
+    if (__y < 0)
+    {
+      __h += __y;
+      __y = 0;
+    }
+    if ((__y + __h) > HEIGHT)
+      __h = (HEIGHT - __y);
+    if (__h <= 0)
+      return;
+
+    uint8_t y = __y;
+    uint8_t h = __h;
+
+    uint8_t *pBuf = buffer;
+    pBuf += ((y / 8) * SH1106_LCDWIDTH);
+    pBuf += x;
+
+    // do the first partial byte, if necessary - this requires some masking
+    uint8_t mod = (y & 7);
+    if (mod)
+    {
+      mod = 8 - mod;
+      static uint8_t premask[8] = {0x00, 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC, 0xFE};
+      uint8_t mask = premask[mod];
+      if (h < mod)
+        mask &= (0XFF >> (mod - h));
+
+      switch (color)
+      {
+      case WHITE:
+        *pBuf |= mask;
+        break;
+      case BLACK:
+        *pBuf &= ~mask;
+        break;
+      case INVERSE:
+        *pBuf ^= mask;
+        break;
+      }
+      if (h < mod)
+        return;
+
+      h -= mod;
+      pBuf += SH1106_LCDWIDTH;
+    }
+
+    // write solid bytes while we can - effectively doing 8 rows at a time
+    if (h >= 8)
+    {
+      if (color == INVERSE)
+      {
+        do
+        {
+          *pBuf = ~(*pBuf);
+          pBuf += SH1106_LCDWIDTH;
+          h -= 8;
+        } while (h >= 8);
+      }
+      else
+      {
+        uint8_t val = (color == WHITE) ? 255 : 0;
+        do
+        {
+          *pBuf = val;
+          pBuf += SH1106_LCDWIDTH;
+          h -= 8;
+        } while (h >= 8);
+      }
+    }
+
+    // now do the final partial byte, if necessary
+    if (h)
+    {
+      mod = h & 7;
+      static uint8_t postmask[8] = {0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F};
+      uint8_t mask = postmask[mod];
+      switch (color)
+      {
+      case WHITE:
+        *pBuf |= mask;
+        break;
+      case BLACK:
+        *pBuf &= ~mask;
+        break;
+      case INVERSE:
+        *pBuf ^= mask;
+        break;
+      }
+    }
+  }
+};
+
+template <uint8_t ROT>
+class TestDisplay : public SH1106<SH1106_LCDWIDTH, SH1106_LCDHEIGHT, ROT>
+{
+public:
+  TestDisplay() : SH1106<SH1106_LCDWIDTH, SH1106_LCDHEIGHT, ROT>(PIN_RST, Wire) { this->clearDisplay(); }
+  const uint8_t *frame() const { return this->buffer; }
+};
+
+struct Rect
+{
+  int16_t x, y, w, h;
+  uint16_t color;
+};
+
+static uint32_t rng = 3141592653UL;
+static uint32_t nextRandom()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static Rect randomRect(int16_t width, int16_t height)
+{
+  Rect r;
+  r.x = (int16_t)(nextRandom() % (width + 20)) - 10;
+  r.y = (int16_t)(nextRandom() % (height + 20)) - 10;
+  r.w = nextRandom() % (width / 2);
+  r.h = nextRandom() % (height / 2);
+  r.color = nextRandom() % 3;
+  return r;
+}
+
+static double nanoseconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char *name, double legacy, double current, const char *unit)
+{
+  char message[160];
+  snprintf(message, sizeof(message), "%s: %.1f -> %.1f ns/%s (x%.1f)", name, legacy, current, unit, legacy / current);
+  TEST_MESSAGE(message);
+}
+
+// 同じ描画を両方に行い、バッファを比べる
+template <uint8_t ROT>
+static void assertSamePixels()
+{
+  TestDisplay<ROT> current;
+  LegacySh1106 legacy;
+  legacy.setRotation(ROT);
+  TEST_ASSERT_EQUAL_INT(legacy.width(), current.width());
+  TEST_ASSERT_EQUAL_INT(legacy.height(), current.height());
+
+  for (int i = 0; i < 20000; i++)
+  {
+    Rect r = randomRect(legacy.width(), legacy.height());
+    switch (nextRandom() % 7)
+    {
+    case 0:
+      current.drawPixel(r.x, r.y, r.color);
+      legacy.drawPixel(r.x, r.y, r.color);
+      break;
+    case 1:
+      current.drawFastHLine(r.x, r.y, r.w, r.color);
+      legacy.drawFastHLine(r.x, r.y, r.w, r.color);
+      break;
+    case 2:
+      current.drawFastVLine(r.x, r.y, r.h, r.color);
+      legacy.drawFastVLine(r.x, r.y, r.h, r.color);
+      break;
+    case 3:
+      current.fillRect(r.x, r.y, r.w, r.h, r.color);
+      legacy.fillRect(r.x, r.y, r.w, r.h, r.color);
+      break;
+    case 4:
+    {
+      // 文字の大きさと背景色
+      uint8_t size = nextRandom() % 4 == 0 ? 2 : 1;
+      uint16_t bg = nextRandom() % 2 ? r.color : (uint16_t)(nextRandom() % 3);
+      char c = ' ' + nextRandom() % 95;
+      current.setTextSize(size);
+      legacy.setTextSize(size);
+      current.setTextColor(r.color, bg);
+      legacy.setTextColor(r.color, bg);
+      current.setCursor(r.x, r.y);
+      legacy.setCursor(r.x, r.y);
+      current.print(c);
+      legacy.print(c);
+      TEST_ASSERT_EQUAL_INT(legacy.getCursorX(), current.getCursorX());
+      break;
+    }
+    case 5:
+      if (nextRandom() % 50 == 0)
+      {
+        uint16_t color = nextRandom() % 3;
+        current.fillScreen(color);
+        legacy.fillScreen(color);
+      }
+      break;
+    case 6:
+      if (nextRandom() % 50 == 0)
+      {
+        current.clearDisplay();
+        legacy.clearDisplay();
+      }
+      break;
+    }
+  }
+  TEST_ASSERT_EQUAL_MEMORY(legacy.buffer, current.frame(), sizeof(legacy.buffer));
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_same_pixels_in_every_rotation(void)
+{
+  assertSamePixels<0>();
+  assertSamePixels<1>();
+  assertSamePixels<2>();
+  assertSamePixels<3>();
+}
+
+// drawPixel() を数える
+template <uint8_t ROT>
+class PixelCounter : public TestDisplay<ROT>
+{
+public:
+  uint32_t pixels = 0;
+  void drawPixel(int16_t x, int16_t y, uint16_t color)
+  {
+    pixels++;
+    TestDisplay<ROT>::drawPixel(x, y, color);
+  }
+};
+
+// Adafruit_GFXのdrawChar() はvirtualではないので、print() は write() の上書きでblitChar() に届く
+void test_print_uses_blit(void)
+{
+  PixelCounter<0> display;
+  Print &out = display;
+  display.setTextColor(WHITE);
+  out.println("2026/10/16 12:34:56");
+  display.setTextColor(WHITE, BLACK);
+  out.print("Position: 35.6812 139.7671");
+  TEST_ASSERT_EQUAL_UINT32(0, display.pixels);
+
+  // 回転したパネルは画素ごとの経路を通る
+  PixelCounter<1> rotated;
+  Print &rotatedOut = rotated;
+  rotated.setTextColor(WHITE, BLACK);
+  rotatedOut.print("12:34:56");
+  TEST_ASSERT_TRUE(rotated.pixels >= 8 * 5 * 8);
+}
+
+template <class Display>
+static double timeRects(Display &display, const Rect *rects)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_RECTS; i++)
+  {
+    display.fillRect(rects[i].x, rects[i].y, rects[i].w, rects[i].h, rects[i].color);
+  }
+  return nanoseconds(start) / BENCH_RECTS;
+}
+
+void test_benchmark_fill_rect(void)
+{
+  static Rect rects[BENCH_RECTS];
+  for (int i = 0; i < BENCH_RECTS; i++)
+  {
+    rects[i] = randomRect(SH1106_LCDWIDTH, SH1106_LCDHEIGHT);
+  }
+  TestDisplay<0> current;
+  LegacySh1106 legacy;
+  double a = timeRects(legacy, rects);
+  double b = timeRects(current, rects);
+  report("fillRect", a, b, "rect");
+  TEST_ASSERT_EQUAL_MEMORY(legacy.buffer, current.frame(), sizeof(legacy.buffer));
+  TEST_ASSERT_TRUE(b < a);
+
+  // 90度回転
+  TestDisplay<1> rotated;
+  legacy.clearDisplay();
+  legacy.setRotation(1);
+  for (int i = 0; i < BENCH_RECTS; i++)
+  {
+    rects[i] = randomRect(SH1106_LCDHEIGHT, SH1106_LCDWIDTH);
+  }
+  a = timeRects(legacy, rects);
+  b = timeRects(rotated, rects);
+  report("fillRect, rotation 1", a, b, "rect");
+  TEST_ASSERT_EQUAL_MEMORY(legacy.buffer, rotated.frame(), sizeof(legacy.buffer));
+  TEST_ASSERT_TRUE(b < a);
+}
+
+// displayInfo() のような行を描く (長い行は折り返して、1画面で8行)
+template <class Display>
+static double timeText(Display &display)
+{
+  static const char *const lines[] = {
+      "DateTime:", "2026/10/16 12:34:56", "Position:", "Lat: 35.6812 Long:  139.7671 Height above MSL:   40.12 m",
+      "Sats 12/31  PPS lock", "NTP 1234 req/s",
+  };
+  uint32_t chars = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < BENCH_TEXT_FRAMES; frame++)
+  {
+    display.clearDisplay();
+    display.setTextColor(WHITE, frame % 2 ? WHITE : BLACK);
+    display.setCursor(0, frame % 3);
+    for (const char *line : lines)
+    {
+      chars += display.println(line) - 2;
+    }
+  }
+  return nanoseconds(start) / chars;
+}
+
+void test_benchmark_text(void)
+{
+  TestDisplay<0> current;
+  LegacySh1106 legacy;
+  double a = timeText(legacy);
+  double b = timeText(current);
+  report("text", a, b, "char");
+  TEST_ASSERT_EQUAL_MEMORY(legacy.buffer, current.frame(), sizeof(legacy.buffer));
+  TEST_ASSERT_TRUE(b < a);
+}
+
+void test_benchmark_clear(void)
+{
+  TestDisplay<0> current;
+  LegacySh1106 legacy;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_CLEARS; i++)
+  {
+    legacy.clearDisplay();
+  }
+  double a = nanoseconds(start) / BENCH_CLEARS;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_CLEARS; i++)
+  {
+    current.clearDisplay();
+  }
+  double b = nanoseconds(start) / BENCH_CLEARS;
+  // 消去はどちらもmemset。dirtyの範囲を付ける分だけ増える
+  report("clearDisplay", a, b, "frame");
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_CLEARS; i++)
+  {
+    legacy.fillScreen(i % 2 ? WHITE : INVERSE);
+  }
+  a = nanoseconds(start) / BENCH_CLEARS;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_CLEARS; i++)
+  {
+    current.fillScreen(i % 2 ? WHITE : INVERSE);
+  }
+  b = nanoseconds(start) / BENCH_CLEARS;
+  report("fillScreen", a, b, "frame");
+  TEST_ASSERT_EQUAL_MEMORY(legacy.buffer, current.frame(), sizeof(legacy.buffer));
+  TEST_ASSERT_TRUE(b < a);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_same_pixels_in_every_rotation);
+  RUN_TEST(test_print_uses_blit);
+  RUN_TEST(test_benchmark_fill_rect);
+  RUN_TEST(test_benchmark_text);
+  RUN_TEST(test_benchmark_clear);
+  return UNITY_END();
+}
@@ -0,0 +1,203 @@
+// displayAsync() がDMAでI2Cに流すIC_DATA_CMDのワード列 (queueFrame()) をホストで確かめる
+// ワード列をSTOPで区切って送信に戻し、Sh1106Panel に渡して表示を再現する。
+// 並べた後にバッファへ描いても、送信中のフレームは並べた時点の内容のままで、次のフレームに変わった分だけが載ること、
+// display() がWireに送るバイトと同じであることを見る。
+
+#include <unity.h>
+#include <Adafruit_SH1106.h>
+#include <Sh1106_Panel.h>
+#include <algorithm>
+#include <vector>
+
+#define PIN_RST 20
+#define STREAM_WORDS SH1106_STREAM_WORDS(SH1106_LCDWIDTH, SH1106_LCDHEIGHT)
+
+class TestDisplay : public Adafruit_SH1106
+{
+public:
+  using Adafruit_SH1106::Adafruit_SH1106;
+  const uint8_t *frame() const { return buffer; }
+};
+
+typedef std::vector<std::vector<uint8_t>> Transmissions;
+
+static uint32_t rng = 521288629UL;
+static uint32_t nextRandom()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static void drawRandom(TestDisplay &display)
+{
+  uint16_t color = nextRandom() % 3;
+  int16_t x = (int16_t)(nextRandom() % 160) - 16;
+  int16_t y = (int16_t)(nextRandom() % 96) - 16;
+  switch (nextRandom() % 4)
+  {
+  case 0:
+    display.drawPixel(x, y, color);
+    break;
+  case 1:
+    display.fillRect(x, y, nextRandom() % 40, nextRandom() % 40, color);
+    break;
+  case 2:
+    display.setCursor(x, y);
+    display.setTextColor(color, nextRandom() % 3);
+    display.print((char)(' ' + nextRandom() % 95));
+    break;
+  case 3:
+    if (nextRandom() % 16 == 0)
+    {
+      display.clearDisplay();
+    }
+    break;
+  }
+}
+
+// I2Cコントローラと同じく、STOPの付いたワードで送信を終える
+static Transmissions split(const uint16_t *words, uint16_t n)
+{
+  Transmissions out;
+  std::vector<uint8_t> current;
+  for (uint16_t i = 0; i < n; i++)
+  {
+    // 読み出し (CMD) やRESTARTのビットは使わない
+    TEST_ASSERT_EQUAL_HEX16(0, words[i] & ~(SH1106_STREAM_STOP | 0xFF));
+    current.push_back(words[i] & 0xFF);
+    if (words[i] & SH1106_STREAM_STOP)
+    {
+      out.push_back(current);
+      current.clear();
+    }
+  }
+  // 最後のワードにはSTOPが付いている
+  TEST_ASSERT_EQUAL_UINT32(0, current.size());
+  return out;
+}
+
+static void send(const Transmissions &transmissions)
+{
+  for (const std::vector<uint8_t> &t : transmissions)
+  {
+    Wire.beginTransmission(SH1106_I2C_ADDRESS);
+    Wire.write(t.data(), t.size());
+    Wire.endTransmission();
+  }
+}
+
+void setUp(void) {}
+void tearDown(void) { Wire.onTransmission = nullptr; }
+
+// invalidate() の後は全ページが1ページ1送信で並ぶ
+void test_full_frame(void)
+{
+  TestDisplay display(PIN_RST, Wire);
+  Sh1106Panel panel;
+  panel.attachI2C(Wire);
+  display.begin(SH1106_SWITCHCAPVCC, SH1106_I2C_ADDRESS);
+
+  static uint16_t stream[STREAM_WORDS];
+  uint16_t n = display.queueFrame(stream);
+  TEST_ASSERT_EQUAL_UINT32(STREAM_WORDS, n);
+  Transmissions transmissions = split(stream, n);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES, transmissions.size());
+
+  send(transmissions);
+  TEST_ASSERT_TRUE(panel.shows(display.frame(), SH1106_LCDWIDTH, SH1106_PAGES));
+  TEST_ASSERT_EQUAL_UINT32(0, display.queueFrame(stream));
+}
+
+// フレームを並べた後も描き続ける (DMAが送っている間にcore0が次のフレームを描く)
+void test_drawing_while_in_flight(void)
+{
+  TestDisplay display(PIN_RST, Wire);
+  Sh1106Panel panel;
+  panel.attachI2C(Wire);
+  display.begin(SH1106_SWITCHCAPVCC, SH1106_I2C_ADDRESS);
+
+  static uint16_t stream[STREAM_WORDS];
+  static uint8_t queued[SH1106_LCDWIDTH * SH1106_PAGES];
+  uint32_t words = 0;
+  for (int frame = 0; frame < 2000; frame++)
+  {
+    for (uint32_t k = nextRandom() % 6; k > 0; k--)
+    {
+      drawRandom(display);
+    }
+    uint16_t n = display.queueFrame(stream);
+    TEST_ASSERT_TRUE(n <= STREAM_WORDS);
+    words += n;
+    memcpy(queued, display.frame(), sizeof(queued));
+    std::vector<uint16_t> copy(stream, stream + n);
+
+    // 送っている間に描く
+    for (uint32_t k = 1 + nextRandom() % 6; k > 0; k--)
+    {
+      drawRandom(display);
+    }
+    TEST_ASSERT_TRUE(std::equal(copy.begin(), copy.end(), stream));
+
+    send(split(stream, n));
+    TEST_ASSERT_TRUE(panel.shows(queued, SH1106_LCDWIDTH, SH1106_PAGES));
+  }
+  // 最後に描いた分は次のフレームに載る
+  send(split(stream, display.queueFrame(stream)));
+  TEST_ASSERT_TRUE(panel.shows(display.frame(), SH1106_LCDWIDTH, SH1106_PAGES));
+
+  char message[100];
+  snprintf(message, sizeof(message), "%.1f words/frame, full frame %u", words / 2000.0, (unsigned)STREAM_WORDS);
+  TEST_MESSAGE(message);
+}
+
+// queueFrame() はdisplay() がWireで送るのと同じ送信を作る
+void test_same_bytes_as_display(void)
+{
+  TestDisplay a(PIN_RST, Wire);
+  TestDisplay b(PIN_RST, Wire);
+  a.begin(SH1106_SWITCHCAPVCC, SH1106_I2C_ADDRESS);
+  b.begin(SH1106_SWITCHCAPVCC, SH1106_I2C_ADDRESS);
+
+  Transmissions sent;
+  Wire.onTransmission = [&sent](uint8_t address, const uint8_t *data, size_t length)
+  {
+    TEST_ASSERT_EQUAL_HEX8(SH1106_I2C_ADDRESS, address);
+    sent.push_back(std::vector<uint8_t>(data, data + length));
+  };
+
+  static uint16_t stream[STREAM_WORDS];
+  for (int frame = 0; frame < 500; frame++)
+  {
+    uint32_t saved = rng;
+    for (uint32_t k = nextRandom() % 6; k > 0; k--)
+    {
+      drawRandom(a);
+    }
+    rng = saved;
+    for (uint32_t k = nextRandom() % 6; k > 0; k--)
+    {
+      drawRandom(b);
+    }
+
+    sent.clear();
+    a.display();
+    Transmissions queued = split(stream, b.queueFrame(stream));
+    TEST_ASSERT_EQUAL_UINT32(sent.size(), queued.size());
+    for (size_t i = 0; i < sent.size(); i++)
+    {
+      TEST_ASSERT_EQUAL_UINT32(sent[i].size(), queued[i].size());
+      TEST_ASSERT_EQUAL_MEMORY(sent[i].data(), queued[i].data(), sent[i].size());
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_full_frame);
+  RUN_TEST(test_drawing_while_in_flight);
+  RUN_TEST(test_same_bytes_as_display);
+  return UNITY_END();
+}
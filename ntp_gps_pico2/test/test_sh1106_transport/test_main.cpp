@@ -0,0 +1,166 @@
+// SH1106の3つのトランスポート (I2C、ハードウェアSPI、ソフトウェアSPI) で全画面を1回送るときの量を測る
+// バスに出たバイトと送信の数はWire/SPIの代用品とSh1106Panelで数え、パネルの表示がバッファと同じになることも確かめる。
+// バス上の時間はバイト数とクロックから求める (I2Cは1バイト9ビット、送信ごとにSTART・アドレス・STOPの11ビット) 。
+// CPU時間はホストでdisplay()にかかった時間で、ドライバの処理の重さの目安にしかならない。
+
+#include <unity.h>
+#include <Adafruit_SH1106.h>
+#include <Sh1106_Panel.h>
+#include <chrono>
+
+#define PIN_RST 20
+#define PIN_DC 21
+#define PIN_CS 22
+#define PIN_SID 23
+#define PIN_SCLK 24
+
+#define FRAMES 2000
+#define I2C_TRANSMISSION_BITS 11 // START、アドレスとACK、STOP
+#define I2C_BYTE_BITS 9          // 8ビットとACK
+
+class TestDisplay : public Adafruit_SH1106
+{
+public:
+  using Adafruit_SH1106::Adafruit_SH1106;
+  const uint8_t *frame() const { return buffer; }
+};
+
+// 全画面を送ったときにバスに出たもの
+struct FrameCost
+{
+  uint32_t bytes;     // I2Cのコントロールバイトを含み、アドレスは含まない
+  uint32_t transfers; // I2Cの送信、SPIのトランザクション (CSの区間)
+  uint32_t bits;      // バス上のビット時間
+  uint32_t pinWrites; // digitalWrite() の回数
+  double cpuNs;       // ホストでのdisplay() 1回
+};
+
+static void fillPattern(TestDisplay &display)
+{
+  for (int16_t y = 0; y < display.height(); y += 4)
+  {
+    display.drawFastHLine(0, y, display.width(), WHITE);
+  }
+  display.setCursor(0, 10);
+  display.setTextColor(INVERSE);
+  display.print("2026/10/16 12:34:56");
+}
+
+// 1フレームをパネルに送って確かめ、その後はパネルなしで時間を測る
+static FrameCost measure(TestDisplay &display, Sh1106Panel &panel)
+{
+  fillPattern(display);
+  display.invalidate();
+
+  FrameCost cost = {};
+  uint32_t wireBytes = Wire.bytes, wireTransmissions = Wire.transmissions;
+  uint32_t spiBytes = SPI.bytes, spiTransactions = SPI.transactions;
+  uint32_t pinWrites = hostPinWrites;
+  uint32_t sent = display.getBytesSent();
+  panel.resetCounters();
+  display.display();
+
+  TEST_ASSERT_TRUE(panel.shows(display.frame(), SH1106_LCDWIDTH, SH1106_PAGES));
+  TEST_ASSERT_EQUAL_UINT32(display.getBytesSent() - sent, panel.busBytes());
+  cost.bytes = panel.busBytes();
+  cost.transfers = panel.transmissions;
+  cost.pinWrites = hostPinWrites - pinWrites;
+  switch (display.getTransport())
+  {
+  case SH1106_TRANSPORT_I2C:
+    TEST_ASSERT_EQUAL_UINT32(Wire.bytes - wireBytes, cost.bytes);
+    TEST_ASSERT_EQUAL_UINT32(Wire.transmissions - wireTransmissions, cost.transfers);
+    cost.bits = cost.transfers * I2C_TRANSMISSION_BITS + cost.bytes * I2C_BYTE_BITS;
+    break;
+  case SH1106_TRANSPORT_HW_SPI:
+    TEST_ASSERT_EQUAL_UINT32(SPI.bytes - spiBytes, cost.bytes);
+    TEST_ASSERT_EQUAL_UINT32(SPI.transactions - spiTransactions, cost.transfers);
+    cost.bits = cost.bytes * 8;
+    break;
+  case SH1106_TRANSPORT_SOFT_SPI:
+    cost.bits = cost.bytes * 8;
+    break;
+  }
+
+  panel.detach();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < FRAMES; i++)
+  {
+    display.invalidate();
+    display.display();
+  }
+  cost.cpuNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+  return cost;
+}
+
+static void report(const char *name, const FrameCost &cost, uint32_t clock)
+{
+  char message[200];
+  snprintf(message, sizeof(message),
+           "%s: %u bytes in %u transfers, %u bit times = %.2f ms at %u kHz, %u pin writes, host CPU %.1f us/frame",
+           name, (unsigned)cost.bytes, (unsigned)cost.transfers, (unsigned)cost.bits, cost.bits * 1000.0 / clock,
+           (unsigned)(clock / 1000), (unsigned)cost.pinWrites, cost.cpuNs / 1000.0);
+  TEST_MESSAGE(message);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// 1ページ1送信: コントロールバイトとページ・列アドレスの7バイト + 128列
+void test_i2c_full_frame(void)
+{
+  TestDisplay display(PIN_RST, Wire);
+  Sh1106Panel panel;
+  panel.attachI2C(Wire);
+  display.begin(SH1106_SWITCHCAPVCC, SH1106_I2C_ADDRESS);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_I2C_CLOCK, Wire.clock);
+
+  FrameCost cost = measure(display, panel);
+  report("I2C", cost, Wire.clock);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES * (7 + SH1106_LCDWIDTH), cost.bytes);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES, cost.transfers);
+  TEST_ASSERT_EQUAL_UINT32(0, cost.pinWrites);
+}
+
+// 1ページにつきアドレスの3コマンドとページのデータの2つのトランザクション
+void test_hw_spi_full_frame(void)
+{
+  TestDisplay display(PIN_DC, PIN_RST, PIN_CS);
+  Sh1106Panel panel;
+  panel.attachSPI(SPI, PIN_DC, PIN_CS);
+  display.begin(SH1106_SWITCHCAPVCC);
+
+  FrameCost cost = measure(display, panel);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_SPI_CLOCK, SPI.clock);
+  report("HW SPI", cost, SPI.clock);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES * (3 + SH1106_LCDWIDTH), cost.bytes);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES * 2, cost.transfers);
+  // トランザクションごとにD/C、CSを下げる、CSを上げるの3回
+  TEST_ASSERT_EQUAL_UINT32(cost.transfers * 3, cost.pinWrites);
+}
+
+// ホストにはPIOがないのでdigitalWrite() で叩く経路を通る
+void test_soft_spi_full_frame(void)
+{
+  TestDisplay display(PIN_SID, PIN_SCLK, PIN_DC, PIN_RST, PIN_CS);
+  Sh1106Panel panel;
+  panel.attachSoftSPI(PIN_SID, PIN_SCLK, PIN_DC, PIN_CS);
+  display.begin(SH1106_SWITCHCAPVCC);
+
+  FrameCost cost = measure(display, panel);
+  // バス上の時間はPIOで送る場合。ホストのCPU時間とピンの書き込みはdigitalWrite() で叩く場合
+  report("soft SPI", cost, SH1106_SPI_CLOCK);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES * (3 + SH1106_LCDWIDTH), cost.bytes);
+  TEST_ASSERT_EQUAL_UINT32(SH1106_PAGES * 2, cost.transfers);
+  // 1ビットに3回 (SCLKを下げる、SID、SCLKを上げる) と、トランザクションごとにD/C、CS、CS、最後のSCLK
+  TEST_ASSERT_EQUAL_UINT32(cost.bytes * 8 * 3 + cost.transfers * 4, cost.pinWrites);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_i2c_full_frame);
+  RUN_TEST(test_hw_spi_full_frame);
+  RUN_TEST(test_soft_spi_full_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,170 @@
+// SurveyInの平均位置と精度の見積もりを、相関のある位置の誤差で確かめる
+// NAV-PVTの代わりに、真の位置に1次の自己回帰 (AR(1)、相関時間60秒) の誤差を加えた1Hzの解を渡す。
+// 見積もった精度が、平均位置の実際の誤差と同じ程度になることを見る。
+
+#include <unity.h>
+#include <Survey_In.h>
+#include <math.h>
+#include <stdio.h>
+
+#define TRUE_LAT 356812345   // [1e-7 deg]
+#define TRUE_LON 1397654321  // [1e-7 deg]
+#define TRUE_HEIGHT 45000    // 楕円体高 [mm]
+#define NOISE_H 3.0          // 水平の誤差の標準偏差 [m]
+#define NOISE_V 5.0          // 垂直の誤差の標準偏差 [m]
+#define NOISE_TAU 60.0       // 誤差の相関時間 [s]
+#define SURVEYS 20
+#define METERS_PER_E7_DEG (6378137.0 * M_PI / 180.0 * 1e-7)
+
+class FixSim
+{
+public:
+  explicit FixSim(uint32_t seed) : rng_(seed) {}
+
+  // 次の1秒の解の北・東・上の誤差 [m]
+  void next(double error[3])
+  {
+    double a = exp(-1.0 / NOISE_TAU);
+    const double sigma[3] = {NOISE_H, NOISE_H, NOISE_V};
+    for (int k = 0; k < 3; k++)
+    {
+      state_[k] = a * state_[k] + sqrt(1.0 - a * a) * sigma[k] * gaussian();
+      error[k] = state_[k];
+    }
+  }
+
+  bool add(SurveyIn &survey, uint32_t hAcc = 2500, uint32_t vAcc = 4000)
+  {
+    double e[3];
+    next(e);
+    double eastScale = METERS_PER_E7_DEG * cos(TRUE_LAT * 1e-7 * M_PI / 180.0);
+    return survey.add(TRUE_LAT + (int32_t)lround(e[0] / METERS_PER_E7_DEG), TRUE_LON + (int32_t)lround(e[1] / eastScale),
+                      TRUE_HEIGHT + (int32_t)lround(e[2] * 1e3), hAcc, vAcc);
+  }
+
+private:
+  uint32_t rng_;
+  double state_[3] = {};
+
+  double uniform()
+  {
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    return (rng_ + 0.5) / 4294967296.0;
+  }
+  // Box-Muller
+  double gaussian() { return sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform()); }
+};
+
+// 平均位置の真の位置からの距離 (3D) [m]
+static double positionError(const SurveyPosition &p)
+{
+  double north = (p.latitude * 1e7 - TRUE_LAT) * METERS_PER_E7_DEG;
+  double east = (p.longitude * 1e7 - TRUE_LON) * METERS_PER_E7_DEG * cos(TRUE_LAT * 1e-7 * M_PI / 180.0);
+  double up = p.height - TRUE_HEIGHT * 1e-3;
+  return sqrt(north * north + east * east + up * up);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// 最低限の点数を平均するまでは、精度が目標に届いても完了しない
+void test_completes_after_min_samples(void)
+{
+  SurveyIn survey;
+  FixSim sim(2463534242UL);
+  TEST_ASSERT_TRUE(survey.accuracy() < 0.0);
+  uint32_t samples = 0;
+  while (survey.getState() == SURVEY_IN_RUNNING)
+  {
+    TEST_ASSERT_TRUE(sim.add(survey));
+    samples++;
+    TEST_ASSERT_TRUE(samples < 20000);
+  }
+  TEST_ASSERT_EQUAL_INT(SURVEY_IN_COMPLETE, survey.getState());
+  TEST_ASSERT_TRUE(samples >= SURVEY_IN_MIN_SAMPLES);
+  TEST_ASSERT_EQUAL_UINT32(samples, survey.getSamples());
+  TEST_ASSERT_TRUE(survey.accuracy() <= SURVEY_IN_TARGET_ACCURACY);
+
+  // 完了した後の解は使わない
+  TEST_ASSERT_FALSE(sim.add(survey));
+  TEST_ASSERT_EQUAL_UINT32(samples, survey.getSamples());
+}
+
+// 精度の悪い解は平均に入れない
+void test_rejects_poor_fixes(void)
+{
+  SurveyIn survey;
+  FixSim sim(88172645UL);
+  TEST_ASSERT_FALSE(sim.add(survey, SURVEY_IN_MAX_HACC + 1, 4000));
+  TEST_ASSERT_FALSE(sim.add(survey, 2500, SURVEY_IN_MAX_VACC + 1));
+  TEST_ASSERT_EQUAL_UINT32(0, survey.getSamples());
+  TEST_ASSERT_TRUE(sim.add(survey, SURVEY_IN_MAX_HACC, SURVEY_IN_MAX_VACC));
+  TEST_ASSERT_EQUAL_UINT32(1, survey.getSamples());
+}
+
+// 相関を割り引いた精度は、平均位置の実際の誤差と同じ程度になる
+void test_accuracy_tracks_actual_error(void)
+{
+  double sumSquares = 0.0, reported = 0.0, worst = 0.0;
+  for (uint32_t i = 0; i < SURVEYS; i++)
+  {
+    SurveyIn survey;
+    FixSim sim(12345 + 7919 * i);
+    while (survey.getState() == SURVEY_IN_RUNNING)
+    {
+      sim.add(survey);
+    }
+    SurveyPosition p = survey.position();
+    double error = positionError(p);
+    sumSquares += error * error;
+    reported += p.accuracy;
+    worst = fmax(worst, error);
+    TEST_ASSERT_EQUAL_UINT32(survey.getSamples(), p.samples);
+  }
+  double rms = sqrt(sumSquares / SURVEYS);
+  reported /= SURVEYS;
+
+  char line[160];
+  snprintf(line, sizeof(line), "%d surveys: actual error rms %.2f m, max %.2f m, reported accuracy %.2f m",
+           SURVEYS, rms, worst, reported);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(rms < 2.0 * reported);
+  TEST_ASSERT_TRUE(rms > 0.5 * reported);
+  TEST_ASSERT_TRUE(worst < 3.0 * SURVEY_IN_TARGET_ACCURACY);
+}
+
+// 保存した位置で固定すると、その位置と精度を返す。やり直すと最初から平均する
+void test_fix_and_restart(void)
+{
+  SurveyIn survey;
+  FixSim sim(521288629UL);
+  for (int i = 0; i < 100; i++)
+  {
+    sim.add(survey);
+  }
+  SurveyPosition stored = {35.6812345, 139.7654321, 45.0, 0.8f, 3600};
+  survey.fix(stored);
+  TEST_ASSERT_EQUAL_INT(SURVEY_IN_FIXED, survey.getState());
+  TEST_ASSERT_EQUAL_UINT32(3600, survey.getSamples());
+  TEST_ASSERT_DOUBLE_WITHIN(1e-6, 0.8, survey.accuracy());
+  TEST_ASSERT_DOUBLE_WITHIN(1e-9, stored.latitude, survey.position().latitude);
+  TEST_ASSERT_FALSE(sim.add(survey));
+
+  survey.restart();
+  TEST_ASSERT_EQUAL_INT(SURVEY_IN_RUNNING, survey.getState());
+  TEST_ASSERT_EQUAL_UINT32(0, survey.getSamples());
+  TEST_ASSERT_TRUE(sim.add(survey));
+  TEST_ASSERT_EQUAL_UINT32(1, survey.getSamples());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_completes_after_min_samples);
+  RUN_TEST(test_rejects_poor_fixes);
+  RUN_TEST(test_accuracy_tracks_actual_error);
+  RUN_TEST(test_fix_and_restart);
+  return UNITY_END();
+}
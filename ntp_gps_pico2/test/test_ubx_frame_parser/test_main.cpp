@@ -0,0 +1,283 @@
+// UbxFrameParserをGnssUartと同じ渡し方 (DMAのリングを折り返しの手前までずつ) で確かめる
+// フレームがどこで分割されても、リングの折り返しをまたいでも同じフレームが出てくること、
+// 壊れたフレームの中に始まる次のフレームを読み直して拾うこと (rescan) 、あふれた後にrestart()で立ち直ることを見る。
+
+#include <unity.h>
+#include <Ubx_Log.h>
+#include <vector>
+
+#define RING_SIZE 512 // 折り返しが頻繁に起きるように小さくする
+
+static uint32_t rng = 1234567UL;
+static uint32_t nextRandom()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static std::vector<uint8_t> makeFrame(uint8_t cls, uint8_t id, size_t payload)
+{
+  std::vector<uint8_t> p(payload);
+  for (size_t i = 0; i < payload; i++)
+  {
+    p[i] = nextRandom();
+  }
+  UbxLog log;
+  log.addFrame(cls, id, p);
+  return log.bytes;
+}
+
+static void append(std::vector<uint8_t> &stream, const std::vector<uint8_t> &bytes)
+{
+  stream.insert(stream.end(), bytes.begin(), bytes.end());
+}
+
+// 出てきたフレームを順に集める
+struct Collector
+{
+  UbxFrameParser parser;
+  std::vector<std::vector<uint8_t>> frames;
+
+  size_t consume(const uint8_t *data, size_t length)
+  {
+    size_t used = 0;
+    do
+    {
+      used += parser.consume(&data[used], length - used);
+      if (parser.ready())
+      {
+        frames.push_back(std::vector<uint8_t>(parser.frame(), parser.frame() + parser.length()));
+        parser.release();
+      }
+    } while (used < length || parser.ready());
+    return used;
+  }
+  // 読み直し待ちのバイトを入力なしで処理する
+  void drain()
+  {
+    while (parser.consume(NULL, 0), parser.ready())
+    {
+      frames.push_back(std::vector<uint8_t>(parser.frame(), parser.frame() + parser.length()));
+      parser.release();
+    }
+  }
+};
+
+static void assertFrames(const std::vector<std::vector<uint8_t>> &expected, const Collector &collector)
+{
+  TEST_ASSERT_EQUAL_UINT32(expected.size(), collector.frames.size());
+  for (size_t i = 0; i < expected.size(); i++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(expected[i].size(), collector.frames[i].size());
+    TEST_ASSERT_EQUAL_MEMORY(expected[i].data(), collector.frames[i].data(), expected[i].size());
+  }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// 1つのフレームを2つに分けるすべての位置
+void test_every_split_point(void)
+{
+  std::vector<uint8_t> frame = makeFrame(UBX_CLASS_NAV, UBX_NAV_PVT, UBX_NAV_PVT_LEN);
+  for (size_t split = 0; split <= frame.size(); split++)
+  {
+    Collector collector;
+    TEST_ASSERT_EQUAL_UINT32(split, collector.consume(frame.data(), split));
+    collector.consume(frame.data() + split, frame.size() - split);
+    assertFrames({frame}, collector);
+    TEST_ASSERT_EQUAL_UINT32(0, collector.parser.getDiscarded());
+  }
+}
+
+// DMAがリングに書き、GnssUart::fill()のように折り返しの手前までの連続した範囲を渡す
+void test_ring_wrap(void)
+{
+  std::vector<std::vector<uint8_t>> expected;
+  std::vector<uint8_t> stream;
+  for (int i = 0; i < 2000; i++)
+  {
+    // NAV-SATの最大に近いものも混ぜる (リングより長いフレームは2周以上にまたがる)
+    size_t payload = i % 97 == 0 ? 8 + 12 * 60 : nextRandom() % 200;
+    expected.push_back(makeFrame(nextRandom(), nextRandom(), payload));
+    append(stream, expected.back());
+  }
+
+  uint8_t ring[RING_SIZE];
+  uint32_t written = 0, consumed = 0;
+  uint32_t wraps = 0;
+  Collector collector;
+  while (consumed < stream.size())
+  {
+    // DMAが書き込む (読み出し位置を追い越さない範囲で)
+    uint32_t burst = 1 + nextRandom() % (RING_SIZE / 2);
+    for (uint32_t i = 0; i < burst && written < stream.size() && written - consumed < RING_SIZE; i++, written++)
+    {
+      ring[written % RING_SIZE] = stream[written];
+    }
+    while (consumed < written)
+    {
+      uint32_t tail = consumed % RING_SIZE;
+      uint32_t size = min(written - consumed, RING_SIZE - tail);
+      wraps += tail + size == RING_SIZE;
+      consumed += collector.consume(&ring[tail], size);
+    }
+  }
+  collector.drain();
+
+  assertFrames(expected, collector);
+  TEST_ASSERT_EQUAL_UINT32(expected.size(), collector.parser.getFrames());
+  TEST_ASSERT_EQUAL_UINT32(0, collector.parser.getChecksumErrors());
+  TEST_ASSERT_EQUAL_UINT32(0, collector.parser.getDiscarded());
+  TEST_ASSERT_TRUE(wraps > 100);
+}
+
+// 途中で切れた長いフレームの中に、次のフレームが丸ごと入っている
+void test_rescan_truncated_frame(void)
+{
+  std::vector<uint8_t> lost = makeFrame(UBX_CLASS_NAV, UBX_NAV_SAT, 600);
+  lost.resize(40);
+  std::vector<uint8_t> a = makeFrame(UBX_CLASS_TIM, UBX_TIM_TP, UBX_TIM_TP_LEN);
+  std::vector<uint8_t> b = makeFrame(UBX_CLASS_NAV, UBX_NAV_PVT, UBX_NAV_PVT_LEN);
+  std::vector<uint8_t> stream = lost;
+  for (int i = 0; i < 6; i++)
+  {
+    append(stream, i % 2 ? a : b);
+  }
+  // 切れたフレームが長さの分だけ読み終わるように、後ろにも続ける
+  std::vector<std::vector<uint8_t>> expected;
+  for (int i = 0; i < 6; i++)
+  {
+    expected.push_back(i % 2 ? a : b);
+  }
+  while (stream.size() < lost.size() + 700)
+  {
+    append(stream, a);
+    expected.push_back(a);
+  }
+
+  Collector collector;
+  for (size_t offset = 0; offset < stream.size(); offset += 7)
+  {
+    collector.consume(&stream[offset], min((size_t)7, stream.size() - offset));
+  }
+  collector.drain();
+
+  assertFrames(expected, collector);
+  TEST_ASSERT_EQUAL_UINT32(1, collector.parser.getChecksumErrors());
+  TEST_ASSERT_EQUAL_UINT32(lost.size(), collector.parser.getDiscarded());
+}
+
+// 長さがUBX_FRAME_MAX_PAYLOADを超える見出し、0xB5の重複、ペイロードの中の同期文字
+void test_rescan_bad_headers(void)
+{
+  std::vector<uint8_t> a = makeFrame(UBX_CLASS_RXM, UBX_RXM_SFRBX, 40);
+  std::vector<uint8_t> b = makeFrame(UBX_CLASS_NAV, UBX_NAV_PVT, UBX_NAV_PVT_LEN);
+  // ペイロードに同期文字を含むフレーム
+  std::vector<uint8_t> p(32, 0);
+  p[3] = UBX_FRAME_SYNC1;
+  p[4] = UBX_FRAME_SYNC2;
+  UbxLog log;
+  log.addFrame(UBX_CLASS_NAV, UBX_NAV_SAT, p);
+  std::vector<uint8_t> c = log.bytes;
+
+  std::vector<uint8_t> stream = {UBX_FRAME_SYNC1, UBX_FRAME_SYNC2, 0x01, 0x02, 0xff, 0xff};
+  append(stream, a);
+  stream.push_back(UBX_FRAME_SYNC1);
+  append(stream, b);
+  stream.push_back(0x00);
+  append(stream, c);
+
+  Collector collector;
+  collector.consume(stream.data(), stream.size());
+  collector.drain();
+
+  assertFrames({a, b, c}, collector);
+  TEST_ASSERT_EQUAL_UINT32(1, collector.parser.getOversized());
+  TEST_ASSERT_EQUAL_UINT32(0, collector.parser.getChecksumErrors());
+  TEST_ASSERT_EQUAL_UINT32(6 + 1 + 1, collector.parser.getDiscarded());
+}
+
+// リングがあふれたら読みかけを捨て、次のフレームから読み直す
+void test_restart_after_overrun(void)
+{
+  // 読み直した後半に同期文字が現れないように、ペイロードは0にする
+  UbxLog log;
+  log.addFrame(UBX_CLASS_NAV, UBX_NAV_PVT, std::vector<uint8_t>(UBX_NAV_PVT_LEN, 0));
+  std::vector<uint8_t> a = log.bytes;
+  std::vector<uint8_t> b = makeFrame(UBX_CLASS_TIM, UBX_TIM_TP, UBX_TIM_TP_LEN);
+  Collector collector;
+  collector.consume(a.data(), 50);
+  collector.parser.restart();
+  TEST_ASSERT_EQUAL_UINT32(50, collector.parser.getDiscarded());
+  // 上書きされた残りの後半から読み始める
+  collector.consume(a.data() + 70, a.size() - 70);
+  collector.consume(b.data(), b.size());
+  collector.drain();
+  assertFrames({b}, collector);
+}
+
+// ゴミ、切れたフレーム、長すぎる見出しを混ぜた長い列をランダムな大きさで渡す
+void test_rescan_random_stream(void)
+{
+  std::vector<std::vector<uint8_t>> expected;
+  std::vector<uint8_t> stream;
+  for (int i = 0; i < 3000; i++)
+  {
+    switch (nextRandom() % 8)
+    {
+    case 0:
+      for (uint32_t n = nextRandom() % 20; n > 0; n--)
+      {
+        stream.push_back(nextRandom() % 3 == 0 ? UBX_FRAME_SYNC1 : nextRandom());
+      }
+      break;
+    case 1:
+    {
+      std::vector<uint8_t> lost = makeFrame(UBX_CLASS_NAV, UBX_NAV_SAT, 200 + nextRandom() % 800);
+      lost.resize(6 + nextRandom() % 20);
+      append(stream, lost);
+      break;
+    }
+    case 2:
+      append(stream, {UBX_FRAME_SYNC1, UBX_FRAME_SYNC2, 0x01, 0x02, 0xff, 0xff});
+      break;
+    default:
+      expected.push_back(makeFrame(nextRandom(), nextRandom(), nextRandom() % 120));
+      append(stream, expected.back());
+      break;
+    }
+  }
+  // 最後に始まった偽の見出しが長さの分だけ読み終わるように、受信機が送り続ける分を足す
+  stream.resize(stream.size() + UBX_FRAME_MAX_PAYLOAD + UBX_FRAME_OVERHEAD, 0);
+
+  Collector collector;
+  size_t offset = 0;
+  while (offset < stream.size())
+  {
+    size_t size = min((size_t)(nextRandom() % 300), stream.size() - offset);
+    offset += collector.consume(&stream[offset], size);
+  }
+  collector.drain();
+
+  assertFrames(expected, collector);
+  char line[128];
+  snprintf(line, sizeof(line), "%u frames, %u checksum errors, %u oversized, %u bytes discarded",
+           (unsigned)collector.parser.getFrames(), (unsigned)collector.parser.getChecksumErrors(),
+           (unsigned)collector.parser.getOversized(), (unsigned)collector.parser.getDiscarded());
+  TEST_MESSAGE(line);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_every_split_point);
+  RUN_TEST(test_ring_wrap);
+  RUN_TEST(test_rescan_truncated_frame);
+  RUN_TEST(test_rescan_bad_headers);
+  RUN_TEST(test_restart_after_overrun);
+  RUN_TEST(test_rescan_random_stream);
+  return UNITY_END();
+}